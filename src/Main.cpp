@@ -5,6 +5,30 @@
 #include "rtre.h"
 #include "GLFW/rtre_Window.h"
 #include "engine_movement/controller.h"
+#include "engine_abstractions/shader_library.h"
+#include "engine_abstractions/shader_permutations.h"
+#include "engine_abstractions/texture_load_benchmark.h"
+#include "engine_rendering/frame_pipeline.h"
+#include "engine_rendering/feature_profiler.h"
+#include "engine_rendering/normal_pass.h"
+#include "engine_rendering/normal_benchmark.h"
+#include "engine_rendering/light_benchmark.h"
+#include "engine_rendering/debug_lines.h"
+#include "engine_rendering/stream_benchmark.h"
+#include "engine_rendering/material_buffer.h"
+#include "engine_rendering/scene_param_buffer.h"
+#include "engine_rendering/scene_compiler.h"
+#include "engine_rendering/interpreter_benchmark.h"
+#include "engine_scene/scene_codegen.h"
+#include "engine_scene/mesher_benchmark.h"
+#include "engine_scene/evaluator_benchmark.h"
+#include "engine_scene/expression_benchmark.h"
+#include "engine_scene/query_benchmark.h"
+#include "engine_scene/scene_load_benchmark.h"
+#include "engine_scene/scene_reloader.h"
+#include "engine_meshes/mesh_export.h"
+#include "engine_meshes/lod_chain.h"
+#include "engine_meshes/upload_benchmark.h"
 
 #define LOG(x) std::cout << x << "\n"
 
@@ -12,6 +36,121 @@ void prv(glm::vec3 v) {
 	std::cout << v.x << " " << v.y << " " << v.z << "\n";
 }
 
+/*
+Tileable RGBA test patterns for the material atlas
+*/
+std::vector<uint8_t> pattern(int kind, int size) {
+	std::vector<uint8_t> pixels(size_t(size) * size * 4, 255);
+	for (int y = 0; y < size; y++)
+		for (int x = 0; x < size; x++) {
+			uint8_t* texel = &pixels[(size_t(y) * size + x) * 4];
+			if (kind == 0) {
+				uint8_t v = ((x / (size / 8)) + (y / (size / 8))) % 2 ? 230 : 60;
+				texel[0] = texel[1] = texel[2] = v;
+			}
+			else if (kind == 1) {
+				uint8_t v = (x / (size / 16)) % 2 ? 220 : 120;
+				texel[0] = v;
+				texel[1] = uint8_t(v / 2);
+				texel[2] = 40;
+			}
+			else {
+				uint32_t h = uint32_t(x * 374761393 + y * 668265263);
+				h = (h ^ (h >> 13)) * 1274126177;
+				uint8_t v = uint8_t(150 + (h >> 24) % 100);
+				texel[0] = uint8_t(v / 3);
+				texel[1] = v;
+				texel[2] = uint8_t(v / 2);
+			}
+		}
+	return pixels;
+}
+
+/*
+Lists the scene's nodes and edits the selected one, returns true if anything was edited
+Type changes between binary operators are structural, everything else only touches params
+*/
+bool inspectScene(rtre::SdfScene& scene, int& selected, rtre::SdfEdit& edit) {
+	static const char* s_Types[] = { "Sphere", "Box", "Union", "Smooth Union", "Subtract", "Intersect", "Repeat", "Round" };
+	const auto& nodes = scene.nodes();
+	if (selected >= int(nodes.size()))
+		selected = -1;
+
+	ImGui::BeginChild("Scene Nodes", ImVec2(0, 120), true);
+	ImGuiListClipper clipper;
+	clipper.Begin(int(nodes.size()));
+	while (clipper.Step())
+		for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+			std::string label = std::to_string(i) + " " + s_Types[nodes[i].type] + (nodes[i].name.empty() ? "" : " " + nodes[i].name)
+				+ (i == scene.root() ? " (root)" : "");
+			if (ImGui::Selectable(label.c_str(), i == selected))
+				selected = i;
+		}
+	ImGui::EndChild();
+	if (selected < 0)
+		return false;
+
+	rtre::SdfNode node = scene.node(selected);
+	bool changed = false;
+	switch (node.type) {
+	case rtre::rNsphere:
+		changed |= ImGui::DragFloat3("Centre", (float*)&node.params[0], 0.01f);
+		changed |= ImGui::DragFloat("Radius", &node.params[0].w, 0.01f, 0, 100);
+		break;
+	case rtre::rNbox:
+		changed |= ImGui::DragFloat3("Origin", (float*)&node.params[0], 0.01f);
+		changed |= ImGui::DragFloat3("Half Extents", (float*)&node.params[1], 0.01f, 0, 100);
+		break;
+	case rtre::rNunion:
+	case rtre::rNsmoothUnion:
+	case rtre::rNsubtract:
+	case rtre::rNintersect: {
+		int type = node.type - rtre::rNunion;
+		if (ImGui::Combo("Operator", &type, "Union\0Smooth Union\0Subtract\0Intersect\0")) {
+			node.type = rtre::SdfType(rtre::rNunion + type);
+			changed = true;
+		}
+		if (node.type == rtre::rNsmoothUnion)
+			changed |= ImGui::DragFloat("Blend", &node.params[0].x, 0.01f, 0, 10);
+		break;
+	}
+	case rtre::rNrepeat:
+		changed |= ImGui::DragFloat("Period", &node.params[0].x, 0.01f, 0.01f, 100);
+		break;
+	case rtre::rNround:
+		changed |= ImGui::DragFloat("Rounding", &node.params[0].x, 0.01f, 0, 10);
+		break;
+	}
+	if (node.isPrimitive())
+		changed |= ImGui::SliderInt("Material", &node.material, -1, int(scene.materials().size()) - 1);
+
+	if (changed)
+		edit = scene.edit(selected, node);
+	return changed;
+}
+
+/*
+Flips the root, or else the first binary operator, between union and smooth union, a structural edit every call
+Stands in for procedural content that rebuilds the scene each frame
+*/
+void toggleOperator(rtre::SdfScene& scene) {
+	const auto& nodes = scene.nodes();
+	GLint target = -1;
+	if (!scene.empty() && (nodes[scene.root()].type == rtre::rNunion || nodes[scene.root()].type == rtre::rNsmoothUnion))
+		target = scene.root();
+	for (GLint i = 0; target < 0 && i < GLint(nodes.size()); i++)
+		if (nodes[i].type == rtre::rNunion || nodes[i].type == rtre::rNsmoothUnion)
+			target = i;
+	if (target < 0)
+		return;
+
+	rtre::SdfNode node = nodes[target];
+	node.type = node.type == rtre::rNunion ? rtre::rNsmoothUnion : rtre::rNunion;
+	if (node.params[0].x <= 0)
+		node.params[0].x = 0.25f;
+	scene.edit(target, node);
+}
+
 float getTime() {
 	using std::chrono::milliseconds;
 	using std::chrono::duration_cast;
@@ -19,9 +158,12 @@ float getTime() {
 }
 
 
+glm::mat4 view(const rtre::Camera& c) {
+	return glm::lookAt(c.position(), c.position() + c.orientation(), glm::vec3(0, 1, 0));
+}
+
 glm::mat4 matrix(const rtre::Camera& c) {
-	auto view = glm::lookAt(c.position(), c.position() + c.orientation(), glm::vec3(0, 1, 0));
-	return glm::inverse(view);
+	return glm::inverse(view(c));
 	
 }
 
@@ -57,24 +199,184 @@ int main()
 	bool show_another_window = true;
 	ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 
-	std::shared_ptr<rtre::RenderShader> shader = std::make_shared<rtre::RenderShader>(".\\src\\engine_resources\\vert.vert", ".\\src\\engine_resources\\frag.frag", "");
-	rtre::Quad screen = rtre::Quad(shader);
+	rtre::FileWatcher watcher;
+	rtre::ShaderLibrary shaders(watcher);
+
+	rtre::SdfScene scene = rtre::SdfScene::demo();
+
+	// Material textures share one texture array binding, or are bindless where supported
+	rtre::TextureAtlas atlas(1024);
+	const char* patternNames[] = { "Checker", "Stripes", "Noise" };
+	const int patternSizes[] = { 256, 512, 128 };
+	for (int i = 0; i < 3; i++)
+		atlas.add(patternNames[i], pattern(i, patternSizes[i]).data(), patternSizes[i], patternSizes[i]);
+	bool bindlessTextures = false;
+	atlas.build(bindlessTextures);
+
+	rtre::SdfMaterial sphereMaterial;
+	sphereMaterial.name = "Sphere";
+	sphereMaterial.texture = 0;
+	sphereMaterial.scale = 4;
+	rtre::SdfMaterial boxMaterial;
+	boxMaterial.name = "Box";
+	boxMaterial.albedo = glm::vec3(0.9f, 0.8f, 0.7f);
+	boxMaterial.texture = 1;
+	scene.setMaterial(scene.find("Sphere"), scene.material(sphereMaterial));
+	scene.setMaterial(scene.find("Box"), scene.material(boxMaterial));
+
+	// A scene saved from the control panel replaces the demo, the binary copy is preferred when it is up to date
+	rtre::SceneLoadStats sceneLoadStats;
+	if (fs::exists("scene.json") || fs::exists("scene.rscn")) {
+		try {
+			if (fs::exists("scene.rscn") && (!fs::exists("scene.json") || fs::last_write_time("scene.rscn") >= fs::last_write_time("scene.json")))
+				scene = rtre::loadSceneFile("scene.rscn", &sceneLoadStats);
+			else
+				scene = rtre::loadSceneJson("scene.json", &sceneLoadStats);
+		}
+		catch (const std::exception& e) {
+			std::cout << e.what();
+		}
+	}
+	rtre::SceneLoadBenchmark sceneLoadBenchmark;
+
+	// Params live in a buffer, so moving a primitive patches that instead of rebuilding every shader including scene.glsl
+	rtre::SceneParamBuffer sceneParams;
+	sceneParams.update(scene);
+	int selectedNode = -1;
+	uint64_t paramEdits = 0, structuralEdits = 0;
+	rtre::MaterialBuffer materials;
+	materials.upload(scene, atlas);
+
+	// Structural edits run on the bytecode interpreter while they keep coming, and are generated again once the scene settles
+	rtre::SceneCompiler sceneCompiler;
+	sceneCompiler.update(scene, sceneParams.packing(), false);
+	rtre::RenderShader::preprocessor().setVirtualFile("scene.glsl", sceneCompiler.source());
+	int compileMode = sceneCompiler.mode();
+	bool proceduralEdits = false;
+	const rtre::SdfScene startupScene = scene;
+	int referenceScene = 0;
+	const char* referenceNames[] = { "Startup", "Scatter 16", "Scatter 128", "Pillars" };
+	rtre::InterpreterBenchmark interpreterBenchmark;
+	bool runInterpreterBenchmark = false;
+	int benchmarkRestoreMode = -1;
+
+	rtre::ShaderPermutations raymarcher(".\\src\\engine_resources\\vert.vert", ".\\src\\engine_resources\\frag.frag", shaders);
+	rtre::ShaderPermutations normalShaders(".\\src\\engine_resources\\vert.vert", ".\\src\\engine_resources\\normals.frag", shaders,
+		rtre::rFdomainRepetition | rtre::rFanalyticNormals | rtre::rFcentralNormals | rtre::rFsceneInterpreter);
+
+	GLuint features = rtre::rFdomainRepetition | rtre::rFshadows | rtre::rFambientOcclusion;
+	raymarcher.warmUp({
+		features,
+		features & ~rtre::rFshadows,
+		features & ~rtre::rFambientOcclusion,
+		features | rtre::rFsceneInterpreter,
+		rtre::rFdomainRepetition | rtre::rFdebugHeatmap });
+
+	rtre::Quad screen = rtre::Quad(raymarcher.select(features));
 	GLfloat fov = 75.f;
 
+	rtre::FeatureProfiler profiler;
+	profiler.track(rtre::rFshadows, "Soft Shadows", 4.0);
+	profiler.track(rtre::rFambientOcclusion, "Ambient Occlusion", 2.0);
+
+	rtre::HalfResolutionNormals halfResNormals;
+	rtre::NormalBenchmark normalBenchmark;
+	bool runNormalBenchmark = false;
+	int normalMethod = 0;
+	const GLuint normalMethods[] = { 0, rtre::rFcentralNormals, rtre::rFanalyticNormals };
+
+	const glm::vec3 lightsLow(-20, 0, -20), lightsHigh(20, 6, 20);
+	const std::vector<rtre::PointLight> scatteredLights = rtre::scatterLights(1024, lightsLow, lightsHigh);
+	rtre::LightBuffer sceneLights;
+	rtre::LightClusters clusters;
+	rtre::LightBenchmark lightBenchmark;
+	bool runLightBenchmark = false;
+	int pointLightCount = 64;
+
+	const glm::vec3 meshLow(-3, -3, -3), meshHigh(9, 9, 9);
+	rtre::BasicMesh sceneMesh;
+	rtre::MeshingStats meshStats;
+	std::vector<rtre::MeshingStats> meshingResults;
+	int meshDepth = 6;
+	int meshMethod = rtre::rMdualContouring;
+	rtre::EvaluatorBenchmark evaluatorBenchmark;
+	rtre::ExpressionBenchmark expressionBenchmark;
+	rtre::QueryBenchmark queryBenchmark;
+
+	// The simulation thread collides against its own copy of the scene, rebuilt after every edit
+	bool cameraCollision = false;
+	bool colliderStale = false;
+	float collisionRadius = 0.2f;
+	// Clicking the scene outside the panel selects the primitive under the cursor
+	rtre::SdfHit pick;
+
+	auto meshShader = std::make_shared<rtre::RenderShader>(".\\src\\engine_resources\\mesh.vert", ".\\src\\engine_resources\\mesh.frag");
+	shaders.add(meshShader);
+	rtre::LodChain sceneLods;
+	bool meshPreview = false;
+	auto extractMesh = [&]() {
+		rtre::SdfEvaluator evaluator(scene, (features & rtre::rFdomainRepetition) != 0);
+		rtre::SdfMesher mesher(evaluator, meshLow, meshHigh);
+		mesher.setDepth(meshDepth);
+		sceneMesh = mesher.extract(rtre::MeshingMethod(meshMethod));
+		meshStats = mesher.stats();
+		sceneLods.build(sceneMesh);
+	};
+
+	// Saving scene.json from an editor applies just the nodes that changed, the mesh is only extracted again if the change reaches it
+	rtre::SceneReloader sceneReloader(watcher, scene, "scene.json", [&](const rtre::SceneReloadStats& reload) {
+		if (reload.changedMaterials)
+			materials.upload(scene, atlas);
+		if (meshStats.resolution && reload.changed() && reload.touches(meshLow, meshHigh))
+			extractMesh();
+	});
+	float lodPixelError = 1.f;
+	GLuint lodLevel = 0;
+	// Vertical field of view the raymarcher's rays span, (x * aspect, y, -1) with y in [-0.5, 0.5]
+	const GLfloat raymarchFovY = 2 * std::atan(0.5f);
+	rtre::UploadBenchmark uploadBenchmark;
+
+	// Streams through a persistently mapped ring, left off on drivers without buffer storage
+	std::unique_ptr<rtre::DebugLines> debugLines;
+	if (rtre::StreamBuffer::supported()) {
+		auto linesShader = std::make_shared<rtre::RenderShader>(".\\src\\engine_resources\\lines.vert", ".\\src\\engine_resources\\lines.frag");
+		shaders.add(linesShader);
+		debugLines = std::make_unique<rtre::DebugLines>(linesShader);
+	}
+	bool drawDebugLines = false;
+	rtre::StreamBenchmark streamBenchmark;
+
+	// Builds its own loaders, nothing at startup requests textures, so no loader's workers and ring sit idle here
+	rtre::TextureLoadBenchmark textureLoadBenchmark;
+
+	rtre::FramePipeline pipeline;
+	int pacing = pipeline.pacing();
+	int framesInFlight = pipeline.framesInFlight();
+
 
 	float stime = getTime();
 	float time = 0;
 
 	bool cursorVisisble = true;
-	glm::vec3 sphereloc = glm::vec3(0,0,3);
-	GLfloat sphereRadius = 0.5f;
 	GLint maxits = 500;
 	GLfloat thresh = 0.001;
 	float speed = 1;
+	glm::vec3 lightPosition = glm::vec3(2, 3, -1);
+	GLfloat lightRange = 20.f;
+	bool adaptiveShadows = true;
+	GLint shadowSteps = 64;
+	GLfloat shadowSoftness = 8.f;
+	GLint aoSamples = 5;
+	GLfloat aoStep = 0.05f;
 	while (!window.shouldClose() && !window.isKeyPressed(GLFW_KEY_ESCAPE)) {
 
-		screen.m_Shader->checkAndHotplug();
+		pipeline.beginFrame();
+
 		rtre::Window::pollEvents();
+		rtre::controller::control();
+
+		watcher.dispatch();
+		shaders.update();
 
 		int display_w, display_h;
 
@@ -92,37 +394,387 @@ int main()
 		{
 			ImGui::Begin("Control Panel", &show_another_window);
 
-			ImGui::SliderFloat3("Sphere Position", (float*)&sphereloc, -1, 3);
-			ImGui::SliderFloat("Sphere Radius", &sphereRadius, 0, 2);
+			rtre::SdfEdit sceneEdit;
+			if (ImGui::CollapsingHeader("Scene") && inspectScene(scene, selectedNode, sceneEdit))
+				(sceneEdit == rtre::rEparams ? paramEdits : structuralEdits)++;
+			ImGui::Text("Scene edits: %llu param, %llu structural, last upload %lld bytes",
+				(unsigned long long)paramEdits, (unsigned long long)structuralEdits, (long long)sceneParams.uploadedBytes());
+			if (ImGui::Combo("Scene Code", &compileMode, "Automatic\0Generated\0Interpreted\0"))
+				sceneCompiler.setMode(rtre::SceneCompileMode(compileMode));
+			if (ImGui::Combo("Reference Scene", &referenceScene, referenceNames, IM_ARRAYSIZE(referenceNames))) {
+				if (referenceScene == 0)
+					scene = startupScene;
+				else if (referenceScene == 3)
+					scene = rtre::sdf::toScene(rtre::sdf::pillars());
+				else
+					scene = rtre::SceneLoadBenchmark::scatter(referenceScene == 1 ? 16 : 128, 8);
+				sceneParams.invalidate();
+				sceneCompiler.invalidate();
+				sceneReloader.invalidate();
+				selectedNode = -1;
+			}
+			ImGui::Checkbox("Procedural Edits", &proceduralEdits);
+			colliderStale |= ImGui::Checkbox("Camera Collision", &cameraCollision);
+			colliderStale |= ImGui::SliderFloat("Collision Radius", &collisionRadius, 0.01f, 1.f);
+			if (pick.hit)
+				ImGui::Text("Picked node %d at (%.2f, %.2f, %.2f), %.2f away", selectedNode, pick.position.x, pick.position.y, pick.position.z,
+					pick.distance);
+			const rtre::SdfProgram& program = sceneCompiler.program();
+			ImGui::Text("%s: %zu instructions, stack %u, %u generated", sceneCompiler.interpreted() ? "Interpreted" : "Generated",
+				program.code.size(), program.stackDepth, sceneCompiler.generations());
+			if (ImGui::Button("Benchmark Interpreter") && benchmarkRestoreMode < 0) {
+				// Needs generated code for the current scene, measured once it is built
+				benchmarkRestoreMode = compileMode;
+				sceneCompiler.setMode(rtre::rIgenerated);
+			}
+			for (const auto& cost : interpreterBenchmark.results()) {
+				if (cost.interpreted)
+					ImGui::Text("%s, %zu nodes, %zu instructions: generated %.2f ms, interpreted %.2f ms, %.2fx", cost.scene.c_str(), cost.nodes,
+						cost.instructions, cost.generatedMs, cost.interpretedMs, cost.overhead);
+				else
+					ImGui::Text("%s, %zu nodes, %zu instructions: generated %.2f ms, interpreter unsupported (stack %u)", cost.scene.c_str(), cost.nodes,
+						cost.instructions, cost.generatedMs, cost.stackDepth);
+			}
 			ImGui::DragInt("Max Iterations", &maxits, 1.f, 1, 5000);
 			ImGui::SliderFloat("Threshold", &thresh, .00001f, 0.01f,"%.5f");
 
 			ImGui::SliderFloat("Speed", (float*)&speed, 1, 100, "%.1f");
 
-			rtre::camera.setSpeed(glm::vec3(speed/1000000));
+			colliderStale |= ImGui::CheckboxFlags("Domain Repetition", &features, rtre::rFdomainRepetition);
+			ImGui::CheckboxFlags("Iteration Heatmap", &features, rtre::rFdebugHeatmap);
+			ImGui::CheckboxFlags("Materials", &features, rtre::rFmaterials);
+			if (rtre::TextureAtlas::bindlessSupported() && ImGui::Checkbox("Bindless Textures", &bindlessTextures)) {
+				atlas.build(bindlessTextures);
+				materials.upload(scene, atlas);
+			}
+			const rtre::AtlasStats& atlasStats = atlas.stats();
+			if (atlasStats.bindless)
+				ImGui::Text("%zu textures bindless, %.1f MB VRAM", atlasStats.entries, atlasStats.gpuBytes / 1048576.0);
+			else
+				ImGui::Text("%zu textures in %d pages, %.1f%% packed, %.1f MB VRAM", atlasStats.entries, atlasStats.pages,
+					atlasStats.efficiency * 100, atlasStats.gpuBytes / 1048576.0);
+
+			ImGui::Separator();
+			if (ImGui::Combo("Normals", &normalMethod, "Tetrahedral\0Central Differences\0Analytic\0"))
+				features = (features & ~(rtre::rFcentralNormals | rtre::rFanalyticNormals)) | normalMethods[normalMethod];
+			ImGui::CheckboxFlags("Half Resolution Normals", &features, rtre::rFhalfResNormals);
+			runNormalBenchmark = ImGui::Button("Benchmark Normals");
+			if (!normalBenchmark.results().empty()) {
+				ImGui::Text("%llu hit pixels", (unsigned long long)normalBenchmark.hitPixels());
+				for (const auto& cost : normalBenchmark.results())
+					ImGui::Text("%s: %.3f ms, %.2f ns/hit", cost.name.c_str(), cost.milliseconds, cost.nanosecondsPerHit);
+			}
+
+			ImGui::Separator();
+			ImGui::SliderFloat3("Light Position", (float*)&lightPosition, -10, 10);
+			ImGui::SliderFloat("Light Range", &lightRange, 0, 100);
+			ImGui::CheckboxFlags("Soft Shadows", &features, rtre::rFshadows);
+			ImGui::Checkbox("Adaptive Shadows", &adaptiveShadows);
+			ImGui::SliderInt("Shadow Steps", &shadowSteps, 1, 256);
+			ImGui::SliderFloat("Shadow Softness", &shadowSoftness, 1, 64);
+			ImGui::CheckboxFlags("Ambient Occlusion", &features, rtre::rFambientOcclusion);
+			ImGui::SliderInt("AO Samples", &aoSamples, 1, 16);
+			ImGui::SliderFloat("AO Step", &aoStep, 0.005f, 0.5f);
+
+			ImGui::Separator();
+			ImGui::SliderInt("Point Lights", &pointLightCount, 0, GLint(scatteredLights.size()));
+			ImGui::CheckboxFlags("Clustered Lights", &features, rtre::rFclusteredLights);
+			ImGui::Text("Light upload: %lld bytes, culling: %.3f ms", (long long)sceneLights.uploadedBytes(), clusters.cullMs());
+			ImGui::Text("Lights per cluster: %.2f average, %u max", clusters.averageLightsPerCluster(), clusters.maxLightsPerCluster());
+			runLightBenchmark = ImGui::Button("Benchmark Lights");
+			for (const auto& cost : lightBenchmark.results())
+				ImGui::Text("%zu lights: clustered %.2f ms, all %.2f ms, culling %.3f ms, %.1f / %u per cluster",
+					cost.lights, cost.clusteredMs, cost.bruteForceMs, cost.cullMs, cost.averageLightsPerCluster, cost.maxLightsPerCluster);
+
+			ImGui::Separator();
+			ImGui::SliderInt("Mesh Depth", &meshDepth, 3, 9);
+			ImGui::Combo("Mesher", &meshMethod, "Dual Contouring\0Marching Tetrahedra\0");
+			rtre::SdfEvaluator evaluator(scene, (features & rtre::rFdomainRepetition) != 0);
+			if (ImGui::Button("Extract Mesh"))
+				extractMesh();
+			ImGui::SameLine();
+			if (ImGui::Button("Export OBJ")) {
+				try {
+					rtre::writeObj(sceneMesh, "scene.obj");
+				}
+				catch (const std::exception& e) {
+					std::cout << e.what();
+				}
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Benchmark Meshing"))
+				meshingResults = rtre::benchmarkMeshing(evaluator, meshLow, meshHigh, 4, meshDepth);
+			ImGui::SameLine();
+			if (ImGui::Button("Benchmark Evaluators"))
+				evaluatorBenchmark.run(scene, meshLow, meshHigh, 1 << 20, (features & rtre::rFdomainRepetition) != 0);
+			if (!evaluatorBenchmark.results().empty())
+				ImGui::Text("%zu points, %zu instructions, %zu linked", evaluatorBenchmark.points(), evaluatorBenchmark.instructions(),
+					evaluatorBenchmark.linkedInstructions());
+			for (const auto& cost : evaluatorBenchmark.results())
+				ImGui::Text("%s on %u threads: %.1f ms, %.2f M points/s, %.2fx, error %g", cost.path.c_str(), cost.threads, cost.milliseconds,
+					cost.pointsPerSecond / 1e6, cost.speedup, cost.maxError);
+			if (ImGui::Button("Benchmark Expressions"))
+				expressionBenchmark.run(meshLow, meshHigh);
+			for (const auto& cost : expressionBenchmark.results())
+				ImGui::Text("%s, %zu nodes, %s: %.1f ms, %.2f M points/s, %.2fx, error %g", cost.scene.c_str(), cost.nodes, cost.path.c_str(),
+					cost.milliseconds, cost.pointsPerSecond / 1e6, cost.speedup, cost.maxError);
+			if (ImGui::Button("Benchmark Queries"))
+				queryBenchmark.run(scene, meshLow, meshHigh, 4096, (features & rtre::rFdomainRepetition) != 0);
+			for (const auto& cost : queryBenchmark.results())
+				ImGui::Text("%s, %s on %u threads: %.2f ms, %.2f M queries/s, %zu of %zu hit", cost.query.c_str(), cost.path.c_str(), cost.threads,
+					cost.milliseconds, cost.queriesPerSecond / 1e6, cost.hits, cost.count);
+			if (meshStats.resolution)
+				ImGui::Text("%zu vertices, %zu triangles in %.1f ms", meshStats.vertices, meshStats.triangles, meshStats.milliseconds);
+			ImGui::Checkbox("Mesh Preview", &meshPreview);
+			ImGui::SliderFloat("LOD Pixel Error", &lodPixelError, 0.25f, 16.f);
+			for (GLuint i = 0; i < sceneLods.levelCount(); i++) {
+				const rtre::MeshLod& lod = sceneLods.levels()[i];
+				ImGui::Text("%sLOD %u: %u triangles, error %.4f, built in %.1f ms", i == lodLevel ? "> " : "  ", i, lod.triangles(), lod.error, lod.buildMs);
+			}
+			if (ImGui::Button("Benchmark Uploads"))
+				uploadBenchmark.run();
+			for (const auto& cost : uploadBenchmark.results()) {
+				if (cost.allocationsCounted)
+					ImGui::Text("%zu vertices, %s: %.2f ms, %llu allocations", uploadBenchmark.vertices(), cost.path.c_str(), cost.milliseconds, (unsigned long long)cost.allocations);
+				else
+					ImGui::Text("%zu vertices, %s: %.2f ms, allocations not counted", uploadBenchmark.vertices(), cost.path.c_str(), cost.milliseconds);
+			}
+			if (debugLines)
+				ImGui::Checkbox("Debug Lines", &drawDebugLines);
+			if (ImGui::Button("Benchmark Streaming"))
+				streamBenchmark.run();
+			for (const auto& cost : streamBenchmark.results())
+				ImGui::Text("%s: %.3f ms per MB, %.2f GB/s, %llu waits", cost.path.c_str(), cost.milliseconds, cost.gigabytesPerSecond, (unsigned long long)cost.waits);
+			if (streamBenchmark.overrunErrors() >= 0)
+				ImGui::Text("Ring overrun check: %d bad chunks", streamBenchmark.overrunErrors());
+			if (ImGui::Button("Save Scene")) {
+				try {
+					rtre::writeSceneJson(scene, "scene.json");
+					rtre::writeSceneFile(scene, "scene.rscn");
+				}
+				catch (const std::exception& e) {
+					std::cout << e.what();
+				}
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Benchmark Scene Loading"))
+				sceneLoadBenchmark.run();
+			const rtre::SceneReloadStats& reload = sceneReloader.stats();
+			if (!reload.error.empty())
+				ImGui::TextColored(ImVec4(1, 0.3f, 0.3f, 1), "Scene reload failed: %s", reload.error.c_str());
+			else if (!reload.path.empty())
+				ImGui::Text("Reloaded in %.2f ms (parse %.2f%s, diff %.2f, apply %.2f): %zu changed, %zu added, %zu removed%s", reload.milliseconds,
+					reload.parseMs, reload.partial ? " nodes only" : "", reload.diffMs, reload.applyMs, reload.changedNodes, reload.addedNodes,
+					reload.removedNodes, reload.structural ? ", structural" : "");
+			if (sceneLoadStats.bytes)
+				ImGui::Text("Loaded %s: %zu nodes in %.2f ms, %.1f MB/s", sceneLoadStats.path.c_str(), sceneLoadStats.nodes,
+					sceneLoadStats.milliseconds, sceneLoadStats.megabytesPerSecond);
+			for (const auto& cost : sceneLoadBenchmark.results()) {
+				if (cost.allocationsCounted)
+					ImGui::Text("%zu primitives, %s: %.1f MB in %.1f ms, %.1f MB/s, %llu allocations", cost.primitives, cost.path.c_str(),
+						cost.bytes / 1048576.0, cost.milliseconds, cost.megabytesPerSecond, (unsigned long long)cost.allocations);
+				else
+					ImGui::Text("%zu primitives, %s: %.1f MB in %.1f ms, %.1f MB/s, allocations not counted", cost.primitives, cost.path.c_str(),
+						cost.bytes / 1048576.0, cost.milliseconds, cost.megabytesPerSecond);
+			}
+			if (ImGui::Button("Benchmark Texture Loading"))
+				textureLoadBenchmark.run(".\\textures\\benchmark");
+			for (const auto& cost : textureLoadBenchmark.results())
+				ImGui::Text("%zu textures, %s on %u threads: %.1f ms (%.2fx), %.1f MB VRAM", textureLoadBenchmark.textures(), cost.path.c_str(), cost.threads,
+					cost.milliseconds, cost.speedup, cost.gpuBytes / 1048576.0);
+			for (const auto& stats : meshingResults)
+				ImGui::Text("%s %u^3: %.1f ms, %.2f M cells/s, %llu active cells, %.2f MB cells, %.2f MB mesh",
+					stats.method == rtre::rMdualContouring ? "DC" : "MT", stats.resolution, stats.milliseconds, stats.cellsPerSecond / 1e6,
+					(unsigned long long)stats.activeCells, stats.cellBytes / 1048576.0, stats.meshBytes / 1048576.0);
+
+			ImGui::Text("Raymarch pass: %.2f ms", profiler.frameMs());
+			for (const auto& feature : profiler.features()) {
+				ImVec4 color = profiler.overBudget(feature) ? ImVec4(1, 0.3f, 0.3f, 1) : ImVec4(1, 1, 1, 1);
+				ImGui::TextColored(color, "%s: %.2f / %.2f ms", feature.name.c_str(), profiler.costMs(feature), feature.budgetMs);
+			}
+
+			rtre::camera.setSpeed(glm::vec3(speed));
+
+			ImGui::Separator();
+			if (ImGui::Combo("Pacing", &pacing, "Latency\0Throughput\0"))
+				pipeline.setPacing(rtre::FramePacing(pacing));
+			if (ImGui::SliderInt("Frames In Flight", &framesInFlight, 1, 4))
+				pipeline.setFramesInFlight(framesInFlight);
+
+			const rtre::FrameStats& frameStats = pipeline.stats();
+			ImGui::Text("%.2f ms/frame (%.1f FPS)", frameStats.frameMs, frameStats.framesPerSecond);
+			ImGui::Text("Input to GPU done: %.2f ms, fence wait: %.2f ms", frameStats.latencyMs, frameStats.waitMs);
+
+			// Calls made through the abstractions, raw GL and ImGui aren't counted
+			const rtre::glstate::Counters& glCalls = rtre::glstate::lastFrame();
+			ImGui::Checkbox("Filter Redundant State", &rtre::glstate::filterRedundant);
+			ImGui::Text("%s: %llu GL calls, %llu binds, %llu redundant", rtre::glstate::directStateAccess() ? "DSA" : "Bind to edit",
+				(unsigned long long)glCalls.calls, (unsigned long long)glCalls.binds, (unsigned long long)glCalls.redundant);
 
 			ImGui::End();
 		}
 
 		GLfloat aspectRatio = aspectRatio = float(display_w) / display_h;
+		glm::mat4 viewProjection = glm::perspective(raymarchFovY, aspectRatio, 0.05f, 500.f) * view(rtre::camera);
 
 		rtre::setBackgroundColor(0.5, 0.1, 0.1, 1.0);
-		screen.m_Shader->SetUniform("cameraPos", rtre::camera.position());
-		screen.m_Shader->SetUniform("cameraFov", fov);
-		screen.m_Shader->SetUniform("time", time);
-		screen.m_Shader->SetUniform("aspec", aspectRatio);
-		screen.m_Shader->SetUniform("sphereloc", sphereloc);
-		screen.m_Shader->SetUniform("sphereRadius", sphereRadius);
-		screen.m_Shader->SetUniform("maxits", maxits);
-		screen.m_Shader->SetUniform("thresh", thresh);
-		screen.m_Shader->SetUniform("matrix", matrix(rtre::camera));
-		screen.draw();
+		// Only lights past the current count are added, the buffer uploads just those
+		while (sceneLights.count() < pointLightCount)
+			sceneLights.add(scatteredLights[sceneLights.count()]);
+		while (sceneLights.count() > pointLightCount)
+			sceneLights.remove(sceneLights.count() - 1);
+		sceneLights.upload();
+
+		if (proceduralEdits) {
+			toggleOperator(scene);
+			structuralEdits++;
+		}
+		// Param edits were patched into the buffer, structural ones recompile the bytecode and regenerate the code when it is used
+		bool sceneStructural = sceneParams.update(scene, sceneCompiler.packingsInUse());
+		if (sceneStructural)
+			materials.upload(scene, atlas);
+		bool repetition = (features & rtre::rFdomainRepetition) != 0;
+		if (colliderStale || (cameraCollision && (sceneStructural || sceneParams.uploadedBytes() > 0))) {
+			rtre::controller::setCollider(cameraCollision ? std::make_shared<const rtre::CameraCollider>(scene, collisionRadius, repetition) : nullptr);
+			colliderStale = false;
+		}
+		if (ImGui::IsMouseClicked(0) && !ImGui::GetIO().WantCaptureMouse) {
+			// The raymarcher's ray through the cursor, see frag.frag
+			const ImGuiIO& io = ImGui::GetIO();
+			glm::vec2 screenPosition(io.MousePos.x / io.DisplaySize.x - 0.5f, 0.5f - io.MousePos.y / io.DisplaySize.y);
+			glm::vec3 direction = glm::vec3(matrix(rtre::camera) * glm::vec4(glm::normalize(glm::vec3(screenPosition.x * aspectRatio, screenPosition.y, -1)), 0));
+			rtre::BytecodeEvaluator picker(scene, repetition);
+			pick = rtre::SdfQueries(picker, thresh, maxits).rayCast({ rtre::camera.position(), direction, 500.f });
+			if (pick.hit)
+				selectedNode = picker.primitiveAt(pick.position);
+		}
+		if (sceneCompiler.update(scene, sceneParams.packing(), shaders.hasPendingReloads())) {
+			rtre::RenderShader::preprocessor().setVirtualFile("scene.glsl", sceneCompiler.source());
+			shaders.touch(rtre::ShaderPreprocessor::virtualKey("scene.glsl"));
+		}
+		runInterpreterBenchmark = benchmarkRestoreMode >= 0 && !sceneCompiler.interpreted() && !shaders.hasPendingReloads();
 
+		if (features & rtre::rFclusteredLights) {
+			clusters.cull(sceneLights, view(rtre::camera), aspectRatio);
+			clusters.upload();
+		}
 
+		auto bindLights = [&](rtre::LightBuffer& lights, rtre::LightClusters& lightClusters) {
+			lights.bind();
+			lightClusters.bind();
+			screen.m_Shader->SetUniform("lightCount", lights.count());
+			lightClusters.setUniforms(*screen.m_Shader);
+		};
+
+		auto drawPass = [&](rtre::ShaderPermutations& permutations, GLuint variant) {
+			if ((variant & rtre::rFmaterials) && atlas.bindless())
+				variant |= rtre::rFbindlessTextures;
+			if (sceneCompiler.interpreted())
+				variant |= rtre::rFsceneInterpreter;
+			screen.m_Shader = permutations.select(variant);
+			screen.m_Shader->activate();
+
+			screen.m_Shader->SetUniform("cameraPos", rtre::camera.position());
+			screen.m_Shader->SetUniform("cameraFov", fov);
+			screen.m_Shader->SetUniform("time", time);
+			screen.m_Shader->SetUniform("aspec", aspectRatio);
+			screen.m_Shader->SetUniform("maxits", maxits);
+			screen.m_Shader->SetUniform("thresh", thresh);
+			screen.m_Shader->SetUniform("matrix", matrix(rtre::camera));
+			screen.m_Shader->SetUniform("lightP", lightPosition);
+			screen.m_Shader->SetUniform("lightRange", lightRange);
+			screen.m_Shader->SetUniform("adaptiveShadows", GLint(adaptiveShadows));
+			screen.m_Shader->SetUniform("shadowSteps", shadowSteps);
+			screen.m_Shader->SetUniform("shadowSoftness", shadowSoftness);
+			screen.m_Shader->SetUniform("aoSamples", aoSamples);
+			screen.m_Shader->SetUniform("aoStep", aoStep);
+			bindLights(sceneLights, clusters);
+			sceneParams.bind();
+			sceneCompiler.bind();
+			if (variant & rtre::rFmaterials)
+				materials.bind(*screen.m_Shader, atlas);
+		};
+
+		// Hit pass at full resolution, then one normal per 2x2 block of it
+		auto drawHalfResNormals = [&](GLuint variant, GLint width, GLint height) {
+			halfResNormals.resize(display_w, display_h);
+			halfResNormals.render(width, height,
+				[&]() {
+					drawPass(raymarcher, (variant & rtre::rFdomainRepetition) | rtre::rFhitPass);
+					screen.draw();
+				},
+				[&]() {
+					drawPass(normalShaders, variant);
+					screen.m_Shader->SetUniform("resolution", glm::vec2(width, height));
+					screen.m_Shader->SetUniform("hitBuffer", 0);
+					screen.draw();
+				});
+		};
+
+		rtre::setBackgroundColor(0.5, 0.1, 0.1, 1.0);
+		if (runNormalBenchmark)
+			normalBenchmark.run(features,
+				[&](GLuint variant) { drawPass(raymarcher, variant); screen.draw(); },
+				[&]() { drawPass(raymarcher, (features & rtre::rFdomainRepetition) | rtre::rFhitPass); screen.draw(); },
+				[&]() { drawHalfResNormals(features & ~rtre::rFhalfResNormals, display_w, display_h); });
+
+		if (runInterpreterBenchmark) {
+			interpreterBenchmark.run(referenceNames[referenceScene], scene, sceneCompiler.program(), features,
+				[&](GLuint variant) { drawPass(raymarcher, variant); screen.draw(); });
+			sceneCompiler.setMode(rtre::SceneCompileMode(benchmarkRestoreMode));
+			benchmarkRestoreMode = -1;
+		}
+
+		if (runLightBenchmark)
+			lightBenchmark.run({ 1, 64, 1024 }, features & ~rtre::rFhalfResNormals, view(rtre::camera), aspectRatio, lightsLow, lightsHigh,
+				[&](GLuint variant, rtre::LightBuffer& lights, rtre::LightClusters& lightClusters) {
+					drawPass(raymarcher, variant);
+					bindLights(lights, lightClusters);
+					screen.draw();
+				});
+
+		if (meshPreview && !sceneLods.empty()) {
+			glm::vec3 eye = rtre::camera.position();
+			lodLevel = sceneLods.select(glm::length(eye - glm::clamp(eye, meshLow, meshHigh)), raymarchFovY, GLfloat(display_h), lodPixelError);
+
+			glEnable(GL_DEPTH_TEST);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			meshShader->activate();
+			meshShader->SetUniform("viewProjection", viewProjection);
+			meshShader->SetUniform("cameraPos", rtre::camera.position());
+			meshShader->SetUniform("lightP", lightPosition);
+			meshShader->SetUniform("lightRange", lightRange);
+			sceneLods.draw(lodLevel);
+			glDisable(GL_DEPTH_TEST);
+		}
+		else {
+			profiler.render(features, display_w, display_h, [&](GLuint variant, GLint width, GLint height) {
+				if (variant & rtre::rFhalfResNormals)
+					drawHalfResNormals(variant, width, height);
+
+				drawPass(raymarcher, variant);
+				if (variant & rtre::rFhalfResNormals) {
+					screen.m_Shader->SetUniform("hitBuffer", 0);
+					screen.m_Shader->SetUniform("normalBuffer", 1);
+				}
+				screen.draw();
+			});
+		}
+
+		if (debugLines && drawDebugLines) {
+			debugLines->box(meshLow, meshHigh, glm::vec3(1, 1, 0));
+			debugLines->cross(lightPosition, 0.5f, glm::vec3(1));
+			for (GLint i = 0; i < pointLightCount; i++)
+				debugLines->cross(scatteredLights[i].position, 0.2f, scatteredLights[i].diffuse);
+			debugLines->flush(viewProjection);
+		}
 
 		// Rendering
 		ImGui::Render();
 		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		// The backend restores the bindings it changes, but behind the state cache's back
+		rtre::glstate::invalidate();
+		rtre::glstate::endFrame();
 
 		if (window.isKeyPressed(GLFW_KEY_F) && !cursorVisisble) {
 			cursorVisisble = !cursorVisisble;
@@ -135,11 +787,12 @@ int main()
 
 		time = getTime() - stime;
 
-		rtre::controller::control();
 		window.swapBuffers();
+		pipeline.endFrame();
 	}
 
 
+	rtre::controller::stop();
 	ImGui_ImplOpenGL3_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
 	ImGui::DestroyContext();
@@ -1,9 +1,11 @@
 #pragma once
 #include <exception>
 #include <array>
+#include <algorithm>
 #include "glad/glad.h"
 #include "dependencies/stb_image.h"
 #include "shader.h"
+#include "gl_state.h"
 
 namespace rtre {
 
@@ -18,7 +20,10 @@ namespace rtre {
 		virtual inline GLuint unit() const { return m_Unit; }
 		virtual inline GLuint id() const { return m_ID; }
 		virtual inline Senum type() const { return m_Type; }
-		virtual inline void free() { glDeleteTextures(1, &m_ID); };
+		virtual inline void free() {
+			glDeleteTextures(1, &m_ID);
+			glstate::forgetTexture(m_ID);
+		};
 
 		virtual inline void setUnit(GLuint unit) { m_Unit = unit; }
 		virtual inline void setType(Senum type) { m_Type = type; }
@@ -46,118 +51,91 @@ namespace rtre {
 	};
 
 	class Sampler2D : public Sampler {
-	public:
-		Sampler2D(const char* image, GLuint unit, Senum type = rTdiffuse)
-		{
-			m_Unit = unit;
-			m_Type = type;
+
+		static GLsizei mipLevels(GLsizei width, GLsizei height) {
+			GLsizei levels = 1;
+			while ((std::max(width, height) >> levels) > 0)
+				levels++;
+			return levels;
+		}
+
+		/*
+		With DSA the texture gets immutable storage and is never bound to be filled
+		*/
+		void load(const char* image) {
 			int widthImg, heightImg, numColCh;
 			stbi_set_flip_vertically_on_load(true);
 			unsigned char* bytes = stbi_load(image, &widthImg, &heightImg, &numColCh, 0);
 
-			glGenTextures(1, &m_ID);
-			glActiveTexture(GL_TEXTURE0 + unit);
-			glBindTexture(GL_TEXTURE_2D, m_ID);
-			
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-			if (bytes) {
-				switch (numColCh) {
-				case 4:
-					glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, widthImg, heightImg, 0, GL_RGBA, GL_UNSIGNED_BYTE, bytes);
-					break;
-				case 3:
-					glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, widthImg, heightImg, 0, GL_RGB, GL_UNSIGNED_BYTE, bytes);
-					break;
-				case 1:
-					glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, widthImg, heightImg, 0, GL_RED, GL_UNSIGNED_BYTE, bytes);
-					break;
-				default:
-				{
-					stbi_image_free(bytes);
-					glBindTexture(GL_TEXTURE_2D, 0);
-					throw std::exception("Automatic Texture type recognition failed\n");
-					break;
-				}
-				}
-
-				glGenerateMipmap(GL_TEXTURE_2D);
-				glBindTexture(GL_TEXTURE_2D, 0);
+			if (!bytes) {
+				std::string exceptionMessage = "Failed to load texture: " + std::string(image);
+				throw std::exception(exceptionMessage.c_str());
+			}
 
+			GLenum format;
+			switch (numColCh) {
+			case 4:
+				format = GL_RGBA;
+				break;
+			case 3:
+				format = GL_RGB;
+				break;
+			case 1:
+				format = GL_RED;
+				break;
+			default:
 				stbi_image_free(bytes);
+				throw std::exception("Automatic Texture type recognition failed\n");
+			}
+
+			if (glstate::directStateAccess()) {
+				glext::glCreateTextures(GL_TEXTURE_2D, 1, &m_ID);
+				glext::glTextureParameteri(m_ID, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+				glext::glTextureParameteri(m_ID, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+				glext::glTextureParameteri(m_ID, GL_TEXTURE_WRAP_S, GL_REPEAT);
+				glext::glTextureParameteri(m_ID, GL_TEXTURE_WRAP_T, GL_REPEAT);
+				glext::glTextureStorage2D(m_ID, mipLevels(widthImg, heightImg), GL_RGBA8, widthImg, heightImg);
+				glext::glTextureSubImage2D(m_ID, 0, 0, 0, widthImg, heightImg, format, GL_UNSIGNED_BYTE, bytes);
+				glext::glGenerateTextureMipmap(m_ID);
+				glstate::count(8);
 			}
 			else {
-				glBindTexture(GL_TEXTURE_2D, 0);
-				std::string exceptionMessage = "Failed to load texture: " + std::string(image);
-				stbi_image_free(bytes);
-				throw std::exception(exceptionMessage.c_str());
+				glGenTextures(1, &m_ID);
+				glstate::bindTexture(m_Unit, GL_TEXTURE_2D, m_ID);
 
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, widthImg, heightImg, 0, format, GL_UNSIGNED_BYTE, bytes);
+				glGenerateMipmap(GL_TEXTURE_2D);
+				glstate::bindTexture(m_Unit, GL_TEXTURE_2D, 0);
+				glstate::count(7);
 			}
+
+			stbi_image_free(bytes);
 		}
 
-		Sampler2D(const std::string& texture, GLuint unit, Senum type = rTdiffuse)
+	public:
+		Sampler2D(const char* image, GLuint unit, Senum type = rTdiffuse)
 		{
-			const char* image = texture.c_str();
-
 			m_Unit = unit;
 			m_Type = type;
-			int widthImg, heightImg, numColCh;
-			stbi_set_flip_vertically_on_load(true);
-			unsigned char* bytes = stbi_load(image, &widthImg, &heightImg, &numColCh, 0);
-
-			glGenTextures(1, &m_ID);
-			glActiveTexture(GL_TEXTURE0 + unit);
-			glBindTexture(GL_TEXTURE_2D, m_ID);
-
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-			if (bytes) {
-				switch (numColCh) {
-				case 4:
-					glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, widthImg, heightImg, 0, GL_RGBA, GL_UNSIGNED_BYTE, bytes);
-					break;
-				case 3:
-					glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, widthImg, heightImg, 0, GL_RGB, GL_UNSIGNED_BYTE, bytes);
-					break;
-				case 1:
-					glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, widthImg, heightImg, 0, GL_RED, GL_UNSIGNED_BYTE, bytes);
-					break;
-				default:
-				{
-					stbi_image_free(bytes);
-					glBindTexture(GL_TEXTURE_2D, 0);
-					throw std::exception("Automatic Texture type recognition failed\n");
-					break;
-				}
-				}
-
-				glGenerateMipmap(GL_TEXTURE_2D);
-				glBindTexture(GL_TEXTURE_2D, 0);
-
-				stbi_image_free(bytes);
-			}
-			else {
-				glBindTexture(GL_TEXTURE_2D, 0);
-				std::string exceptionMessage = "Failed to load texture: " + std::string(image);
-				stbi_image_free(bytes);
-				throw std::exception(exceptionMessage.c_str());
+			load(image);
+		}
 
-			}
+		Sampler2D(const std::string& texture, GLuint unit, Senum type = rTdiffuse)
+			:
+			Sampler2D(texture.c_str(), unit, type)
+		{
 		}
 
 		inline void bind() override {
-			glActiveTexture(GL_TEXTURE0 + m_Unit);
-			glBindTexture(GL_TEXTURE_2D, m_ID);
+			glstate::bindTexture(m_Unit, GL_TEXTURE_2D, m_ID);
 		}
-		inline void unbind() override { glBindTexture(GL_TEXTURE_2D, 0); }
+		inline void unbind() override { glstate::bindTexture(m_Unit, GL_TEXTURE_2D, 0); }
 	};
 
 	class Sampler3D : public Sampler {
@@ -170,8 +148,7 @@ namespace rtre {
 
 			glGenTextures(1, &m_ID);
 
-			glActiveTexture(GL_TEXTURE0 + unit);
-			glBindTexture(GL_TEXTURE_CUBE_MAP, m_ID);
+			glstate::bindTexture(unit, GL_TEXTURE_CUBE_MAP, m_ID);
 
 			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -187,7 +164,7 @@ namespace rtre {
 				unsigned char* bytes = stbi_load(mapsides[i].c_str(), &widthImg, &heightImg, &numColCh, 0);
 
 				if (!bytes) {
-					glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+					glstate::bindTexture(m_Unit, GL_TEXTURE_CUBE_MAP, 0);
 					std::string exceptionMessage = "Failed to load texture: " + mapsides[i] + "\n";
 					stbi_image_free(bytes);
 					throw std::exception(exceptionMessage.c_str());
@@ -205,7 +182,7 @@ namespace rtre {
 					break;
 				default:
 				{
-					glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+					glstate::bindTexture(m_Unit, GL_TEXTURE_CUBE_MAP, 0);
 					stbi_image_free(bytes);
 					throw std::invalid_argument("Automatic Texture type recognition failed\n");
 					break;
@@ -215,14 +192,13 @@ namespace rtre {
 				}
 
 			}
-			glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+			glstate::bindTexture(m_Unit, GL_TEXTURE_CUBE_MAP, 0);
 		}
 
 		inline void bind() override {
-			glActiveTexture(GL_TEXTURE0 + m_Unit);
-			glBindTexture(GL_TEXTURE_CUBE_MAP, m_ID);
+			glstate::bindTexture(m_Unit, GL_TEXTURE_CUBE_MAP, m_ID);
 		}
-		inline void unbind() override { glBindTexture(GL_TEXTURE_CUBE_MAP, 0); }
+		inline void unbind() override { glstate::bindTexture(m_Unit, GL_TEXTURE_CUBE_MAP, 0); }
 	};
 
 
@@ -1,5 +1,16 @@
 #pragma once
 #include <string>
+#include <vector>
+#include <array>
+#include <memory>
+#include <future>
+#include <chrono>
+#include <unordered_set>
+#include <unordered_map>
+#include <mutex>
+#include <sstream>
+#include <algorithm>
+#include <filesystem>
 #include <iostream>
 #include <fstream>
 #include <iostream>
@@ -11,6 +22,9 @@
 #include "glad/glad.h"
 #include "glm/glm.hpp"
 #include "glm/gtc/type_ptr.hpp"
+#include "../engine_system/paths.h"
+#include "gl_ext.h"
+#include "gl_state.h"
 
 
 namespace rtre {
@@ -41,6 +55,176 @@ namespace rtre {
 		}
 	}
 
+	/*
+	Output of the shader preprocessor
+	dependencies holds every file that was read to produce the code, the root file first
+	The index of a file in dependencies is the source string number used in the emitted #line directives
+	*/
+	struct ShaderSource {
+		std::string code;
+		std::vector<std::string> dependencies;
+	};
+
+	/*
+	Expands #include "file" directives in shader sources
+	Includes are resolved against the virtual files, relative to the including file, then against the include directories
+	A file is only included once per program, #pragma once is accepted and ignored
+	*/
+	class ShaderPreprocessor {
+
+		std::vector<std::filesystem::path> m_IncludeDirectories;
+		std::unordered_map<std::string, std::string> m_VirtualFiles;
+		mutable std::mutex m_VirtualFilesMutex;
+
+		bool findVirtualFile(const std::string& name, std::string& source) const {
+			std::lock_guard<std::mutex> lock(m_VirtualFilesMutex);
+			auto file = m_VirtualFiles.find(name);
+			if (file == m_VirtualFiles.end())
+				return false;
+			source = file->second;
+			return true;
+		}
+
+		static bool startsWith(const std::string& line, size_t at, const char* directive) {
+			return line.compare(at, std::strlen(directive), directive) == 0;
+		}
+
+		std::filesystem::path resolve(const std::string& name, const std::filesystem::path& from) const {
+			std::filesystem::path candidate = from.parent_path() / name;
+			if (std::filesystem::exists(candidate))
+				return candidate;
+
+			for (const auto& directory : m_IncludeDirectories) {
+				candidate = directory / name;
+				if (std::filesystem::exists(candidate))
+					return candidate;
+			}
+			std::string err = "Couldn't resolve include " + name + " from " + from.generic_string() + " .\n";
+			throw(std::exception(err.c_str()));
+		}
+
+		/*
+		key is the dependency name of the source, file the path nested includes are resolved from
+		*/
+		void expand(const std::string& key, const std::filesystem::path& file, const std::string& contents,
+				ShaderSource& out, std::unordered_set<std::string>& included) const {
+			const size_t sourceIndex = out.dependencies.size();
+			out.dependencies.push_back(key);
+
+			std::istringstream stream(contents);
+			std::string line;
+			size_t lineNumber = 0;
+
+			if (sourceIndex != 0)
+				out.code += "#line 1 " + std::to_string(sourceIndex) + "\n";
+
+			while (std::getline(stream, line)) {
+				lineNumber++;
+				if (!line.empty() && line.back() == '\r')
+					line.pop_back();
+
+				size_t at = line.find_first_not_of(" \t");
+				if (at == std::string::npos || line[at] != '#') {
+					out.code += line + "\n";
+					continue;
+				}
+				at = line.find_first_not_of(" \t", at + 1);
+
+				if (at != std::string::npos && startsWith(line, at, "include")) {
+					size_t open = line.find_first_of("\"<", at);
+					size_t close = open == std::string::npos ? open : line.find_first_of("\">", open + 1);
+					if (close == std::string::npos) {
+						std::string err = "Malformed include in " + file.generic_string() + " line " + std::to_string(lineNumber) + " .\n";
+						throw(std::exception(err.c_str()));
+					}
+
+					std::string name = line.substr(open + 1, close - open - 1);
+					std::string source;
+					std::filesystem::path target;
+					std::string targetKey;
+					if (findVirtualFile(name, source)) {
+						targetKey = virtualKey(name);
+					}
+					else {
+						target = resolve(name, file);
+						targetKey = normalizePath(target);
+					}
+
+					if (included.insert(targetKey).second) {
+						if (!isVirtual(targetKey))
+							source = get_file_contents(target.string().c_str());
+						expand(targetKey, target, source, out, included);
+						out.code += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(sourceIndex) + "\n";
+					}
+					else {
+						out.code += "\n";
+					}
+				}
+				else if (at != std::string::npos && startsWith(line, at, "pragma once")) {
+					out.code += "\n";
+				}
+				else if (at != std::string::npos && startsWith(line, at, "version") && sourceIndex != 0) {
+					out.code += "\n";
+				}
+				else {
+					out.code += line + "\n";
+				}
+			}
+		}
+
+	public:
+
+		void addIncludeDirectory(const std::string& directory) {
+			m_IncludeDirectories.push_back(std::filesystem::path(directory));
+		}
+
+		/*
+		Registers in-memory source that #include "name" resolves to before any file on disk
+		Programs including it list virtualKey(name) in their dependencies, see ShaderLibrary::touch
+		Safe to call while other threads preprocess
+		*/
+		void setVirtualFile(const std::string& name, const std::string& source) {
+			std::lock_guard<std::mutex> lock(m_VirtualFilesMutex);
+			m_VirtualFiles[name] = source;
+		}
+
+		static std::string virtualKey(const std::string& name) {
+			return "virtual:" + name;
+		}
+
+		static bool isVirtual(const std::string& dependency) {
+			return dependency.compare(0, 8, "virtual:") == 0;
+		}
+
+		/*
+		defines are emitted as #define lines right after the #version directive of the root file
+		*/
+		ShaderSource process(const std::string& file, const std::vector<std::string>& defines = {}) const {
+			ShaderSource out;
+			std::string key = normalizePath(file);
+			std::unordered_set<std::string> included = { key };
+			expand(key, std::filesystem::path(file), get_file_contents(file.c_str()), out, included);
+
+			if (!defines.empty()) {
+				std::string block;
+				for (const auto& define : defines)
+					block += "#define " + define + "\n";
+
+				size_t version = out.code.find("#version");
+				if (version != std::string::npos && (version == 0 || out.code[version - 1] == '\n')) {
+					size_t lineEnd = out.code.find('\n', version) + 1;
+					size_t lineNumber = std::count(out.code.begin(), out.code.begin() + lineEnd, '\n');
+					block += "#line " + std::to_string(lineNumber + 1) + " 0\n";
+					out.code.insert(lineEnd, block);
+				}
+				else {
+					out.code.insert(0, block + "#line 1 0\n");
+				}
+			}
+			return out;
+		}
+	};
+
 	class AbstractShader {
 
 	protected:
@@ -48,18 +232,22 @@ namespace rtre {
 
 	public:
 		inline void activate() {
-			glUseProgram(m_ID);
+			glstate::useProgram(m_ID);
 		}
 		inline virtual void free() {
 			glDeleteProgram(m_ID);
+			glstate::forgetProgram(m_ID);
 		}
 
-		static inline void checkError(GLuint shaderID, const char* type) {
+		/*
+		Prints the compile or link log of the object, returns false if it failed
+		*/
+		static inline bool checkError(GLuint shaderID, const char* type) {
 
 			GLint hasCompiled;
 
 			char infoLog[1024];
-			if (type != "PROGRAM")
+			if (std::strcmp(type, "PROGRAM") != 0)
 			{
 				glGetShaderiv(shaderID, GL_COMPILE_STATUS, &hasCompiled);
 				if (hasCompiled == GL_FALSE)
@@ -77,6 +265,7 @@ namespace rtre {
 					std::cout << "SHADER_LINKING_ERROR for:" << type << "\n" << infoLog << std::endl;
 				}
 			}
+			return hasCompiled != GL_FALSE;
 		}
 
 		inline GLint getUnifromID(const char* name) const {
@@ -132,99 +321,229 @@ namespace rtre {
 
 	class RenderShader : public AbstractShader {
 
-		std::string vfile;
-		std::string ffile;
-		time_t lastmod;
-
-	public:
-
-		void checkAndHotplug() {
-			struct stat fileInfo;
+		typedef std::array<ShaderSource, 2> Sources;
 
-			stat(ffile.c_str(), &fileInfo);
+		/*
+		A rebuild in flight, sources are preprocessed on a worker thread
+		then compiled and linked without waiting on the driver
+		*/
+		struct PendingBuild {
+			std::future<Sources> sources;
+			GLuint program = 0;
+			GLuint vertexShader = 0;
+			GLuint fragmentShader = 0;
+		};
 
-			if (lastmod == fileInfo.st_mtime)
-				return;
+		std::string vfile;
+		std::string ffile;
+		std::vector<std::string> m_Defines;
+		std::vector<std::string> m_Dependencies;
+		std::vector<time_t> m_DependencyTimes;
+		std::unique_ptr<PendingBuild> m_Pending;
+		bool m_ReloadAgain = false;
+
+		static Sources preprocess(const std::string& vertexFile, const std::string& fragmentFile, const std::vector<std::string>& defines) {
+			return { preprocessor().process(vertexFile, defines), preprocessor().process(fragmentFile, defines) };
+		}
 
-			lastmod = fileInfo.st_mtime;
+		static GLuint compileStage(GLenum type, const std::string& code) {
+			GLuint shader = glCreateShader(type);
+			const char* source = code.c_str();
+			glShaderSource(shader, 1, &source, NULL);
+			glCompileShader(shader);
+			return shader;
+		}
 
-			auto fragmentCode = get_file_contents(ffile.c_str());
-			auto vertexCode = get_file_contents(vfile.c_str());
+		/*
+		Issues the compile and link commands, status is only queried by finishLink
+		so drivers that compile in the background aren't forced to block here
+		*/
+		static void beginLink(const Sources& sources, PendingBuild& build) {
+			build.vertexShader = compileStage(GL_VERTEX_SHADER, sources[0].code);
+			build.fragmentShader = compileStage(GL_FRAGMENT_SHADER, sources[1].code);
+
+			build.program = glCreateProgram();
+			glAttachShader(build.program, build.vertexShader);
+			glAttachShader(build.program, build.fragmentShader);
+			glLinkProgram(build.program);
+		}
 
+		/*
+		Reports compile and link errors and frees the shader objects
+		Returns the linked program, or 0 if it failed
+		*/
+		static GLuint finishLink(PendingBuild& build) {
+			bool linked = checkError(build.vertexShader, "VERTEX");
+			linked = checkError(build.fragmentShader, "FRAGMENT") && linked;
+			linked = checkError(build.program, "PROGRAM") && linked;
+
+			glDeleteShader(build.vertexShader);
+			glDeleteShader(build.fragmentShader);
+			if (linked)
+				return build.program;
+
+			glDeleteProgram(build.program);
+			return 0;
+		}
 
-			GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-			const char* fc = fragmentCode.data();
-			glShaderSource(fragmentShader, 1, &fc, NULL);
-			glCompileShader(fragmentShader);
-			checkError(fragmentShader, "FRAGMENT");
+		void setDependencies(const Sources& sources) {
+			m_Dependencies = sources[0].dependencies;
+			m_Dependencies.insert(m_Dependencies.end(), sources[1].dependencies.begin(), sources[1].dependencies.end());
+			m_DependencyTimes.clear();
+			for (const auto& file : m_Dependencies)
+				m_DependencyTimes.push_back(modificationTime(file));
+		}
 
+	public:
 
-			GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-			const char* vc = vertexCode.data();
-			glShaderSource(vertexShader, 1, &vc, NULL);
-			glCompileShader(vertexShader);
-			checkError(vertexShader, "VERTEX");
+		/*
+		Preprocessor shared by every RenderShader
+		Add include directories to it before creating shaders that rely on them
+		*/
+		static ShaderPreprocessor& preprocessor() {
+			static ShaderPreprocessor s_Preprocessor;
+			return s_Preprocessor;
+		}
 
-			glDeleteProgram(m_ID);
-			m_ID = glCreateProgram();
-			glAttachShader(m_ID, vertexShader);
-			glAttachShader(m_ID, fragmentShader);
-			glLinkProgram(m_ID);
+		static time_t modificationTime(const std::string& file) {
+			struct stat fileInfo;
+			if (stat(file.c_str(), &fileInfo) != 0)
+				return 0;
+			return fileInfo.st_mtime;
+		}
 
-			glDeleteShader(fragmentShader);
-			glDeleteShader(vertexShader);
-			glDeleteShader(fragmentShader);
+		/*
+		Every file the current program was built from,
+		the vertex and fragment sources followed by everything they include
+		*/
+		inline const std::vector<std::string>& dependencies() const {
+			return m_Dependencies;
+		}
 
+		inline bool reloading() const {
+			return m_Pending != nullptr;
 		}
 
+		/*
+		Starts rebuilding the program from disk, the current program stays active
+		until the new one links successfully, see pollReload
+		A reload requested while one is in flight is started once the first one finishes
+		*/
+		void reload() {
+			if (m_Pending) {
+				m_ReloadAgain = true;
+				return;
+			}
 
-		RenderShader(const char* vertexFile, const char* fragmentFile, const char* geometryFile = NULL)
-		{
+			m_Pending = std::make_unique<PendingBuild>();
+			m_Pending->sources = std::async(std::launch::async, preprocess, vfile, ffile, m_Defines);
+		}
 
-			 const char* vertexCode;
-			 const char* fragmentCode;
-			 
-			 vfile = vertexFile;
-			 ffile = fragmentFile;
+		/*
+		Advances the reload in flight without blocking the render thread
+		With KHR_parallel_shader_compile the link status is only read once the driver reports completion,
+		otherwise it's read on the frame after the link was issued
+		Returns true on the call that finished the reload, whether or not the new program replaced the old one
+		*/
+		bool pollReload() {
+			if (!m_Pending)
+				return false;
+
+			if (m_Pending->program == 0) {
+				if (m_Pending->sources.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+					return false;
+
+				try {
+					Sources sources = m_Pending->sources.get();
+					setDependencies(sources);
+					beginLink(sources, *m_Pending);
+					return false;
+				}
+				catch (const std::exception& e) {
+					std::cout << "SHADER_PREPROCESSING_ERROR\n" << e.what() << std::endl;
+					for (size_t i = 0; i < m_Dependencies.size(); i++)
+						m_DependencyTimes[i] = modificationTime(m_Dependencies[i]);
+				}
+			}
+			else {
+				if (glext::KHR_parallel_shader_compile) {
+					GLint completed = GL_FALSE;
+					glGetProgramiv(m_Pending->program, GL_COMPLETION_STATUS_KHR, &completed);
+					if (completed == GL_FALSE)
+						return false;
+				}
 
-			std::string vertexSource = get_file_contents(vertexFile);
-			std::string fragSource = get_file_contents(fragmentFile);
-			// Read vertexFile and fragmentFile and store the strings
-			vertexCode = vertexSource.c_str();
-			fragmentCode = fragSource.c_str();
+				GLuint program = finishLink(*m_Pending);
+				if (program) {
+					glDeleteProgram(m_ID);
+					glstate::forgetProgram(m_ID);
+					m_ID = program;
+				}
+				else {
+					std::cout << "Keeping the previous program for " << ffile << std::endl;
+				}
+			}
 
+			m_Pending.reset();
+			if (m_ReloadAgain) {
+				m_ReloadAgain = false;
+				reload();
+			}
+			return true;
+		}
 
-			// Create Vertex Shader Object and get its reference
-			GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-			glShaderSource(vertexShader, 1, &vertexCode, NULL);
+		/*
+		Reloads the program if any of its dependencies changed on disk
+		Prefer ShaderLibrary when more than one program is in use, it doesn't stat files from the render thread
+		*/
+		void checkAndHotplug() {
+			if (!m_Pending) {
+				for (size_t i = 0; i < m_Dependencies.size(); i++) {
+					if (modificationTime(m_Dependencies[i]) != m_DependencyTimes[i]) {
+						reload();
+						break;
+					}
+				}
+			}
+			pollReload();
+		}
 
-			glCompileShader(vertexShader);
-			checkError(vertexShader, "VERTEX");
 
-			// Create Fragment Shader Object and get its reference
-			GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-			glShaderSource(fragmentShader, 1, &fragmentCode, NULL);
-			glCompileShader(fragmentShader);
-			checkError(fragmentShader, "FRAGMENT");
+		RenderShader(const char* vertexFile, const char* fragmentFile, const char* geometryFile = NULL)
+			:
+			RenderShader(vertexFile, fragmentFile, std::vector<std::string>())
+		{
+		}
 
-			// Create Shader Program Object and get its reference
-			m_ID = glCreateProgram();
-			glAttachShader(m_ID, vertexShader);
-			glAttachShader(m_ID, fragmentShader);
-			glLinkProgram(m_ID);
-			checkError(m_ID, "PROGRAM");
+		/*
+		Builds the program with every entry of defines emitted as a #define in both stages
+		*/
+		RenderShader(const char* vertexFile, const char* fragmentFile, const std::vector<std::string>& defines)
+		{
+			vfile = vertexFile;
+			ffile = fragmentFile;
+			m_Defines = defines;
 
-			glDeleteShader(vertexShader);
-			glDeleteShader(fragmentShader);
+			Sources sources = preprocess(vfile, ffile, m_Defines);
+			setDependencies(sources);
 
-			struct stat fileInfo;
-			stat(ffile.c_str(), &fileInfo);
-			lastmod = fileInfo.st_mtime;
+			PendingBuild build;
+			beginLink(sources, build);
+			m_ID = finishLink(build);
+		}
 
+		inline const std::vector<std::string>& defines() const {
+			return m_Defines;
 		}
 
 		~RenderShader() {
+			if (m_Pending && m_Pending->program) {
+				glDeleteShader(m_Pending->vertexShader);
+				glDeleteShader(m_Pending->fragmentShader);
+				glDeleteProgram(m_Pending->program);
+			}
 			glDeleteProgram(m_ID);
+			glstate::forgetProgram(m_ID);
 		}
 	};
 }
\ No newline at end of file
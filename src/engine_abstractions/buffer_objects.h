@@ -1,8 +1,11 @@
 #pragma once
 #include <vector>
 #include <array>
+#include <algorithm>
 #include "glad/glad.h"
 #include "glm/glm.hpp"
+#include "gl_state.h"
+#include "../engine_system/span.h"
 
 
 namespace rtre {
@@ -14,154 +17,234 @@ namespace rtre {
 	using glm::mat3;
 	using glm::mat2;
 
-	class Ebo {
+	/*
+	GL buffer ownership shared by Ebo and Vbo, move-only so exactly one object deletes each buffer
+	Uploads read straight from the caller's storage, update reuses the existing storage when the data fits
+	With direct state access buffers are edited by name and uploads leave the bindings alone
+	*/
+	template<GLenum Target>
+	class BufferObject {
+	protected:
 
 		GLuint m_ID = 0;
+		GLsizeiptr m_Size = 0;
 
 	public:
-		Ebo() {
-			glGenBuffers(1, &m_ID);
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ID);
-		}
-		Ebo(Ebo& eb) {
-			m_ID = eb.id();
+
+		BufferObject() {
+			if (glstate::directStateAccess())
+				glext::glCreateBuffers(1, &m_ID);
+			else
+				glGenBuffers(1, &m_ID);
+			glstate::count();
+		}
+		BufferObject(const BufferObject&) = delete;
+		BufferObject& operator=(const BufferObject&) = delete;
+
+		BufferObject(BufferObject&& other) noexcept
+			:
+			m_ID(other.m_ID),
+			m_Size(other.m_Size)
+		{
+			other.m_ID = 0;
+			other.m_Size = 0;
 		}
-		Ebo(Ebo&& eb) noexcept {
-			m_ID = eb.id();
-			eb.free();
+
+		BufferObject& operator=(BufferObject&& other) noexcept {
+			if (this != &other) {
+				free();
+				m_ID = other.m_ID;
+				m_Size = other.m_Size;
+				other.m_ID = 0;
+				other.m_Size = 0;
+			}
+			return *this;
 		}
 
-		~Ebo() {
-			glDeleteBuffers(1, &m_ID);
+		~BufferObject() {
+			free();
 		}
 
+		/*
+		Reallocates the storage and fills it from data
+		*/
+		inline void loadData(const void* data, GLsizeiptr size, GLenum usage = GL_STATIC_DRAW) {
+			if (glstate::directStateAccess())
+				glext::glNamedBufferData(m_ID, size, data, usage);
+			else {
+				glstate::bindBuffer(Target, m_ID);
+				glBufferData(Target, size, data, usage);
+			}
+			glstate::count();
+			m_Size = size;
+		}
 
-		Ebo(const std::vector<GLuint>& vertices) {
-			glGenBuffers(1, &m_ID);
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ID);
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, vertices.size() * sizeof(GLuint), vertices.data(), GL_STATIC_DRAW);
+		template<class T>
+		inline void loadData(Span<const T> data, GLenum usage = GL_STATIC_DRAW) {
+			loadData(data.data(), GLsizeiptr(data.bytes()), usage);
 		}
-		template<std::size_t n>
-		Ebo(const std::array<GLuint, n>& vertices) {
-			glGenBuffers(1, &m_ID);
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ID);
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, vertices.size() * sizeof(GLuint), vertices.data(), GL_STATIC_DRAW);
+		template<class T>
+		inline void loadData(const std::vector<T>& data, GLenum usage = GL_STATIC_DRAW) {
+			loadData(Span<const T>(data), usage);
 		}
-		Ebo(GLuint* vertices, GLsizeiptr size) {
-			glGenBuffers(1, &m_ID);
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ID);
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, vertices, GL_STATIC_DRAW);
+		template<class T, std::size_t n>
+		inline void loadData(const std::array<T, n>& data, GLenum usage = GL_STATIC_DRAW) {
+			loadData(Span<const T>(data), usage);
 		}
 
+		inline void allocate(GLsizeiptr size, GLenum usage = GL_STATIC_DRAW) {
+			loadData(nullptr, size, usage);
+		}
 
-		inline void loadData(const std::vector<GLuint>& vertices) {
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ID);
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, vertices.size() * sizeof(GLuint), vertices.data(), GL_STATIC_DRAW);
+		/*
+		Writes data at a byte offset into the existing storage
+		*/
+		inline void write(GLintptr offset, const void* data, GLsizeiptr size) {
+			if (glstate::directStateAccess())
+				glext::glNamedBufferSubData(m_ID, offset, size, data);
+			else {
+				glstate::bindBuffer(Target, m_ID);
+				glBufferSubData(Target, offset, size, data);
+			}
+			glstate::count();
 		}
-		template<std::size_t n>
-		inline void loadData(const std::array<GLuint, n>& vertices) {
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ID);
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, vertices.size() * sizeof(GLuint), vertices.data(), GL_STATIC_DRAW);
+
+		template<class T>
+		inline void write(GLintptr offset, Span<const T> data) {
+			write(offset, data.data(), GLsizeiptr(data.bytes()));
 		}
-		inline void loadData(GLuint* vertices, GLsizeiptr size) {
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ID);
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, vertices, GL_STATIC_DRAW);
+
+		/*
+		Overwrites the storage in place when data fits, reallocates otherwise
+		*/
+		template<class T>
+		void update(Span<const T> data, GLenum usage = GL_DYNAMIC_DRAW) {
+			GLsizeiptr size = GLsizeiptr(data.bytes());
+			if (size > m_Size) {
+				loadData(data, usage);
+				return;
+			}
+			write(0, data.data(), size);
 		}
 
 		inline void bind() {
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ID);
+			glstate::bindBuffer(Target, m_ID);
 		}
 		inline void unbind() {
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, NULL);
+			glstate::bindBuffer(Target, 0);
 		}
 		inline void free() {
-			glDeleteBuffers(1, &m_ID);
+			if (m_ID)
+				glDeleteBuffers(1, &m_ID);
+			m_ID = 0;
+			m_Size = 0;
 		}
 
 		inline GLuint id() const {
 			return m_ID;
 		}
+		inline GLsizeiptr size() const {
+			return m_Size;
+		}
 	};
-	class Vbo {
-		GLuint m_ID = 0;
+
+	class Ebo : public BufferObject<GL_ELEMENT_ARRAY_BUFFER> {
 
 	public:
+		using BufferObject::loadData;
 
-		Vbo() {
-			glGenBuffers(1, &m_ID);
-		}
-		Vbo(Vbo& vb) {
-			m_ID = vb.id();
+		/*
+		Binds the new buffer, so it attaches to the bound Vao
+		Prefer Vao::attachIndices, loads through DSA don't bind
+		*/
+		Ebo() {
+			bind();
 		}
-		Vbo(Vbo&& vb) noexcept {
-			m_ID = vb.id();
-			vb.free();
+
+		Ebo(Span<const GLuint> indices) {
+			loadData(indices);
 		}
-		template<class T>
-		Vbo(const std::vector<T>& vertices) {
-			glGenBuffers(1, &m_ID);
-			glBindBuffer(GL_ARRAY_BUFFER, m_ID);
-			glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(T), vertices.data(), GL_STATIC_DRAW);
+		Ebo(const std::vector<GLuint>& indices) {
+			loadData(indices);
 		}
-		template<class T, std::size_t n>
-		Vbo(const std::array<T, n>& vertices) {
-			glGenBuffers(1, &m_ID);
-			glBindBuffer(GL_ARRAY_BUFFER, m_ID);
-			glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(T), vertices.data(), GL_STATIC_DRAW);
+		template<std::size_t n>
+		Ebo(const std::array<GLuint, n>& indices) {
+			loadData(indices);
 		}
-		Vbo(GLfloat* vertices, GLsizeiptr size) {
-			glGenBuffers(1, &m_ID);
-			glBindBuffer(GL_ARRAY_BUFFER, m_ID);
-			glBufferData(GL_ARRAY_BUFFER, size, vertices, GL_STATIC_DRAW);
+		Ebo(GLuint* indices, GLsizeiptr size) {
+			loadData(indices, size);
 		}
 
-		~Vbo() {
-			glDeleteBuffers(1, &m_ID);
+		inline void loadData(GLuint* indices, GLsizeiptr size) {
+			BufferObject::loadData(static_cast<const void*>(indices), size);
 		}
+	};
+
+	class Vbo : public BufferObject<GL_ARRAY_BUFFER> {
+
+	public:
+		using BufferObject::loadData;
+
+		Vbo() {}
 
 		template<class T>
-		inline void loadData(const std::vector<T>& vertices) {
-			glBindBuffer(GL_ARRAY_BUFFER, m_ID);
-			glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(T), vertices.data(), GL_STATIC_DRAW);
-		}
-		template<class T, std::size_t n>
-		inline void loadData(const std::array<T, n>& vertices) {
-			glBindBuffer(GL_ARRAY_BUFFER, m_ID);
-			glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(T), vertices.data(), GL_STATIC_DRAW);
-		}
-		inline void loadData(GLfloat* vertices, GLsizeiptr size) {
-			glBindBuffer(GL_ARRAY_BUFFER, m_ID);
-			glBufferData(GL_ARRAY_BUFFER, size, vertices, GL_STATIC_DRAW);
+		Vbo(Span<const T> vertices) {
+			loadData(vertices);
 		}
-
-		inline void bind() {
-			glBindBuffer(GL_ARRAY_BUFFER, m_ID);
+		template<class T>
+		Vbo(const std::vector<T>& vertices) {
+			loadData(vertices);
 		}
-		inline void unbind() {
-			glBindBuffer(GL_ARRAY_BUFFER, NULL);
+		template<class T, std::size_t n>
+		Vbo(const std::array<T, n>& vertices) {
+			loadData(vertices);
 		}
-		inline void free() {
-			glDeleteBuffers(1, &m_ID);
+		Vbo(GLfloat* vertices, GLsizeiptr size) {
+			loadData(vertices, size);
 		}
 
-		inline GLuint id() const {
-			return m_ID;
+		inline void loadData(GLfloat* vertices, GLsizeiptr size) {
+			BufferObject::loadData(static_cast<const void*>(vertices), size);
 		}
-
 	};
+
 	class Vao {
 		GLuint m_ID = 0;
 
 	public:
 
+		/*
+		Binds the new array for the bind-to-edit calls that follow, even with DSA
+		*/
 		Vao() {
-			glGenVertexArrays(1, &m_ID);
-			glBindVertexArray(m_ID);
+			if (glstate::directStateAccess())
+				glext::glCreateVertexArrays(1, &m_ID);
+			else
+				glGenVertexArrays(1, &m_ID);
+			glstate::count();
+			bind();
+		}
+		Vao(const Vao&) = delete;
+		Vao& operator=(const Vao&) = delete;
 
+		Vao(Vao&& other) noexcept
+			:
+			m_ID(other.m_ID)
+		{
+			other.m_ID = 0;
+		}
+
+		Vao& operator=(Vao&& other) noexcept {
+			if (this != &other) {
+				free();
+				m_ID = other.m_ID;
+				other.m_ID = 0;
+			}
+			return *this;
 		}
 
 		~Vao() {
-			glDeleteVertexArrays(1, &m_ID);
+			free();
 		}
 
 
@@ -173,16 +256,60 @@ namespace rtre {
 		inline void linkAttrib( GLuint layout, GLuint numComponents, GLenum type, GLsizeiptr stride, void* offset) {
 			glVertexAttribPointer(layout, numComponents, type, GL_FALSE, stride, offset);
 			glEnableVertexAttribArray(layout);
+			glstate::count(2);
+		}
+
+		/*
+			Separate vertex format, attributes read from a buffer attached to a binding point
+			These don't need the Vao bound, with DSA they leave the bindings alone
+		*/
+		void attachVertices(GLuint buffer, GLsizei stride, GLintptr offset = 0, GLuint binding = 0) {
+			if (glstate::directStateAccess())
+				glext::glVertexArrayVertexBuffer(m_ID, binding, buffer, offset, stride);
+			else {
+				bind();
+				glBindVertexBuffer(binding, buffer, offset, stride);
+			}
+			glstate::count();
+		}
+
+		void attachIndices(GLuint buffer) {
+			if (glstate::directStateAccess())
+				glext::glVertexArrayElementBuffer(m_ID, buffer);
+			else {
+				bind();
+				glstate::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+			}
+			glstate::count();
+		}
+
+		void attribute(GLuint layout, GLint components, GLenum type, GLuint relativeOffset, GLuint binding = 0) {
+			if (glstate::directStateAccess()) {
+				glext::glVertexArrayAttribFormat(m_ID, layout, components, type, GL_FALSE, relativeOffset);
+				glext::glVertexArrayAttribBinding(m_ID, layout, binding);
+				glext::glEnableVertexArrayAttrib(m_ID, layout);
+			}
+			else {
+				bind();
+				glVertexAttribFormat(layout, components, type, GL_FALSE, relativeOffset);
+				glVertexAttribBinding(layout, binding);
+				glEnableVertexAttribArray(layout);
+			}
+			glstate::count(3);
 		}
 
 		inline void bind() {
-			glBindVertexArray(m_ID);
+			glstate::bindVertexArray(m_ID);
 		}
 		inline void unbind() {
-			glBindVertexArray(0);
+			glstate::bindVertexArray(0);
 		}
 		inline void free() {
-			glDeleteVertexArrays(1, &m_ID);
+			if (m_ID) {
+				glDeleteVertexArrays(1, &m_ID);
+				glstate::forgetVertexArray(m_ID);
+			}
+			m_ID = 0;
 		}
 
 		inline GLuint id() const {
@@ -190,4 +317,135 @@ namespace rtre {
 		}
 	};
 
+	/*
+	Shader storage buffer that grows to fit, contents are kept when it grows
+	Bound to an indexed binding point matching the shader's layout(binding = n)
+	*/
+	class Ssbo {
+		GLuint m_ID = 0;
+		GLsizeiptr m_Capacity = 0;
+
+	public:
+
+		Ssbo() {
+			glGenBuffers(1, &m_ID);
+		}
+		Ssbo(const Ssbo&) = delete;
+		Ssbo& operator=(const Ssbo&) = delete;
+
+		~Ssbo() {
+			glDeleteBuffers(1, &m_ID);
+		}
+
+		/*
+		Returns true if the buffer was reallocated
+		*/
+		bool reserve(GLsizeiptr size) {
+			if (size <= m_Capacity)
+				return false;
+
+			GLsizeiptr capacity = std::max<GLsizeiptr>(size, m_Capacity * 2);
+			GLuint buffer = 0;
+			glGenBuffers(1, &buffer);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, capacity, nullptr, GL_DYNAMIC_DRAW);
+			if (m_Capacity > 0) {
+				glBindBuffer(GL_COPY_READ_BUFFER, m_ID);
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_SHADER_STORAGE_BUFFER, 0, 0, m_Capacity);
+			}
+			glDeleteBuffers(1, &m_ID);
+
+			m_ID = buffer;
+			m_Capacity = capacity;
+			return true;
+		}
+
+		inline void write(GLintptr offset, const void* data, GLsizeiptr size) {
+			reserve(offset + size);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_ID);
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset, size, data);
+		}
+
+		template<class T>
+		inline void write(const std::vector<T>& data, size_t first = 0) {
+			write(first * sizeof(T), data.data() + first, (data.size() - first) * sizeof(T));
+		}
+
+		inline void bindBase(GLuint binding) {
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, m_ID);
+		}
+
+		inline GLuint id() const { return m_ID; }
+		inline GLsizeiptr capacity() const { return m_Capacity; }
+	};
+
+	/*
+	Framebuffer with a single color texture attachment, used as a render target between passes
+	*/
+	class Fbo {
+		GLuint m_ID = 0;
+		GLuint m_Texture = 0;
+		GLsizei m_Width = 0;
+		GLsizei m_Height = 0;
+
+	public:
+
+		Fbo() {
+			glGenFramebuffers(1, &m_ID);
+		}
+		Fbo(const Fbo&) = delete;
+		Fbo& operator=(const Fbo&) = delete;
+
+		~Fbo() {
+			glDeleteTextures(1, &m_Texture);
+			glstate::forgetTexture(m_Texture);
+			glDeleteFramebuffers(1, &m_ID);
+		}
+
+		/*
+		(Re)creates the color attachment, nearest filtered and clamped so passes can texelFetch it
+		*/
+		void attachColor(GLenum internalFormat, GLsizei width, GLsizei height) {
+			glDeleteTextures(1, &m_Texture);
+			glstate::forgetTexture(m_Texture);
+			if (glstate::directStateAccess()) {
+				glext::glCreateTextures(GL_TEXTURE_2D, 1, &m_Texture);
+				glext::glTextureStorage2D(m_Texture, 1, internalFormat, width, height);
+				glext::glTextureParameteri(m_Texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+				glext::glTextureParameteri(m_Texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+				glext::glTextureParameteri(m_Texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+				glext::glTextureParameteri(m_Texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			}
+			else {
+				glGenTextures(1, &m_Texture);
+				glstate::bindTextureForEdit(GL_TEXTURE_2D, m_Texture);
+				glTexStorage2D(GL_TEXTURE_2D, 1, internalFormat, width, height);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			}
+			glstate::count(7);
+
+			glBindFramebuffer(GL_FRAMEBUFFER, m_ID);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_Texture, 0);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+			m_Width = width;
+			m_Height = height;
+		}
+
+		inline void bind() {
+			glBindFramebuffer(GL_FRAMEBUFFER, m_ID);
+		}
+		inline void unbind() {
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		}
+
+		inline GLuint id() const { return m_ID; }
+		inline GLuint texture() const { return m_Texture; }
+		inline GLsizei width() const { return m_Width; }
+		inline GLsizei height() const { return m_Height; }
+	};
+
 }
\ No newline at end of file
@@ -0,0 +1,146 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <exception>
+#include "glad/glad.h"
+#include "Sampler.h"
+#include "gl_state.h"
+#include "texture_file.h"
+#include "../engine_system/mapped_file.h"
+
+namespace rtre {
+
+	/*
+	2D texture loaded from a file written by TextureCooker
+	The file is memory mapped and every level goes to immutable storage straight from the mapping,
+	no decoding, no format conversion and no glGenerateMipmap at load time
+	*/
+	class CookedTexture : public Sampler {
+
+		CookedFormat m_Format = rCrgba8;
+		GLsizei m_Width = 0;
+		GLsizei m_Height = 0;
+		GLsizei m_Levels = 0;
+		uint64_t m_GpuBytes = 0;
+
+		static void invalid(const std::string& file, const char* reason) {
+			std::string exceptionMessage = "Invalid cooked texture " + file + ": " + reason;
+			throw std::exception(exceptionMessage.c_str());
+		}
+
+		void load(const std::string& file) {
+			MappedFile mapped(file);
+			if (mapped.size() < sizeof(TextureFileHeader))
+				invalid(file, "truncated header");
+
+			const TextureFileHeader& header = *reinterpret_cast<const TextureFileHeader*>(mapped.data());
+			if (std::memcmp(header.magic, textureFileMagic, 4) != 0)
+				invalid(file, "not a cooked texture");
+			if (header.version != textureFileVersion)
+				invalid(file, "unsupported version, cook it again");
+			if (header.format > rCbc5 || header.levels == 0 || header.width == 0 || header.height == 0)
+				invalid(file, "bad header");
+			uint32_t chainLength = 1;
+			for (uint32_t size = std::max(header.width, header.height); size > 1; size /= 2)
+				chainLength++;
+			if (header.levels > chainLength)
+				invalid(file, "more levels than the mip chain has");
+			if (mapped.size() < sizeof(TextureFileHeader) + header.levels * sizeof(TextureFileLevel))
+				invalid(file, "truncated level table");
+
+			m_Format = CookedFormat(header.format);
+			if (!formatSupported(m_Format))
+				invalid(file, "block format not supported by the driver");
+
+			const TextureFileLevel* levels = reinterpret_cast<const TextureFileLevel*>(mapped.data() + sizeof(TextureFileHeader));
+			for (uint32_t i = 0; i < header.levels; i++) {
+				// Every level is half the previous one, rounded down and never below a texel, as glTexStorage2D allocates them
+				if (levels[i].width != std::max(header.width >> i, 1u) || levels[i].height != std::max(header.height >> i, 1u))
+					invalid(file, "level size doesn't match the mip chain");
+				if (levels[i].offset > mapped.size() || levels[i].size > mapped.size() - levels[i].offset
+					|| levels[i].size != levelBytes(m_Format, levels[i].width, levels[i].height))
+					invalid(file, "level out of bounds");
+			}
+
+			m_Width = header.width;
+			m_Height = header.height;
+			m_Levels = header.levels;
+			bool compressed = isCompressed(m_Format);
+			GLenum format = internalFormat(m_Format);
+
+			// Uncompressed rows of one and three channel levels aren't 4 byte aligned
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			if (glstate::directStateAccess()) {
+				glext::glCreateTextures(GL_TEXTURE_2D, 1, &m_ID);
+				glext::glTextureStorage2D(m_ID, m_Levels, format, m_Width, m_Height);
+			}
+			else {
+				glGenTextures(1, &m_ID);
+				glstate::bindTexture(m_Unit, GL_TEXTURE_2D, m_ID);
+				glTexStorage2D(GL_TEXTURE_2D, m_Levels, format, m_Width, m_Height);
+			}
+
+			for (GLint i = 0; i < m_Levels; i++) {
+				const TextureFileLevel& level = levels[i];
+				const void* pixels = mapped.data() + level.offset;
+				if (glstate::directStateAccess()) {
+					if (compressed)
+						glext::glCompressedTextureSubImage2D(m_ID, i, 0, 0, level.width, level.height, format, GLsizei(level.size), pixels);
+					else
+						glext::glTextureSubImage2D(m_ID, i, 0, 0, level.width, level.height, pixelFormat(m_Format), GL_UNSIGNED_BYTE, pixels);
+				}
+				else {
+					if (compressed)
+						glCompressedTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, level.width, level.height, format, GLsizei(level.size), pixels);
+					else
+						glTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, level.width, level.height, pixelFormat(m_Format), GL_UNSIGNED_BYTE, pixels);
+				}
+				m_GpuBytes += level.size;
+			}
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+			setParameter(GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			setParameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			setParameter(GL_TEXTURE_WRAP_S, GL_REPEAT);
+			setParameter(GL_TEXTURE_WRAP_T, GL_REPEAT);
+			if (!glstate::directStateAccess())
+				glstate::bindTexture(m_Unit, GL_TEXTURE_2D, 0);
+			glstate::count(6 + m_Levels);
+		}
+
+		void setParameter(GLenum name, GLint value) {
+			if (glstate::directStateAccess())
+				glext::glTextureParameteri(m_ID, name, value);
+			else
+				glTexParameteri(GL_TEXTURE_2D, name, value);
+		}
+
+	public:
+
+		CookedTexture(const std::string& file, GLuint unit, Senum type = rTdiffuse) {
+			m_Unit = unit;
+			m_Type = type;
+			setPath(file);
+			load(file);
+		}
+
+		inline void bind() override {
+			glstate::bindTexture(m_Unit, GL_TEXTURE_2D, m_ID);
+		}
+		inline void unbind() override { glstate::bindTexture(m_Unit, GL_TEXTURE_2D, 0); }
+		inline void free() override {
+			glDeleteTextures(1, &m_ID);
+			glstate::forgetTexture(m_ID);
+			m_ID = 0;
+		}
+
+		inline CookedFormat format() const { return m_Format; }
+		inline GLsizei width() const { return m_Width; }
+		inline GLsizei height() const { return m_Height; }
+		inline GLsizei levels() const { return m_Levels; }
+		// Bytes of texel data uploaded, what the texture occupies in video memory before driver padding
+		inline uint64_t gpuBytes() const { return m_GpuBytes; }
+	};
+}
@@ -1,6 +1,12 @@
 #pragma once
+#include <cmath>
+#include <vector>
+#include <utility>
+#include <limits>
+#include <algorithm>
 #include "glad/glad.h"
 #include "glm/glm.hpp"
+#include "../engine_system/span.h"
 
 namespace rtre {
 
@@ -64,11 +70,38 @@ namespace rtre {
 		GLfloat linear = 0.02f;
 		GLfloat quadratic = 0.032f;
 
+		PointLight() {}
+
 		PointLight(vec3 pos, vec3 dif, vec3 spec = vec3(1.f, 1.f, 1.f),
-			GLfloat cons = 0.8, GLfloat lin = 0.02f, GLfloat quad = 0.032f);
+			GLfloat cons = 0.8, GLfloat lin = 0.02f, GLfloat quad = 0.032f)
+			:
+			position(pos),
+			diffuse(dif),
+			specular(spec),
+			constant(cons),
+			linear(lin),
+			quadratic(quad)
+		{}
 
-		~PointLight();
+		/*
+		Distance past which the light's attenuated intensity drops under cutoff, used to cull it
+		*/
+		GLfloat range(GLfloat cutoff = 1.f / 256) const {
+			GLfloat intensity = std::max(std::max(std::max(diffuse.x, diffuse.y), std::max(diffuse.z, specular.x)), std::max(specular.y, specular.z));
+			GLfloat c = constant - intensity / cutoff;
+			if (c >= 0)
+				return 0;
+			if (quadratic > 0)
+				return (-linear + std::sqrt(linear * linear - 4 * quadratic * c)) / (2 * quadratic);
+			if (linear > 0)
+				return -c / linear;
+			return std::numeric_limits<GLfloat>::max();
+		}
 
+		/*
+		Uploads the light as individual uniforms, fine for a few lights
+		Larger light counts go through a LightBuffer
+		*/
 		void passStruct(std::shared_ptr<RenderShader> shader, GLuint index) {
 			std::string uniformName = "pointLights[" + std::to_string(index) + "]";
 			shader->SetUniform((uniformName + "." + "position").c_str(), position);
@@ -81,6 +114,11 @@ namespace rtre {
 
 	};
 
+	/*
+	Indexed triangle mesh owning its vertex and index storage
+	Constructors take the vectors by value, pass temporaries or std::move them to avoid a copy
+	Accessors hand out views of the storage, uploads read straight from it
+	*/
 	class BasicMesh {
 		std::vector<Vertex3> vertices;
 		std::vector<GLuint> indices;
@@ -88,24 +126,45 @@ namespace rtre {
 	public:
 		BasicMesh() {}
 
-		BasicMesh(std::vector<Vertex3>& verts, std::vector<GLuint>& inds)
+		BasicMesh(std::vector<Vertex3> verts, std::vector<GLuint> inds)
 			:
-			vertices(verts),
-			indices(inds)
+			vertices(std::move(verts)),
+			indices(std::move(inds))
 		{
 		}
 
-		std::vector<Vertex3> getVertices() {
+		inline Span<const Vertex3> getVertices() const {
 			return vertices;
 		}
 
-		std::vector<GLuint> getIndices() {
+		inline Span<const GLuint> getIndices() const {
 			return indices;
 		}
 
+		/*
+		Mutable views, the element count can't change through them
+		*/
+		inline Span<Vertex3> editVertices() {
+			return vertices;
+		}
 
-		
+		inline Span<GLuint> editIndices() {
+			return indices;
+		}
+
+		/*
+		Hands the storage over, the mesh is left empty
+		*/
+		inline std::vector<Vertex3> releaseVertices() {
+			return std::move(vertices);
+		}
+
+		inline std::vector<GLuint> releaseIndices() {
+			return std::move(indices);
+		}
 
+		inline size_t vertexCount() const { return vertices.size(); }
+		inline size_t indexCount() const { return indices.size(); }
 	};
 }
 
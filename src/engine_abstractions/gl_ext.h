@@ -0,0 +1,168 @@
+#pragma once
+#include <cstring>
+#include "glad/glad.h"
+#include "GLFW/rtre_Window.h"
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+#endif
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+namespace rtre {
+
+	/*
+	Entry points and extensions newer than the GL 4.3 core profile glad was generated for
+	Loaded by rtre::init, a pointer stays null when the driver doesn't expose it
+	*/
+	namespace glext {
+
+		typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+		typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+		// Direct state access, GL 4.5 or ARB_direct_state_access
+		typedef void (APIENTRYP PFNGLCREATEBUFFERSPROC)(GLsizei n, GLuint* buffers);
+		typedef void (APIENTRYP PFNGLNAMEDBUFFERDATAPROC)(GLuint buffer, GLsizeiptr size, const void* data, GLenum usage);
+		typedef void (APIENTRYP PFNGLNAMEDBUFFERSUBDATAPROC)(GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data);
+		typedef void (APIENTRYP PFNGLCREATEVERTEXARRAYSPROC)(GLsizei n, GLuint* arrays);
+		typedef void (APIENTRYP PFNGLVERTEXARRAYVERTEXBUFFERPROC)(GLuint vaobj, GLuint bindingindex, GLuint buffer, GLintptr offset, GLsizei stride);
+		typedef void (APIENTRYP PFNGLVERTEXARRAYELEMENTBUFFERPROC)(GLuint vaobj, GLuint buffer);
+		typedef void (APIENTRYP PFNGLVERTEXARRAYATTRIBFORMATPROC)(GLuint vaobj, GLuint attribindex, GLint size, GLenum type, GLboolean normalized, GLuint relativeoffset);
+		typedef void (APIENTRYP PFNGLVERTEXARRAYATTRIBBINDINGPROC)(GLuint vaobj, GLuint attribindex, GLuint bindingindex);
+		typedef void (APIENTRYP PFNGLENABLEVERTEXARRAYATTRIBPROC)(GLuint vaobj, GLuint index);
+		typedef void (APIENTRYP PFNGLCREATETEXTURESPROC)(GLenum target, GLsizei n, GLuint* textures);
+		typedef void (APIENTRYP PFNGLTEXTURESTORAGE2DPROC)(GLuint texture, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height);
+		typedef void (APIENTRYP PFNGLCOMPRESSEDTEXTURESUBIMAGE2DPROC)(GLuint texture, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLsizei imageSize, const void* data);
+		typedef void (APIENTRYP PFNGLTEXTURESUBIMAGE2DPROC)(GLuint texture, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels);
+		typedef void (APIENTRYP PFNGLTEXTUREPARAMETERIPROC)(GLuint texture, GLenum pname, GLint param);
+		typedef void (APIENTRYP PFNGLGENERATETEXTUREMIPMAPPROC)(GLuint texture);
+		typedef void (APIENTRYP PFNGLBINDTEXTUREUNITPROC)(GLuint unit, GLuint texture);
+
+		typedef GLuint64 (APIENTRYP PFNGLGETTEXTUREHANDLEARBPROC)(GLuint texture);
+		typedef void (APIENTRYP PFNGLMAKETEXTUREHANDLERESIDENTARBPROC)(GLuint64 handle);
+		typedef void (APIENTRYP PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC)(GLuint64 handle);
+
+		static PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glMaxShaderCompilerThreadsKHR = nullptr;
+		static PFNGLBUFFERSTORAGEPROC glBufferStorage = nullptr;
+
+		static PFNGLCREATEBUFFERSPROC glCreateBuffers = nullptr;
+		static PFNGLNAMEDBUFFERDATAPROC glNamedBufferData = nullptr;
+		static PFNGLNAMEDBUFFERSUBDATAPROC glNamedBufferSubData = nullptr;
+		static PFNGLCREATEVERTEXARRAYSPROC glCreateVertexArrays = nullptr;
+		static PFNGLVERTEXARRAYVERTEXBUFFERPROC glVertexArrayVertexBuffer = nullptr;
+		static PFNGLVERTEXARRAYELEMENTBUFFERPROC glVertexArrayElementBuffer = nullptr;
+		static PFNGLVERTEXARRAYATTRIBFORMATPROC glVertexArrayAttribFormat = nullptr;
+		static PFNGLVERTEXARRAYATTRIBBINDINGPROC glVertexArrayAttribBinding = nullptr;
+		static PFNGLENABLEVERTEXARRAYATTRIBPROC glEnableVertexArrayAttrib = nullptr;
+		static PFNGLCREATETEXTURESPROC glCreateTextures = nullptr;
+		static PFNGLTEXTURESTORAGE2DPROC glTextureStorage2D = nullptr;
+		static PFNGLTEXTURESUBIMAGE2DPROC glTextureSubImage2D = nullptr;
+		static PFNGLCOMPRESSEDTEXTURESUBIMAGE2DPROC glCompressedTextureSubImage2D = nullptr;
+		static PFNGLTEXTUREPARAMETERIPROC glTextureParameteri = nullptr;
+		static PFNGLGENERATETEXTUREMIPMAPPROC glGenerateTextureMipmap = nullptr;
+		static PFNGLBINDTEXTUREUNITPROC glBindTextureUnit = nullptr;
+
+		static PFNGLGETTEXTUREHANDLEARBPROC glGetTextureHandleARB = nullptr;
+		static PFNGLMAKETEXTUREHANDLERESIDENTARBPROC glMakeTextureHandleResidentARB = nullptr;
+		static PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC glMakeTextureHandleNonResidentARB = nullptr;
+
+		// Context version as major * 10 + minor
+		static GLint version = 0;
+		static bool KHR_parallel_shader_compile = false;
+		static bool ARB_buffer_storage = false;
+		static bool ARB_direct_state_access = false;
+		// BC1 and BC3, BC4 and BC5 are core as RGTC
+		static bool EXT_texture_compression_s3tc = false;
+		static bool ARB_bindless_texture = false;
+		// Lets a bindless sampler come from a value that differs between invocations
+		static bool NV_gpu_shader5 = false;
+
+		template<class Proc>
+		inline bool loadProc(Proc& proc, const char* name) {
+			proc = (Proc)glfwGetProcAddress(name);
+			return proc != nullptr;
+		}
+
+		inline bool hasExtension(const char* name) {
+			GLint count = 0;
+			glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+			for (GLint i = 0; i < count; i++) {
+				const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+				if (extension && std::strcmp(extension, name) == 0)
+					return true;
+			}
+			return false;
+		}
+
+		/*
+		Must be called after glad is loaded, with the context current
+		Define RTRE_NO_DSA to keep the bind-to-edit paths on GL 4.5 drivers, for comparing the two
+		*/
+		inline void load() {
+			GLint major = 0, minor = 0;
+			glGetIntegerv(GL_MAJOR_VERSION, &major);
+			glGetIntegerv(GL_MINOR_VERSION, &minor);
+			version = major * 10 + minor;
+
+			if (version >= 44 || hasExtension("GL_ARB_buffer_storage")) {
+				glBufferStorage = (PFNGLBUFFERSTORAGEPROC)glfwGetProcAddress("glBufferStorage");
+				ARB_buffer_storage = glBufferStorage != nullptr;
+			}
+
+			EXT_texture_compression_s3tc = hasExtension("GL_EXT_texture_compression_s3tc");
+
+#ifndef RTRE_NO_DSA
+			if (version >= 45 || hasExtension("GL_ARB_direct_state_access")) {
+				bool loaded = true;
+				loaded &= loadProc(glCreateBuffers, "glCreateBuffers");
+				loaded &= loadProc(glNamedBufferData, "glNamedBufferData");
+				loaded &= loadProc(glNamedBufferSubData, "glNamedBufferSubData");
+				loaded &= loadProc(glCreateVertexArrays, "glCreateVertexArrays");
+				loaded &= loadProc(glVertexArrayVertexBuffer, "glVertexArrayVertexBuffer");
+				loaded &= loadProc(glVertexArrayElementBuffer, "glVertexArrayElementBuffer");
+				loaded &= loadProc(glVertexArrayAttribFormat, "glVertexArrayAttribFormat");
+				loaded &= loadProc(glVertexArrayAttribBinding, "glVertexArrayAttribBinding");
+				loaded &= loadProc(glEnableVertexArrayAttrib, "glEnableVertexArrayAttrib");
+				loaded &= loadProc(glCreateTextures, "glCreateTextures");
+				loaded &= loadProc(glTextureStorage2D, "glTextureStorage2D");
+				loaded &= loadProc(glTextureSubImage2D, "glTextureSubImage2D");
+				loaded &= loadProc(glCompressedTextureSubImage2D, "glCompressedTextureSubImage2D");
+				loaded &= loadProc(glTextureParameteri, "glTextureParameteri");
+				loaded &= loadProc(glGenerateTextureMipmap, "glGenerateTextureMipmap");
+				loaded &= loadProc(glBindTextureUnit, "glBindTextureUnit");
+				ARB_direct_state_access = loaded;
+			}
+#endif
+
+			if (hasExtension("GL_ARB_bindless_texture")) {
+				bool loaded = true;
+				loaded &= loadProc(glGetTextureHandleARB, "glGetTextureHandleARB");
+				loaded &= loadProc(glMakeTextureHandleResidentARB, "glMakeTextureHandleResidentARB");
+				loaded &= loadProc(glMakeTextureHandleNonResidentARB, "glMakeTextureHandleNonResidentARB");
+				ARB_bindless_texture = loaded;
+			}
+			NV_gpu_shader5 = hasExtension("GL_NV_gpu_shader5");
+
+			if (hasExtension("GL_KHR_parallel_shader_compile") || hasExtension("GL_ARB_parallel_shader_compile")) {
+				glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+				if (!glMaxShaderCompilerThreadsKHR)
+					glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+
+				KHR_parallel_shader_compile = glMaxShaderCompilerThreadsKHR != nullptr;
+				if (KHR_parallel_shader_compile)
+					glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+			}
+		}
+	}
+}
@@ -0,0 +1,158 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include "glad/glad.h"
+#include "gl_ext.h"
+
+namespace rtre {
+
+	/*
+	Shadow copy of the binding state the abstractions change, so redundant binds never reach the driver
+	Tracks the current program, vertex array and the texture bound on each unit
+	Every GL call the abstractions make is counted here, endFrame() turns the counts into per frame figures
+	Code binding state behind the cache's back (ImGui's backend, raw GL) must call invalidate() afterwards
+	*/
+	namespace glstate {
+
+		struct Counters {
+			uint64_t calls = 0;
+			uint64_t binds = 0;
+			// Binds dropped because the state was already current
+			uint64_t redundant = 0;
+		};
+
+		static const GLuint maxTextureUnits = 32;
+
+		static GLuint s_Program = 0;
+		static GLuint s_VertexArray = 0;
+		static GLuint s_ActiveUnit = 0;
+		static std::array<GLuint, maxTextureUnits> s_Textures = {};
+		static std::array<GLenum, maxTextureUnits> s_TextureTargets = {};
+		// The cache starts unknown so the first bind of anything is always issued
+		static bool s_Known = false;
+
+		static bool filterRedundant = true;
+		static Counters s_Frame;
+		static Counters s_LastFrame;
+
+		inline bool directStateAccess() {
+			return glext::ARB_direct_state_access;
+		}
+
+		inline void count(uint64_t calls = 1) {
+			s_Frame.calls += calls;
+		}
+
+		inline void invalidate() {
+			s_Known = false;
+		}
+
+		inline void validate() {
+			if (s_Known)
+				return;
+			s_Program = s_VertexArray = 0;
+			s_ActiveUnit = ~0u;
+			s_Textures.fill(~0u);
+			s_TextureTargets.fill(0);
+			s_Known = true;
+		}
+
+		/*
+		Returns true if the bind has to be issued, counting it either way
+		*/
+		inline bool changes(GLuint& current, GLuint next) {
+			validate();
+			s_Frame.binds++;
+			if (filterRedundant && current == next) {
+				s_Frame.redundant++;
+				return false;
+			}
+			current = next;
+			s_Frame.calls++;
+			return true;
+		}
+
+		inline void useProgram(GLuint program) {
+			if (changes(s_Program, program))
+				glUseProgram(program);
+		}
+
+		inline void bindVertexArray(GLuint vertexArray) {
+			if (changes(s_VertexArray, vertexArray))
+				glBindVertexArray(vertexArray);
+		}
+
+		inline void activeTexture(GLuint unit) {
+			if (changes(s_ActiveUnit, unit))
+				glActiveTexture(GL_TEXTURE0 + unit);
+		}
+
+		/*
+		Binds texture to unit, with DSA a single glBindTextureUnit without touching the active unit
+		Units past maxTextureUnits are passed through unfiltered
+		*/
+		inline void bindTexture(GLuint unit, GLenum target, GLuint texture) {
+			validate();
+			if (unit >= maxTextureUnits) {
+				glActiveTexture(GL_TEXTURE0 + unit);
+				glBindTexture(target, texture);
+				s_ActiveUnit = unit;
+				count(2);
+				return;
+			}
+
+			// A unit has one binding per target, only a bind to the cached target can be redundant
+			GLuint cached = s_TextureTargets[unit] == target ? s_Textures[unit] : ~0u;
+			if (!changes(cached, texture))
+				return;
+			s_Textures[unit] = texture;
+			s_TextureTargets[unit] = target;
+
+			if (directStateAccess() && texture != 0) {
+				glext::glBindTextureUnit(unit, texture);
+				return;
+			}
+			activeTexture(unit);
+			glBindTexture(target, texture);
+		}
+
+		/*
+		Binds texture on the active unit to edit it, the bind-to-edit path
+		*/
+		inline void bindTextureForEdit(GLenum target, GLuint texture) {
+			validate();
+			GLuint unit = s_ActiveUnit < maxTextureUnits ? s_ActiveUnit : 0;
+			bindTexture(unit, target, texture);
+		}
+
+		inline void bindBuffer(GLenum target, GLuint buffer) {
+			s_Frame.binds++;
+			count();
+			glBindBuffer(target, buffer);
+		}
+
+		/*
+		Deleted names can be reused by the driver, so the cache must forget them
+		*/
+		inline void forgetProgram(GLuint program) {
+			if (s_Program == program)
+				s_Program = ~0u;
+		}
+		inline void forgetVertexArray(GLuint vertexArray) {
+			if (s_VertexArray == vertexArray)
+				s_VertexArray = ~0u;
+		}
+		inline void forgetTexture(GLuint texture) {
+			for (GLuint& bound : s_Textures)
+				if (bound == texture)
+					bound = ~0u;
+		}
+
+		inline void endFrame() {
+			s_LastFrame = s_Frame;
+			s_Frame = Counters();
+		}
+
+		inline const Counters& lastFrame() { return s_LastFrame; }
+	}
+}
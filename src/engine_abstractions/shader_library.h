@@ -0,0 +1,151 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <unordered_map>
+#include "shader.h"
+#include "../engine_system/file_watcher.h"
+
+namespace rtre {
+
+	/*
+	Owns the render programs and the graph of which shader files each of them was built from
+	A change to a shared include only rebuilds the programs that include it
+	Change notifications come from a FileWatcher, the library never stats files itself
+	*/
+	class ShaderLibrary {
+
+		FileWatcher& m_Watcher;
+		size_t m_Listener;
+
+		std::vector<std::shared_ptr<RenderShader>> m_Programs;
+		std::unordered_map<std::string, std::vector<RenderShader*>> m_Files;
+		std::deque<RenderShader*> m_Pending;
+		std::vector<RenderShader*> m_Building;
+		GLuint m_ReloadsPerUpdate = 1;
+
+		void link(RenderShader* shader) {
+			for (const auto& file : shader->dependencies()) {
+				auto inserted = m_Files.try_emplace(file);
+				if (inserted.second && !ShaderPreprocessor::isVirtual(file))
+					m_Watcher.watch(file);
+
+				auto& dependents = inserted.first->second;
+				if (std::find(dependents.begin(), dependents.end(), shader) == dependents.end())
+					dependents.push_back(shader);
+			}
+		}
+
+		/*
+		Removes shader from every file it depends on, except the ones listed in keep
+		*/
+		void unlink(RenderShader* shader, const std::vector<std::string>& keep = {}) {
+			for (auto it = m_Files.begin(); it != m_Files.end();) {
+				if (std::find(keep.begin(), keep.end(), it->first) != keep.end()) {
+					++it;
+					continue;
+				}
+				auto& dependents = it->second;
+				dependents.erase(std::remove(dependents.begin(), dependents.end(), shader), dependents.end());
+				if (dependents.empty()) {
+					if (!ShaderPreprocessor::isVirtual(it->first))
+						m_Watcher.unwatch(it->first);
+					it = m_Files.erase(it);
+				}
+				else {
+					++it;
+				}
+			}
+		}
+
+		void onFileChanged(const std::string& file) {
+			auto entry = m_Files.find(file);
+			if (entry == m_Files.end())
+				return;
+			for (RenderShader* shader : entry->second)
+				schedule(shader);
+		}
+
+		void schedule(RenderShader* shader) {
+			if (std::find(m_Pending.begin(), m_Pending.end(), shader) == m_Pending.end())
+				m_Pending.push_back(shader);
+		}
+
+	public:
+
+		ShaderLibrary(FileWatcher& watcher)
+			:
+			m_Watcher(watcher)
+		{
+			m_Listener = m_Watcher.addListener([this](const std::string& file) { onFileChanged(file); });
+		}
+
+		ShaderLibrary(const ShaderLibrary&) = delete;
+		ShaderLibrary& operator=(const ShaderLibrary&) = delete;
+
+		~ShaderLibrary() {
+			m_Watcher.removeListener(m_Listener);
+			for (const auto& entry : m_Files)
+				if (!ShaderPreprocessor::isVirtual(entry.first))
+					m_Watcher.unwatch(entry.first);
+		}
+
+		void add(const std::shared_ptr<RenderShader>& shader) {
+			m_Programs.push_back(shader);
+			link(shader.get());
+		}
+
+		void remove(const std::shared_ptr<RenderShader>& shader) {
+			unlink(shader.get());
+			m_Pending.erase(std::remove(m_Pending.begin(), m_Pending.end(), shader.get()), m_Pending.end());
+			m_Building.erase(std::remove(m_Building.begin(), m_Building.end(), shader.get()), m_Building.end());
+			m_Programs.erase(std::remove(m_Programs.begin(), m_Programs.end(), shader), m_Programs.end());
+		}
+
+		/*
+		Queues a rebuild of every program depending on file, for sources the watcher can't see
+		such as virtual files, pass ShaderPreprocessor::virtualKey(name) for those
+		*/
+		void touch(const std::string& file) {
+			onFileChanged(file);
+		}
+
+		/*
+		Rebuilds started per call to update, the rest stay queued for the following frames
+		so a change to a widely used include never stalls a single frame with every rebuild
+		*/
+		inline void setReloadsPerUpdate(GLuint count) { m_ReloadsPerUpdate = std::max<GLuint>(count, 1); }
+		inline bool hasPendingReloads() const { return !m_Pending.empty() || !m_Building.empty(); }
+		inline const std::vector<std::shared_ptr<RenderShader>>& programs() const { return m_Programs; }
+
+		/*
+		Starts at most setReloadsPerUpdate of the rebuilds queued by the watcher and advances the ones in flight,
+		programs keep rendering with their last working version until the new one links
+		Call after FileWatcher::dispatch(), from the thread owning the GL context
+		*/
+		void update() {
+			for (GLuint i = 0; i < m_ReloadsPerUpdate && !m_Pending.empty(); i++) {
+				RenderShader* shader = m_Pending.front();
+				m_Pending.pop_front();
+
+				shader->reload();
+				if (std::find(m_Building.begin(), m_Building.end(), shader) == m_Building.end())
+					m_Building.push_back(shader);
+			}
+
+			for (auto it = m_Building.begin(); it != m_Building.end();) {
+				RenderShader* shader = *it;
+				if (shader->pollReload()) {
+					link(shader);
+					unlink(shader, shader->dependencies());
+				}
+
+				if (shader->reloading())
+					++it;
+				else
+					it = m_Building.erase(it);
+			}
+		}
+	};
+}
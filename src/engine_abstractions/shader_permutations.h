@@ -0,0 +1,121 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "shader.h"
+#include "shader_library.h"
+
+namespace rtre {
+
+	/*
+	Compile time features of the raymarching shader, combined as a bit mask
+	Each one is exposed to GLSL as a FEATURE_ define, disabled features are compiled out
+	*/
+	enum ShaderFeature : GLuint {
+		rFdomainRepetition = 1 << 0,
+		rFdebugHeatmap = 1 << 1,
+		rFshadows = 1 << 2,
+		rFambientOcclusion = 1 << 3,
+		rFanalyticNormals = 1 << 4,
+		rFcentralNormals = 1 << 5,
+		rFhalfResNormals = 1 << 6,
+		rFhitPass = 1 << 7,
+		rFdebugNormals = 1 << 8,
+		rFdebugHits = 1 << 9,
+		rFclusteredLights = 1 << 10,
+		rFmaterials = 1 << 11,
+		rFbindlessTextures = 1 << 12,
+		rFsceneInterpreter = 1 << 13
+	};
+
+	/*
+	Variants of one vertex/fragment pair built with different feature defines
+	Variants are built on first use and cached by feature mask,
+	warmUp builds the ones a scene needs up front so selecting them never compiles mid-frame
+	*/
+	class ShaderPermutations {
+
+		std::string m_VertexFile;
+		std::string m_FragmentFile;
+		ShaderLibrary& m_Library;
+		GLuint m_Supported;
+
+		std::unordered_map<GLuint, std::shared_ptr<RenderShader>> m_Variants;
+
+		static std::vector<std::string> defines(GLuint features) {
+			static const std::pair<GLuint, const char*> s_Names[] = {
+				{ rFdomainRepetition, "FEATURE_DOMAIN_REPETITION" },
+				{ rFdebugHeatmap, "FEATURE_DEBUG_HEATMAP" },
+				{ rFshadows, "FEATURE_SHADOWS" },
+				{ rFambientOcclusion, "FEATURE_AO" },
+				{ rFanalyticNormals, "FEATURE_ANALYTIC_NORMALS" },
+				{ rFcentralNormals, "FEATURE_CENTRAL_NORMALS" },
+				{ rFhalfResNormals, "FEATURE_HALF_RES_NORMALS" },
+				{ rFhitPass, "FEATURE_HIT_PASS" },
+				{ rFdebugNormals, "FEATURE_DEBUG_NORMALS" },
+				{ rFdebugHits, "FEATURE_DEBUG_HITS" },
+				{ rFclusteredLights, "FEATURE_CLUSTERED_LIGHTS" },
+				{ rFmaterials, "FEATURE_MATERIALS" },
+				{ rFbindlessTextures, "FEATURE_BINDLESS_TEXTURES" },
+				{ rFsceneInterpreter, "FEATURE_SCENE_INTERPRETER" },
+			};
+
+			std::vector<std::string> out;
+			for (const auto& name : s_Names)
+				if (features & name.first)
+					out.push_back(name.second);
+			return out;
+		}
+
+	public:
+
+		/*
+		supported masks out the features the shader pair doesn't implement, so they don't spawn identical variants
+		Built variants are registered with library for hot reloading
+		*/
+		ShaderPermutations(const char* vertexFile, const char* fragmentFile, ShaderLibrary& library, GLuint supported = ~0u)
+			:
+			m_VertexFile(vertexFile),
+			m_FragmentFile(fragmentFile),
+			m_Library(library),
+			m_Supported(supported)
+		{
+		}
+
+		ShaderPermutations(const ShaderPermutations&) = delete;
+		ShaderPermutations& operator=(const ShaderPermutations&) = delete;
+
+		~ShaderPermutations() {
+			for (auto& variant : m_Variants)
+				m_Library.remove(variant.second);
+		}
+
+		inline GLuint key(GLuint features) const { return features & m_Supported; }
+		inline bool isBuilt(GLuint features) const { return m_Variants.count(key(features)) != 0; }
+		inline size_t variantCount() const { return m_Variants.size(); }
+
+		/*
+		Returns the variant for features, building it synchronously on a cache miss
+		*/
+		std::shared_ptr<RenderShader> select(GLuint features) {
+			GLuint variant = key(features);
+			auto cached = m_Variants.find(variant);
+			if (cached != m_Variants.end())
+				return cached->second;
+
+			auto shader = std::make_shared<RenderShader>(m_VertexFile.c_str(), m_FragmentFile.c_str(), defines(variant));
+			m_Variants.emplace(variant, shader);
+			m_Library.add(shader);
+			return shader;
+		}
+
+		/*
+		Builds every listed variant that isn't cached yet, meant for scene load time
+		*/
+		void warmUp(const std::vector<GLuint>& featureSets) {
+			for (GLuint features : featureSets)
+				select(features);
+		}
+	};
+}
@@ -0,0 +1,182 @@
+#pragma once
+#include <deque>
+#include <chrono>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "glad/glad.h"
+#include "gl_ext.h"
+#include "../engine_system/span.h"
+
+namespace rtre {
+
+	/*
+	Persistently mapped buffer for data rewritten every frame, sub-allocated as a ring
+	Storage comes from glBufferStorage with a coherent persistent mapping, so writes are plain memcpys with no GL call
+	fence() closes the regions written since the previous fence with one sync object,
+	allocate waits on a region's fence only when the ring wraps around onto it while the GPU may still read it
+	Size the ring for a few frames of data and the waits never block
+	Needs GL 4.4 or ARB_buffer_storage, see supported()
+	*/
+	class StreamBuffer {
+
+		struct Region {
+			GLintptr begin;
+			GLintptr end;
+			GLsync fence;
+		};
+
+		GLuint m_ID = 0;
+		GLenum m_Target;
+		GLsizeiptr m_Size;
+		uint8_t* m_Mapped = nullptr;
+
+		std::deque<Region> m_Regions;
+		GLintptr m_Head = 0;
+		GLintptr m_Open = 0;
+
+		uint64_t m_Waits = 0;
+		double m_WaitMs = 0;
+		uint64_t m_BytesWritten = 0;
+
+		/*
+		Regions written since the last fence, not yet guarded
+		*/
+		void close(GLintptr end) {
+			if (end > m_Open)
+				m_Regions.push_back({ m_Open, end, nullptr });
+			m_Open = end;
+		}
+
+		/*
+		Puts one fence behind every closed region that has none yet
+		*/
+		void guard() {
+			GLsync sync = nullptr;
+			for (auto region = m_Regions.rbegin(); region != m_Regions.rend() && !region->fence; ++region) {
+				if (!sync)
+					sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+				region->fence = sync;
+			}
+		}
+
+		void retire() {
+			Region region = m_Regions.front();
+			m_Regions.pop_front();
+			if (!region.fence)
+				return;
+
+			GLenum status = glClientWaitSync(region.fence, 0, 0);
+			if (status == GL_TIMEOUT_EXPIRED) {
+				auto start = std::chrono::steady_clock::now();
+				while (glClientWaitSync(region.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED);
+				m_WaitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+				m_Waits++;
+			}
+
+			// Regions closed by the same fence() share the sync object, the last one deletes it
+			if (m_Regions.empty() || m_Regions.front().fence != region.fence)
+				glDeleteSync(region.fence);
+		}
+
+	public:
+
+		struct Allocation {
+			void* data;
+			GLintptr offset;
+			GLsizeiptr size;
+		};
+
+		static bool supported() {
+			return glext::ARB_buffer_storage;
+		}
+
+		StreamBuffer(GLenum target, GLsizeiptr size)
+			:
+			m_Target(target),
+			m_Size(size)
+		{
+			if (!supported())
+				throw std::exception("StreamBuffer needs GL 4.4 or ARB_buffer_storage\n");
+
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glGenBuffers(1, &m_ID);
+			glBindBuffer(m_Target, m_ID);
+			glext::glBufferStorage(m_Target, m_Size, nullptr, flags);
+			m_Mapped = static_cast<uint8_t*>(glMapBufferRange(m_Target, 0, m_Size, flags));
+			glBindBuffer(m_Target, 0);
+
+			if (!m_Mapped) {
+				glDeleteBuffers(1, &m_ID);
+				throw std::exception("Could not map the stream buffer\n");
+			}
+		}
+
+		StreamBuffer(const StreamBuffer&) = delete;
+		StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+		~StreamBuffer() {
+			while (!m_Regions.empty()) {
+				Region region = m_Regions.front();
+				m_Regions.pop_front();
+				if (region.fence && (m_Regions.empty() || m_Regions.front().fence != region.fence))
+					glDeleteSync(region.fence);
+			}
+			glBindBuffer(m_Target, m_ID);
+			glUnmapBuffer(m_Target);
+			glBindBuffer(m_Target, 0);
+			glDeleteBuffers(1, &m_ID);
+		}
+
+		/*
+		Reserves size bytes aligned to alignment, the returned memory may be written until the next fence()
+		size must not exceed the buffer's size
+		*/
+		Allocation allocate(GLsizeiptr size, GLsizeiptr alignment = 16) {
+			GLintptr offset = (m_Head + alignment - 1) / alignment * alignment;
+			if (offset + size > m_Size) {
+				close(m_Head);
+				offset = 0;
+				m_Head = 0;
+				m_Open = 0;
+			}
+
+			// The oldest region is the one right ahead of the head, wait until the GPU is done with what we overwrite
+			// A region without a fence yet was written this frame, fencing what is closed covers the commands already reading it
+			while (!m_Regions.empty() && m_Regions.front().begin < offset + size && offset < m_Regions.front().end) {
+				if (!m_Regions.front().fence)
+					guard();
+				retire();
+			}
+
+			m_Head = offset + size;
+			m_BytesWritten += size;
+			return { m_Mapped + offset, offset, size };
+		}
+
+		template<class T>
+		Allocation write(Span<const T> data, GLsizeiptr alignment = sizeof(T)) {
+			Allocation allocation = allocate(GLsizeiptr(data.bytes()), alignment);
+			std::memcpy(allocation.data, data.data(), data.bytes());
+			return allocation;
+		}
+
+		/*
+		Call after submitting the draws reading everything allocated since the previous fence
+		*/
+		void fence() {
+			close(m_Head);
+			guard();
+		}
+
+		inline void bind() { glBindBuffer(m_Target, m_ID); }
+		inline void bind(GLenum target) { glBindBuffer(target, m_ID); }
+
+		inline GLuint id() const { return m_ID; }
+		inline GLsizeiptr size() const { return m_Size; }
+		inline uint64_t waits() const { return m_Waits; }
+		inline double waitMs() const { return m_WaitMs; }
+		inline uint64_t bytesWritten() const { return m_BytesWritten; }
+	};
+}
@@ -0,0 +1,315 @@
+#pragma once
+#include <cctype>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+#include "dependencies/stb_image.h"
+#include "texture_file.h"
+
+namespace rtre {
+
+	/*
+	Block compression of 4x4 pixel blocks, endpoints from the block's bounding box
+	Fast rather than optimal, quality is close to what drivers produce when compressing on upload
+	*/
+	namespace bc {
+
+		inline uint16_t pack565(const int color[3]) {
+			int r = (color[0] * 31 + 127) / 255;
+			int g = (color[1] * 63 + 127) / 255;
+			int b = (color[2] * 31 + 127) / 255;
+			return uint16_t((r << 11) | (g << 5) | b);
+		}
+
+		inline void unpack565(uint16_t packed, int color[3]) {
+			int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+			color[0] = (r << 3) | (r >> 2);
+			color[1] = (g << 2) | (g >> 4);
+			color[2] = (b << 3) | (b >> 2);
+		}
+
+		/*
+		BC1 color block from 16 RGBA pixels, always in four color mode
+		*/
+		void encodeColor(const uint8_t pixels[16][4], uint8_t* out) {
+			int low[3] = { 255, 255, 255 }, high[3] = { 0, 0, 0 };
+			for (int i = 0; i < 16; i++)
+				for (int c = 0; c < 3; c++) {
+					low[c] = std::min<int>(low[c], pixels[i][c]);
+					high[c] = std::max<int>(high[c], pixels[i][c]);
+				}
+			// Insetting the box by 1/16 of its size lowers the average error
+			for (int c = 0; c < 3; c++) {
+				int inset = (high[c] - low[c]) / 16;
+				low[c] += inset;
+				high[c] -= inset;
+			}
+
+			uint16_t color0 = pack565(high), color1 = pack565(low);
+			uint32_t indices = 0;
+			if (color0 < color1)
+				std::swap(color0, color1);
+
+			if (color0 != color1) {
+				int palette[4][3];
+				unpack565(color0, palette[0]);
+				unpack565(color1, palette[1]);
+				for (int c = 0; c < 3; c++) {
+					palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+					palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+				}
+				for (int i = 0; i < 16; i++) {
+					int best = 0, bestError = 1 << 30;
+					for (int p = 0; p < 4; p++) {
+						int error = 0;
+						for (int c = 0; c < 3; c++) {
+							int d = pixels[i][c] - palette[p][c];
+							error += d * d;
+						}
+						if (error < bestError) {
+							best = p;
+							bestError = error;
+						}
+					}
+					indices |= uint32_t(best) << (2 * i);
+				}
+			}
+
+			std::memcpy(out, &color0, 2);
+			std::memcpy(out + 2, &color1, 2);
+			std::memcpy(out + 4, &indices, 4);
+		}
+
+		/*
+		BC4 block from 16 single channel values, also the alpha half of BC3, always in eight value mode
+		*/
+		void encodeChannel(const uint8_t values[16], uint8_t* out) {
+			int low = 255, high = 0;
+			for (int i = 0; i < 16; i++) {
+				low = std::min<int>(low, values[i]);
+				high = std::max<int>(high, values[i]);
+			}
+
+			uint64_t indices = 0;
+			if (high != low) {
+				int palette[8] = { high, low };
+				for (int p = 2; p < 8; p++)
+					palette[p] = ((8 - p) * high + (p - 1) * low + 3) / 7;
+				for (int i = 0; i < 16; i++) {
+					int best = 0, bestError = 256;
+					for (int p = 0; p < 8; p++) {
+						int error = std::abs(values[i] - palette[p]);
+						if (error < bestError) {
+							best = p;
+							bestError = error;
+						}
+					}
+					indices |= uint64_t(best) << (3 * i);
+				}
+			}
+
+			out[0] = uint8_t(high);
+			out[1] = uint8_t(low);
+			for (int i = 0; i < 6; i++)
+				out[2 + i] = uint8_t(indices >> (8 * i));
+		}
+	}
+
+	struct CookOptions {
+		// Block compress to the format matching the channel count, BC1, BC3, BC4 or BC5
+		bool compress = false;
+		// Matches Sampler2D, cube map faces are cooked unflipped
+		bool flip = true;
+		bool mipmaps = true;
+	};
+
+	struct CookStats {
+		std::string source;
+		CookedFormat format = rCrgba8;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t levels = 0;
+		uint64_t sourceBytes = 0;
+		uint64_t cookedBytes = 0;
+		double milliseconds = 0;
+	};
+
+	/*
+	Converts images into cooked texture files, the mip chain is computed here rather than by the driver at load time
+	Runs on the CPU only, no context needed, so it can run in a tool or on worker threads
+	*/
+	class TextureCooker {
+
+		/*
+		Halves a level with a box filter, odd edges repeat their last texel
+		*/
+		static std::vector<uint8_t> downsample(const std::vector<uint8_t>& level, uint32_t width, uint32_t height, uint32_t channels) {
+			uint32_t nextWidth = std::max(width / 2, 1u), nextHeight = std::max(height / 2, 1u);
+			std::vector<uint8_t> next(size_t(nextWidth) * nextHeight * channels);
+			for (uint32_t y = 0; y < nextHeight; y++)
+				for (uint32_t x = 0; x < nextWidth; x++) {
+					uint32_t x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+					uint32_t y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+					for (uint32_t c = 0; c < channels; c++) {
+						uint32_t sum = level[(size_t(y0) * width + x0) * channels + c] + level[(size_t(y0) * width + x1) * channels + c]
+							+ level[(size_t(y1) * width + x0) * channels + c] + level[(size_t(y1) * width + x1) * channels + c];
+						next[(size_t(y) * nextWidth + x) * channels + c] = uint8_t((sum + 2) / 4);
+					}
+				}
+			return next;
+		}
+
+		static std::vector<uint8_t> compress(const std::vector<uint8_t>& level, uint32_t width, uint32_t height, uint32_t channels, CookedFormat format) {
+			std::vector<uint8_t> out(levelBytes(format, width, height));
+			uint8_t* block = out.data();
+			for (uint32_t by = 0; by < height; by += 4)
+				for (uint32_t bx = 0; bx < width; bx += 4) {
+					// Blocks past the edge repeat the edge texels
+					uint8_t pixels[16][4] = {};
+					for (uint32_t i = 0; i < 16; i++) {
+						uint32_t x = std::min(bx + i % 4, width - 1), y = std::min(by + i / 4, height - 1);
+						std::memcpy(pixels[i], &level[(size_t(y) * width + x) * channels], channels);
+					}
+
+					uint8_t channel[16];
+					auto extract = [&](uint32_t c) {
+						for (int i = 0; i < 16; i++)
+							channel[i] = pixels[i][c];
+						return channel;
+					};
+
+					switch (format) {
+					case rCbc1:
+						bc::encodeColor(pixels, block);
+						break;
+					case rCbc3:
+						bc::encodeChannel(extract(3), block);
+						bc::encodeColor(pixels, block + 8);
+						break;
+					case rCbc4:
+						bc::encodeChannel(extract(0), block);
+						break;
+					case rCbc5:
+						bc::encodeChannel(extract(0), block);
+						bc::encodeChannel(extract(1), block + 8);
+						break;
+					default:
+						break;
+					}
+					block += formatUnitBytes(format);
+				}
+			return out;
+		}
+
+		static CookedFormat chooseFormat(uint32_t channels, bool compressed) {
+			static const CookedFormat s_Plain[] = { rCr8, rCrg8, rCrgb8, rCrgba8 };
+			static const CookedFormat s_Compressed[] = { rCbc4, rCbc5, rCbc1, rCbc3 };
+			return compressed ? s_Compressed[channels - 1] : s_Plain[channels - 1];
+		}
+
+	public:
+
+		static CookStats cook(const std::string& source, const std::string& destination, const CookOptions& options = CookOptions()) {
+			auto start = std::chrono::steady_clock::now();
+			CookStats stats;
+			stats.source = source;
+
+			stbi_set_flip_vertically_on_load_thread(options.flip);
+			int width, height, channels;
+			std::unique_ptr<unsigned char, void(*)(void*)> pixels(stbi_load(source.c_str(), &width, &height, &channels, 0), stbi_image_free);
+			if (!pixels) {
+				std::string exceptionMessage = "Failed to load texture: " + source;
+				throw std::exception(exceptionMessage.c_str());
+			}
+
+			stats.format = chooseFormat(channels, options.compress);
+			stats.width = width;
+			stats.height = height;
+			stats.sourceBytes = std::filesystem::file_size(source);
+
+			std::vector<std::vector<uint8_t>> levels;
+			std::vector<TextureFileLevel> table;
+			std::vector<uint8_t> level(pixels.get(), pixels.get() + size_t(width) * height * channels);
+			pixels.reset();
+
+			uint32_t levelWidth = width, levelHeight = height;
+			uint64_t offset = sizeof(TextureFileHeader);
+			for (;;) {
+				levels.push_back(isCompressed(stats.format) ? compress(level, levelWidth, levelHeight, channels, stats.format) : level);
+				table.push_back({ 0, levels.back().size(), levelWidth, levelHeight });
+
+				if (!options.mipmaps || (levelWidth == 1 && levelHeight == 1))
+					break;
+				level = downsample(level, levelWidth, levelHeight, channels);
+				levelWidth = std::max(levelWidth / 2, 1u);
+				levelHeight = std::max(levelHeight / 2, 1u);
+			}
+			stats.levels = uint32_t(levels.size());
+
+			offset += table.size() * sizeof(TextureFileLevel);
+			for (auto& entry : table) {
+				offset = (offset + textureFileAlignment - 1) / textureFileAlignment * textureFileAlignment;
+				entry.offset = offset;
+				offset += entry.size;
+			}
+
+			TextureFileHeader header;
+			std::memcpy(header.magic, textureFileMagic, 4);
+			header.version = textureFileVersion;
+			header.format = stats.format;
+			header.width = width;
+			header.height = height;
+			header.levels = stats.levels;
+
+			std::filesystem::path target(destination);
+			if (target.has_parent_path())
+				std::filesystem::create_directories(target.parent_path());
+			std::ofstream file(destination, std::ios::binary | std::ios::trunc);
+			if (!file) {
+				std::string exceptionMessage = "Failed to write cooked texture: " + destination;
+				throw std::exception(exceptionMessage.c_str());
+			}
+
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(TextureFileLevel));
+			const char padding[textureFileAlignment] = {};
+			for (size_t i = 0; i < levels.size(); i++) {
+				file.write(padding, std::streamsize(table[i].offset - uint64_t(file.tellp())));
+				file.write(reinterpret_cast<const char*>(levels[i].data()), levels[i].size());
+			}
+
+			stats.cookedBytes = uint64_t(file.tellp());
+			stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			return stats;
+		}
+
+		/*
+		Cooks every image of sourceDirectory into destinationDirectory as <name>.rtex
+		Files whose cooked version is newer than the image are skipped
+		*/
+		static std::vector<CookStats> cookDirectory(const std::string& sourceDirectory, const std::string& destinationDirectory, const CookOptions& options = CookOptions()) {
+			namespace fs = std::filesystem;
+			std::vector<CookStats> cooked;
+			for (const auto& entry : fs::directory_iterator(sourceDirectory)) {
+				std::string extension = entry.path().extension().string();
+				std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return char(std::tolower(c)); });
+				if (extension != ".png" && extension != ".jpg" && extension != ".jpeg" && extension != ".tga" && extension != ".bmp")
+					continue;
+
+				fs::path target = fs::path(destinationDirectory) / entry.path().stem();
+				target += ".rtex";
+				if (fs::exists(target) && fs::last_write_time(target) >= fs::last_write_time(entry.path()))
+					continue;
+				cooked.push_back(cook(entry.path().string(), target.string(), options));
+			}
+			return cooked;
+		}
+	};
+}
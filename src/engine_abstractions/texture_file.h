@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include "glad/glad.h"
+#include "gl_ext.h"
+
+namespace rtre {
+
+	/*
+	Pixel formats of cooked textures
+	Uncompressed formats keep the source channel count, block formats store 4x4 pixel blocks
+		rCbc1	RGB, 8 bytes per block
+		rCbc3	RGBA, 16 bytes per block
+		rCbc4	R, 8 bytes per block
+		rCbc5	RG, 16 bytes per block
+	*/
+	enum CookedFormat : uint32_t {
+		rCr8,
+		rCrg8,
+		rCrgb8,
+		rCrgba8,
+		rCbc1,
+		rCbc3,
+		rCbc4,
+		rCbc5
+	};
+
+	/*
+	Layout of a cooked texture file, little endian
+		TextureFileHeader
+		TextureFileLevel	levels entries, largest level first
+		level data			each level at its offset, aligned to textureFileAlignment
+	*/
+	static const char textureFileMagic[4] = { 'R', 'T', 'E', 'X' };
+	static const uint32_t textureFileVersion = 1;
+	static const uint64_t textureFileAlignment = 16;
+
+	struct TextureFileHeader {
+		char magic[4];
+		uint32_t version;
+		uint32_t format;
+		uint32_t width;
+		uint32_t height;
+		uint32_t levels;
+	};
+
+	struct TextureFileLevel {
+		uint64_t offset;
+		uint64_t size;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	inline bool isCompressed(CookedFormat format) {
+		return format >= rCbc1;
+	}
+
+	inline uint32_t channelCount(CookedFormat format) {
+		static const uint32_t s_Channels[] = { 1, 2, 3, 4, 3, 4, 1, 2 };
+		return s_Channels[format];
+	}
+
+	/*
+	Bytes per pixel of uncompressed formats, bytes per 4x4 block of compressed ones
+	*/
+	inline uint32_t formatUnitBytes(CookedFormat format) {
+		static const uint32_t s_Bytes[] = { 1, 2, 3, 4, 8, 16, 8, 16 };
+		return s_Bytes[format];
+	}
+
+	inline uint64_t levelBytes(CookedFormat format, uint32_t width, uint32_t height) {
+		if (isCompressed(format))
+			return uint64_t((width + 3) / 4) * ((height + 3) / 4) * formatUnitBytes(format);
+		return uint64_t(width) * height * formatUnitBytes(format);
+	}
+
+	inline GLenum internalFormat(CookedFormat format) {
+		static const GLenum s_Formats[] = {
+			GL_R8, GL_RG8, GL_RGB8, GL_RGBA8,
+			GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, GL_COMPRESSED_RED_RGTC1, GL_COMPRESSED_RG_RGTC2
+		};
+		return s_Formats[format];
+	}
+
+	/*
+	Client format of uncompressed formats
+	*/
+	inline GLenum pixelFormat(CookedFormat format) {
+		static const GLenum s_Formats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+		return s_Formats[std::min<uint32_t>(format, rCrgba8)];
+	}
+
+	inline bool formatSupported(CookedFormat format) {
+		if (format == rCbc1 || format == rCbc3)
+			return glext::EXT_texture_compression_s3tc;
+		return format <= rCbc5;
+	}
+}
@@ -0,0 +1,151 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <vector>
+#include <random>
+#include <thread>
+#include <cstdint>
+#include <filesystem>
+#include "glad/glad.h"
+#include "dependencies/stb_image_write.h"
+#include "Sampler.h"
+#include "texture_loader.h"
+#include "texture_cooker.h"
+#include "cooked_texture.h"
+
+namespace rtre {
+
+	struct TextureLoadCost {
+		std::string path;
+		unsigned threads = 0;
+		double milliseconds = 0;
+		double speedup = 1;
+		uint64_t gpuBytes = 0;
+	};
+
+	/*
+	Startup cost of loading a texture set, synchronous Sampler2D against TextureLoader with one and with every thread,
+	and against cooked files, plain and block compressed, which are cooked beforehand and not timed
+	The set is written once as noisy PNGs, which decode about as slowly as photos
+	Loader runs call update() back to back with an unlimited budget, as a loading screen would
+	Blocks until everything is on the GPU, run it on demand
+	*/
+	class TextureLoadBenchmark {
+
+		std::vector<TextureLoadCost> m_Results;
+		size_t m_Textures = 0;
+
+		static std::vector<std::string> writeTestSet(const std::string& directory, size_t count, int size) {
+			std::filesystem::create_directories(directory);
+			std::vector<std::string> files;
+			std::mt19937 random(7);
+			std::vector<unsigned char> pixels;
+			for (size_t i = 0; i < count; i++) {
+				std::string file = (std::filesystem::path(directory) / ("texture" + std::to_string(i) + ".png")).string();
+				files.push_back(file);
+				if (std::filesystem::exists(file))
+					continue;
+
+				pixels.resize(size_t(size) * size * 3);
+				for (int y = 0; y < size; y++)
+					for (int x = 0; x < size; x++) {
+						unsigned char* pixel = &pixels[(size_t(y) * size + x) * 3];
+						pixel[0] = (unsigned char)(x ^ y);
+						pixel[1] = (unsigned char)(random() & 0x3F) + (unsigned char)(y * 191 / size);
+						pixel[2] = (unsigned char)(i * 37);
+					}
+				stbi_write_png(file.c_str(), size, size, 3, pixels.data(), size * 3);
+			}
+			return files;
+		}
+
+		static uint64_t mipChainBytes(uint64_t width, uint64_t height, uint64_t bytesPerPixel) {
+			uint64_t bytes = 0;
+			for (;;) {
+				bytes += width * height * bytesPerPixel;
+				if (width == 1 && height == 1)
+					return bytes;
+				width = std::max<uint64_t>(width / 2, 1);
+				height = std::max<uint64_t>(height / 2, 1);
+			}
+		}
+
+		double loadCooked(const std::string& directory, const CookOptions& options, uint64_t& gpuBytes) {
+			std::string cooked = (std::filesystem::path(directory) / (options.compress ? "cooked_bc" : "cooked")).string();
+			TextureCooker::cookDirectory(directory, cooked, options);
+
+			std::vector<std::string> files;
+			for (const auto& entry : std::filesystem::directory_iterator(cooked))
+				files.push_back(entry.path().string());
+
+			gpuBytes = 0;
+			return measure([&]() {
+				for (const auto& file : files) {
+					CookedTexture texture(file, 0);
+					gpuBytes += texture.gpuBytes();
+					texture.free();
+				}
+			});
+		}
+
+		template<class Load>
+		double measure(Load load) {
+			glFinish();
+			auto start = std::chrono::steady_clock::now();
+			load();
+			glFinish();
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		double loadAsync(const std::vector<std::string>& files, unsigned threads) {
+			TextureLoader loader(threads);
+			loader.setBudget(GLsizeiptr(1) << 40, 1e9);
+			std::vector<std::shared_ptr<AsyncTexture>> textures;
+			return measure([&]() {
+				for (const auto& file : files)
+					textures.push_back(loader.load2D(file, 0));
+				while (!loader.idle()) {
+					loader.update();
+					std::this_thread::yield();
+				}
+			});
+		}
+
+	public:
+
+		void run(const std::string& directory, size_t count = 32, int size = 1024) {
+			m_Results.clear();
+			std::vector<std::string> files = writeTestSet(directory, count, size);
+			m_Textures = files.size();
+
+			double synchronous = measure([&]() {
+				for (const auto& file : files) {
+					Sampler2D texture(file, 0);
+					texture.free();
+				}
+			});
+			// Both expand to RGBA8 and build the whole chain
+			uint64_t expandedBytes = mipChainBytes(size, size, 4) * files.size();
+			m_Results.push_back({ "Sampler2D", 1, synchronous, 1, expandedBytes });
+
+			unsigned cores = std::max(std::thread::hardware_concurrency(), 1u);
+			for (unsigned threads : { 1u, cores }) {
+				double milliseconds = loadAsync(files, threads);
+				m_Results.push_back({ "TextureLoader", threads, milliseconds, synchronous / milliseconds, expandedBytes });
+			}
+
+			CookOptions options;
+			for (bool compress : { false, true }) {
+				options.compress = compress;
+				if (compress && !formatSupported(rCbc1))
+					continue;
+				uint64_t gpuBytes = 0;
+				double milliseconds = loadCooked(directory, options, gpuBytes);
+				m_Results.push_back({ compress ? "Cooked BC1" : "Cooked RGB8", 1, milliseconds, synchronous / milliseconds, gpuBytes });
+			}
+		}
+
+		inline size_t textures() const { return m_Textures; }
+		inline const std::vector<TextureLoadCost>& results() const { return m_Results; }
+	};
+}
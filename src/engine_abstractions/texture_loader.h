@@ -0,0 +1,388 @@
+#pragma once
+#include <deque>
+#include <array>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <future>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include "glad/glad.h"
+#include "dependencies/stb_image.h"
+#include "Sampler.h"
+#include "gl_state.h"
+#include "stream_buffer.h"
+#include "../engine_system/thread_pool.h"
+
+namespace rtre {
+
+	/*
+	Image decoded to RGBA8 on a worker thread, freed with stbi_image_free
+	*/
+	struct DecodedImage {
+		std::unique_ptr<unsigned char, void(*)(void*)> pixels{ nullptr, stbi_image_free };
+		GLsizei width = 0;
+		GLsizei height = 0;
+		double milliseconds = 0;
+
+		inline GLsizeiptr rowBytes() const { return GLsizeiptr(width) * 4; }
+	};
+
+	/*
+	Decodes path with stb_image, safe to call from any thread
+	Throws on failure, through the future when run on a pool
+	*/
+	DecodedImage decodeImage(const std::string& path, bool flip) {
+		auto start = std::chrono::steady_clock::now();
+		// The global flip flag would race with other decodes, the thread local one doesn't
+		stbi_set_flip_vertically_on_load_thread(flip);
+
+		int width, height, channels;
+		DecodedImage image;
+		image.pixels.reset(stbi_load(path.c_str(), &width, &height, &channels, 4));
+		if (!image.pixels) {
+			std::string exceptionMessage = "Failed to load texture: " + path;
+			throw std::exception(exceptionMessage.c_str());
+		}
+		image.width = width;
+		image.height = height;
+		image.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return image;
+	}
+
+	/*
+	Texture handed out by TextureLoader before its pixels exist
+	Binds the loader's placeholder until the upload finished, so it can be used right away
+	*/
+	class AsyncTexture : public Sampler {
+
+		friend class TextureLoader;
+
+		GLenum m_Target;
+		GLuint m_Placeholder;
+		bool m_Ready = false;
+		bool m_Failed = false;
+		std::string m_Error;
+
+	public:
+
+		AsyncTexture(GLenum target, GLuint placeholder, GLuint unit, Senum type)
+			:
+			m_Target(target),
+			m_Placeholder(placeholder)
+		{
+			m_Unit = unit;
+			m_Type = type;
+		}
+
+		AsyncTexture(const AsyncTexture&) = delete;
+		AsyncTexture& operator=(const AsyncTexture&) = delete;
+
+		~AsyncTexture() {
+			free();
+		}
+
+		inline GLuint id() const override { return m_Ready ? m_ID : m_Placeholder; }
+
+		inline void free() override {
+			if (m_ID) {
+				glDeleteTextures(1, &m_ID);
+				glstate::forgetTexture(m_ID);
+			}
+			m_ID = 0;
+			m_Ready = false;
+		}
+
+		inline void bind() override { glstate::bindTexture(m_Unit, m_Target, id()); }
+		inline void unbind() override { glstate::bindTexture(m_Unit, m_Target, 0); }
+
+		inline bool ready() const { return m_Ready; }
+		inline bool failed() const { return m_Failed; }
+		inline const std::string& error() const { return m_Error; }
+		inline GLenum target() const { return m_Target; }
+	};
+
+	struct TextureLoadStats {
+		size_t requested = 0;
+		size_t completed = 0;
+		size_t failed = 0;
+		uint64_t bytesUploaded = 0;
+		// Summed over workers, compare with wallMs for the parallel speedup
+		double decodeMs = 0;
+		// From the first request of a batch until the loader went idle again
+		double wallMs = 0;
+	};
+
+	/*
+	Loads textures without stalling the render thread
+	Images are decoded on a thread pool, the six faces of a cube map in parallel,
+	and update() uploads them through a pixel unpack buffer a few rows at a time within a per frame budget
+	Requests return an AsyncTexture at once, it binds a 1x1 grey placeholder until its upload completes
+	Every GL call happens in update() or the constructor, call both from the thread owning the context
+	The loader owns the placeholders, it must outlive the textures it hands out
+	*/
+	class TextureLoader {
+
+		struct Job {
+			std::shared_ptr<AsyncTexture> texture;
+			std::vector<std::future<DecodedImage>> pending;
+			std::vector<DecodedImage> faces;
+			size_t face = 0;
+			GLsizei row = 0;
+		};
+
+		ThreadPool m_Pool;
+		std::deque<Job> m_Jobs;
+
+		GLuint m_Placeholder2D = 0;
+		GLuint m_PlaceholderCube = 0;
+
+		// Persistent ring when buffer storage exists, otherwise one PBO orphaned per chunk
+		std::unique_ptr<StreamBuffer> m_Stream;
+		GLuint m_Pbo = 0;
+
+		GLsizeiptr m_BytesPerFrame = 8 << 20;
+		double m_MillisecondsPerFrame = 2;
+
+		TextureLoadStats m_Stats;
+		std::chrono::steady_clock::time_point m_BatchStart;
+
+		static GLsizei mipLevels(GLsizei width, GLsizei height) {
+			GLsizei levels = 1;
+			while ((std::max(width, height) >> levels) > 0)
+				levels++;
+			return levels;
+		}
+
+		static GLuint placeholder(GLenum target) {
+			const unsigned char grey[4] = { 128, 128, 128, 255 };
+			GLuint texture = 0;
+			glGenTextures(1, &texture);
+			glstate::bindTextureForEdit(target, texture);
+			GLuint faces = target == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+			GLenum first = target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X : target;
+			for (GLuint i = 0; i < faces; i++)
+				glTexImage2D(first + i, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+			glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			return texture;
+		}
+
+		std::shared_ptr<AsyncTexture> request(GLenum target, const std::vector<std::string>& files, bool flip, GLuint unit, Senum type) {
+			if (m_Jobs.empty())
+				m_BatchStart = std::chrono::steady_clock::now();
+
+			GLuint placeholderTexture = target == GL_TEXTURE_CUBE_MAP ? m_PlaceholderCube : m_Placeholder2D;
+			Job job;
+			job.texture = std::make_shared<AsyncTexture>(target, placeholderTexture, unit, type);
+			job.texture->setPath(files.front());
+			for (const auto& file : files)
+				job.pending.push_back(m_Pool.submit([file, flip]() { return decodeImage(file, flip); }));
+
+			m_Stats.requested++;
+			m_Jobs.push_back(std::move(job));
+			return m_Jobs.back().texture;
+		}
+
+		void fail(Job& job, const std::string& error) {
+			job.texture->m_Failed = true;
+			job.texture->m_Error = error;
+			job.texture->free();
+			m_Stats.failed++;
+		}
+
+		/*
+		Returns false while a face is still decoding
+		*/
+		bool collect(Job& job) {
+			for (auto& face : job.pending)
+				if (face.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+					return false;
+
+			for (auto& face : job.pending) {
+				job.faces.push_back(face.get());
+				m_Stats.decodeMs += job.faces.back().milliseconds;
+			}
+			job.pending.clear();
+
+			const DecodedImage& first = job.faces.front();
+			for (const auto& face : job.faces)
+				if (face.width != first.width || face.height != first.height)
+					throw std::exception(("Cube map faces differ in size: " + job.texture->path()).c_str());
+
+			AsyncTexture& texture = *job.texture;
+			GLenum target = texture.m_Target;
+			bool cube = target == GL_TEXTURE_CUBE_MAP;
+			glGenTextures(1, &texture.m_ID);
+			glstate::bindTextureForEdit(target, texture.m_ID);
+			glTexStorage2D(target, cube ? 1 : mipLevels(first.width, first.height), GL_RGBA8, first.width, first.height);
+			glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(target, GL_TEXTURE_WRAP_S, cube ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+			glTexParameteri(target, GL_TEXTURE_WRAP_T, cube ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+			if (cube)
+				glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+			glstate::count(7);
+			return true;
+		}
+
+		/*
+		Copies rows of the current face into the unpack buffer and returns their offset in it
+		*/
+		GLintptr stage(const unsigned char* rows, GLsizeiptr size) {
+			if (m_Stream) {
+				StreamBuffer::Allocation allocation = m_Stream->allocate(size, 4);
+				std::memcpy(allocation.data, rows, size);
+				m_Stream->bind(GL_PIXEL_UNPACK_BUFFER);
+				glstate::count();
+				return allocation.offset;
+			}
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_Pbo);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+			void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+			std::memcpy(mapped, rows, size);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			glstate::count(3);
+			return 0;
+		}
+
+		/*
+		Uploads rows until budget runs out, returns true once every face is uploaded
+		*/
+		bool upload(Job& job, GLsizeiptr& budget, std::chrono::steady_clock::time_point deadline) {
+			AsyncTexture& texture = *job.texture;
+			glstate::bindTextureForEdit(texture.m_Target, texture.m_ID);
+
+			while (job.face < job.faces.size()) {
+				if (budget <= 0 || std::chrono::steady_clock::now() > deadline)
+					return false;
+
+				const DecodedImage& face = job.faces[job.face];
+				GLsizeiptr rowBytes = face.rowBytes();
+				// Half the ring at most, so a chunk never waits on the one staged just before it
+				GLsizeiptr chunk = m_Stream ? std::min(budget, m_Stream->size() / 2) : budget;
+				GLsizei rows = GLsizei(std::clamp<GLsizeiptr>(chunk / rowBytes, 1, face.height - job.row));
+				GLsizeiptr size = rows * rowBytes;
+
+				GLintptr offset = stage(face.pixels.get() + job.row * rowBytes, size);
+				GLenum target = texture.m_Target == GL_TEXTURE_CUBE_MAP ? GLenum(GL_TEXTURE_CUBE_MAP_POSITIVE_X + job.face) : texture.m_Target;
+				glTexSubImage2D(target, 0, 0, job.row, face.width, rows, GL_RGBA, GL_UNSIGNED_BYTE, (void*)offset);
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+				glstate::count(2);
+
+				budget -= size;
+				m_Stats.bytesUploaded += size;
+				job.row += rows;
+				if (job.row == face.height) {
+					job.row = 0;
+					job.face++;
+				}
+			}
+
+			if (texture.m_Target != GL_TEXTURE_CUBE_MAP) {
+				glGenerateMipmap(texture.m_Target);
+				glstate::count();
+			}
+			// Pixels are in the unpack buffer or the texture by now
+			job.faces.clear();
+			texture.m_Ready = true;
+			m_Stats.completed++;
+			return true;
+		}
+
+	public:
+
+		/*
+		threads of 0 uses every hardware thread
+		*/
+		explicit TextureLoader(unsigned threads = 0)
+			:
+			m_Pool(threads)
+		{
+			m_Placeholder2D = placeholder(GL_TEXTURE_2D);
+			m_PlaceholderCube = placeholder(GL_TEXTURE_CUBE_MAP);
+			if (StreamBuffer::supported())
+				m_Stream = std::make_unique<StreamBuffer>(GL_PIXEL_UNPACK_BUFFER, m_BytesPerFrame * 3);
+			else
+				glGenBuffers(1, &m_Pbo);
+		}
+
+		TextureLoader(const TextureLoader&) = delete;
+		TextureLoader& operator=(const TextureLoader&) = delete;
+
+		~TextureLoader() {
+			glDeleteTextures(1, &m_Placeholder2D);
+			glDeleteTextures(1, &m_PlaceholderCube);
+			glstate::forgetTexture(m_Placeholder2D);
+			glstate::forgetTexture(m_PlaceholderCube);
+			glDeleteBuffers(1, &m_Pbo);
+		}
+
+		/*
+		flip matches Sampler2D, images are flipped so their first row is at the bottom
+		*/
+		std::shared_ptr<AsyncTexture> load2D(const std::string& file, GLuint unit, Senum type = rTdiffuse, bool flip = true) {
+			return request(GL_TEXTURE_2D, { file }, flip, unit, type);
+		}
+
+		std::shared_ptr<AsyncTexture> loadCube(const std::array<std::string, 6>& faces, GLuint unit, Senum type = rTdiffuse) {
+			return request(GL_TEXTURE_CUBE_MAP, std::vector<std::string>(faces.begin(), faces.end()), false, unit, type);
+		}
+
+		/*
+		Caps the upload work of one update(), at least one row is uploaded per call while work is left
+		bytes beyond the staging ring size aren't useful, it is sized for three frames of the initial budget
+		*/
+		void setBudget(GLsizeiptr bytesPerFrame, double millisecondsPerFrame) {
+			m_BytesPerFrame = std::max<GLsizeiptr>(bytesPerFrame, 1);
+			m_MillisecondsPerFrame = millisecondsPerFrame;
+		}
+
+		/*
+		Call once per frame, uploads decoded images oldest first within the budget
+		*/
+		void update() {
+			if (m_Jobs.empty())
+				return;
+
+			auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+				std::chrono::duration<double, std::milli>(m_MillisecondsPerFrame));
+			GLsizeiptr budget = m_BytesPerFrame;
+
+			for (auto job = m_Jobs.begin(); job != m_Jobs.end();) {
+				bool done = false;
+				try {
+					if (!job->pending.empty() && !collect(*job)) {
+						++job;
+						continue;
+					}
+					done = upload(*job, budget, deadline);
+				}
+				catch (const std::exception& exception) {
+					fail(*job, exception.what());
+					done = true;
+				}
+
+				if (done)
+					job = m_Jobs.erase(job);
+				else if (budget <= 0 || std::chrono::steady_clock::now() > deadline)
+					break;
+				else
+					++job;
+			}
+
+			if (m_Stream)
+				m_Stream->fence();
+			if (m_Jobs.empty())
+				m_Stats.wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_BatchStart).count();
+		}
+
+		inline bool idle() const { return m_Jobs.empty(); }
+		inline size_t pending() const { return m_Jobs.size(); }
+		inline size_t threadCount() const { return m_Pool.threadCount(); }
+		inline const TextureLoadStats& stats() const { return m_Stats; }
+		inline void resetStats() { m_Stats = TextureLoadStats(); }
+	};
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include <cmath>
+#include <chrono>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include "glad/glad.h"
+#include "../engine_abstractions/dtypes.h"
+#include "../engine_abstractions/buffer_objects.h"
+#include "mesh_simplifier.h"
+
+namespace rtre {
+
+	struct MeshLod {
+		GLuint firstIndex = 0;
+		GLuint indexCount = 0;
+		GLint baseVertex = 0;
+		GLuint vertexCount = 0;
+		// Largest collapse error of the level, in world units
+		GLfloat error = 0;
+		double buildMs = 0;
+
+		inline GLuint triangles() const { return indexCount / 3; }
+	};
+
+	/*
+	Chain of progressively simplified meshes sharing one vertex and one index buffer
+	Level 0 is the source mesh, each further level is simplified from the previous one by ratio
+	Levels are drawn with glDrawElementsBaseVertex from their offsets, so switching levels never rebinds buffers
+	*/
+	class LodChain {
+
+		Vao m_Vao;
+		Vbo m_Vbo;
+		Ebo m_Ebo;
+		std::vector<MeshLod> m_Levels;
+
+	public:
+
+		LodChain() {
+			m_Vao.unbind();
+		}
+
+		LodChain(const LodChain&) = delete;
+		LodChain& operator=(const LodChain&) = delete;
+
+		/*
+		Builds up to levels levels, stopping early once a level would drop under minTriangles or stops shrinking
+		*/
+		void build(const BasicMesh& mesh, GLuint levels = 5, GLfloat ratio = 0.5f, size_t minTriangles = 64) {
+			m_Levels.clear();
+
+			MeshLod base;
+			base.indexCount = GLuint(mesh.indexCount());
+			base.vertexCount = GLuint(mesh.vertexCount());
+			m_Levels.push_back(base);
+
+			std::vector<BasicMesh> simplified;
+			MeshSimplifier simplifier;
+			const BasicMesh* previous = &mesh;
+			size_t vertexCount = mesh.vertexCount(), indexCount = mesh.indexCount();
+			while (m_Levels.size() < levels) {
+				size_t target = size_t(previous->indexCount() / 3 * ratio);
+				if (target < minTriangles)
+					break;
+
+				auto start = std::chrono::steady_clock::now();
+				MeshLod level;
+				BasicMesh next = simplifier.simplify(previous->getVertices(), previous->getIndices(), target, &level.error);
+				level.buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+				if (next.indexCount() >= previous->indexCount())
+					break;
+
+				level.error = std::max(level.error, m_Levels.back().error);
+				level.firstIndex = GLuint(indexCount);
+				level.indexCount = GLuint(next.indexCount());
+				level.baseVertex = GLint(vertexCount);
+				level.vertexCount = GLuint(next.vertexCount());
+				m_Levels.push_back(level);
+
+				vertexCount += next.vertexCount();
+				indexCount += next.indexCount();
+				simplified.push_back(std::move(next));
+				previous = &simplified.back();
+			}
+
+			// Every level is written straight from its own storage into the shared buffers
+			// Without DSA the element array binding belongs to the bound Vao, so ours is bound before touching the Ebo
+			m_Vao.bind();
+			m_Vbo.allocate(vertexCount * sizeof(Vertex3));
+			m_Ebo.allocate(indexCount * sizeof(GLuint));
+			for (size_t i = 0; i < m_Levels.size(); i++) {
+				const BasicMesh& level = i == 0 ? mesh : simplified[i - 1];
+				m_Vbo.write(m_Levels[i].baseVertex * sizeof(Vertex3), level.getVertices());
+				m_Ebo.write(m_Levels[i].firstIndex * sizeof(GLuint), level.getIndices());
+			}
+			m_Vao.attachVertices(m_Vbo.id(), sizeof(Vertex3));
+			m_Vao.attachIndices(m_Ebo.id());
+			m_Vao.attribute(0, 3, GL_FLOAT, offsetof(Vertex3, position));
+			m_Vao.attribute(1, 2, GL_FLOAT, offsetof(Vertex3, txtCoord));
+			m_Vao.attribute(2, 3, GL_FLOAT, offsetof(Vertex3, normal));
+			m_Vao.unbind();
+		}
+
+		/*
+		Coarsest level whose error, projected at distance, stays under pixelError pixels
+		fovY in radians, viewportHeight in pixels
+		*/
+		GLuint select(GLfloat distance, GLfloat fovY, GLfloat viewportHeight, GLfloat pixelError = 1.f) const {
+			if (m_Levels.empty())
+				return 0;
+			GLfloat pixelsPerUnit = viewportHeight / (2 * std::max(distance, 1e-4f) * std::tan(fovY * 0.5f));
+			GLuint level = 0;
+			for (GLuint i = 1; i < m_Levels.size(); i++)
+				if (m_Levels[i].error * pixelsPerUnit <= pixelError)
+					level = i;
+			return level;
+		}
+
+		void draw(GLuint level) {
+			if (m_Levels.empty())
+				return;
+			const MeshLod& lod = m_Levels[std::min<size_t>(level, m_Levels.size() - 1)];
+			m_Vao.bind();
+			glDrawElementsBaseVertex(GL_TRIANGLES, lod.indexCount, GL_UNSIGNED_INT, (void*)(lod.firstIndex * sizeof(GLuint)), lod.baseVertex);
+			m_Vao.unbind();
+		}
+
+		inline bool empty() const { return m_Levels.empty(); }
+		inline size_t levelCount() const { return m_Levels.size(); }
+		inline const std::vector<MeshLod>& levels() const { return m_Levels; }
+	};
+}
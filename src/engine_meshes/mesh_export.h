@@ -0,0 +1,35 @@
+#pragma once
+#include <string>
+#include <fstream>
+#include "../engine_abstractions/dtypes.h"
+
+namespace rtre {
+
+	/*
+	Writes mesh as a Wavefront OBJ with positions, normals and texture coordinates
+	*/
+	void writeObj(const BasicMesh& mesh, const std::string& path) {
+		std::ofstream out(path);
+		if (!out) {
+			std::string message = "Could not open " + path + " for writing\n";
+			throw std::exception(message.c_str());
+		}
+
+		out << "# Generated by rtre\n";
+		for (const auto& vertex : mesh.getVertices()) {
+			out << "v " << vertex.position.x << " " << vertex.position.y << " " << vertex.position.z << "\n";
+			out << "vn " << vertex.normal.x << " " << vertex.normal.y << " " << vertex.normal.z << "\n";
+			out << "vt " << vertex.txtCoord.x << " " << vertex.txtCoord.y << "\n";
+		}
+
+		Span<const GLuint> indices = mesh.getIndices();
+		for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+			out << "f";
+			for (size_t j = 0; j < 3; j++) {
+				GLuint index = indices[i + j] + 1;
+				out << " " << index << "/" << index << "/" << index;
+			}
+			out << "\n";
+		}
+	}
+}
@@ -0,0 +1,344 @@
+#pragma once
+#include <cmath>
+#include <array>
+#include <queue>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+#include "../engine_abstractions/dtypes.h"
+
+namespace rtre {
+
+	/*
+	Quadric error metric mesh simplification, Garland and Heckbert
+	Edges are collapsed cheapest first until the target triangle count is reached or nothing can collapse
+	Each vertex accumulates the planes of its faces, collapsed vertices move to the point minimizing
+	the summed squared plane distances, open borders get perpendicular planes so they hold their shape
+	Collapses that would flip a face or make the surface non-manifold are skipped
+	Coincident vertices are welded first, so unindexed soup simplifies like an indexed mesh
+	*/
+	class MeshSimplifier {
+
+		// Symmetric 4x4, upper triangle row by row
+		typedef std::array<double, 10> Quadric;
+
+		struct Candidate {
+			double cost;
+			GLuint a, b;
+			GLuint versionA, versionB;
+			vec3 target;
+
+			inline bool operator>(const Candidate& other) const { return cost > other.cost; }
+		};
+
+		std::vector<vec3> m_Positions;
+		std::vector<Quadric> m_Quadrics;
+		std::vector<GLuint> m_Versions;
+		std::vector<bool> m_Removed;
+		std::vector<std::vector<GLuint>> m_VertexFaces;
+		std::vector<std::array<GLuint, 3>> m_Faces;
+		std::vector<bool> m_FaceRemoved;
+		std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> m_Heap;
+
+		double m_Error = 0;
+
+		static Quadric plane(const vec3& n, double d, double weight) {
+			return {
+				weight * n.x * n.x, weight * n.x * n.y, weight * n.x * n.z, weight * n.x * d,
+				weight * n.y * n.y, weight * n.y * n.z, weight * n.y * d,
+				weight * n.z * n.z, weight * n.z * d,
+				weight * d * d };
+		}
+
+		static void accumulate(Quadric& into, const Quadric& q) {
+			for (size_t i = 0; i < into.size(); i++)
+				into[i] += q[i];
+		}
+
+		static double evaluate(const Quadric& q, const vec3& v) {
+			double x = v.x, y = v.y, z = v.z;
+			return q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x
+				+ q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y
+				+ q[7] * z * z + 2 * q[8] * z
+				+ q[9];
+		}
+
+		/*
+		Point minimizing the quadric, false when it's singular
+		*/
+		static bool optimum(const Quadric& q, vec3& out) {
+			double a = q[0], b = q[1], c = q[2], d = q[4], e = q[5], f = q[7];
+			double det = a * (d * f - e * e) - b * (b * f - e * c) + c * (b * e - d * c);
+			if (std::fabs(det) < 1e-12)
+				return false;
+			double r0 = -q[3], r1 = -q[6], r2 = -q[8];
+			out = vec3(
+				GLfloat((r0 * (d * f - e * e) - b * (r1 * f - e * r2) + c * (r1 * e - d * r2)) / det),
+				GLfloat((a * (r1 * f - e * r2) - r0 * (b * f - e * c) + c * (b * r2 - r1 * c)) / det),
+				GLfloat((a * (d * r2 - r1 * e) - b * (b * r2 - r1 * c) + r0 * (b * e - d * c)) / det));
+			return true;
+		}
+
+		static inline uint64_t edgeKey(GLuint a, GLuint b) {
+			return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+		}
+
+		/*
+		For every vertex the first one at its quantised position, so triangle soup like marching tetrahedra's shares
+		its edges instead of every edge being a border
+		*/
+		static std::vector<GLuint> weld(Span<const Vertex3> vertices) {
+			std::vector<GLuint> canonical(vertices.size());
+			if (vertices.size() == 0)
+				return canonical;
+			vec3 low = vertices[0].position, high = low;
+			for (size_t i = 0; i < vertices.size(); i++) {
+				low = glm::min(low, vertices[i].position);
+				high = glm::max(high, vertices[i].position);
+			}
+			// 2^20 steps over the largest extent, far below any edge the mesher produces
+			GLfloat extent = std::max(std::max(high.x - low.x, high.y - low.y), std::max(high.z - low.z, 1e-6f));
+			GLfloat scale = GLfloat(1 << 20) / extent;
+
+			std::unordered_map<uint64_t, GLuint> first;
+			first.reserve(vertices.size());
+			for (size_t i = 0; i < vertices.size(); i++) {
+				vec3 q = glm::round((vertices[i].position - low) * scale);
+				uint64_t key = (uint64_t(q.x) << 42) | (uint64_t(q.y) << 21) | uint64_t(q.z);
+				canonical[i] = first.emplace(key, GLuint(i)).first->second;
+			}
+			return canonical;
+		}
+
+		inline vec3 faceNormal(const std::array<GLuint, 3>& face) const {
+			return glm::cross(m_Positions[face[1]] - m_Positions[face[0]], m_Positions[face[2]] - m_Positions[face[0]]);
+		}
+
+		void push(GLuint a, GLuint b) {
+			Quadric q = m_Quadrics[a];
+			accumulate(q, m_Quadrics[b]);
+
+			vec3 target;
+			if (!optimum(q, target)) {
+				// Fall back to the best of the endpoints and the midpoint
+				vec3 options[3] = { m_Positions[a], m_Positions[b], (m_Positions[a] + m_Positions[b]) * 0.5f };
+				target = options[0];
+				for (const vec3& option : options)
+					if (evaluate(q, option) < evaluate(q, target))
+						target = option;
+			}
+			m_Heap.push({ std::max(evaluate(q, target), 0.0), a, b, m_Versions[a], m_Versions[b], target });
+		}
+
+		void neighbours(GLuint v, std::vector<GLuint>& out) const {
+			out.clear();
+			for (GLuint f : m_VertexFaces[v])
+				for (GLuint u : m_Faces[f])
+					if (u != v && std::find(out.begin(), out.end(), u) == out.end())
+						out.push_back(u);
+		}
+
+		/*
+		Link condition, the vertices shared by a's and b's neighbourhoods must be exactly the ones opposite the edge
+		*/
+		bool manifold(GLuint a, GLuint b, std::vector<GLuint>& na, std::vector<GLuint>& nb) const {
+			neighbours(a, na);
+			neighbours(b, nb);
+			GLuint common = 0;
+			for (GLuint v : na)
+				if (std::find(nb.begin(), nb.end(), v) != nb.end())
+					common++;
+
+			GLuint shared = 0;
+			for (GLuint f : m_VertexFaces[a]) {
+				const auto& face = m_Faces[f];
+				if (face[0] == b || face[1] == b || face[2] == b)
+					shared++;
+			}
+			return common == shared;
+		}
+
+		bool flips(GLuint moving, GLuint other, const vec3& target) const {
+			for (GLuint f : m_VertexFaces[moving]) {
+				auto face = m_Faces[f];
+				if (face[0] == other || face[1] == other || face[2] == other)
+					continue;
+				vec3 before = faceNormal(face);
+				vec3 moved[3] = { m_Positions[face[0]], m_Positions[face[1]], m_Positions[face[2]] };
+				for (GLuint i = 0; i < 3; i++)
+					if (face[i] == moving)
+						moved[i] = target;
+				vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+				if (glm::dot(before, after) <= 0)
+					return true;
+			}
+			return false;
+		}
+
+		/*
+		Merges b into a, returns the number of faces removed
+		*/
+		size_t collapse(const Candidate& edge) {
+			GLuint a = edge.a, b = edge.b;
+			size_t removed = 0;
+			for (GLuint f : m_VertexFaces[b]) {
+				auto& face = m_Faces[f];
+				if (face[0] == a || face[1] == a || face[2] == a) {
+					m_FaceRemoved[f] = true;
+					removed++;
+					continue;
+				}
+				for (GLuint& v : face)
+					if (v == b)
+						v = a;
+				m_VertexFaces[a].push_back(f);
+			}
+
+			auto& faces = m_VertexFaces[a];
+			faces.erase(std::remove_if(faces.begin(), faces.end(), [&](GLuint f) { return m_FaceRemoved[f]; }), faces.end());
+
+			// The faces removed from a's list are the ones shared with b, drop them from their third vertex as well
+			for (GLuint f : m_VertexFaces[b]) {
+				if (!m_FaceRemoved[f])
+					continue;
+				for (GLuint v : m_Faces[f]) {
+					if (v == a || v == b)
+						continue;
+					auto& others = m_VertexFaces[v];
+					others.erase(std::remove(others.begin(), others.end(), f), others.end());
+				}
+			}
+
+			m_VertexFaces[b].clear();
+			m_Removed[b] = true;
+			m_Positions[a] = edge.target;
+			accumulate(m_Quadrics[a], m_Quadrics[b]);
+			m_Versions[a]++;
+			m_Error = std::max(m_Error, edge.cost);
+			return removed;
+		}
+
+	public:
+
+		/*
+		Simplifies mesh towards targetTriangles
+		error receives the square root of the largest collapse cost, roughly how far the surface moved in world units
+		Normals are recomputed from the simplified faces, texture coordinates are kept from the surviving vertices
+		*/
+		BasicMesh simplify(Span<const Vertex3> vertices, Span<const GLuint> indices, size_t targetTriangles, GLfloat* error = nullptr) {
+			size_t vertexCount = vertices.size();
+			m_Positions.resize(vertexCount);
+			for (size_t i = 0; i < vertexCount; i++)
+				m_Positions[i] = vertices[i].position;
+			m_Quadrics.assign(vertexCount, Quadric{});
+			m_Versions.assign(vertexCount, 0);
+			m_Removed.assign(vertexCount, false);
+			m_VertexFaces.assign(vertexCount, {});
+			m_Faces.clear();
+			m_Heap = decltype(m_Heap)();
+			m_Error = 0;
+
+			std::vector<GLuint> canonical = weld(vertices);
+			std::unordered_map<uint64_t, GLuint> edges;
+			for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+				std::array<GLuint, 3> face = { canonical[indices[i]], canonical[indices[i + 1]], canonical[indices[i + 2]] };
+				if (face[0] == face[1] || face[1] == face[2] || face[0] == face[2])
+					continue;
+
+				vec3 n = faceNormal(face);
+				GLfloat area = glm::length(n);
+				if (area <= 0)
+					continue;
+				n /= area;
+				Quadric q = plane(n, -glm::dot(n, m_Positions[face[0]]), 1.0);
+
+				GLuint f = GLuint(m_Faces.size());
+				m_Faces.push_back(face);
+				for (GLuint j = 0; j < 3; j++) {
+					accumulate(m_Quadrics[face[j]], q);
+					m_VertexFaces[face[j]].push_back(f);
+					edges[edgeKey(face[j], face[(j + 1) % 3])]++;
+				}
+			}
+			m_FaceRemoved.assign(m_Faces.size(), false);
+
+			// Border edges belong to a single face, a heavily weighted plane through them and along the face normal pins them
+			for (const auto& face : m_Faces) {
+				vec3 n = glm::normalize(faceNormal(face));
+				for (GLuint j = 0; j < 3; j++) {
+					GLuint a = face[j], b = face[(j + 1) % 3];
+					if (edges[edgeKey(a, b)] != 1)
+						continue;
+					vec3 along = m_Positions[b] - m_Positions[a];
+					GLfloat length = glm::length(along);
+					if (length <= 0)
+						continue;
+					vec3 side = glm::normalize(glm::cross(along, n));
+					Quadric q = plane(side, -glm::dot(side, m_Positions[a]), 100.0);
+					accumulate(m_Quadrics[a], q);
+					accumulate(m_Quadrics[b], q);
+				}
+			}
+
+			for (const auto& edge : edges)
+				push(GLuint(edge.first >> 32), GLuint(edge.first & 0xFFFFFFFF));
+
+			size_t triangles = m_Faces.size();
+			std::vector<GLuint> na, nb;
+			while (triangles > targetTriangles && !m_Heap.empty()) {
+				Candidate edge = m_Heap.top();
+				m_Heap.pop();
+				if (m_Removed[edge.a] || m_Removed[edge.b] || m_Versions[edge.a] != edge.versionA || m_Versions[edge.b] != edge.versionB)
+					continue;
+				if (!manifold(edge.a, edge.b, na, nb) || flips(edge.a, edge.b, edge.target) || flips(edge.b, edge.a, edge.target))
+					continue;
+
+				triangles -= collapse(edge);
+				neighbours(edge.a, na);
+				for (GLuint v : na)
+					push(edge.a, v);
+			}
+
+			if (error)
+				*error = GLfloat(std::sqrt(m_Error));
+			return compact(vertices);
+		}
+
+	private:
+
+		BasicMesh compact(Span<const Vertex3> vertices) {
+			std::vector<GLint> remap(m_Positions.size(), -1);
+			std::vector<Vertex3> outVertices;
+			std::vector<GLuint> outIndices;
+
+			for (size_t f = 0; f < m_Faces.size(); f++) {
+				if (m_FaceRemoved[f])
+					continue;
+				for (GLuint v : m_Faces[f]) {
+					if (remap[v] < 0) {
+						remap[v] = GLint(outVertices.size());
+						outVertices.push_back(Vertex3(m_Positions[v], vertices[v].txtCoord, vec3(0)));
+					}
+					outIndices.push_back(GLuint(remap[v]));
+				}
+			}
+
+			for (size_t i = 0; i + 2 < outIndices.size(); i += 3) {
+				Vertex3& a = outVertices[outIndices[i]];
+				Vertex3& b = outVertices[outIndices[i + 1]];
+				Vertex3& c = outVertices[outIndices[i + 2]];
+				vec3 n = glm::cross(b.position - a.position, c.position - a.position);
+				a.normal += n;
+				b.normal += n;
+				c.normal += n;
+			}
+			for (auto& vertex : outVertices) {
+				GLfloat length = glm::length(vertex.normal);
+				vertex.normal = length > 0 ? vertex.normal / length : vec3(0, 1, 0);
+			}
+
+			return BasicMesh(std::move(outVertices), std::move(outIndices));
+		}
+	};
+}
@@ -82,14 +82,13 @@ namespace rtre {
 		Ebo m_Ebo;
 
 		void loadData() {
-			m_Vao.bind();
 			m_Vbo.loadData(s_Vertices);
 			m_Ebo.loadData(s_Indices);
-			m_Vao.linkAttrib(0, 2, GL_FLOAT, sizeof(Vertex2), (void*)0);
-			m_Vao.linkAttrib(1, 2, GL_FLOAT, sizeof(Vertex2), (void*)sizeof(vec2));
+			m_Vao.attachVertices(m_Vbo.id(), sizeof(Vertex2));
+			m_Vao.attachIndices(m_Ebo.id());
+			m_Vao.attribute(0, 2, GL_FLOAT, 0);
+			m_Vao.attribute(1, 2, GL_FLOAT, sizeof(vec2));
 			m_Vao.unbind();
-			m_Vbo.unbind();
-			m_Ebo.unbind();
 		}
 
 
@@ -0,0 +1,102 @@
+#pragma once
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "glad/glad.h"
+#include "../engine_abstractions/dtypes.h"
+#include "../engine_abstractions/buffer_objects.h"
+#include "../engine_system/allocation_counter.h"
+
+namespace rtre {
+
+	struct UploadCost {
+		std::string path;
+		double milliseconds = 0;
+		uint64_t allocations = 0;
+		bool allocationsCounted = false;
+	};
+
+	/*
+	Compares ways of getting a large mesh into GPU buffers
+		Copy then upload	copies the vertex and index vectors first, what by-value mesh accessors used to cost
+		Upload from views	glBufferData straight from the mesh's storage
+		Update in place		glBufferSubData into buffers already large enough
+	Times include a glFinish so the driver's copy is counted, allocations are only counted in builds with RTRE_COUNT_ALLOCATIONS
+	*/
+	class UploadBenchmark {
+
+		std::vector<UploadCost> m_Results;
+		size_t m_Vertices = 0;
+
+		template<class Work>
+		void measure(const char* path, GLuint repeats, Work work) {
+			glFinish();
+			uint64_t allocations = allocationCount();
+			auto start = std::chrono::steady_clock::now();
+			for (GLuint i = 0; i < repeats; i++)
+				work();
+			glFinish();
+
+			UploadCost cost;
+			cost.path = path;
+			cost.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repeats;
+			cost.allocations = (allocationCount() - allocations) / repeats;
+			cost.allocationsCounted = countsAllocations();
+			m_Results.push_back(cost);
+		}
+
+	public:
+
+		/*
+		Square grid with at least vertexCount vertices
+		*/
+		static BasicMesh grid(size_t vertexCount) {
+			GLuint side = std::max<GLuint>(GLuint(std::ceil(std::sqrt(double(vertexCount)))), 2);
+			std::vector<Vertex3> vertices;
+			std::vector<GLuint> indices;
+			vertices.reserve(size_t(side) * side);
+			indices.reserve(size_t(side - 1) * (side - 1) * 6);
+
+			for (GLuint y = 0; y < side; y++)
+				for (GLuint x = 0; x < side; x++)
+					vertices.push_back(Vertex3(vec3(GLfloat(x), 0, GLfloat(y)), vec2(GLfloat(x) / side, GLfloat(y) / side), vec3(0, 1, 0)));
+			for (GLuint y = 0; y + 1 < side; y++)
+				for (GLuint x = 0; x + 1 < side; x++) {
+					GLuint i = y * side + x;
+					indices.insert(indices.end(), { i, i + side, i + 1, i + 1, i + side, i + side + 1 });
+				}
+			return BasicMesh(std::move(vertices), std::move(indices));
+		}
+
+		void run(size_t vertexCount = 1 << 20, GLuint repeats = 4) {
+			m_Results.clear();
+			BasicMesh mesh = grid(vertexCount);
+			m_Vertices = mesh.vertexCount();
+
+			Vao vao;
+			Vbo vbo;
+			Ebo ebo;
+
+			measure("Copy then upload", repeats, [&]() {
+				std::vector<Vertex3> vertices(mesh.getVertices().begin(), mesh.getVertices().end());
+				std::vector<GLuint> indices(mesh.getIndices().begin(), mesh.getIndices().end());
+				vbo.loadData(vertices);
+				ebo.loadData(indices);
+			});
+			measure("Upload from views", repeats, [&]() {
+				vbo.loadData(mesh.getVertices());
+				ebo.loadData(mesh.getIndices());
+			});
+			measure("Update in place", repeats, [&]() {
+				vbo.update(mesh.getVertices());
+				ebo.update(mesh.getIndices());
+			});
+
+			vao.unbind();
+		}
+
+		inline size_t vertices() const { return m_Vertices; }
+		inline const std::vector<UploadCost>& results() const { return m_Results; }
+	};
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <algorithm>
+#include "glm/glm.hpp"
+#include "../engine_scene/sdf_scene.h"
+#include "../engine_scene/bytecode_evaluator.h"
+#include "../engine_scene/sdf_queries.h"
+
+
+namespace rtre {
+
+	/*
+	Keeps a sphere of radius around the camera out of the scene's geometry
+	Owns a copy of the scene, so the simulation thread can use it while the editor keeps changing the original,
+	and is rebuilt when the scene changes
+	*/
+	class CameraCollider {
+
+		SdfScene m_Scene;
+		BytecodeEvaluator m_Evaluator;
+		SdfQueries m_Queries;
+		GLfloat m_Radius;
+
+		// Slides along at most this many surfaces per move, corners take two
+		static const GLuint s_Slides = 3;
+
+	public:
+
+		CameraCollider(const SdfScene& scene, GLfloat radius = 0.2f, bool repetition = true)
+			:
+			m_Scene(scene),
+			m_Evaluator(m_Scene, repetition),
+			m_Queries(m_Evaluator, 1e-4f, 64, 1),
+			m_Radius(radius)
+		{
+		}
+
+		CameraCollider(const CameraCollider&) = delete;
+		CameraCollider& operator=(const CameraCollider&) = delete;
+
+		/*
+		Pushes position out along the gradient until the sphere only touches the geometry
+		*/
+		vec3 pushOut(const vec3& position) const {
+			GLfloat distance = m_Evaluator.distance(position);
+			if (distance >= m_Radius)
+				return position;
+			return position + m_Evaluator.normal(position) * (m_Radius - distance);
+		}
+
+		/*
+		Where the camera ends up moving from from towards to, sliding along the surfaces it touches
+		A camera starting inside the geometry is pushed out first
+		*/
+		vec3 move(const vec3& from, const vec3& to) const {
+			if (m_Scene.empty())
+				return to;
+
+			vec3 position = pushOut(from);
+			vec3 motion = to - from;
+			for (GLuint slide = 0; slide < s_Slides && glm::length(motion) > 1e-6f; slide++) {
+				SdfHit hit = m_Queries.sweep({ position, m_Radius, motion });
+				if (!hit.hit) {
+					position += motion;
+					break;
+				}
+
+				// Stop just short of the contact and keep the motion along the surface
+				GLfloat length = glm::length(motion);
+				GLfloat travelled = std::max(hit.distance - m_Queries.epsilon(), 0.0f);
+				position += motion * (travelled / length);
+				motion *= 1 - travelled / length;
+				motion -= hit.normal * std::min(glm::dot(motion, hit.normal), 0.0f);
+
+				// Already touching, a sweep would stop at once, so slide and let pushOut settle it
+				if (travelled == 0) {
+					position += motion;
+					break;
+				}
+			}
+			return pushOut(position);
+		}
+
+		inline GLfloat radius() const { return m_Radius; }
+		inline const SdfScene& scene() const { return m_Scene; }
+	};
+}
@@ -1,8 +1,15 @@
 #pragma once
 #include <chrono>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <algorithm>
 #include "GLFW/rtre_Window.h"
 #include "../engine_rendering/camera.h"
-#include "../rtre_base.h" 
+#include "camera_collider.h"
+#include "../engine_system/triple_buffer.h"
+#include "../rtre_base.h"
 
 
 namespace rtre {
@@ -16,78 +23,256 @@ namespace rtre {
 	}
 
 	namespace controller {
-		
-		static rTtime lastTime,crntTime,deltaTime;
+
+		enum InputKey : GLuint {
+			rKforward = 1 << 0,
+			rKbackward = 1 << 1,
+			rKleft = 1 << 2,
+			rKright = 1 << 3,
+			rKup = 1 << 4,
+			rKdown = 1 << 5
+		};
+
+		/*
+		Input as sampled on the render thread, GLFW only allows polling input from the main thread
+		speed is the camera speed in units per second
+		*/
+		struct InputState {
+			GLuint keys = 0;
+			glm::vec2 cursor = glm::vec2(0, 0);
+			GLfloat speed = 0;
+		};
+
+		/*
+		Camera state of the last two simulation ticks, time is when the latest one was published
+		*/
+		struct CameraSnapshot {
+			glm::vec3 previousPosition = glm::vec3(0);
+			glm::vec3 position = glm::vec3(0);
+			glm::vec3 previousOrientation = glm::vec3(0, 0, 1);
+			glm::vec3 orientation = glm::vec3(0, 0, 1);
+			rTtime time = 0;
+		};
+
 		static const float mSensitivity = 7.0f;
-		static bool firstCall = true;
 		static const glm::vec2 sensitivityModifier(100, 50);
-		glm::vec2 prevCursorPos(0,0);
-		glm::vec2 crntCursorPos(0,0);
-		glm::vec2 cursorDelta(0, 0);
-		void control() {
 
+		/*
+		Integrates camera motion on its own thread at a fixed tick, independently of the render rate
+		Input reaches it and camera snapshots leave it through triple buffers, so neither thread waits on the other
+		With a collider set, every tick's motion is swept against the scene and slides along what it hits
+		*/
+		class Simulation {
 
-			crntTime = getTime();
-			deltaTime = crntTime - lastTime;
+			std::thread m_Thread;
+			std::atomic<bool> m_Running{ false };
+			rTtime m_Tick = 1000000 / 120;
 
-			if (firstCall) {
-				firstCall = false;
-				eWindow->setInputMode(GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-				eWindow->setCursorPosition(viewportWidth / 2, viewportHeight / 2);
-				crntCursorPos = glm::vec2(viewportWidth /2, viewportHeight/2);
-				prevCursorPos = glm::vec2(viewportWidth / 2, viewportHeight / 2);
-			}
-			else {
-				auto crntCursorPos_PlaceHolder = eWindow->getCursorPosition();
-				crntCursorPos = glm::vec2(crntCursorPos_PlaceHolder.x, crntCursorPos_PlaceHolder.y);
+			TripleBuffer<InputState> m_Input;
+			TripleBuffer<CameraSnapshot> m_Snapshots;
 
+			// Swapped whole by the render thread, the simulation keeps its copy for the tick
+			std::mutex m_ColliderMutex;
+			std::shared_ptr<const CameraCollider> m_Collider;
 
-				cursorDelta = -mSensitivity * ((crntCursorPos - prevCursorPos) / sensitivityModifier);
+			static void step(Camera& body, const InputState& input, glm::vec2 previousCursor, GLfloat deltaTime, const CameraCollider* collider) {
+				glm::vec2 cursorDelta = -mSensitivity * ((input.cursor - previousCursor) / sensitivityModifier);
 
-				camera.setSpeed( glm::vec3(deltaTime)*camera.speed());
+				body.setSpeed(glm::vec3(input.speed * deltaTime));
 
 				// Guards so camera doesn't get cuckery
-				if ((camera.orientation().y <= -0.99f) && cursorDelta.y < 0) {
+				if ((body.orientation().y <= -0.99f) && cursorDelta.y < 0) {
 					cursorDelta.y = 0;
-					camera.setOrientation(glm::vec3(camera.orientation().x, -0.99f, camera.orientation().z));
+					body.setOrientation(glm::vec3(body.orientation().x, -0.99f, body.orientation().z));
 				}
-				else if ((camera.orientation().y >= 0.99f) && cursorDelta.y > 0) {
+				else if ((body.orientation().y >= 0.99f) && cursorDelta.y > 0) {
 					cursorDelta.y = 0;
-					camera.setOrientation(glm::vec3(camera.orientation().x, 0.99f, camera.orientation().z));
+					body.setOrientation(glm::vec3(body.orientation().x, 0.99f, body.orientation().z));
 				}
 
-				
-				if (eWindow->isKeyPressed(GLFW_KEY_SPACE)) {
-					camera.moveUp();
+				glm::vec3 start = body.position();
+
+				if (input.keys & rKup) {
+					body.moveUp();
 				}
-				else if (eWindow->isKeyPressed(GLFW_KEY_LEFT_CONTROL)) {
-					camera.moveDown();
+				else if (input.keys & rKdown) {
+					body.moveDown();
 				}
-				if (eWindow->isKeyPressed(GLFW_KEY_W)) {
-					camera.moveForward();
+				if (input.keys & rKforward) {
+					body.moveForward();
 				}
-				else if (eWindow->isKeyPressed(GLFW_KEY_S)) {
-					camera.moveBackward();
+				else if (input.keys & rKbackward) {
+					body.moveBackward();
 				}
-				if (eWindow->isKeyPressed(GLFW_KEY_A)) {
-					camera.moveLeft();
+				if (input.keys & rKleft) {
+					body.moveLeft();
 				}
-				else if (eWindow->isKeyPressed(GLFW_KEY_D)) {
-					camera.moveRight();
+				else if (input.keys & rKright) {
+					body.moveRight();
 				}
+				if (collider)
+					body.setPosition(collider->move(start, body.position()));
 
 				//	Rotate World around the vertical axis
-				camera.setOrientation(glm::rotate(camera.orientation(), glm::radians(GLfloat(cursorDelta.x)), camera.upDirection()));
+				body.setOrientation(glm::rotate(body.orientation(), glm::radians(GLfloat(cursorDelta.x)), body.upDirection()));
 				//	Rotate World around the horizontal axis
-				camera.setOrientation(glm::normalize(camera.orientation() + glm::vec3(0.0f, glm::radians(cursorDelta.y), 0.0f)));
+				body.setOrientation(glm::normalize(body.orientation() + glm::vec3(0.0f, glm::radians(cursorDelta.y), 0.0f)));
+			}
+
+			void run(Camera body) {
+				glm::vec2 cursor = m_Input.front().cursor;
+				CameraSnapshot snapshot;
+				snapshot.position = snapshot.previousPosition = body.position();
+				snapshot.orientation = snapshot.previousOrientation = body.orientation();
+
+				rTtime next = getTime();
+				while (m_Running) {
+					m_Input.update();
+					const InputState& input = m_Input.front();
+					std::shared_ptr<const CameraCollider> collider;
+					{
+						std::lock_guard<std::mutex> lock(m_ColliderMutex);
+						collider = m_Collider;
+					}
+
+					step(body, input, cursor, m_Tick / 1000000.0f, collider.get());
+					cursor = input.cursor;
 
-				prevCursorPos = crntCursorPos;
+					snapshot.previousPosition = snapshot.position;
+					snapshot.previousOrientation = snapshot.orientation;
+					snapshot.position = body.position();
+					snapshot.orientation = body.orientation();
+					snapshot.time = getTime();
+					m_Snapshots.write(snapshot);
+
+					next += m_Tick;
+					rTtime now = getTime();
+					// Drop the backlog after a stall rather than replaying it in a burst
+					if (now > next + 250000)
+						next = now;
+					else if (next > now)
+						std::this_thread::sleep_for(std::chrono::microseconds(next - now));
+				}
+			}
+
+		public:
+
+			~Simulation() {
+				stop();
 			}
 
+			inline bool running() const { return m_Running; }
+			inline rTtime tick() const { return m_Tick; }
+
+			void start(const Camera& body, const InputState& input, GLuint ticksPerSecond) {
+				if (m_Running)
+					return;
+
+				m_Tick = 1000000 / std::max<GLuint>(ticksPerSecond, 1);
+				m_Input.write(input);
+				m_Input.update();
+
+				m_Running = true;
+				m_Thread = std::thread(&Simulation::run, this, body);
+			}
+
+			void stop() {
+				m_Running = false;
+				if (m_Thread.joinable())
+					m_Thread.join();
+			}
 
-			lastTime = crntTime;
+			inline void submit(const InputState& input) {
+				m_Input.write(input);
+			}
+
+			/*
+			nullptr lets the camera fly through geometry again
+			*/
+			void setCollider(std::shared_ptr<const CameraCollider> collider) {
+				std::lock_guard<std::mutex> lock(m_ColliderMutex);
+				m_Collider = std::move(collider);
+			}
+
+			/*
+			Camera state interpolated between the last two ticks, lagging the simulation by at most one tick
+			*/
+			void interpolate(Camera& target) {
+				m_Snapshots.update();
+				const CameraSnapshot& snapshot = m_Snapshots.front();
+				if (snapshot.time == 0)
+					return;
+
+				GLfloat alpha = std::clamp(GLfloat(getTime() - snapshot.time) / m_Tick, 0.0f, 1.0f);
+				target.setPosition(glm::mix(snapshot.previousPosition, snapshot.position, alpha));
+				target.setOrientation(glm::normalize(glm::mix(snapshot.previousOrientation, snapshot.orientation, alpha)));
+			}
+		};
+
+		static Simulation simulation;
+
+		InputState sampleInput() {
+			InputState input;
+			auto cursor = eWindow->getCursorPosition();
+			input.cursor = glm::vec2(cursor.x, cursor.y);
+			input.speed = camera.speed().x;
+
+			if (eWindow->isKeyPressed(GLFW_KEY_SPACE))
+				input.keys |= rKup;
+			if (eWindow->isKeyPressed(GLFW_KEY_LEFT_CONTROL))
+				input.keys |= rKdown;
+			if (eWindow->isKeyPressed(GLFW_KEY_W))
+				input.keys |= rKforward;
+			if (eWindow->isKeyPressed(GLFW_KEY_S))
+				input.keys |= rKbackward;
+			if (eWindow->isKeyPressed(GLFW_KEY_A))
+				input.keys |= rKleft;
+			if (eWindow->isKeyPressed(GLFW_KEY_D))
+				input.keys |= rKright;
+			return input;
+		}
+
+		/*
+		Starts the simulation thread, camera speed is read in units per second
+		Called by the first control() if not called beforehand
+		*/
+		void start(GLuint ticksPerSecond = 120) {
+			if (simulation.running())
+				return;
+
+			eWindow->setInputMode(GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+			eWindow->setCursorPosition(viewportWidth / 2, viewportHeight / 2);
+
+			InputState input = sampleInput();
+			input.cursor = glm::vec2(viewportWidth / 2, viewportHeight / 2);
+			simulation.start(camera, input, ticksPerSecond);
+		}
+
+		void stop() {
+			simulation.stop();
+		}
+
+		/*
+		Collides the camera with the collider's scene from the next tick, nullptr turns collision off
+		Build a new collider after editing the scene, the simulation keeps using the old one until then
+		*/
+		void setCollider(std::shared_ptr<const CameraCollider> collider) {
+			simulation.setCollider(std::move(collider));
+		}
+
+		/*
+		Call once per frame from the render thread after polling events
+		Hands the sampled input to the simulation and moves the camera to the interpolated simulation state
+		*/
+		void control() {
+			if (!simulation.running()) {
+				start();
+				return;
+			}
 
+			simulation.submit(sampleInput());
+			simulation.interpolate(camera);
 		}
 
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <algorithm>
+#include "glad/glad.h"
+#include "../engine_abstractions/shader.h"
+#include "../engine_abstractions/buffer_objects.h"
+#include "../engine_abstractions/stream_buffer.h"
+
+namespace rtre {
+
+	struct LineVertex {
+		vec3 position;
+		vec3 color;
+	};
+
+	/*
+	Immediate mode line drawing for debug overlays, lines are collected during the frame and drawn by flush
+	Vertices go through a StreamBuffer ring, a frame's lines are one memcpy and one draw call
+	*/
+	class DebugLines {
+
+		std::shared_ptr<RenderShader> m_Shader;
+		std::vector<LineVertex> m_Vertices;
+		StreamBuffer m_Stream;
+		Vao m_Vao;
+		size_t m_Drawn = 0;
+
+	public:
+
+		/*
+		capacity is the ring size in bytes, room for a few frames of lines
+		*/
+		DebugLines(std::shared_ptr<RenderShader> shader, GLsizeiptr capacity = 4 << 20)
+			:
+			m_Shader(shader),
+			m_Stream(GL_ARRAY_BUFFER, capacity)
+		{
+			m_Vao.attachVertices(m_Stream.id(), sizeof(LineVertex));
+			m_Vao.attribute(0, 3, GL_FLOAT, offsetof(LineVertex, position));
+			m_Vao.attribute(1, 3, GL_FLOAT, offsetof(LineVertex, color));
+			m_Vao.unbind();
+		}
+
+		inline void line(const vec3& a, const vec3& b, const vec3& color) {
+			m_Vertices.push_back({ a, color });
+			m_Vertices.push_back({ b, color });
+		}
+
+		void box(const vec3& low, const vec3& high, const vec3& color) {
+			for (GLuint i = 0; i < 4; i++) {
+				vec3 a(i & 1 ? high.x : low.x, i & 2 ? high.y : low.y, low.z);
+				line(a, vec3(a.x, a.y, high.z), color);
+			}
+			for (GLfloat z : { low.z, high.z }) {
+				line(vec3(low.x, low.y, z), vec3(high.x, low.y, z), color);
+				line(vec3(high.x, low.y, z), vec3(high.x, high.y, z), color);
+				line(vec3(high.x, high.y, z), vec3(low.x, high.y, z), color);
+				line(vec3(low.x, high.y, z), vec3(low.x, low.y, z), color);
+			}
+		}
+
+		void cross(const vec3& centre, GLfloat size, const vec3& color) {
+			line(centre - vec3(size, 0, 0), centre + vec3(size, 0, 0), color);
+			line(centre - vec3(0, size, 0), centre + vec3(0, size, 0), color);
+			line(centre - vec3(0, 0, size), centre + vec3(0, 0, size), color);
+		}
+
+		/*
+		Draws and clears the collected lines, lines past the ring's capacity are dropped
+		*/
+		void flush(const mat4& viewProjection) {
+			m_Drawn = std::min(m_Vertices.size(), size_t(m_Stream.size() / sizeof(LineVertex)) & ~size_t(1));
+			if (m_Drawn) {
+				auto allocation = m_Stream.write(Span<const LineVertex>(m_Vertices.data(), m_Drawn));
+
+				m_Shader->activate();
+				m_Shader->SetUniform("viewProjection", viewProjection);
+				m_Vao.bind();
+				glDrawArrays(GL_LINES, GLint(allocation.offset / sizeof(LineVertex)), GLsizei(m_Drawn));
+				m_Vao.unbind();
+				m_Stream.fence();
+			}
+			m_Vertices.clear();
+		}
+
+		inline size_t drawnVertices() const { return m_Drawn; }
+		inline const StreamBuffer& stream() const { return m_Stream; }
+	};
+}
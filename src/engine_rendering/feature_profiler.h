@@ -0,0 +1,100 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "glad/glad.h"
+#include "gpu_timer.h"
+
+namespace rtre {
+
+	/*
+	Estimates the GPU cost of individual shader features so they can be budgeted per scene
+	Every interval frames the scene is drawn at a reduced resolution once with the frame's features
+	and once per enabled tracked feature with that feature compiled out,
+	the difference in GPU time scaled back to the full resolution is the feature's cost
+	Probe draws go to the current framebuffer before the real frame, which overwrites them
+	*/
+	class FeatureProfiler {
+	public:
+
+		struct Feature {
+			GLuint mask;
+			std::string name;
+			double budgetMs;
+			bool enabled = false;
+			std::unique_ptr<GpuTimer> timer = std::make_unique<GpuTimer>();
+		};
+
+	private:
+
+		GpuTimer m_Frame;
+		GpuTimer m_Reference;
+		std::vector<Feature> m_Features;
+
+		GLuint m_Interval = 30;
+		GLuint m_Divisor = 4;
+		double m_Scale = 16;
+		uint64_t m_Count = 0;
+
+		template<class Draw>
+		void probe(GLuint features, GLint width, GLint height, Draw& draw) {
+			GLint probeWidth = std::max<GLint>(width / m_Divisor, 1);
+			GLint probeHeight = std::max<GLint>(height / m_Divisor, 1);
+			m_Scale = double(width) * height / (double(probeWidth) * probeHeight);
+
+			glViewport(0, 0, probeWidth, probeHeight);
+			m_Reference.time([&]() { draw(features, probeWidth, probeHeight); });
+			for (auto& feature : m_Features) {
+				feature.enabled = (features & feature.mask) != 0;
+				if (feature.enabled)
+					feature.timer->time([&]() { draw(features & ~feature.mask, probeWidth, probeHeight); });
+			}
+			glViewport(0, 0, width, height);
+		}
+
+	public:
+
+		/*
+		budgetMs of 0 means unbudgeted
+		*/
+		void track(GLuint feature, const std::string& name, double budgetMs = 0) {
+			m_Features.push_back({ feature, name, budgetMs });
+		}
+
+		void setBudget(GLuint feature, double budgetMs) {
+			for (auto& tracked : m_Features)
+				if (tracked.mask == feature)
+					tracked.budgetMs = budgetMs;
+		}
+
+		inline void setInterval(GLuint frames) { m_Interval = std::max<GLuint>(frames, 1); }
+		inline void setDivisor(GLuint divisor) { m_Divisor = std::max<GLuint>(divisor, 1); }
+
+		/*
+		draw(features, width, height) must render the scene with the shader variant for features,
+		the viewport is already set to width x height
+		*/
+		template<class Draw>
+		void render(GLuint features, GLint width, GLint height, Draw draw) {
+			if (m_Count++ % m_Interval == 0)
+				probe(features, width, height, draw);
+
+			m_Frame.time([&]() { draw(features, width, height); });
+		}
+
+		inline double frameMs() const { return m_Frame.milliseconds(); }
+
+		double costMs(const Feature& feature) const {
+			if (!feature.enabled)
+				return 0;
+			return std::max(0.0, m_Reference.milliseconds() - feature.timer->milliseconds()) * m_Scale;
+		}
+
+		inline bool overBudget(const Feature& feature) const {
+			return feature.budgetMs > 0 && costMs(feature) > feature.budgetMs;
+		}
+
+		inline const std::vector<Feature>& features() const { return m_Features; }
+	};
+}
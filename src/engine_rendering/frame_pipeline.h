@@ -0,0 +1,166 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <algorithm>
+#include "glad/glad.h"
+
+namespace rtre {
+
+	enum FramePacing {
+		rPlatency,
+		rPthroughput
+	};
+
+	struct FrameStats {
+		double frameMs = 0;
+		double waitMs = 0;
+		double latencyMs = 0;
+		double framesPerSecond = 0;
+	};
+
+	/*
+	Bounds how many frames the CPU may queue ahead of the GPU with fences
+	With rPthroughput the CPU builds frame N+1 while the GPU still executes frame N,
+	rPlatency waits for the previous frame to finish before sampling input, trading throughput for latency
+
+	Latency is measured from beginFrame, where input should be sampled,
+	to the GPU timestamp written after the frame's swap completed
+	*/
+	class FramePipeline {
+
+		static constexpr GLuint s_MaxFramesInFlight = 4;
+		static constexpr GLuint s_CalibrationInterval = 240;
+
+		typedef std::chrono::steady_clock Clock;
+
+		struct Slot {
+			GLsync fence = nullptr;
+			GLuint query = 0;
+			Clock::time_point inputTime;
+		};
+
+		std::array<Slot, s_MaxFramesInFlight> m_Slots;
+		GLuint m_FramesInFlight = 2;
+		GLuint m_ThroughputFrames = 2;
+		FramePacing m_Pacing = rPthroughput;
+		uint64_t m_Frame = 0;
+
+		int64_t m_GpuToCpuNs = 0;
+		Clock::time_point m_LastBegin;
+		FrameStats m_Stats;
+
+		static int64_t nanoseconds(Clock::time_point time) {
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+		}
+
+		static double smooth(double average, double sample) {
+			return average == 0 ? sample : average + (sample - average) * 0.05;
+		}
+
+		inline Slot& current() { return m_Slots[m_Frame % m_FramesInFlight]; }
+
+		void calibrate() {
+			GLint64 gpuNow = 0;
+			glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+			m_GpuToCpuNs = nanoseconds(Clock::now()) - gpuNow;
+		}
+
+		/*
+		Waits for the frame that last used slot, returns false if the slot was free
+		*/
+		bool retire(Slot& slot) {
+			if (!slot.fence)
+				return false;
+
+			while (glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED);
+			glDeleteSync(slot.fence);
+			slot.fence = nullptr;
+			return true;
+		}
+
+		void drain() {
+			for (auto& slot : m_Slots)
+				retire(slot);
+		}
+
+	public:
+
+		FramePipeline(GLuint framesInFlight = 2) {
+			for (auto& slot : m_Slots)
+				glGenQueries(1, &slot.query);
+			setFramesInFlight(framesInFlight);
+			calibrate();
+			m_LastBegin = Clock::now();
+		}
+
+		FramePipeline(const FramePipeline&) = delete;
+		FramePipeline& operator=(const FramePipeline&) = delete;
+
+		~FramePipeline() {
+			for (auto& slot : m_Slots) {
+				if (slot.fence)
+					glDeleteSync(slot.fence);
+				glDeleteQueries(1, &slot.query);
+			}
+		}
+
+		/*
+		Frames the CPU may run ahead by when pacing for throughput, clamped to [1, 4]
+		*/
+		void setFramesInFlight(GLuint frames) {
+			m_ThroughputFrames = std::clamp<GLuint>(frames, 1, s_MaxFramesInFlight);
+			setPacing(m_Pacing);
+		}
+
+		void setPacing(FramePacing pacing) {
+			GLuint frames = pacing == rPlatency ? 1 : m_ThroughputFrames;
+			if (frames != m_FramesInFlight) {
+				drain();
+				m_FramesInFlight = frames;
+				m_Frame = 0;
+			}
+			m_Pacing = pacing;
+		}
+
+		inline FramePacing pacing() const { return m_Pacing; }
+		inline GLuint framesInFlight() const { return m_FramesInFlight; }
+		inline const FrameStats& stats() const { return m_Stats; }
+
+		/*
+		Blocks until the GPU finished the frame that used this frame's slot
+		Sample input and build the frame after this call
+		*/
+		void beginFrame() {
+			Slot& slot = current();
+
+			Clock::time_point waitStart = Clock::now();
+			if (retire(slot)) {
+				GLuint64 gpuDone = 0;
+				glGetQueryObjectui64v(slot.query, GL_QUERY_RESULT, &gpuDone);
+				double latency = (int64_t(gpuDone) + m_GpuToCpuNs - nanoseconds(slot.inputTime)) / 1e6;
+				m_Stats.latencyMs = smooth(m_Stats.latencyMs, latency);
+			}
+			Clock::time_point now = Clock::now();
+
+			m_Stats.waitMs = smooth(m_Stats.waitMs, std::chrono::duration<double, std::milli>(now - waitStart).count());
+			m_Stats.frameMs = smooth(m_Stats.frameMs, std::chrono::duration<double, std::milli>(now - m_LastBegin).count());
+			m_Stats.framesPerSecond = m_Stats.frameMs > 0 ? 1000.0 / m_Stats.frameMs : 0;
+			m_LastBegin = now;
+
+			if (m_Frame % s_CalibrationInterval == 0)
+				calibrate();
+
+			slot.inputTime = now;
+		}
+
+		/*
+		Call right after swapping buffers, fences everything submitted for the frame
+		*/
+		void endFrame() {
+			Slot& slot = current();
+			glQueryCounter(slot.query, GL_TIMESTAMP);
+			slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			m_Frame++;
+		}
+	};
+}
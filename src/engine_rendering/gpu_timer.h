@@ -0,0 +1,81 @@
+#pragma once
+#include <array>
+#include "glad/glad.h"
+
+namespace rtre {
+
+	/*
+	Measures GPU time spent between begin and end with GL_TIME_ELAPSED queries
+	Queries are cycled through a small ring and only read once available, so reading never stalls the pipeline
+	The result lags a few frames behind and is smoothed over time
+	GL_TIME_ELAPSED queries can't nest, only one GpuTimer may be running at a time
+	*/
+	class GpuTimer {
+
+		static constexpr GLuint s_Latency = 4;
+
+		std::array<GLuint, s_Latency> m_Queries;
+		std::array<bool, s_Latency> m_Issued = {};
+		GLuint m_Next = 0;
+		double m_Milliseconds = 0;
+
+		void collect() {
+			for (GLuint i = 0; i < s_Latency; i++) {
+				if (!m_Issued[i])
+					continue;
+
+				GLint available = GL_FALSE;
+				glGetQueryObjectiv(m_Queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+				if (!available)
+					continue;
+
+				GLuint64 elapsed = 0;
+				glGetQueryObjectui64v(m_Queries[i], GL_QUERY_RESULT, &elapsed);
+				double sample = elapsed / 1e6;
+				m_Milliseconds = m_Milliseconds == 0 ? sample : m_Milliseconds + (sample - m_Milliseconds) * 0.1;
+				m_Issued[i] = false;
+			}
+		}
+
+	public:
+
+		GpuTimer() {
+			glGenQueries(s_Latency, m_Queries.data());
+		}
+
+		GpuTimer(const GpuTimer&) = delete;
+		GpuTimer& operator=(const GpuTimer&) = delete;
+
+		~GpuTimer() {
+			glDeleteQueries(s_Latency, m_Queries.data());
+		}
+
+		/*
+		Skips the measurement if every query of the ring is still in flight
+		*/
+		bool begin() {
+			collect();
+			if (m_Issued[m_Next])
+				return false;
+
+			glBeginQuery(GL_TIME_ELAPSED, m_Queries[m_Next]);
+			return true;
+		}
+
+		void end() {
+			glEndQuery(GL_TIME_ELAPSED);
+			m_Issued[m_Next] = true;
+			m_Next = (m_Next + 1) % s_Latency;
+		}
+
+		template<class Work>
+		void time(Work work) {
+			bool timing = begin();
+			work();
+			if (timing)
+				end();
+		}
+
+		inline double milliseconds() const { return m_Milliseconds; }
+	};
+}
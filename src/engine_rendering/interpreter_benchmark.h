@@ -0,0 +1,97 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "glad/glad.h"
+#include "../engine_abstractions/shader_permutations.h"
+#include "../engine_scene/sdf_scene.h"
+#include "../engine_scene/sdf_bytecode.h"
+
+namespace rtre {
+
+	/*
+	overhead is interpretedMs / generatedMs, 1 means the interpreter is free
+	interpreted is false when the program is too deep for the interpreter's stacks, only generatedMs is measured then
+	*/
+	struct InterpreterCost {
+		std::string scene;
+		size_t nodes = 0;
+		size_t instructions = 0;
+		GLuint stackDepth = 0;
+		double generatedMs = 0;
+		double interpretedMs = 0;
+		double overhead = 0;
+		bool interpreted = false;
+	};
+
+	/*
+	Times the raymarcher with code generated from the scene against the bytecode interpreter on the same scene and view
+	The generated variant has to be built from the current scene, results are kept per scene so several can be compared,
+	a scene measured again replaces its row
+	Every measurement blocks on its queries, run it on demand rather than every frame
+	*/
+	class InterpreterBenchmark {
+
+		GLuint m_TimeQuery = 0;
+		std::vector<InterpreterCost> m_Results;
+
+		template<class Draw>
+		double measure(GLuint frames, Draw draw) {
+			// The first draw may build the variant, keep it out of the timings
+			draw();
+			GLuint64 total = 0;
+			for (GLuint i = 0; i < frames; i++) {
+				glBeginQuery(GL_TIME_ELAPSED, m_TimeQuery);
+				draw();
+				glEndQuery(GL_TIME_ELAPSED);
+
+				GLuint64 result = 0;
+				glGetQueryObjectui64v(m_TimeQuery, GL_QUERY_RESULT, &result);
+				total += result;
+			}
+			return total / 1e6 / frames;
+		}
+
+	public:
+
+		InterpreterBenchmark() {
+			glGenQueries(1, &m_TimeQuery);
+		}
+
+		InterpreterBenchmark(const InterpreterBenchmark&) = delete;
+		InterpreterBenchmark& operator=(const InterpreterBenchmark&) = delete;
+
+		~InterpreterBenchmark() {
+			glDeleteQueries(1, &m_TimeQuery);
+		}
+
+		/*
+		draw(features) renders the raymarcher with the given feature mask into the current framebuffer
+		program is the scene's bytecode, as uploaded by SceneCompiler, the interpreter is skipped when it doesn't fit
+		*/
+		template<class Draw>
+		void run(const std::string& label, const SdfScene& scene, const SdfProgram& program, GLuint features, Draw draw, GLuint frames = 16) {
+			features &= ~(rFsceneInterpreter | rFhalfResNormals);
+
+			InterpreterCost cost;
+			cost.scene = label;
+			cost.nodes = scene.nodes().size();
+			cost.instructions = program.code.size();
+			cost.stackDepth = program.stackDepth;
+			cost.generatedMs = measure(frames, [&]() { draw(features); });
+			cost.interpreted = program.fits();
+			if (cost.interpreted) {
+				cost.interpretedMs = measure(frames, [&]() { draw(features | rFsceneInterpreter); });
+				cost.overhead = cost.generatedMs > 0 ? cost.interpretedMs / cost.generatedMs : 0;
+			}
+
+			auto existing = std::find_if(m_Results.begin(), m_Results.end(), [&](const InterpreterCost& row) { return row.scene == label; });
+			if (existing != m_Results.end())
+				*existing = cost;
+			else
+				m_Results.push_back(cost);
+		}
+
+		inline const std::vector<InterpreterCost>& results() const { return m_Results; }
+	};
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <chrono>
+#include <vector>
+#include <random>
+#include "glad/glad.h"
+#include "../engine_abstractions/dtypes.h"
+#include "../engine_abstractions/shader_permutations.h"
+#include "light_buffer.h"
+#include "light_clusters.h"
+
+namespace rtre {
+
+	/*
+	Deterministic lights spread over the box between low and high, the same seed always yields the same prefix
+	*/
+	std::vector<PointLight> scatterLights(size_t count, vec3 low, vec3 high, unsigned seed = 1) {
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<GLfloat> unit(0.f, 1.f);
+
+		std::vector<PointLight> lights;
+		lights.reserve(count);
+		for (size_t i = 0; i < count; i++) {
+			vec3 position = low + (high - low) * vec3(unit(random), unit(random), unit(random));
+			vec3 color = vec3(unit(random), unit(random), unit(random)) * 0.6f + 0.2f;
+			lights.push_back(PointLight(position, color, color * 0.5f, 1.f, 1.4f, 7.f));
+		}
+		return lights;
+	}
+
+	struct LightCost {
+		size_t lights = 0;
+		double cullMs = 0;
+		double clusteredMs = 0;
+		double bruteForceMs = 0;
+		double averageLightsPerCluster = 0;
+		GLuint maxLightsPerCluster = 0;
+	};
+
+	/*
+	Times shading with scattered lights, through the clusters and through the whole light list
+	Uses its own light buffer and clusters on the same binding points, the caller rebinds its own afterwards
+	Every measurement blocks on its query, run it on demand rather than every frame
+	*/
+	class LightBenchmark {
+
+		GLuint m_Query = 0;
+		LightBuffer m_Lights;
+		LightClusters m_Clusters;
+		std::vector<LightCost> m_Results;
+
+		template<class Draw>
+		double measure(GLuint frames, Draw draw) {
+			GLuint64 total = 0;
+			for (GLuint i = 0; i < frames; i++) {
+				glBeginQuery(GL_TIME_ELAPSED, m_Query);
+				draw();
+				glEndQuery(GL_TIME_ELAPSED);
+
+				GLuint64 elapsed = 0;
+				glGetQueryObjectui64v(m_Query, GL_QUERY_RESULT, &elapsed);
+				total += elapsed;
+			}
+			return total / 1e6 / frames;
+		}
+
+	public:
+
+		LightBenchmark() {
+			glGenQueries(1, &m_Query);
+		}
+
+		LightBenchmark(const LightBenchmark&) = delete;
+		LightBenchmark& operator=(const LightBenchmark&) = delete;
+
+		~LightBenchmark() {
+			glDeleteQueries(1, &m_Query);
+		}
+
+		/*
+		draw(features, lights, clusters) renders the raymarcher with the given feature mask, lights and clusters
+		*/
+		template<class Draw>
+		void run(const std::vector<size_t>& counts, GLuint features, const mat4& view, GLfloat aspect, vec3 low, vec3 high, Draw draw, GLuint frames = 16) {
+			m_Results.clear();
+			for (size_t count : counts) {
+				m_Lights.clear();
+				for (const auto& light : scatterLights(count, low, high))
+					m_Lights.add(light);
+				m_Lights.upload();
+
+				LightCost cost;
+				cost.lights = count;
+
+				const GLuint repeats = 8;
+				for (GLuint i = 0; i < repeats; i++) {
+					m_Clusters.cull(m_Lights, view, aspect);
+					cost.cullMs += m_Clusters.cullMs() / repeats;
+				}
+				m_Clusters.upload();
+				cost.averageLightsPerCluster = m_Clusters.averageLightsPerCluster();
+				cost.maxLightsPerCluster = m_Clusters.maxLightsPerCluster();
+
+				cost.clusteredMs = measure(frames, [&]() { draw(features | rFclusteredLights, m_Lights, m_Clusters); });
+				cost.bruteForceMs = measure(frames, [&]() { draw(features & ~rFclusteredLights, m_Lights, m_Clusters); });
+				m_Results.push_back(cost);
+			}
+		}
+
+		inline const std::vector<LightCost>& results() const { return m_Results; }
+	};
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include "glad/glad.h"
+#include "../engine_abstractions/dtypes.h"
+#include "../engine_abstractions/buffer_objects.h"
+
+namespace rtre {
+
+	/*
+	std430 layout of a light in the shader's light buffer, matches PointLight in sdf/lights.glsl
+		position	xyz position, w range
+		diffuse		rgb
+		specular	rgb
+		attenuation	constant, linear, quadratic
+	*/
+	struct GpuPointLight {
+		vec4 position;
+		vec4 diffuse;
+		vec4 specular;
+		vec4 attenuation;
+	};
+
+	/*
+	Point lights mirrored into a shader storage buffer
+	Edits only mark the touched range dirty, upload sends that range once per frame
+	*/
+	class LightBuffer {
+
+		std::vector<PointLight> m_Lights;
+		std::vector<GpuPointLight> m_Packed;
+		Ssbo m_Buffer;
+		GLuint m_Binding;
+
+		size_t m_DirtyBegin = 0;
+		size_t m_DirtyEnd = 0;
+		GLsizeiptr m_UploadedBytes = 0;
+
+		inline void markDirty(size_t begin, size_t end) {
+			if (m_DirtyBegin == m_DirtyEnd) {
+				m_DirtyBegin = begin;
+				m_DirtyEnd = end;
+				return;
+			}
+			m_DirtyBegin = std::min(m_DirtyBegin, begin);
+			m_DirtyEnd = std::max(m_DirtyEnd, end);
+		}
+
+	public:
+
+		LightBuffer(GLuint binding = 0)
+			:
+			m_Binding(binding)
+		{
+		}
+
+		static GpuPointLight pack(const PointLight& light) {
+			GpuPointLight packed;
+			packed.position = vec4(light.position, light.range());
+			packed.diffuse = vec4(light.diffuse, 0);
+			packed.specular = vec4(light.specular, 0);
+			packed.attenuation = vec4(light.constant, light.linear, light.quadratic, 0);
+			return packed;
+		}
+
+		size_t add(const PointLight& light) {
+			m_Lights.push_back(light);
+			m_Packed.push_back(pack(light));
+			markDirty(m_Lights.size() - 1, m_Lights.size());
+			return m_Lights.size() - 1;
+		}
+
+		void set(size_t index, const PointLight& light) {
+			m_Lights[index] = light;
+			m_Packed[index] = pack(light);
+			markDirty(index, index + 1);
+		}
+
+		/*
+		Moves the last light into index, indices of other lights stay valid
+		*/
+		void remove(size_t index) {
+			m_Lights[index] = m_Lights.back();
+			m_Packed[index] = m_Packed.back();
+			m_Lights.pop_back();
+			m_Packed.pop_back();
+			if (index < m_Lights.size())
+				markDirty(index, index + 1);
+		}
+
+		void clear() {
+			m_Lights.clear();
+			m_Packed.clear();
+			m_DirtyBegin = m_DirtyEnd = 0;
+		}
+
+		/*
+		Sends the dirty range to the GPU, returns the number of bytes uploaded
+		*/
+		GLsizeiptr upload() {
+			m_DirtyEnd = std::min(m_DirtyEnd, m_Packed.size());
+			if (m_DirtyBegin >= m_DirtyEnd) {
+				m_DirtyBegin = m_DirtyEnd = 0;
+				return m_UploadedBytes = 0;
+			}
+
+			m_UploadedBytes = (m_DirtyEnd - m_DirtyBegin) * sizeof(GpuPointLight);
+			m_Buffer.write(m_DirtyBegin * sizeof(GpuPointLight), m_Packed.data() + m_DirtyBegin, m_UploadedBytes);
+			m_DirtyBegin = m_DirtyEnd = 0;
+			return m_UploadedBytes;
+		}
+
+		/*
+		The buffer always has storage once bound, even without lights
+		*/
+		inline void bind() {
+			m_Buffer.reserve(sizeof(GpuPointLight));
+			m_Buffer.bindBase(m_Binding);
+		}
+
+		inline GLint count() const { return GLint(m_Lights.size()); }
+		inline const PointLight& light(size_t index) const { return m_Lights[index]; }
+		inline const std::vector<PointLight>& lights() const { return m_Lights; }
+		inline const std::vector<GpuPointLight>& packed() const { return m_Packed; }
+		inline GLsizeiptr uploadedBytes() const { return m_UploadedBytes; }
+	};
+}
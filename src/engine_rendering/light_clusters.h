@@ -0,0 +1,184 @@
+#pragma once
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include "glad/glad.h"
+#include "../engine_abstractions/shader.h"
+#include "../engine_abstractions/buffer_objects.h"
+#include "light_buffer.h"
+
+namespace rtre {
+
+	struct LightCluster {
+		GLuint offset;
+		GLuint count;
+	};
+
+	/*
+	Assigns lights to a froxel grid so each pixel only shades the lights that can reach it
+	The view is split into x by y screen tiles and z depth slices spaced exponentially between near and far,
+	depths past far fall into the last slice
+	Culling runs on the CPU against tile planes and slice bounds, which is conservative at the tile corners
+	Screen coordinates are the raymarcher's, view rays are (x * aspect, y, -1) with x and y in [-0.5, 0.5]
+	*/
+	class LightClusters {
+
+		struct Bounds {
+			GLuint x0, x1;
+			GLuint y0, y1;
+			GLuint z0, z1;
+		};
+
+		GLuint m_X = 16;
+		GLuint m_Y = 9;
+		GLuint m_Z = 24;
+		GLfloat m_Near = 0.1f;
+		GLfloat m_Far = 200.f;
+
+		std::vector<LightCluster> m_Clusters;
+		std::vector<GLuint> m_Indices;
+		std::vector<Bounds> m_Bounds;
+		std::vector<GLuint> m_Touching;
+
+		Ssbo m_ClusterBuffer;
+		Ssbo m_IndexBuffer;
+		GLuint m_ClusterBinding;
+		GLuint m_IndexBinding;
+
+		double m_CullMs = 0;
+		GLuint m_MaxLights = 0;
+
+		inline GLfloat sliceScale() const { return m_Z / std::log(m_Far / m_Near); }
+
+		inline GLuint slice(GLfloat depth) const {
+			if (depth <= m_Near)
+				return 0;
+			return std::min<GLuint>(GLuint(std::log(depth / m_Near) * sliceScale()), m_Z - 1);
+		}
+
+		/*
+		First and last tile along one screen axis the sphere may touch, false if it misses the view
+		Tile boundary i is the plane through the eye and screen coordinate -0.5 + i / tiles
+		*/
+		static bool tileRange(GLfloat center, GLfloat depthAxis, GLfloat radius, GLfloat scale, GLuint tiles, GLuint& first, GLuint& last) {
+			first = tiles;
+			last = 0;
+			for (GLuint i = 0; i < tiles; i++) {
+				GLfloat low = (-0.5f + GLfloat(i) / tiles) * scale;
+				GLfloat high = (-0.5f + GLfloat(i + 1) / tiles) * scale;
+				// Signed distances to the boundary planes, positive towards increasing screen coordinate
+				GLfloat aboveLow = (center + depthAxis * low) / std::sqrt(1 + low * low);
+				GLfloat belowHigh = -(center + depthAxis * high) / std::sqrt(1 + high * high);
+				if (aboveLow >= -radius && belowHigh >= -radius) {
+					first = std::min(first, i);
+					last = i;
+				}
+			}
+			return first <= last;
+		}
+
+	public:
+
+		LightClusters(GLuint clusterBinding = 1, GLuint indexBinding = 2)
+			:
+			m_ClusterBinding(clusterBinding),
+			m_IndexBinding(indexBinding)
+		{
+		}
+
+		void setGrid(GLuint x, GLuint y, GLuint z) {
+			m_X = std::max<GLuint>(x, 1);
+			m_Y = std::max<GLuint>(y, 1);
+			m_Z = std::max<GLuint>(z, 1);
+		}
+
+		void setDepthRange(GLfloat zNear, GLfloat zFar) {
+			m_Near = std::max(zNear, 0.001f);
+			m_Far = std::max(zFar, m_Near * 2);
+		}
+
+		/*
+		Rebuilds the cluster lists for lights seen through view, call whenever the camera or the lights moved
+		*/
+		void cull(const LightBuffer& lights, const mat4& view, GLfloat aspect) {
+			auto start = std::chrono::steady_clock::now();
+
+			const auto& packed = lights.packed();
+			m_Clusters.assign(size_t(m_X) * m_Y * m_Z, { 0, 0 });
+			m_Bounds.clear();
+			m_Touching.clear();
+			m_MaxLights = 0;
+
+			// Count pass, the ranges each light touches are kept for the fill pass
+			for (GLuint i = 0; i < packed.size(); i++) {
+				GLfloat radius = packed[i].position.w;
+				vec4 center = view * vec4(vec3(packed[i].position), 1);
+				GLfloat depth = -center.z;
+				if (depth + radius < 0)
+					continue;
+
+				Bounds bounds;
+				if (!tileRange(center.x, center.z, radius, aspect, m_X, bounds.x0, bounds.x1) ||
+					!tileRange(center.y, center.z, radius, 1, m_Y, bounds.y0, bounds.y1))
+					continue;
+				bounds.z0 = slice(depth - radius);
+				bounds.z1 = slice(depth + radius);
+
+				for (GLuint z = bounds.z0; z <= bounds.z1; z++)
+					for (GLuint y = bounds.y0; y <= bounds.y1; y++)
+						for (GLuint x = bounds.x0; x <= bounds.x1; x++)
+							m_Clusters[x + m_X * (y + m_Y * z)].count++;
+
+				m_Bounds.push_back(bounds);
+				m_Touching.push_back(i);
+			}
+
+			GLuint offset = 0;
+			for (auto& cluster : m_Clusters) {
+				cluster.offset = offset;
+				offset += cluster.count;
+				m_MaxLights = std::max(m_MaxLights, cluster.count);
+				cluster.count = 0;
+			}
+
+			m_Indices.resize(offset);
+			for (size_t i = 0; i < m_Bounds.size(); i++) {
+				const Bounds& bounds = m_Bounds[i];
+				for (GLuint z = bounds.z0; z <= bounds.z1; z++)
+					for (GLuint y = bounds.y0; y <= bounds.y1; y++)
+						for (GLuint x = bounds.x0; x <= bounds.x1; x++) {
+							LightCluster& cluster = m_Clusters[x + m_X * (y + m_Y * z)];
+							m_Indices[cluster.offset + cluster.count++] = m_Touching[i];
+						}
+			}
+
+			m_CullMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		void upload() {
+			m_ClusterBuffer.write(m_Clusters);
+			m_IndexBuffer.write(m_Indices);
+		}
+
+		inline void bind() {
+			m_ClusterBuffer.reserve(sizeof(LightCluster));
+			m_IndexBuffer.reserve(sizeof(GLuint));
+			m_ClusterBuffer.bindBase(m_ClusterBinding);
+			m_IndexBuffer.bindBase(m_IndexBinding);
+		}
+
+		/*
+		Sets clusterGrid and clusterDepth on the active program
+		*/
+		void setUniforms(RenderShader& shader) const {
+			shader.SetUniform("clusterGrid", vec3(m_X, m_Y, m_Z));
+			shader.SetUniform("clusterDepth", vec2(m_Near, sliceScale()));
+		}
+
+		inline double cullMs() const { return m_CullMs; }
+		inline GLuint maxLightsPerCluster() const { return m_MaxLights; }
+		inline size_t indexCount() const { return m_Indices.size(); }
+		inline double averageLightsPerCluster() const { return m_Clusters.empty() ? 0 : double(m_Indices.size()) / m_Clusters.size(); }
+	};
+}
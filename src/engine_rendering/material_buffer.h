@@ -0,0 +1,87 @@
+#pragma once
+#include <vector>
+#include "glad/glad.h"
+#include "../engine_abstractions/dtypes.h"
+#include "../engine_abstractions/shader.h"
+#include "../engine_abstractions/buffer_objects.h"
+#include "../engine_scene/sdf_scene.h"
+#include "texture_atlas.h"
+
+namespace rtre {
+
+	/*
+	std430 layout of a material in the shader's material buffer, matches Material in sdf/materials.glsl
+		albedo		rgb, w atlas layer or -1 when untextured
+		rect		uv offset and size inside the layer
+		params		x texture repeats per unit
+		handle		xy bindless handle split in two words
+	*/
+	struct GpuMaterial {
+		vec4 albedo;
+		vec4 rect;
+		vec4 params;
+		GLuint handle[4];
+	};
+
+	/*
+	A scene's materials resolved against the atlas and mirrored into a shader storage buffer
+	Uploaded whole, materials are few and change only when the scene or the atlas is rebuilt
+	*/
+	class MaterialBuffer {
+
+		std::vector<GpuMaterial> m_Packed;
+		Ssbo m_Buffer;
+		GLuint m_Binding;
+		GLuint m_Unit;
+
+	public:
+
+		/*
+		binding matches the shader's MaterialBuffer, unit is the texture unit the atlas is bound to
+		*/
+		MaterialBuffer(GLuint binding = 3, GLuint unit = 4)
+			:
+			m_Binding(binding),
+			m_Unit(unit)
+		{
+		}
+
+		static GpuMaterial pack(const SdfMaterial& material, const TextureAtlas& atlas) {
+			GpuMaterial packed = {};
+			packed.albedo = vec4(material.albedo, -1);
+			packed.rect = vec4(0, 0, 1, 1);
+			packed.params = vec4(material.scale, 0, 0, 0);
+			if (material.texture >= 0 && size_t(material.texture) < atlas.entryCount()) {
+				const AtlasRegion& region = atlas.region(material.texture);
+				packed.albedo.w = GLfloat(region.layer);
+				packed.rect = region.rect;
+				packed.handle[0] = GLuint(region.handle);
+				packed.handle[1] = GLuint(region.handle >> 32);
+			}
+			return packed;
+		}
+
+		void upload(const SdfScene& scene, const TextureAtlas& atlas) {
+			m_Packed.clear();
+			for (const auto& material : scene.materials())
+				m_Packed.push_back(pack(material, atlas));
+			if (!m_Packed.empty())
+				m_Buffer.write(m_Packed);
+		}
+
+		/*
+		The buffer always has storage once bound, even without materials
+		*/
+		void bind(RenderShader& shader, TextureAtlas& atlas) {
+			m_Buffer.reserve(sizeof(GpuMaterial));
+			m_Buffer.bindBase(m_Binding);
+			atlas.bind(m_Unit);
+			shader.SetUniform("materialCount", count());
+			if (!atlas.bindless())
+				shader.SetUniform("materialTextures", GLint(m_Unit));
+		}
+
+		inline GLint count() const { return GLint(m_Packed.size()); }
+		inline const std::vector<GpuMaterial>& packed() const { return m_Packed; }
+	};
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "glad/glad.h"
+#include "../engine_abstractions/shader_permutations.h"
+
+namespace rtre {
+
+	struct NormalCost {
+		std::string name;
+		double milliseconds = 0;
+		double nanosecondsPerHit = 0;
+	};
+
+	/*
+	Measures what each normal estimator costs per hit pixel
+	Full resolution estimators are drawn as normal debug views and timed against a variant
+	that marches the same rays and discards the same misses without computing normals,
+	the half resolution path is timed against its hit pass alone and amortized over the full resolution hits
+	Every measurement blocks on its queries, run it on demand rather than every frame
+	*/
+	class NormalBenchmark {
+
+		GLuint m_TimeQuery = 0;
+		GLuint m_SampleQuery = 0;
+		GLuint64 m_Hits = 0;
+		std::vector<NormalCost> m_Results;
+
+		template<class Draw>
+		double measure(GLuint frames, Draw draw, GLuint64* samples = nullptr) {
+			GLuint64 totalTime = 0;
+			GLuint64 totalSamples = 0;
+			for (GLuint i = 0; i < frames; i++) {
+				glBeginQuery(GL_TIME_ELAPSED, m_TimeQuery);
+				if (samples)
+					glBeginQuery(GL_SAMPLES_PASSED, m_SampleQuery);
+				draw();
+				if (samples)
+					glEndQuery(GL_SAMPLES_PASSED);
+				glEndQuery(GL_TIME_ELAPSED);
+
+				GLuint64 result = 0;
+				glGetQueryObjectui64v(m_TimeQuery, GL_QUERY_RESULT, &result);
+				totalTime += result;
+				if (samples) {
+					glGetQueryObjectui64v(m_SampleQuery, GL_QUERY_RESULT, &result);
+					totalSamples += result;
+				}
+			}
+			if (samples)
+				*samples = totalSamples / frames;
+			return totalTime / 1e6 / frames;
+		}
+
+		void record(const char* name, double milliseconds) {
+			NormalCost cost;
+			cost.name = name;
+			cost.milliseconds = std::max(milliseconds, 0.0);
+			cost.nanosecondsPerHit = m_Hits ? cost.milliseconds * 1e6 / m_Hits : 0;
+			m_Results.push_back(cost);
+		}
+
+	public:
+
+		NormalBenchmark() {
+			glGenQueries(1, &m_TimeQuery);
+			glGenQueries(1, &m_SampleQuery);
+		}
+
+		NormalBenchmark(const NormalBenchmark&) = delete;
+		NormalBenchmark& operator=(const NormalBenchmark&) = delete;
+
+		~NormalBenchmark() {
+			glDeleteQueries(1, &m_TimeQuery);
+			glDeleteQueries(1, &m_SampleQuery);
+		}
+
+		/*
+		draw(features) renders the raymarcher with the given feature mask into the current framebuffer
+		drawHits() renders only the hit pass, drawHalfResolution() the hit pass followed by the half resolution normal pass
+		*/
+		template<class Draw, class DrawHits, class DrawHalfResolution>
+		void run(GLuint features, Draw draw, DrawHits drawHits, DrawHalfResolution drawHalfResolution, GLuint frames = 16) {
+			m_Results.clear();
+			features &= rFdomainRepetition;
+
+			double reference = measure(frames, [&]() { draw(features | rFdebugHits); }, &m_Hits);
+			record("Central differences", measure(frames, [&]() { draw(features | rFdebugNormals | rFcentralNormals); }) - reference);
+			record("Tetrahedral", measure(frames, [&]() { draw(features | rFdebugNormals); }) - reference);
+			record("Analytic gradient", measure(frames, [&]() { draw(features | rFdebugNormals | rFanalyticNormals); }) - reference);
+
+			double hitPass = measure(frames, drawHits);
+			record("Half resolution pass", measure(frames, drawHalfResolution) - hitPass);
+		}
+
+		inline GLuint64 hitPixels() const { return m_Hits; }
+		inline const std::vector<NormalCost>& results() const { return m_Results; }
+	};
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <algorithm>
+#include "glad/glad.h"
+#include "../engine_abstractions/buffer_objects.h"
+
+namespace rtre {
+
+	/*
+	Render targets of the half resolution normal path
+		hit pass		full resolution RG32F, distance and iteration count per pixel
+		normal pass		half resolution RGBA16F, normal and distance per 2x2 block
+	The shading pass then reads both instead of marching again, paying for one normal per four hit pixels
+	Targets are sized for the window and reused as is for smaller viewports
+	*/
+	class HalfResolutionNormals {
+
+		Fbo m_Hits;
+		Fbo m_Normals;
+
+	public:
+
+		void resize(GLsizei width, GLsizei height) {
+			if (width == m_Hits.width() && height == m_Hits.height())
+				return;
+
+			m_Hits.attachColor(GL_RG32F, width, height);
+			m_Normals.attachColor(GL_RGBA16F, std::max((width + 1) / 2, 1), std::max((height + 1) / 2, 1));
+		}
+
+		/*
+		drawHits renders the hit pass into a width x height viewport, drawNormals the normal pass at half of it,
+		with the hit buffer bound to hitUnit
+		Returns with the default framebuffer bound, the viewport restored
+		and the hit and normal buffers bound to hitUnit and normalUnit for the shading pass
+		*/
+		template<class DrawHits, class DrawNormals>
+		void render(GLsizei width, GLsizei height, DrawHits drawHits, DrawNormals drawNormals, GLuint hitUnit = 0, GLuint normalUnit = 1) {
+			m_Hits.bind();
+			glViewport(0, 0, width, height);
+			drawHits();
+
+			glstate::bindTexture(hitUnit, GL_TEXTURE_2D, m_Hits.texture());
+
+			m_Normals.bind();
+			glViewport(0, 0, std::max((width + 1) / 2, 1), std::max((height + 1) / 2, 1));
+			drawNormals();
+
+			m_Normals.unbind();
+			glViewport(0, 0, width, height);
+			glstate::bindTexture(normalUnit, GL_TEXTURE_2D, m_Normals.texture());
+		}
+	};
+}
@@ -0,0 +1,161 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "glad/glad.h"
+#include "../engine_abstractions/buffer_objects.h"
+#include "../engine_scene/sdf_scene.h"
+#include "../engine_scene/sdf_bytecode.h"
+#include "../engine_scene/scene_codegen.h"
+#include "scene_param_buffer.h"
+
+namespace rtre {
+
+	/*
+	How SceneCompiler runs the scene
+		rIauto			generated code while the structure is stable, the interpreter while it keeps changing
+		rIgenerated		always generated code, frames drawn before a rebuild finishes use the previous structure
+						with the params packed for it, see SceneParamBuffer
+		rIinterpreted	always the interpreter, whenever the program fits its stacks
+	*/
+	enum SceneCompileMode {
+		rIauto,
+		rIgenerated,
+		rIinterpreted
+	};
+
+	/*
+	Chooses between code generated from the scene and the bytecode interpreter in sdf/interpreter.glsl
+	The bytecode is compiled and uploaded on every structural edit, it costs microseconds where a shader rebuild
+	costs frames, so scenes that are being restructured render interpreted and are generated again once they settle
+	Generated code is only emitted when it will be used and no rebuild is in flight, and the interpreter keeps rendering
+	until the rebuilt shaders are ready, so a switch never shows a frame of stale code
+	Params are read from the buffer SceneParamBuffer binds, which both paths share, at the base it packed the structure at
+	*/
+	class SceneCompiler {
+
+		Ssbo m_Buffer;
+		GLuint m_Binding;
+		SceneCompileMode m_Mode = rIauto;
+		GLuint m_ChurnEdits;
+		GLuint m_ChurnFrames;
+		GLuint m_StableFrames;
+
+		SdfProgram m_Program;
+		std::vector<uint32_t> m_Words;
+		std::string m_Source;
+		GLuint m_Structure = 0;
+		// Params of the compiled structure, of the last emitted source, and of the source every program has linked
+		ParamPacking m_Packing;
+		ParamPacking m_Emitted;
+		ParamPacking m_Linked;
+		bool m_Initialized = false;
+		bool m_SourceCurrent = false;
+		bool m_Interpreted = false;
+
+		GLuint m_Frame = 0;
+		GLuint m_LastEdit = 0;
+		GLuint m_Churn = 0;
+		GLuint m_Generations = 0;
+
+		void compile(const SdfScene& scene) {
+			m_Program = compileBytecode(scene);
+			m_Words.clear();
+			m_Words.push_back(uint32_t(m_Program.code.size()));
+			m_Words.push_back(m_Packing.base);
+			m_Words.insert(m_Words.end(), m_Program.code.begin(), m_Program.code.end());
+			m_Buffer.write(m_Words);
+		}
+
+		bool wantsInterpreter() const {
+			if (!m_Program.fits())
+				return false;
+			if (m_Mode != rIauto)
+				return m_Mode == rIinterpreted;
+			return m_Churn >= m_ChurnEdits && m_Frame - m_LastEdit < m_StableFrames;
+		}
+
+	public:
+
+		/*
+		In rIauto the interpreter takes over after churnEdits structural edits each within churnFrames of the last,
+		and generated code comes back once the structure stayed the same for stableFrames
+		*/
+		SceneCompiler(GLuint binding = 5, GLuint churnEdits = 2, GLuint churnFrames = 60, GLuint stableFrames = 120)
+			:
+			m_Binding(binding),
+			m_ChurnEdits(churnEdits),
+			m_ChurnFrames(churnFrames),
+			m_StableFrames(stableFrames)
+		{
+		}
+
+		/*
+		Call once per frame after the scene's edits and SceneParamBuffer::update, packing is its packing()
+		shadersPending is whether rebuilds from earlier source are still in flight
+		Returns true when source() changed and has to replace scene.glsl
+		*/
+		bool update(const SdfScene& scene, ParamPacking packing, bool shadersPending) {
+			m_Frame++;
+			if (!m_Initialized || scene.structureRevision() != m_Structure) {
+				m_Packing = packing;
+				compile(scene);
+				m_Churn = m_Initialized && m_Frame - m_LastEdit <= m_ChurnFrames ? m_Churn + 1 : 1;
+				m_LastEdit = m_Frame;
+				m_Structure = scene.structureRevision();
+				m_SourceCurrent = false;
+				m_Initialized = true;
+				// The interpreter is current as soon as the bytecode is, it bridges the frames the rebuild takes
+				if (m_Mode != rIgenerated && m_Program.fits())
+					m_Interpreted = true;
+			}
+
+			// With nothing in flight every program has linked the last source emitted
+			if (!shadersPending)
+				m_Linked = m_Emitted;
+
+			bool interpret = wantsInterpreter();
+			bool emitted = false;
+			// One rebuild at a time, so every program runs either the linked source or the one being built
+			if (!interpret && !m_SourceCurrent && !shadersPending) {
+				m_Source = SceneCodegen(scene, true, m_Packing.base).generate();
+				m_Emitted = m_Packing;
+				m_SourceCurrent = true;
+				m_Generations++;
+				emitted = true;
+			}
+
+			if (interpret)
+				m_Interpreted = true;
+			else if (m_Interpreted && (!m_Program.fits() || (!emitted && !shadersPending)))
+				m_Interpreted = false;
+			return emitted;
+		}
+
+		/*
+		Recompiles everything on the next update, for when the scene was replaced rather than edited
+		*/
+		inline void invalidate() { m_Initialized = false; }
+
+		inline void bind() {
+			m_Buffer.reserve(2 * sizeof(uint32_t));
+			m_Buffer.bindBase(m_Binding);
+		}
+
+		inline void setMode(SceneCompileMode mode) { m_Mode = mode; }
+		inline SceneCompileMode mode() const { return m_Mode; }
+
+		/*
+		Whether this frame has to draw with rFsceneInterpreter
+		*/
+		inline bool interpreted() const { return m_Interpreted; }
+		inline const std::string& source() const { return m_Source; }
+
+		/*
+		Packings the linked programs and the ones being rebuilt read, a repack has to leave them alone
+		*/
+		inline std::vector<ParamPacking> packingsInUse() const { return { m_Linked, m_Emitted }; }
+		inline const SdfProgram& program() const { return m_Program; }
+		inline GLuint generations() const { return m_Generations; }
+	};
+}
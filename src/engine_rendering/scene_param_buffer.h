@@ -0,0 +1,118 @@
+#pragma once
+#include <vector>
+#include "glad/glad.h"
+#include "../engine_abstractions/dtypes.h"
+#include "../engine_abstractions/buffer_objects.h"
+#include "../engine_scene/sdf_scene.h"
+
+namespace rtre {
+
+	/*
+	vec4s [base, base + count) of sceneParams holding one packing of a scene
+	*/
+	struct ParamPacking {
+		GLuint base = 0;
+		GLuint count = 0;
+
+		inline bool overlaps(GLuint begin, GLuint end) const { return count && base < end && begin < base + count; }
+	};
+
+	/*
+	Node params of an SdfScene mirrored into the shader storage buffer read by code from SceneCodegen with a parameter buffer
+	Param edits upload only the scene's dirty range, structural edits repack everything and
+	are reported so the caller can generate the code again
+	A repack goes around the previous packing and the ones the caller says code still reads, so programs running code
+	generated for an earlier structure read the params they were built for until their rebuild links,
+	code is made against packing()
+	Param edits made while the rebuild is in flight only show once it links
+	*/
+	class SceneParamBuffer {
+
+		std::vector<vec4> m_Packed;
+		Ssbo m_Buffer;
+		GLuint m_Binding;
+		// First vec4 of the current packing
+		GLuint m_Base = 0;
+		GLuint m_Structure = 0;
+		bool m_Initialized = false;
+		GLsizeiptr m_UploadedBytes = 0;
+
+		static void pack(const SdfNode& node, vec4* out) {
+			out[0] = node.params[0];
+			out[1] = vec4(vec3(node.params[1]), GLfloat(node.material));
+		}
+
+	public:
+
+		SceneParamBuffer(GLuint binding = 4)
+			:
+			m_Binding(binding)
+		{
+		}
+
+		/*
+		Brings the buffer up to date with scene, returns true if the structure changed since the last call
+		inUse are the packings compiled code may still read, see SceneCompiler::packingsInUse
+		*/
+		bool update(SdfScene& scene, const std::vector<ParamPacking>& inUse = {}) {
+			const auto& nodes = scene.nodes();
+			bool structural = !m_Initialized || scene.structureRevision() != m_Structure;
+			if (structural) {
+				// Lowest offset clear of the previous packing and every one in use, replaced scenes included
+				GLuint count = GLuint(nodes.size() * 2), base = 0;
+				std::vector<ParamPacking> avoid = inUse;
+				avoid.push_back(packing());
+				for (bool moved = true; moved;) {
+					moved = false;
+					for (const ParamPacking& other : avoid)
+						if (other.overlaps(base, base + count)) {
+							base = other.base + other.count;
+							moved = true;
+						}
+				}
+				m_Base = base;
+				m_Packed.resize(nodes.size() * 2);
+				for (size_t i = 0; i < nodes.size(); i++)
+					pack(nodes[i], &m_Packed[2 * i]);
+				m_UploadedBytes = GLsizeiptr(m_Packed.size() * sizeof(vec4));
+				if (!m_Packed.empty())
+					m_Buffer.write(m_Base * sizeof(vec4), m_Packed.data(), m_UploadedBytes);
+				m_Structure = scene.structureRevision();
+				m_Initialized = true;
+				scene.clearDirty();
+				return true;
+			}
+
+			if (!scene.paramsDirty()) {
+				m_UploadedBytes = 0;
+				return false;
+			}
+			size_t begin = scene.dirtyBegin(), end = std::min(scene.dirtyEnd(), nodes.size());
+			for (size_t i = begin; i < end; i++)
+				pack(nodes[i], &m_Packed[2 * i]);
+			m_UploadedBytes = GLsizeiptr((end - begin) * 2 * sizeof(vec4));
+			m_Buffer.write((m_Base + begin * 2) * sizeof(vec4), &m_Packed[2 * begin], m_UploadedBytes);
+			scene.clearDirty();
+			return false;
+		}
+
+		/*
+		Forces a full repack on the next update, for when the scene was replaced rather than edited
+		*/
+		inline void invalidate() { m_Initialized = false; }
+
+		/*
+		The buffer always has storage once bound, even for an empty scene
+		*/
+		inline void bind() {
+			m_Buffer.reserve(2 * sizeof(vec4));
+			m_Buffer.bindBase(m_Binding);
+		}
+
+		/*
+		Where the current structure's params are in sceneParams
+		*/
+		inline ParamPacking packing() const { return { m_Base, GLuint(m_Packed.size()) }; }
+		inline GLsizeiptr uploadedBytes() const { return m_UploadedBytes; }
+	};
+}
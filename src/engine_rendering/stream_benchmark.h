@@ -0,0 +1,138 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "glad/glad.h"
+#include "../engine_abstractions/buffer_objects.h"
+#include "../engine_abstractions/stream_buffer.h"
+
+namespace rtre {
+
+	struct StreamCost {
+		std::string path;
+		double milliseconds = 0;
+		double gigabytesPerSecond = 0;
+		uint64_t waits = 0;
+	};
+
+	/*
+	Sustained upload bandwidth of the ways to feed per-frame data to the GPU
+	Every frame a chunk is written and then read by the GPU with a buffer copy, so uploads can't be skipped or coalesced
+		Orphaning			glBufferData with the data, what Vbo::loadData does
+		Orphan and update	glBufferData without data then glBufferSubData
+		Persistent ring		memcpy into a StreamBuffer three chunks large
+	The ring is also checked with frames writing more than it holds, every chunk is copied out and read back
+	Blocks until the GPU finished, run it on demand
+	*/
+	class StreamBenchmark {
+
+		std::vector<StreamCost> m_Results;
+		// Chunks that came back wrong from the overrun check, -1 before it ran
+		GLint m_OverrunErrors = -1;
+
+		/*
+		chunksPerFrame chunks of their own byte through a ring of ringChunks, each copied to its slot of a sink
+		A wrap that reuses memory before the GPU copied out of it shows up as a chunk with the wrong byte
+		*/
+		GLint checkOverrun(GLsizeiptr chunk, GLuint ringChunks = 3, GLuint chunksPerFrame = 8, GLuint frames = 4) {
+			GLuint sink = 0;
+			glGenBuffers(1, &sink);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, sink);
+			glBufferData(GL_COPY_WRITE_BUFFER, chunk * chunksPerFrame, nullptr, GL_STREAM_COPY);
+
+			StreamBuffer ring(GL_COPY_READ_BUFFER, chunk * ringChunks);
+			std::vector<uint8_t> source(chunk), copied(chunk * chunksPerFrame);
+			GLint errors = 0;
+			for (GLuint frame = 0; frame < frames; frame++) {
+				for (GLuint i = 0; i < chunksPerFrame; i++) {
+					std::fill(source.begin(), source.end(), uint8_t(frame * chunksPerFrame + i + 1));
+					StreamBuffer::Allocation allocation = ring.write(Span<const uint8_t>(source), 256);
+					ring.bind(GL_COPY_READ_BUFFER);
+					glBindBuffer(GL_COPY_WRITE_BUFFER, sink);
+					glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, allocation.offset, i * chunk, chunk);
+				}
+				ring.fence();
+
+				glBindBuffer(GL_COPY_WRITE_BUFFER, sink);
+				glGetBufferSubData(GL_COPY_WRITE_BUFFER, 0, GLsizeiptr(copied.size()), copied.data());
+				for (GLuint i = 0; i < chunksPerFrame; i++) {
+					uint8_t expected = uint8_t(frame * chunksPerFrame + i + 1);
+					const uint8_t* begin = copied.data() + i * chunk;
+					if (std::any_of(begin, begin + chunk, [expected](uint8_t b) { return b != expected; }))
+						errors++;
+				}
+			}
+
+			glDeleteBuffers(1, &sink);
+			return errors;
+		}
+
+		template<class Upload>
+		void measure(const char* path, GLsizeiptr chunk, GLuint frames, GLuint sink, Upload upload, StreamBuffer* ring = nullptr) {
+			glFinish();
+			uint64_t waits = ring ? ring->waits() : 0;
+			auto start = std::chrono::steady_clock::now();
+			for (GLuint i = 0; i < frames; i++) {
+				GLintptr offset = upload();
+				glBindBuffer(GL_COPY_WRITE_BUFFER, sink);
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, 0, chunk);
+				if (ring)
+					ring->fence();
+			}
+			glFinish();
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			StreamCost cost;
+			cost.path = path;
+			cost.milliseconds = seconds * 1000 / frames;
+			cost.gigabytesPerSecond = seconds > 0 ? double(chunk) * frames / seconds / 1e9 : 0;
+			cost.waits = ring ? ring->waits() - waits : 0;
+			m_Results.push_back(cost);
+		}
+
+	public:
+
+		void run(GLsizeiptr chunk = 1 << 20, GLuint frames = 256) {
+			m_Results.clear();
+			std::vector<uint8_t> source(chunk, 0x5A);
+			Span<const uint8_t> data(source);
+
+			GLuint sink = 0;
+			glGenBuffers(1, &sink);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, sink);
+			glBufferData(GL_COPY_WRITE_BUFFER, chunk, nullptr, GL_STREAM_COPY);
+
+			{
+				Vbo vbo;
+				measure("Orphaning", chunk, frames, sink, [&]() {
+					vbo.loadData(data, GL_STREAM_DRAW);
+					glBindBuffer(GL_COPY_READ_BUFFER, vbo.id());
+					return GLintptr(0);
+				});
+				measure("Orphan and update", chunk, frames, sink, [&]() {
+					vbo.allocate(chunk, GL_STREAM_DRAW);
+					vbo.write(0, data);
+					glBindBuffer(GL_COPY_READ_BUFFER, vbo.id());
+					return GLintptr(0);
+				});
+			}
+
+			if (StreamBuffer::supported()) {
+				StreamBuffer ring(GL_COPY_READ_BUFFER, chunk * 3);
+				measure("Persistent ring", chunk, frames, sink, [&]() {
+					StreamBuffer::Allocation allocation = ring.write(data, 256);
+					ring.bind(GL_COPY_READ_BUFFER);
+					return allocation.offset;
+				}, &ring);
+			}
+			m_OverrunErrors = StreamBuffer::supported() ? checkOverrun(chunk) : -1;
+
+			glDeleteBuffers(1, &sink);
+		}
+
+		inline const std::vector<StreamCost>& results() const { return m_Results; }
+		inline GLint overrunErrors() const { return m_OverrunErrors; }
+	};
+}
@@ -0,0 +1,279 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+#include "../engine_abstractions/gl_ext.h"
+#include "../engine_abstractions/gl_state.h"
+#include "../engine_abstractions/texture_loader.h"
+
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "../implimgui/imstb_rectpack.h"
+
+namespace rtre {
+
+	/*
+	Where an atlas entry ended up
+		layer		page of the texture array
+		rect		uv offset in xy and uv size in zw of the entry inside its page, gutters excluded
+		handle		bindless handle of the entry's own texture, 0 unless the atlas is bindless
+	*/
+	struct AtlasRegion {
+		GLint layer = -1;
+		glm::vec4 rect = glm::vec4(0, 0, 1, 1);
+		GLuint64 handle = 0;
+	};
+
+	struct AtlasStats {
+		size_t entries = 0;
+		GLsizei pages = 0;
+		// Entry texels over page texels, gutters and empty space are the rest
+		double efficiency = 0;
+		uint64_t gpuBytes = 0;
+		bool bindless = false;
+	};
+
+	/*
+	Material textures packed into the pages of one GL_TEXTURE_2D_ARRAY, so every material samples through a single binding
+	Entries are packed with stb_rect_pack, a new page is opened when one fills up
+	Every entry is surrounded by a gutter holding its wrapped edges, so tiling across the entry's edges is seamless
+	and mip levels stop before the gutter is averaged away, limiting how far neighbours bleed in
+	With ARB_bindless_texture and NV_gpu_shader5 entries can instead keep their own textures and hand out resident
+	handles, nothing is packed or bound then
+	add() collects images, build() packs and uploads them, entries added later need another build()
+	*/
+	class TextureAtlas {
+
+		struct Entry {
+			std::string name;
+			std::vector<uint8_t> pixels;
+			GLsizei width = 0;
+			GLsizei height = 0;
+		};
+
+		std::vector<Entry> m_Entries;
+		std::vector<AtlasRegion> m_Regions;
+		std::vector<GLuint> m_Textures;
+
+		GLuint m_Array = 0;
+		GLsizei m_PageSize;
+		GLsizei m_Gutter;
+		bool m_Bindless = false;
+		AtlasStats m_Stats;
+
+		static GLsizei mipLevels(GLsizei size, GLsizei limit) {
+			GLsizei levels = 1;
+			while ((size >> levels) > 0 && levels < limit)
+				levels++;
+			return levels;
+		}
+
+		/*
+		Entry with its gutter, texels past an edge wrap around to the opposite edge
+		*/
+		std::vector<uint8_t> padded(const Entry& entry) const {
+			GLsizei width = entry.width + 2 * m_Gutter, height = entry.height + 2 * m_Gutter;
+			std::vector<uint8_t> out(size_t(width) * height * 4);
+			for (GLsizei y = 0; y < height; y++) {
+				GLsizei sourceY = ((y - m_Gutter) % entry.height + entry.height) % entry.height;
+				for (GLsizei x = 0; x < width; x++) {
+					GLsizei sourceX = ((x - m_Gutter) % entry.width + entry.width) % entry.width;
+					std::memcpy(&out[(size_t(y) * width + x) * 4], &entry.pixels[(size_t(sourceY) * entry.width + sourceX) * 4], 4);
+				}
+			}
+			return out;
+		}
+
+		void release() {
+			for (size_t i = 0; i < m_Textures.size(); i++) {
+				if (m_Regions[i].handle)
+					glext::glMakeTextureHandleNonResidentARB(m_Regions[i].handle);
+				glDeleteTextures(1, &m_Textures[i]);
+				glstate::forgetTexture(m_Textures[i]);
+			}
+			m_Textures.clear();
+			if (m_Array) {
+				glDeleteTextures(1, &m_Array);
+				glstate::forgetTexture(m_Array);
+			}
+			m_Array = 0;
+		}
+
+		void buildBindless() {
+			for (size_t i = 0; i < m_Entries.size(); i++) {
+				const Entry& entry = m_Entries[i];
+				GLuint texture = 0;
+				glGenTextures(1, &texture);
+				glstate::bindTextureForEdit(GL_TEXTURE_2D, texture);
+				glTexStorage2D(GL_TEXTURE_2D, mipLevels(std::max(entry.width, entry.height), 32), GL_RGBA8, entry.width, entry.height);
+				glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, entry.width, entry.height, GL_RGBA, GL_UNSIGNED_BYTE, entry.pixels.data());
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+				glGenerateMipmap(GL_TEXTURE_2D);
+				glstate::count(5);
+
+				// A texture's parameters are frozen once it has a handle
+				AtlasRegion region;
+				region.layer = 0;
+				region.handle = glext::glGetTextureHandleARB(texture);
+				glext::glMakeTextureHandleResidentARB(region.handle);
+				m_Textures.push_back(texture);
+				m_Regions[i] = region;
+				m_Stats.gpuBytes += uint64_t(entry.width) * entry.height * 4 * 4 / 3;
+			}
+			m_Stats.efficiency = 1;
+		}
+
+		void buildArray() {
+			std::vector<stbrp_rect> pending(m_Entries.size());
+			for (size_t i = 0; i < m_Entries.size(); i++) {
+				pending[i].id = int(i);
+				pending[i].w = m_Entries[i].width + 2 * m_Gutter;
+				pending[i].h = m_Entries[i].height + 2 * m_Gutter;
+				if (pending[i].w > m_PageSize || pending[i].h > m_PageSize) {
+					std::string exceptionMessage = "Texture larger than an atlas page: " + m_Entries[i].name;
+					throw std::exception(exceptionMessage.c_str());
+				}
+			}
+
+			// Each pass fills one page with what fits and leaves the rest for the next
+			std::vector<stbrp_rect> placed;
+			std::vector<stbrp_node> nodes(m_PageSize);
+			GLsizei pages = 0;
+			while (!pending.empty()) {
+				stbrp_context context;
+				stbrp_init_target(&context, m_PageSize, m_PageSize, nodes.data(), int(nodes.size()));
+				stbrp_pack_rects(&context, pending.data(), int(pending.size()));
+
+				std::vector<stbrp_rect> rest;
+				for (auto& rect : pending) {
+					if (rect.was_packed) {
+						m_Regions[rect.id].layer = pages;
+						placed.push_back(rect);
+					}
+					else
+						rest.push_back(rect);
+				}
+				pending.swap(rest);
+				pages++;
+			}
+
+			// Mip levels stop where the gutter shrinks below a texel
+			GLsizei levels = mipLevels(m_PageSize, mipLevels(m_Gutter, 32));
+			glGenTextures(1, &m_Array);
+			glstate::bindTextureForEdit(GL_TEXTURE_2D_ARRAY, m_Array);
+			glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, GL_RGBA8, m_PageSize, m_PageSize, pages);
+			uint64_t used = 0;
+			for (const auto& rect : placed) {
+				const Entry& entry = m_Entries[rect.id];
+				std::vector<uint8_t> pixels = padded(entry);
+				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, rect.x, rect.y, m_Regions[rect.id].layer, rect.w, rect.h, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+				m_Regions[rect.id].rect = glm::vec4(
+					GLfloat(rect.x + m_Gutter) / m_PageSize, GLfloat(rect.y + m_Gutter) / m_PageSize,
+					GLfloat(entry.width) / m_PageSize, GLfloat(entry.height) / m_PageSize);
+				used += uint64_t(entry.width) * entry.height;
+			}
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+			glstate::count(6 + placed.size());
+
+			uint64_t pageTexels = uint64_t(m_PageSize) * m_PageSize;
+			m_Stats.pages = pages;
+			m_Stats.efficiency = pages ? double(used) / (pageTexels * pages) : 0;
+			m_Stats.gpuBytes = pageTexels * pages * 4 * 4 / 3;
+		}
+
+	public:
+
+		/*
+		gutter in texels on every side of an entry, mip levels stop at log2(gutter) + 1
+		*/
+		TextureAtlas(GLsizei pageSize = 2048, GLsizei gutter = 8)
+			:
+			m_PageSize(pageSize),
+			m_Gutter(std::max<GLsizei>(gutter, 1))
+		{
+		}
+
+		TextureAtlas(const TextureAtlas&) = delete;
+		TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+		~TextureAtlas() {
+			release();
+		}
+
+		/*
+		Materials pick their handle per pixel, which ARB_bindless_texture alone only allows for dynamically uniform values
+		*/
+		static bool bindlessSupported() {
+			return glext::ARB_bindless_texture && glext::NV_gpu_shader5;
+		}
+
+		/*
+		Returns the entry index materials refer to, pixels are RGBA8
+		Throws on an empty image, its gutter would wrap around nothing
+		*/
+		GLint add(const std::string& name, const uint8_t* pixels, GLsizei width, GLsizei height) {
+			if (width <= 0 || height <= 0 || !pixels) {
+				std::string exceptionMessage = "Empty atlas texture " + name;
+				throw std::exception(exceptionMessage.c_str());
+			}
+			Entry entry;
+			entry.name = name;
+			entry.pixels.assign(pixels, pixels + size_t(width) * height * 4);
+			entry.width = width;
+			entry.height = height;
+			m_Entries.push_back(std::move(entry));
+			return GLint(m_Entries.size()) - 1;
+		}
+
+		GLint add(const std::string& name, const DecodedImage& image) {
+			return add(name, image.pixels.get(), image.width, image.height);
+		}
+
+		GLint addFile(const std::string& file, bool flip = true) {
+			return add(file, decodeImage(file, flip));
+		}
+
+		/*
+		Packs and uploads every entry, bindless only takes effect when the extension exists
+		*/
+		void build(bool bindless = false) {
+			release();
+			m_Stats = AtlasStats();
+			m_Regions.assign(m_Entries.size(), AtlasRegion());
+			m_Bindless = bindless && bindlessSupported();
+			m_Stats.entries = m_Entries.size();
+			m_Stats.bindless = m_Bindless;
+			if (m_Entries.empty())
+				return;
+
+			if (m_Bindless)
+				buildBindless();
+			else
+				buildArray();
+		}
+
+		/*
+		Bindless atlases have nothing to bind
+		*/
+		inline void bind(GLuint unit) {
+			if (m_Array)
+				glstate::bindTexture(unit, GL_TEXTURE_2D_ARRAY, m_Array);
+		}
+
+		inline const AtlasRegion& region(GLint entry) const { return m_Regions[entry]; }
+		inline const std::vector<AtlasRegion>& regions() const { return m_Regions; }
+		inline size_t entryCount() const { return m_Entries.size(); }
+		inline bool bindless() const { return m_Bindless; }
+		inline const AtlasStats& stats() const { return m_Stats; }
+	};
+}
@@ -1,5 +1,19 @@
 #version 430 core
-#define PI 3.14159265359
+#ifdef FEATURE_BINDLESS_TEXTURES
+#extension GL_ARB_bindless_texture : require
+#extension GL_NV_gpu_shader5 : require
+#endif
+#include "sdf/common.glsl"
+#include "sdf/operators.glsl"
+#include "sdf/primitives.glsl"
+#include "scene.glsl"
+#include "sdf/interpreter.glsl"
+#include "sdf/normals.glsl"
+#include "sdf/lighting.glsl"
+#include "sdf/lights.glsl"
+#ifdef FEATURE_MATERIALS
+#include "sdf/materials.glsl"
+#endif
 
 out vec4 FragColor;
 in vec2 vPosition;
@@ -9,69 +23,73 @@ uniform vec3 cameraPos;
 uniform float fov;
 uniform float aspec;
 uniform float time;
-uniform vec3 sphereloc;
-uniform float sphereRadius;
 uniform int maxits;
 uniform float thresh;
 uniform mat4 matrix;
 
 
 
-float atan2(in float y, in float x) {
-    bool s = (abs(x) > abs(y));
-    return mix(PI/2.0 - atan(x,y), atan(y,x), s);
+#ifdef FEATURE_HALF_RES_NORMALS
+uniform sampler2D hitBuffer;
+uniform sampler2D normalBuffer;
+
+/*
+Picks the closest in depth of the four nearest half resolution normals, so normals don't bleed across silhouettes
+*/
+vec3 upsampleNormal(vec3 position, float dist) {
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	ivec2 base = pixel / 2;
+	ivec2 side = (pixel & 1) * 2 - 1;
+	ivec2 limit = textureSize(normalBuffer, 0) - 1;
+
+	vec4 best = vec4(0, 0, 0, -1);
+	float bestError = 1e10;
+	for (int i = 0; i < 4; i++) {
+		ivec2 texel = clamp(base + side * ivec2(i & 1, i >> 1), ivec2(0), limit);
+		vec4 candidate = texelFetch(normalBuffer, texel, 0);
+		float error = abs(candidate.w - dist);
+		if (candidate.w >= 0.0 && error < bestError) {
+			best = candidate;
+			bestError = error;
+		}
+	}
+
+	if (best.w < 0.0)
+		return estimateNormal(position);
+	return best.xyz;
 }
-
-float smin(float a, float b, float k) {
-	float h = clamp( 0.5 + 0.5*(b-a)/k, 0.0, 1.0 );
-	return mix( b, a, h ) - k*h*(1.0-h);
-}
-
-float smax(float a, float b, float k) {
-    return smin(a, b, -k);
-}
-
-float sdSphere(vec3 position, vec3 centre, float radius) {
-	return length(position-centre) - radius;
-}
-
-float sdBox(vec3 position, vec3 origin, vec3 bound) {
-	 vec3 d = abs(position-origin) - bound;
-	 return min(max(d.x,max(d.y,d.z)),0.0) + length(max(d,0.0));
-}
-
-vec3 hypot(vec3 x, vec3 y) {
-	return sqrt(x*x+y*y);
+#endif
+
+vec3 surfaceNormal(vec3 position, float dist) {
+#ifdef FEATURE_HALF_RES_NORMALS
+	return upsampleNormal(position, dist);
+#else
+	return estimateNormal(position);
+#endif
 }
 
-float hypot(float x, float y) {
-	return sqrt(x*x+y*y);
-}
-
-vec3 sphereP = vec3(3,3,3);
-float sphereR = 0.1;
-
-vec3 boxP = vec3(2,2.9,3);
-vec3 boxB = vec3(0.5);
-
-
-const vec3 lightP = vec3( 2 , 3 , -1);
-
-int raymarch(vec3 origin, vec3 direction) {
+int raymarch(vec3 origin, vec3 direction, out float dist) {
 
+	dist = 0;
 	int i = 0;
 	for( i; i<=maxits; i++) {
  
-		float m = smin( sdSphere(mod(origin,6),sphereP,sphereR), sdBox(origin,boxP,boxB) , 1.5);
-		m = smin(m,m,5.5);
-		//m = smin(sdSphere(mod(origin+time/1000,6),sphereloc,sphereRadius),100000, 0.4f);
+		float m = map(origin);
 		origin += direction*m;
+		dist += m;
 		if(m < thresh ) return i;
 		
 	} 
 	return -1;
 }
 
+/*
+Pass and debug variants
+	FEATURE_HIT_PASS			writes (distance, iterations) instead of shading, iterations is -1 on a miss
+	FEATURE_HALF_RES_NORMALS	reads the hit pass instead of marching and upsamples normals from the half resolution pass
+	FEATURE_DEBUG_NORMALS		outputs normals, misses are discarded
+	FEATURE_DEBUG_HITS			outputs white, misses are discarded
+*/
 void main() {
 
 	vec3 rayOrigin = cameraPos;
@@ -80,12 +98,50 @@ void main() {
 	
 	rayDirection = (matrix * vec4(normalize(rayDirection),0)).xyz;
 	
-	int r = raymarch(rayOrigin, rayDirection.xyz);
-
-
+	float dist;
+#ifdef FEATURE_HALF_RES_NORMALS
+	vec2 hit = texelFetch(hitBuffer, ivec2(gl_FragCoord.xy), 0).xy;
+	dist = hit.x;
+	int r = int(hit.y);
+#else
+	int r = raymarch(rayOrigin, rayDirection.xyz, dist);
+#endif
+
+#if defined(FEATURE_HIT_PASS)
+	FragColor = vec4(dist, float(r), 0, 1);
+#elif defined(FEATURE_DEBUG_HEATMAP)
 	if(r > 0)
 		FragColor = vec4(r/float(maxits),0,0,1);
 	else
 		FragColor = vec4(0,0,0,1);
+#else
+#ifdef FEATURE_MATERIALS
+	// Every pixel of the quad still runs here, past the branches below the derivatives would be undefined
+	vec3 positionDx = dFdx(rayOrigin + rayDirection*dist), positionDy = dFdy(rayOrigin + rayDirection*dist);
+#endif
+	if(r < 0) {
+#if defined(FEATURE_DEBUG_NORMALS) || defined(FEATURE_DEBUG_HITS)
+		discard;
+#endif
+		FragColor = vec4(0,0,0,1);
+		return;
+	}
+
+	vec3 position = rayOrigin + rayDirection*dist;
+#if defined(FEATURE_DEBUG_HITS)
+	FragColor = vec4(1);
+#elif defined(FEATURE_DEBUG_NORMALS)
+	FragColor = vec4(surfaceNormal(position, dist)*0.5 + 0.5, 1);
+#else
+	vec3 normal = surfaceNormal(position, dist);
+	// Depth along the view axis, the unnormalized ray has a view space z of -1
+	float viewDepth = dist/length(vec3(vPosition.x*aspec,vPosition.y,-1));
+	vec3 color = shade(position, normal) + pointLights(position, normal, rayDirection, vPosition + 0.5, viewDepth);
+#ifdef FEATURE_MATERIALS
+	color *= materialAlbedo(position, normal, positionDx, positionDy);
+#endif
+	FragColor = vec4(color*exp(-0.05*dist),1);
+#endif
+#endif
 
 }
\ No newline at end of file
@@ -0,0 +1,13 @@
+#version 430 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aColor;
+
+uniform mat4 viewProjection;
+
+out vec3 vColor;
+
+void main() {
+	vColor = aColor;
+	gl_Position = viewProjection * vec4(aPos, 1);
+}
@@ -0,0 +1,24 @@
+#version 430 core
+
+out vec4 FragColor;
+in vec3 vWorld;
+in vec3 vNormal;
+
+uniform vec3 cameraPos;
+uniform vec3 lightP;
+uniform float lightRange;
+
+/*
+Preview shading for extracted meshes, the raymarcher's key light without shadows or occlusion
+*/
+void main() {
+	vec3 normal = normalize(vNormal);
+	vec3 toLight = lightP - vWorld;
+	float lightDistance = length(toLight);
+
+	float diffuse = max(dot(normal, toLight/lightDistance), 0.0);
+	float attenuation = clamp(1.0 - lightDistance/lightRange, 0.0, 1.0);
+	float dist = length(vWorld - cameraPos);
+
+	FragColor = vec4(vec3(0.08 + diffuse*attenuation)*exp(-0.05*dist), 1);
+}
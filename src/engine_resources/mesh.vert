@@ -0,0 +1,16 @@
+#version 430 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+layout (location = 2) in vec3 aNormal;
+
+uniform mat4 viewProjection;
+
+out vec3 vWorld;
+out vec3 vNormal;
+
+void main() {
+	vWorld = aPos;
+	vNormal = aNormal;
+	gl_Position = viewProjection * vec4(aPos, 1);
+}
@@ -0,0 +1,35 @@
+#version 430 core
+#include "sdf/common.glsl"
+#include "sdf/operators.glsl"
+#include "sdf/primitives.glsl"
+#include "scene.glsl"
+#include "sdf/interpreter.glsl"
+#include "sdf/normals.glsl"
+
+out vec4 FragColor;
+in vec2 vPosition;
+
+uniform sampler2D hitBuffer;
+uniform vec2 resolution;
+uniform vec3 cameraPos;
+uniform float aspec;
+uniform mat4 matrix;
+
+/*
+Half resolution normal pass, one normal per 2x2 block of the hit pass
+Writes (normal, distance), distance is -1 where the ray missed
+*/
+void main() {
+
+	ivec2 pixel = ivec2(gl_FragCoord.xy) * 2;
+	vec2 hit = texelFetch(hitBuffer, pixel, 0).xy;
+	if(hit.y < 0.0) {
+		FragColor = vec4(0,0,0,-1);
+		return;
+	}
+
+	vec2 screen = (vec2(pixel) + 0.5) / resolution - 0.5;
+	vec3 rayDirection = (matrix * vec4(normalize(vec3(screen.x*aspec,screen.y,-1)),0)).xyz;
+
+	FragColor = vec4(estimateNormal(cameraPos + rayDirection*hit.x), hit.x);
+}
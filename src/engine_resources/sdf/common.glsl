@@ -0,0 +1,15 @@
+#pragma once
+#define PI 3.14159265359
+
+float atan2(in float y, in float x) {
+    bool s = (abs(x) > abs(y));
+    return mix(PI/2.0 - atan(x,y), atan(y,x), s);
+}
+
+vec3 hypot(vec3 x, vec3 y) {
+	return sqrt(x*x+y*y);
+}
+
+float hypot(float x, float y) {
+	return sqrt(x*x+y*y);
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+/*
+Stack machine running the scene bytecode from compileBytecode in engine_scene/sdf_bytecode.h
+Replaces the generated map, mapGradient and mapMaterial, so a structural edit only uploads new code instead of
+rebuilding every shader, params come from sceneParams like the generated code with a parameter buffer
+	sceneCode[0]		instruction count
+	sceneCode[1]		index of the first vec4 of the params packing the code was compiled against
+	sceneCode[2..]		opcode in bits 0-3, swapped operands in bit 4, node in bits 8-31
+*/
+#ifdef FEATURE_SCENE_INTERPRETER
+
+// Matches sdfStackLimit and sdfPositionLimit, SceneCompiler keeps deeper programs on generated code
+#define SCENE_STACK 16
+#define SCENE_POSITIONS 4
+
+#define OP_SPHERE 0u
+#define OP_BOX 1u
+#define OP_UNION 2u
+#define OP_SMOOTH_UNION 3u
+#define OP_SUBTRACT 4u
+#define OP_INTERSECT 5u
+#define OP_REPEAT 6u
+#define OP_RESTORE 7u
+#define OP_ROUND 8u
+#define OP_SWAPPED 16u
+
+layout(std430, binding = 5) readonly buffer SceneCode {
+	uint sceneCode[];
+};
+
+float map(vec3 p) {
+	float stack[SCENE_STACK];
+	vec3 positions[SCENE_POSITIONS];
+	int top = 0;
+	int saved = 0;
+	uint count = sceneCode[0];
+	int base = int(sceneCode[1]);
+	for (uint i = 2u; i < count + 2u; i++) {
+		uint instruction = sceneCode[i];
+		uint op = instruction & 15u;
+		int n = int(instruction >> 8);
+		vec4 params = sceneParams[base + 2 * n];
+
+		if (op == OP_SPHERE)
+			stack[top++] = sdSphere(p, params.xyz, params.w);
+		else if (op == OP_BOX)
+			stack[top++] = sdBox(p, params.xyz, sceneParams[base + 2 * n + 1].xyz);
+		else if (op == OP_ROUND)
+			stack[top - 1] -= params.x;
+		else if (op == OP_REPEAT) {
+			positions[saved++] = p;
+#ifdef FEATURE_DOMAIN_REPETITION
+			p = mod(p, params.x);
+#endif
+		}
+		else if (op == OP_RESTORE)
+			p = positions[--saved];
+		else {
+			top--;
+			bool swapped = (instruction & OP_SWAPPED) != 0u;
+			float a = swapped ? stack[top] : stack[top - 1];
+			float b = swapped ? stack[top - 1] : stack[top];
+			if (op == OP_UNION)
+				stack[top - 1] = min(a, b);
+			else if (op == OP_SMOOTH_UNION)
+				stack[top - 1] = smin(a, b, params.x);
+			else if (op == OP_SUBTRACT)
+				stack[top - 1] = max(a, -b);
+			else
+				stack[top - 1] = max(a, b);
+		}
+	}
+	return top > 0 ? stack[0] : 1e10;
+}
+
+vec4 mapGradient(vec3 p) {
+	vec4 stack[SCENE_STACK];
+	vec3 positions[SCENE_POSITIONS];
+	int top = 0;
+	int saved = 0;
+	uint count = sceneCode[0];
+	int base = int(sceneCode[1]);
+	for (uint i = 2u; i < count + 2u; i++) {
+		uint instruction = sceneCode[i];
+		uint op = instruction & 15u;
+		int n = int(instruction >> 8);
+		vec4 params = sceneParams[base + 2 * n];
+
+		if (op == OP_SPHERE)
+			stack[top++] = sdgSphere(p, params.xyz, params.w);
+		else if (op == OP_BOX)
+			stack[top++] = sdgBox(p, params.xyz, sceneParams[base + 2 * n + 1].xyz);
+		else if (op == OP_ROUND)
+			stack[top - 1].x -= params.x;
+		else if (op == OP_REPEAT) {
+			positions[saved++] = p;
+#ifdef FEATURE_DOMAIN_REPETITION
+			p = mod(p, params.x);
+#endif
+		}
+		else if (op == OP_RESTORE)
+			p = positions[--saved];
+		else {
+			top--;
+			bool swapped = (instruction & OP_SWAPPED) != 0u;
+			vec4 a = swapped ? stack[top] : stack[top - 1];
+			vec4 b = swapped ? stack[top - 1] : stack[top];
+			if (op == OP_UNION)
+				stack[top - 1] = minGrad(a, b);
+			else if (op == OP_SMOOTH_UNION)
+				stack[top - 1] = sminGrad(a, b, params.x);
+			else if (op == OP_SUBTRACT)
+				stack[top - 1] = maxGrad(a, -b);
+			else
+				stack[top - 1] = maxGrad(a, b);
+		}
+	}
+	return top > 0 ? stack[0] : vec4(1e10, 0.0, 1.0, 0.0);
+}
+
+vec2 mapMaterial(vec3 p) {
+	vec2 stack[SCENE_STACK];
+	vec3 positions[SCENE_POSITIONS];
+	int top = 0;
+	int saved = 0;
+	uint count = sceneCode[0];
+	int base = int(sceneCode[1]);
+	for (uint i = 2u; i < count + 2u; i++) {
+		uint instruction = sceneCode[i];
+		uint op = instruction & 15u;
+		int n = int(instruction >> 8);
+		vec4 params = sceneParams[base + 2 * n];
+
+		if (op == OP_SPHERE)
+			stack[top++] = vec2(sdSphere(p, params.xyz, params.w), sceneParams[base + 2 * n + 1].w);
+		else if (op == OP_BOX)
+			stack[top++] = vec2(sdBox(p, params.xyz, sceneParams[base + 2 * n + 1].xyz), sceneParams[base + 2 * n + 1].w);
+		else if (op == OP_ROUND)
+			stack[top - 1].x -= params.x;
+		else if (op == OP_REPEAT) {
+			positions[saved++] = p;
+#ifdef FEATURE_DOMAIN_REPETITION
+			p = mod(p, params.x);
+#endif
+		}
+		else if (op == OP_RESTORE)
+			p = positions[--saved];
+		else {
+			top--;
+			bool swapped = (instruction & OP_SWAPPED) != 0u;
+			vec2 a = swapped ? stack[top] : stack[top - 1];
+			vec2 b = swapped ? stack[top - 1] : stack[top];
+			if (op == OP_UNION)
+				stack[top - 1] = minMat(a, b);
+			else if (op == OP_SMOOTH_UNION)
+				stack[top - 1] = sminMat(a, b, params.x);
+			else if (op == OP_SUBTRACT)
+				// The carved surface takes the material of the subtracted shape
+				stack[top - 1] = maxMat(a, vec2(-b.x, b.y));
+			else
+				stack[top - 1] = maxMat(a, b);
+		}
+	}
+	return top > 0 ? stack[0] : vec2(1e10, -1.0);
+}
+
+#endif
@@ -0,0 +1,68 @@
+#pragma once
+
+// Expects map to be declared
+
+uniform vec3 lightP;
+uniform float lightRange;
+uniform bool adaptiveShadows;
+uniform int shadowSteps;
+uniform float shadowSoftness;
+uniform int aoSamples;
+uniform float aoStep;
+
+/*
+Penumbra estimate from the closest miss along the shadow ray,
+reuses the scene distance so it costs shadowSteps map evaluations at most
+*/
+float softShadow(vec3 origin, vec3 direction, float mint, float maxt) {
+	float result = 1.0;
+	float t = mint;
+	for (int i = 0; i < shadowSteps && t < maxt; i++) {
+		float h = map(origin + direction*t);
+		if (h < 0.0001)
+			return 0.0;
+		result = min(result, shadowSoftness*h/t);
+		t += clamp(h, 0.005, 0.5);
+	}
+	return clamp(result, 0.0, 1.0);
+}
+
+/*
+Samples the distance field along the normal, occluded points are closer to geometry than their offset
+*/
+float ambientOcclusion(vec3 position, vec3 normal) {
+	float occlusion = 0.0;
+	float weight = 1.0;
+	for (int i = 1; i <= aoSamples; i++) {
+		float h = aoStep*i;
+		occlusion += weight*(h - map(position + normal*h));
+		weight *= 0.5;
+	}
+	return clamp(1.0 - 2.0*occlusion, 0.0, 1.0);
+}
+
+/*
+With adaptiveShadows no shadow ray is cast for points facing away from the light or beyond lightRange,
+they are unlit either way
+*/
+vec3 shade(vec3 position, vec3 normal) {
+	vec3 toLight = lightP - position;
+	float lightDistance = length(toLight);
+	toLight /= lightDistance;
+
+	float diffuse = max(dot(normal, toLight), 0.0);
+	float attenuation = clamp(1.0 - lightDistance/lightRange, 0.0, 1.0);
+
+	float shadow = 1.0;
+#ifdef FEATURE_SHADOWS
+	if (!adaptiveShadows || diffuse*attenuation > 0.0)
+		shadow = softShadow(position + normal*0.002, toLight, 0.01, lightDistance);
+#endif
+
+	float occlusion = 1.0;
+#ifdef FEATURE_AO
+	occlusion = ambientOcclusion(position, normal);
+#endif
+
+	return vec3(0.08)*occlusion + vec3(diffuse*attenuation*shadow)*occlusion;
+}
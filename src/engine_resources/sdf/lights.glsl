@@ -0,0 +1,73 @@
+#pragma once
+
+/*
+Point lights read from the light buffer, with FEATURE_CLUSTERED_LIGHTS only those of the pixel's cluster
+Layouts match GpuPointLight and LightCluster on the CPU side
+*/
+
+struct PointLight {
+	vec4 position;
+	vec4 diffuse;
+	vec4 specular;
+	vec4 attenuation;
+};
+
+layout(std430, binding = 0) readonly buffer LightBuffer {
+	PointLight lights[];
+};
+
+uniform int lightCount;
+
+#ifdef FEATURE_CLUSTERED_LIGHTS
+layout(std430, binding = 1) readonly buffer ClusterBuffer {
+	uvec2 clusters[];
+};
+
+layout(std430, binding = 2) readonly buffer ClusterIndexBuffer {
+	uint clusterLights[];
+};
+
+// x, y tiles and z slices
+uniform vec3 clusterGrid;
+// near plane, slices per log unit of depth
+uniform vec2 clusterDepth;
+
+/*
+screen in [0, 1], depth along the view axis
+*/
+uvec2 lightCluster(vec2 screen, float depth) {
+	ivec3 grid = ivec3(clusterGrid);
+	ivec2 tile = clamp(ivec2(screen*vec2(grid.xy)), ivec2(0), grid.xy - 1);
+	int slice = depth <= clusterDepth.x ? 0 : min(int(log(depth/clusterDepth.x)*clusterDepth.y), grid.z - 1);
+	return clusters[tile.x + grid.x*(tile.y + grid.y*slice)];
+}
+#endif
+
+vec3 pointLight(PointLight light, vec3 position, vec3 normal, vec3 view) {
+	vec3 toLight = light.position.xyz - position;
+	float lightDistance = length(toLight);
+	if (lightDistance >= light.position.w)
+		return vec3(0);
+	toLight /= lightDistance;
+
+	float attenuation = 1.0/(light.attenuation.x + light.attenuation.y*lightDistance + light.attenuation.z*lightDistance*lightDistance);
+	float diffuse = max(dot(normal, toLight), 0.0);
+	float specular = pow(max(dot(normal, normalize(toLight - view)), 0.0), 32.0);
+	return (light.diffuse.rgb*diffuse + light.specular.rgb*specular)*attenuation;
+}
+
+/*
+view is the ray direction, screen and depth locate the pixel's cluster
+*/
+vec3 pointLights(vec3 position, vec3 normal, vec3 view, vec2 screen, float depth) {
+	vec3 result = vec3(0);
+#ifdef FEATURE_CLUSTERED_LIGHTS
+	uvec2 cluster = lightCluster(screen, depth);
+	for (uint i = 0; i < cluster.y; i++)
+		result += pointLight(lights[clusterLights[cluster.x + i]], position, normal, view);
+#else
+	for (int i = 0; i < lightCount; i++)
+		result += pointLight(lights[i], position, normal, view);
+#endif
+	return result;
+}
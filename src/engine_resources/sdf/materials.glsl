@@ -0,0 +1,58 @@
+#pragma once
+
+/*
+Surface materials read from the material buffer, indexed by mapMaterial
+Layout matches GpuMaterial on the CPU side
+	albedo		rgb, w is the atlas layer or -1 when untextured
+	rect		uv offset and size of the texture inside its layer
+	params		x texture repeats per unit
+	handle		xy bindless handle, only read with FEATURE_BINDLESS_TEXTURES, where GL_NV_gpu_shader5 allows
+				it to differ between the pixels of a draw
+Textures are projected triplanar, derivatives come from the unwrapped coordinates so the fract
+at tile edges doesn't select the smallest mip
+The caller takes the hit position's derivatives before branching on the hit, they are undefined in
+non-uniform control flow, and materialAlbedo returns early for untextured materials
+*/
+
+struct Material {
+	vec4 albedo;
+	vec4 rect;
+	vec4 params;
+	uvec4 handle;
+};
+
+layout(std430, binding = 3) readonly buffer MaterialBuffer {
+	Material materials[];
+};
+
+uniform int materialCount;
+#ifndef FEATURE_BINDLESS_TEXTURES
+uniform sampler2DArray materialTextures;
+#endif
+
+vec3 sampleMaterial(Material m, vec2 uv, vec2 dx, vec2 dy) {
+#ifdef FEATURE_BINDLESS_TEXTURES
+	return textureGrad(sampler2D(m.handle.xy), uv, dx, dy).rgb;
+#else
+	vec2 atlas = m.rect.xy + fract(uv)*m.rect.zw;
+	return textureGrad(materialTextures, vec3(atlas, m.albedo.w), dx*m.rect.zw, dy*m.rect.zw).rgb;
+#endif
+}
+
+vec3 materialAlbedo(vec3 position, vec3 normal, vec3 positionDx, vec3 positionDy) {
+	int index = int(mapMaterial(position).y + 0.5);
+	if (index < 0 || index >= materialCount)
+		return vec3(1);
+
+	Material m = materials[index];
+	if (m.albedo.w < 0.0)
+		return m.albedo.rgb;
+
+	vec3 weights = pow(abs(normal), vec3(4));
+	weights /= weights.x + weights.y + weights.z;
+	vec3 p = position*m.params.x;
+	vec3 dx = positionDx*m.params.x, dy = positionDy*m.params.x;
+	vec3 texel = sampleMaterial(m, p.yz, dx.yz, dy.yz)*weights.x + sampleMaterial(m, p.xz, dx.xz, dy.xz)*weights.y
+		+ sampleMaterial(m, p.xy, dx.xy, dy.xy)*weights.z;
+	return m.albedo.rgb*texel;
+}
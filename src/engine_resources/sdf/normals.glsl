@@ -0,0 +1,41 @@
+#pragma once
+
+/*
+Surface normal estimators, selected at compile time
+	FEATURE_ANALYTIC_NORMALS	gradient generated from the scene description, one evaluation
+	FEATURE_CENTRAL_NORMALS		central differences, six evaluations
+	otherwise					tetrahedral differences, four evaluations
+Expects map and mapGradient to be declared
+*/
+
+vec3 centralNormal(vec3 position) {
+	const vec2 e = vec2(0.0005, 0.0);
+	return normalize(vec3(
+		map(position + e.xyy) - map(position - e.xyy),
+		map(position + e.yxy) - map(position - e.yxy),
+		map(position + e.yyx) - map(position - e.yyx)));
+}
+
+vec3 tetrahedralNormal(vec3 position) {
+	const vec2 k = vec2(1.0, -1.0);
+	const float h = 0.0005;
+	return normalize(
+		k.xyy*map(position + k.xyy*h) +
+		k.yyx*map(position + k.yyx*h) +
+		k.yxy*map(position + k.yxy*h) +
+		k.xxx*map(position + k.xxx*h));
+}
+
+vec3 analyticNormal(vec3 position) {
+	return normalize(mapGradient(position).yzw);
+}
+
+vec3 estimateNormal(vec3 position) {
+#if defined(FEATURE_ANALYTIC_NORMALS)
+	return analyticNormal(position);
+#elif defined(FEATURE_CENTRAL_NORMALS)
+	return centralNormal(position);
+#else
+	return tetrahedralNormal(position);
+#endif
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+float smin(float a, float b, float k) {
+	float h = clamp( 0.5 + 0.5*(b-a)/k, 0.0, 1.0 );
+	return mix( b, a, h ) - k*h*(1.0-h);
+}
+
+float smax(float a, float b, float k) {
+    return smin(a, b, -k);
+}
+
+/*
+Gradient forms, operands and results are vec4(distance, gradient)
+*/
+vec4 sminGrad(vec4 a, vec4 b, float k) {
+	float h = clamp( 0.5 + 0.5*(b.x-a.x)/k, 0.0, 1.0 );
+	return vec4(mix( b.x, a.x, h ) - k*h*(1.0-h), mix( b.yzw, a.yzw, h ));
+}
+
+vec4 minGrad(vec4 a, vec4 b) {
+	return (a.x < b.x) ? a : b;
+}
+
+vec4 maxGrad(vec4 a, vec4 b) {
+	return (a.x > b.x) ? a : b;
+}
+
+/*
+Material forms, operands and results are vec2(distance, material index)
+*/
+vec2 minMat(vec2 a, vec2 b) {
+	return (a.x < b.x) ? a : b;
+}
+
+vec2 maxMat(vec2 a, vec2 b) {
+	return (a.x > b.x) ? a : b;
+}
+
+vec2 sminMat(vec2 a, vec2 b, float k) {
+	return vec2(smin(a.x, b.x, k), (a.x < b.x) ? a.y : b.y);
+}
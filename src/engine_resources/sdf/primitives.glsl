@@ -0,0 +1,31 @@
+#pragma once
+
+float sdSphere(vec3 position, vec3 centre, float radius) {
+	return length(position-centre) - radius;
+}
+
+float sdBox(vec3 position, vec3 origin, vec3 bound) {
+	 vec3 d = abs(position-origin) - bound;
+	 return min(max(d.x,max(d.y,d.z)),0.0) + length(max(d,0.0));
+}
+
+/*
+Gradient forms, vec4(distance, gradient)
+*/
+vec4 sdgSphere(vec3 position, vec3 centre, float radius) {
+	vec3 d = position-centre;
+	float l = length(d);
+	return vec4(l - radius, d/max(l, 1e-8));
+}
+
+vec4 sdgBox(vec3 position, vec3 origin, vec3 bound) {
+	vec3 q = position-origin;
+	vec3 w = abs(q) - bound;
+	vec3 s = sign(q);
+	float g = max(w.x,max(w.y,w.z));
+	vec3 outside = max(w,0.0);
+	float l = length(outside);
+	if (g > 0.0)
+		return vec4(l, s*outside/l);
+	return vec4(g, s*((w.x>w.y && w.x>w.z) ? vec3(1,0,0) : ((w.y>w.z) ? vec3(0,1,0) : vec3(0,0,1))));
+}
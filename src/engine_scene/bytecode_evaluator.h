@@ -0,0 +1,551 @@
+#pragma once
+#include <cmath>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include "glm/glm.hpp"
+#include "sdf_scene.h"
+#include "sdf_bytecode.h"
+
+// GCC and Clang dispatch through a table of label addresses, MSVC through the switch it turns into a jump table
+#if defined(__GNUC__) || defined(__clang__)
+#define RTRE_COMPUTED_GOTO
+#endif
+
+namespace rtre {
+
+	/*
+	Points in structure of arrays layout, the batch evaluator's input
+	*/
+	struct SdfPoints {
+		std::vector<GLfloat> x;
+		std::vector<GLfloat> y;
+		std::vector<GLfloat> z;
+
+		inline void push(const vec3& point) {
+			x.push_back(point.x);
+			y.push_back(point.y);
+			z.push_back(point.z);
+		}
+		inline void reserve(size_t count) {
+			x.reserve(count);
+			y.reserve(count);
+			z.reserve(count);
+		}
+		inline void clear() {
+			x.clear();
+			y.clear();
+			z.clear();
+		}
+		inline size_t size() const { return x.size(); }
+	};
+
+	// Points evaluated together per pass over the program
+	static const GLuint sdfBatchWidth = 64;
+
+	/*
+	Evaluates an SdfScene from its bytecode, with the same results as SdfEvaluator's distance
+	The program is linked into flat instructions holding their params, so the loop never touches the scene's nodes,
+	and a primitive followed by the operator consuming it is fused into one instruction, the common shape of scenes
+	built up one primitive at a time
+	Batches run each instruction over sdfBatchWidth points before moving on, which pays for dispatch once per batch
+	and leaves the kernels as plain loops over arrays for the compiler to vectorize
+	Params are copied when linking, call link again after editing the scene, which must outlive the evaluator
+	*/
+	class BytecodeEvaluator {
+
+		enum Kernel : uint32_t {
+			rVsphere,
+			rVbox,
+			rVunion,
+			rVsmoothUnion,
+			rVsmoothUnionSwapped,
+			rVsubtract,
+			rVsubtractSwapped,
+			rVintersect,
+			rVrepeat,
+			rVrestore,
+			rVround,
+			rVsphereUnion,
+			rVsphereSmoothUnion,
+			rVsphereSubtract,
+			rVsphereIntersect,
+			rVboxUnion,
+			rVboxSmoothUnion,
+			rVboxSubtract,
+			rVboxIntersect,
+			rVend
+		};
+
+		/*
+		k is the blend, period or rounding, and for fused instructions the operator's
+		extent is the radius in x for spheres, the half extents for boxes
+		node is the scene node, the primitive's for fused instructions
+		*/
+		struct Instruction {
+			Kernel kernel;
+			GLfloat k;
+			GLfloat centre[3];
+			GLfloat extent[3];
+			GLint node;
+		};
+
+		/*
+		Current positions and the storage the stacks live in, stack rows and saved positions are Width wide
+		*/
+		template<GLuint Width>
+		struct Lanes {
+			GLfloat x[Width];
+			GLfloat y[Width];
+			GLfloat z[Width];
+			GLfloat* stack;
+			GLfloat* saved;
+		};
+
+		struct Sphere {
+			static inline GLfloat at(const Instruction& in, GLfloat x, GLfloat y, GLfloat z) {
+				x -= in.centre[0];
+				y -= in.centre[1];
+				z -= in.centre[2];
+				return std::sqrt(x * x + y * y + z * z) - in.extent[0];
+			}
+		};
+
+		struct Box {
+			static inline GLfloat at(const Instruction& in, GLfloat x, GLfloat y, GLfloat z) {
+				x = std::abs(x - in.centre[0]) - in.extent[0];
+				y = std::abs(y - in.centre[1]) - in.extent[1];
+				z = std::abs(z - in.centre[2]) - in.extent[2];
+				GLfloat inside = std::min(std::max(x, std::max(y, z)), 0.0f);
+				x = std::max(x, 0.0f);
+				y = std::max(y, 0.0f);
+				z = std::max(z, 0.0f);
+				return inside + std::sqrt(x * x + y * y + z * z);
+			}
+		};
+
+		struct Union {
+			static inline GLfloat apply(GLfloat a, GLfloat b, GLfloat) { return std::min(a, b); }
+		};
+
+		struct SmoothUnion {
+			static inline GLfloat apply(GLfloat a, GLfloat b, GLfloat k) {
+				GLfloat h = glm::clamp(0.5f + 0.5f * (b - a) / k, 0.0f, 1.0f);
+				return glm::mix(b, a, h) - k * h * (1.0f - h);
+			}
+		};
+
+		struct Subtract {
+			static inline GLfloat apply(GLfloat a, GLfloat b, GLfloat) { return std::max(a, -b); }
+		};
+
+		struct Intersect {
+			static inline GLfloat apply(GLfloat a, GLfloat b, GLfloat) { return std::max(a, b); }
+		};
+
+		// Kernels take the next free stack row and return it after their pushes and pops
+
+		template<class Shape, GLuint Width>
+		static inline GLfloat* push(GLfloat* top, const Lanes<Width>& lanes, const Instruction& in) {
+			for (GLuint i = 0; i < Width; i++)
+				top[i] = Shape::at(in, lanes.x[i], lanes.y[i], lanes.z[i]);
+			return top + Width;
+		}
+
+		/*
+		Swapped operators had their right operand pushed first
+		*/
+		template<class Operator, bool Swapped, GLuint Width>
+		static inline GLfloat* combine(GLfloat* top, const Instruction& in) {
+			GLfloat* a = top - 2 * Width;
+			const GLfloat* b = top - Width;
+			for (GLuint i = 0; i < Width; i++)
+				a[i] = Swapped ? Operator::apply(b[i], a[i], in.k) : Operator::apply(a[i], b[i], in.k);
+			return top - Width;
+		}
+
+		/*
+		The primitive is the operator's right operand and never reaches the stack
+		*/
+		template<class Shape, class Operator, GLuint Width>
+		static inline GLfloat* fused(GLfloat* top, const Lanes<Width>& lanes, const Instruction& in) {
+			GLfloat* a = top - Width;
+			for (GLuint i = 0; i < Width; i++)
+				a[i] = Operator::apply(a[i], Shape::at(in, lanes.x[i], lanes.y[i], lanes.z[i]), in.k);
+			return top;
+		}
+
+		template<GLuint Width>
+		static inline GLfloat* repeat(GLfloat* saved, Lanes<Width>& lanes, const Instruction& in) {
+			for (GLuint i = 0; i < Width; i++) {
+				saved[i] = lanes.x[i];
+				saved[Width + i] = lanes.y[i];
+				saved[2 * Width + i] = lanes.z[i];
+				lanes.x[i] -= in.k * std::floor(lanes.x[i] / in.k);
+				lanes.y[i] -= in.k * std::floor(lanes.y[i] / in.k);
+				lanes.z[i] -= in.k * std::floor(lanes.z[i] / in.k);
+			}
+			return saved + 3 * Width;
+		}
+
+		template<GLuint Width>
+		static inline GLfloat* restore(GLfloat* saved, Lanes<Width>& lanes) {
+			saved -= 3 * Width;
+			for (GLuint i = 0; i < Width; i++) {
+				lanes.x[i] = saved[i];
+				lanes.y[i] = saved[Width + i];
+				lanes.z[i] = saved[2 * Width + i];
+			}
+			return saved;
+		}
+
+		template<GLuint Width>
+		static inline void round(GLfloat* top, const Instruction& in) {
+			GLfloat* a = top - Width;
+			for (GLuint i = 0; i < Width; i++)
+				a[i] -= in.k;
+		}
+
+		/*
+		Runs the program to rVend, the distances are left in the first stack row
+		*/
+		template<GLuint Width>
+		static void execute(const Instruction* in, Lanes<Width>& lanes) {
+			GLfloat* top = lanes.stack;
+			GLfloat* saved = lanes.saved;
+#ifdef RTRE_COMPUTED_GOTO
+			// In Kernel order
+			static const void* s_Labels[] = {
+				&&rVsphere, &&rVbox, &&rVunion, &&rVsmoothUnion, &&rVsmoothUnionSwapped, &&rVsubtract, &&rVsubtractSwapped,
+				&&rVintersect, &&rVrepeat, &&rVrestore, &&rVround, &&rVsphereUnion, &&rVsphereSmoothUnion, &&rVsphereSubtract,
+				&&rVsphereIntersect, &&rVboxUnion, &&rVboxSmoothUnion, &&rVboxSubtract, &&rVboxIntersect, &&rVend
+			};
+#define RTRE_KERNEL(kernel) kernel:
+#define RTRE_NEXT() goto *s_Labels[(++in)->kernel]
+			goto *s_Labels[in->kernel];
+#else
+#define RTRE_KERNEL(kernel) case kernel:
+#define RTRE_NEXT() in++; continue
+			for (;;) switch (in->kernel) {
+#endif
+			RTRE_KERNEL(rVsphere) top = push<Sphere>(top, lanes, *in); RTRE_NEXT();
+			RTRE_KERNEL(rVbox) top = push<Box>(top, lanes, *in); RTRE_NEXT();
+			RTRE_KERNEL(rVunion) top = combine<Union, false, Width>(top, *in); RTRE_NEXT();
+			RTRE_KERNEL(rVsmoothUnion) top = combine<SmoothUnion, false, Width>(top, *in); RTRE_NEXT();
+			RTRE_KERNEL(rVsmoothUnionSwapped) top = combine<SmoothUnion, true, Width>(top, *in); RTRE_NEXT();
+			RTRE_KERNEL(rVsubtract) top = combine<Subtract, false, Width>(top, *in); RTRE_NEXT();
+			RTRE_KERNEL(rVsubtractSwapped) top = combine<Subtract, true, Width>(top, *in); RTRE_NEXT();
+			RTRE_KERNEL(rVintersect) top = combine<Intersect, false, Width>(top, *in); RTRE_NEXT();
+			RTRE_KERNEL(rVrepeat) saved = repeat(saved, lanes, *in); RTRE_NEXT();
+			RTRE_KERNEL(rVrestore) saved = restore(saved, lanes); RTRE_NEXT();
+			RTRE_KERNEL(rVround) round<Width>(top, *in); RTRE_NEXT();
+			RTRE_KERNEL(rVsphereUnion) top = fused<Sphere, Union>(top, lanes, *in); RTRE_NEXT();
+			RTRE_KERNEL(rVsphereSmoothUnion) top = fused<Sphere, SmoothUnion>(top, lanes, *in); RTRE_NEXT();
+			RTRE_KERNEL(rVsphereSubtract) top = fused<Sphere, Subtract>(top, lanes, *in); RTRE_NEXT();
+			RTRE_KERNEL(rVsphereIntersect) top = fused<Sphere, Intersect>(top, lanes, *in); RTRE_NEXT();
+			RTRE_KERNEL(rVboxUnion) top = fused<Box, Union>(top, lanes, *in); RTRE_NEXT();
+			RTRE_KERNEL(rVboxSmoothUnion) top = fused<Box, SmoothUnion>(top, lanes, *in); RTRE_NEXT();
+			RTRE_KERNEL(rVboxSubtract) top = fused<Box, Subtract>(top, lanes, *in); RTRE_NEXT();
+			RTRE_KERNEL(rVboxIntersect) top = fused<Box, Intersect>(top, lanes, *in); RTRE_NEXT();
+			RTRE_KERNEL(rVend) return;
+#ifndef RTRE_COMPUTED_GOTO
+			}
+#endif
+#undef RTRE_KERNEL
+#undef RTRE_NEXT
+		}
+
+		const SdfScene& m_Scene;
+		bool m_Repetition;
+		bool m_Fuse;
+		std::vector<Instruction> m_Code;
+		size_t m_Instructions = 0;
+		GLuint m_StackDepth = 1;
+		GLuint m_PositionDepth = 1;
+
+		/*
+		Per thread storage for both stacks, Width lanes wide
+		*/
+		template<GLuint Width>
+		void prepare(Lanes<Width>& lanes, std::vector<GLfloat>& storage) const {
+			storage.resize(size_t(m_StackDepth + 3 * m_PositionDepth) * Width);
+			lanes.stack = storage.data();
+			lanes.saved = storage.data() + size_t(m_StackDepth) * Width;
+		}
+
+		/*
+		load(lanes, first, count) fills a batch's positions, short batches repeat their last point so kernels always run full width
+		*/
+		template<class Load>
+		void batches(size_t count, GLfloat* out, GLuint threads, Load load) const {
+			if (m_Scene.empty()) {
+				std::fill(out, out + count, 1e10f);
+				return;
+			}
+			size_t batchCount = (count + sdfBatchWidth - 1) / sdfBatchWidth;
+			threads = threads ? threads : std::max(std::thread::hardware_concurrency(), 1u);
+			threads = GLuint(std::min<size_t>(threads, batchCount));
+
+			std::atomic<size_t> next{ 0 };
+			auto worker = [&]() {
+				Lanes<sdfBatchWidth> lanes;
+				std::vector<GLfloat> storage;
+				prepare(lanes, storage);
+				for (size_t batch = next++; batch < batchCount; batch = next++) {
+					size_t first = batch * sdfBatchWidth;
+					size_t filled = std::min<size_t>(sdfBatchWidth, count - first);
+					load(lanes, first, filled);
+					for (size_t i = filled; i < sdfBatchWidth; i++) {
+						lanes.x[i] = lanes.x[filled - 1];
+						lanes.y[i] = lanes.y[filled - 1];
+						lanes.z[i] = lanes.z[filled - 1];
+					}
+					execute(m_Code.data(), lanes);
+					std::copy(lanes.stack, lanes.stack + filled, out + first);
+				}
+			};
+
+			std::vector<std::thread> workers;
+			for (GLuint t = 1; t < threads; t++)
+				workers.emplace_back(worker);
+			worker();
+			for (auto& thread : workers)
+				thread.join();
+		}
+
+	public:
+
+		/*
+		repetition mirrors FEATURE_DOMAIN_REPETITION like SdfEvaluator's, fuse can be turned off to measure what fusing gains
+		*/
+		BytecodeEvaluator(const SdfScene& scene, bool repetition = true, bool fuse = true)
+			:
+			m_Scene(scene),
+			m_Repetition(repetition),
+			m_Fuse(fuse)
+		{
+			link();
+		}
+
+		/*
+		Compiles the scene and copies its params into the instructions
+		*/
+		void link() {
+			SdfProgram program = compileBytecode(m_Scene);
+			m_Instructions = program.code.size();
+			m_StackDepth = std::max<GLuint>(program.stackDepth, 1);
+			m_PositionDepth = std::max<GLuint>(program.positionDepth, 1);
+			m_Code.clear();
+			m_Code.reserve(program.code.size() + 1);
+
+			for (size_t i = 0; i < program.code.size(); i++) {
+				uint32_t word = program.code[i];
+				const SdfNode& node = m_Scene.node(sdfNode(word));
+				SdfOp op = sdfOpcode(word);
+				Instruction in = {};
+				in.k = node.params[0].x;
+				in.node = sdfNode(word);
+
+				switch (op) {
+				case rOsphere:
+				case rObox: {
+					for (int c = 0; c < 3; c++) {
+						in.centre[c] = node.params[0][c];
+						in.extent[c] = op == rOsphere ? node.params[0].w : node.params[1][c];
+					}
+					in.kernel = op == rOsphere ? rVsphere : rVbox;
+					SdfOp consumer = i + 1 < program.code.size() ? sdfOpcode(program.code[i + 1]) : rOrepeat;
+					if (m_Fuse && consumer >= rOunion && consumer <= rOintersect && !sdfIsSwapped(program.code[i + 1])) {
+						in.kernel = Kernel((op == rOsphere ? rVsphereUnion : rVboxUnion) + (consumer - rOunion));
+						in.k = m_Scene.node(sdfNode(program.code[++i])).params[0].x;
+					}
+					break;
+				}
+				case rOunion:
+					in.kernel = rVunion;
+					break;
+				case rOsmoothUnion:
+					in.kernel = sdfIsSwapped(word) ? rVsmoothUnionSwapped : rVsmoothUnion;
+					break;
+				case rOsubtract:
+					in.kernel = sdfIsSwapped(word) ? rVsubtractSwapped : rVsubtract;
+					break;
+				case rOintersect:
+					in.kernel = rVintersect;
+					break;
+				case rOrepeat:
+				case rOrestore:
+					// Without repetition the positions pass through untouched
+					if (!m_Repetition)
+						continue;
+					in.kernel = op == rOrepeat ? rVrepeat : rVrestore;
+					break;
+				case rOround:
+					in.kernel = rVround;
+					break;
+				}
+				m_Code.push_back(in);
+			}
+			Instruction end = {};
+			end.kernel = rVend;
+			m_Code.push_back(end);
+		}
+
+		GLfloat distance(const vec3& position) const {
+			if (m_Scene.empty())
+				return 1e10f;
+			thread_local std::vector<GLfloat> t_Storage;
+			Lanes<1> lanes;
+			prepare(lanes, t_Storage);
+			lanes.x[0] = position.x;
+			lanes.y[0] = position.y;
+			lanes.z[0] = position.z;
+			execute(m_Code.data(), lanes);
+			return lanes.stack[0];
+		}
+
+		/*
+		Tetrahedral differences, the four samples run as one batch
+		*/
+		vec3 normal(const vec3& position, GLfloat h = 1e-4f) const {
+			if (m_Scene.empty())
+				return vec3(0, 1, 0);
+			static const vec3 s_Offsets[4] = { vec3(1, -1, -1), vec3(-1, -1, 1), vec3(-1, 1, -1), vec3(1, 1, 1) };
+			thread_local std::vector<GLfloat> t_Storage;
+			Lanes<4> lanes;
+			prepare(lanes, t_Storage);
+			for (int i = 0; i < 4; i++) {
+				lanes.x[i] = position.x + s_Offsets[i].x * h;
+				lanes.y[i] = position.y + s_Offsets[i].y * h;
+				lanes.z[i] = position.z + s_Offsets[i].z * h;
+			}
+			execute(m_Code.data(), lanes);
+			vec3 n(0);
+			for (int i = 0; i < 4; i++)
+				n += s_Offsets[i] * lanes.stack[i];
+			GLfloat l = glm::length(n);
+			return l > 0 ? n / l : vec3(0, 1, 0);
+		}
+
+		/*
+		The primitive whose surface is closest at position, chosen like mapMaterial chooses materials, -1 for an empty scene
+		Walks the program once without batching, meant for picking rather than bulk queries
+		*/
+		GLint primitiveAt(const vec3& position) const {
+			if (m_Scene.empty())
+				return -1;
+			std::vector<std::pair<GLfloat, GLint>> stack;
+			std::vector<vec3> saved;
+			vec3 p = position;
+			auto pick = [&](bool second) { return second ? stack.back().second : stack[stack.size() - 2].second; };
+			for (const Instruction& in : m_Code) {
+				GLfloat a = 0, b = 0, result = 0;
+				GLint owner = -1;
+				switch (in.kernel) {
+				case rVsphere:
+					stack.push_back({ Sphere::at(in, p.x, p.y, p.z), in.node });
+					continue;
+				case rVbox:
+					stack.push_back({ Box::at(in, p.x, p.y, p.z), in.node });
+					continue;
+				case rVrepeat:
+					saved.push_back(p);
+					p = glm::mod(p, in.k);
+					continue;
+				case rVrestore:
+					p = saved.back();
+					saved.pop_back();
+					continue;
+				case rVround:
+					stack.back().first -= in.k;
+					continue;
+				case rVend:
+					return stack.back().second;
+				case rVsphereUnion:
+				case rVsphereSmoothUnion:
+				case rVsphereSubtract:
+				case rVsphereIntersect:
+				case rVboxUnion:
+				case rVboxSmoothUnion:
+				case rVboxSubtract:
+				case rVboxIntersect: {
+					// Fused, the primitive is pushed then combined by its operator
+					bool sphere = in.kernel <= rVsphereIntersect;
+					stack.push_back({ sphere ? Sphere::at(in, p.x, p.y, p.z) : Box::at(in, p.x, p.y, p.z), in.node });
+					break;
+				}
+				default:
+					break;
+				}
+
+				bool swapped = in.kernel == rVsmoothUnionSwapped || in.kernel == rVsubtractSwapped;
+				a = stack[stack.size() - (swapped ? 1 : 2)].first;
+				b = stack[stack.size() - (swapped ? 2 : 1)].first;
+				GLint ownerA = pick(swapped), ownerB = pick(!swapped);
+				switch (in.kernel) {
+				case rVunion:
+				case rVsphereUnion:
+				case rVboxUnion:
+					result = Union::apply(a, b, in.k);
+					owner = a < b ? ownerA : ownerB;
+					break;
+				case rVsmoothUnion:
+				case rVsmoothUnionSwapped:
+				case rVsphereSmoothUnion:
+				case rVboxSmoothUnion:
+					result = SmoothUnion::apply(a, b, in.k);
+					owner = a < b ? ownerA : ownerB;
+					break;
+				case rVsubtract:
+				case rVsubtractSwapped:
+				case rVsphereSubtract:
+				case rVboxSubtract:
+					// The carved surface belongs to the subtracted shape
+					result = Subtract::apply(a, b, in.k);
+					owner = a > -b ? ownerA : ownerB;
+					break;
+				default:
+					result = Intersect::apply(a, b, in.k);
+					owner = a > b ? ownerA : ownerB;
+					break;
+				}
+				stack.pop_back();
+				stack.back() = { result, owner };
+			}
+			return -1;
+		}
+
+		/*
+		Distances of every point into out, threads of 0 uses every hardware thread
+		*/
+		void distances(const SdfPoints& points, GLfloat* out, GLuint threads = 1) const {
+			batches(points.size(), out, threads, [&](Lanes<sdfBatchWidth>& lanes, size_t first, size_t count) {
+				std::copy(points.x.data() + first, points.x.data() + first + count, lanes.x);
+				std::copy(points.y.data() + first, points.y.data() + first + count, lanes.y);
+				std::copy(points.z.data() + first, points.z.data() + first + count, lanes.z);
+			});
+		}
+
+		/*
+		Same for points stored as vectors, transposed a batch at a time
+		*/
+		void distances(const vec3* points, size_t count, GLfloat* out, GLuint threads = 1) const {
+			batches(count, out, threads, [&](Lanes<sdfBatchWidth>& lanes, size_t first, size_t filled) {
+				for (size_t i = 0; i < filled; i++) {
+					lanes.x[i] = points[first + i].x;
+					lanes.y[i] = points[first + i].y;
+					lanes.z[i] = points[first + i].z;
+				}
+			});
+		}
+
+		/*
+		Instructions in the compiled program, and after linking, which drops fused operators and disabled repetition
+		*/
+		inline size_t instructions() const { return m_Instructions; }
+		inline size_t linkedInstructions() const { return m_Code.size() - 1; }
+		inline const SdfScene& scene() const { return m_Scene; }
+		inline bool repetition() const { return m_Repetition; }
+	};
+}
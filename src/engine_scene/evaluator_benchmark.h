@@ -0,0 +1,95 @@
+#pragma once
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <random>
+#include <thread>
+#include <algorithm>
+#include "sdf_evaluator.h"
+#include "bytecode_evaluator.h"
+
+namespace rtre {
+
+	/*
+	speedup is relative to the tree walk, maxError is the largest difference from it over every point
+	*/
+	struct EvaluatorCost {
+		std::string path;
+		GLuint threads = 1;
+		double milliseconds = 0;
+		double pointsPerSecond = 0;
+		double speedup = 0;
+		double maxError = 0;
+	};
+
+	/*
+	Evaluates the same random points in a box with each CPU evaluator
+		Tree walk				SdfEvaluator, recursive over the nodes
+		Bytecode per point		BytecodeEvaluator::distance, one dispatch per instruction and point
+		Bytecode batch			batches of sdfBatchWidth points without fused instructions
+		Bytecode batch fused	batches with primitives fused into the operators consuming them, single threaded then on every thread
+	Runs on the calling thread and blocks until every path is done
+	*/
+	class EvaluatorBenchmark {
+
+		std::vector<EvaluatorCost> m_Results;
+		size_t m_Points = 0;
+		size_t m_Instructions = 0;
+		size_t m_LinkedInstructions = 0;
+
+		template<class Evaluate>
+		void measure(const char* path, GLuint threads, const std::vector<GLfloat>& reference, std::vector<GLfloat>& out, Evaluate evaluate) {
+			auto start = std::chrono::steady_clock::now();
+			evaluate();
+			EvaluatorCost cost;
+			cost.path = path;
+			cost.threads = threads;
+			cost.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			cost.pointsPerSecond = cost.milliseconds > 0 ? out.size() / (cost.milliseconds / 1000) : 0;
+			cost.speedup = m_Results.empty() || cost.milliseconds <= 0 ? 1 : m_Results.front().milliseconds / cost.milliseconds;
+			for (size_t i = 0; i < out.size(); i++)
+				cost.maxError = std::max(cost.maxError, double(std::abs(out[i] - reference[i])));
+			m_Results.push_back(cost);
+		}
+
+	public:
+
+		void run(const SdfScene& scene, vec3 low, vec3 high, size_t points = 1 << 20, bool repetition = true, GLuint threads = 0) {
+			m_Results.clear();
+			m_Points = points;
+			threads = threads ? threads : std::max(std::thread::hardware_concurrency(), 1u);
+
+			SdfPoints samples;
+			samples.reserve(points);
+			std::mt19937 random(11);
+			std::uniform_real_distribution<GLfloat> x(low.x, high.x), y(low.y, high.y), z(low.z, high.z);
+			for (size_t i = 0; i < points; i++)
+				samples.push(vec3(x(random), y(random), z(random)));
+
+			SdfEvaluator tree(scene, repetition);
+			BytecodeEvaluator plain(scene, repetition, false);
+			BytecodeEvaluator fused(scene, repetition);
+			m_Instructions = fused.instructions();
+			m_LinkedInstructions = fused.linkedInstructions();
+
+			std::vector<GLfloat> reference(points), out(points);
+			measure("Tree walk", 1, reference, reference, [&]() {
+				for (size_t i = 0; i < points; i++)
+					reference[i] = tree.distance(vec3(samples.x[i], samples.y[i], samples.z[i]));
+			});
+			measure("Bytecode per point", 1, reference, out, [&]() {
+				for (size_t i = 0; i < points; i++)
+					out[i] = fused.distance(vec3(samples.x[i], samples.y[i], samples.z[i]));
+			});
+			measure("Bytecode batch", 1, reference, out, [&]() { plain.distances(samples, out.data(), 1); });
+			measure("Bytecode batch fused", 1, reference, out, [&]() { fused.distances(samples, out.data(), 1); });
+			measure("Bytecode batch fused", threads, reference, out, [&]() { fused.distances(samples, out.data(), threads); });
+		}
+
+		inline const std::vector<EvaluatorCost>& results() const { return m_Results; }
+		inline size_t points() const { return m_Points; }
+		inline size_t instructions() const { return m_Instructions; }
+		inline size_t linkedInstructions() const { return m_LinkedInstructions; }
+	};
+}
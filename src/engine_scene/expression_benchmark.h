@@ -0,0 +1,226 @@
+#pragma once
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include "sdf_scene.h"
+#include "sdf_evaluator.h"
+#include "sdf_expression.h"
+#include "bytecode_evaluator.h"
+
+namespace rtre {
+
+	/*
+	A scene as a tree of objects calling their operands through virtual functions, the usual object oriented
+	alternative to expression templates, here only as the benchmark's baseline
+	*/
+	class VirtualSdfNode {
+	public:
+		virtual ~VirtualSdfNode() = default;
+		virtual GLfloat distance(const vec3& position) const = 0;
+
+		/*
+		Builds the tree under node, always with repetition like sdf expressions
+		*/
+		static std::unique_ptr<VirtualSdfNode> build(const SdfScene& scene, GLint node);
+	};
+
+	namespace virtualsdf {
+
+		struct Sphere : VirtualSdfNode {
+			vec3 centre;
+			GLfloat radius;
+			GLfloat distance(const vec3& position) const override { return glm::length(position - centre) - radius; }
+		};
+
+		struct Box : VirtualSdfNode {
+			vec3 origin;
+			vec3 bound;
+			GLfloat distance(const vec3& position) const override {
+				vec3 d = glm::abs(position - origin) - bound;
+				return glm::min(glm::max(d.x, glm::max(d.y, d.z)), 0.0f) + glm::length(glm::max(d, 0.0f));
+			}
+		};
+
+		struct Binary : VirtualSdfNode {
+			std::unique_ptr<VirtualSdfNode> left;
+			std::unique_ptr<VirtualSdfNode> right;
+		};
+
+		struct Union : Binary {
+			GLfloat distance(const vec3& position) const override { return glm::min(left->distance(position), right->distance(position)); }
+		};
+
+		struct SmoothUnion : Binary {
+			GLfloat k;
+			GLfloat distance(const vec3& position) const override {
+				GLfloat a = left->distance(position), b = right->distance(position);
+				GLfloat h = glm::clamp(0.5f + 0.5f * (b - a) / k, 0.0f, 1.0f);
+				return glm::mix(b, a, h) - k * h * (1.0f - h);
+			}
+		};
+
+		struct Subtract : Binary {
+			GLfloat distance(const vec3& position) const override { return glm::max(left->distance(position), -right->distance(position)); }
+		};
+
+		struct Intersect : Binary {
+			GLfloat distance(const vec3& position) const override { return glm::max(left->distance(position), right->distance(position)); }
+		};
+
+		struct Repeat : VirtualSdfNode {
+			std::unique_ptr<VirtualSdfNode> child;
+			GLfloat period;
+			GLfloat distance(const vec3& position) const override { return child->distance(glm::mod(position, period)); }
+		};
+
+		struct Round : VirtualSdfNode {
+			std::unique_ptr<VirtualSdfNode> child;
+			GLfloat radius;
+			GLfloat distance(const vec3& position) const override { return child->distance(position) - radius; }
+		};
+	}
+
+	std::unique_ptr<VirtualSdfNode> VirtualSdfNode::build(const SdfScene& scene, GLint index) {
+		const SdfNode& node = scene.node(index);
+		auto binary = [&](std::unique_ptr<virtualsdf::Binary> result) {
+			result->left = build(scene, node.left);
+			result->right = build(scene, node.right);
+			return std::unique_ptr<VirtualSdfNode>(std::move(result));
+		};
+		switch (node.type) {
+		case rNsphere: {
+			auto result = std::make_unique<virtualsdf::Sphere>();
+			result->centre = vec3(node.params[0]);
+			result->radius = node.params[0].w;
+			return result;
+		}
+		case rNbox: {
+			auto result = std::make_unique<virtualsdf::Box>();
+			result->origin = vec3(node.params[0]);
+			result->bound = vec3(node.params[1]);
+			return result;
+		}
+		case rNunion:
+			return binary(std::make_unique<virtualsdf::Union>());
+		case rNsmoothUnion: {
+			auto result = std::make_unique<virtualsdf::SmoothUnion>();
+			result->k = node.params[0].x;
+			return binary(std::move(result));
+		}
+		case rNsubtract:
+			return binary(std::make_unique<virtualsdf::Subtract>());
+		case rNintersect:
+			return binary(std::make_unique<virtualsdf::Intersect>());
+		case rNrepeat: {
+			auto result = std::make_unique<virtualsdf::Repeat>();
+			result->child = build(scene, node.left);
+			result->period = node.params[0].x;
+			return result;
+		}
+		case rNround: {
+			auto result = std::make_unique<virtualsdf::Round>();
+			result->child = build(scene, node.left);
+			result->radius = node.params[0].x;
+			return result;
+		}
+		}
+		return nullptr;
+	}
+
+	/*
+	speedup is relative to the virtual tree, maxError is the largest difference from the expression over every point
+	*/
+	struct ExpressionCost {
+		std::string scene;
+		std::string path;
+		size_t nodes = 0;
+		double milliseconds = 0;
+		double pointsPerSecond = 0;
+		double speedup = 0;
+		double maxError = 0;
+	};
+
+	/*
+	Evaluates C++ scenes at the same random points
+		Virtual nodes			VirtualSdfNode tree built from the expression's SdfScene
+		Expression template		the expression called directly
+		Tree walk				SdfEvaluator on the expression's SdfScene
+		Bytecode batch			BytecodeEvaluator on the same scene, batched on one thread
+	Runs on the calling thread and blocks until every scene is done
+	*/
+	class ExpressionBenchmark {
+
+		std::vector<ExpressionCost> m_Results;
+
+		template<class Evaluate>
+		void measure(const std::string& scene, const char* path, size_t nodes, const std::vector<GLfloat>& reference, std::vector<GLfloat>& out, Evaluate evaluate) {
+			auto start = std::chrono::steady_clock::now();
+			evaluate();
+			ExpressionCost cost;
+			cost.scene = scene;
+			cost.path = path;
+			cost.nodes = nodes;
+			cost.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			cost.pointsPerSecond = cost.milliseconds > 0 ? out.size() / (cost.milliseconds / 1000) : 0;
+			const ExpressionCost* baseline = nullptr;
+			for (const auto& row : m_Results)
+				if (row.scene == scene && !baseline)
+					baseline = &row;
+			cost.speedup = baseline && cost.milliseconds > 0 ? baseline->milliseconds / cost.milliseconds : 1;
+			for (size_t i = 0; i < out.size(); i++)
+				cost.maxError = std::max(cost.maxError, double(std::abs(out[i] - reference[i])));
+			m_Results.push_back(cost);
+		}
+
+		template<class Shape>
+		void measureScene(const std::string& label, const Shape& shape, vec3 low, vec3 high, size_t points) {
+			SdfScene scene = sdf::toScene(shape);
+			SdfPoints samples;
+			samples.reserve(points);
+			std::mt19937 random(13);
+			std::uniform_real_distribution<GLfloat> x(low.x, high.x), y(low.y, high.y), z(low.z, high.z);
+			for (size_t i = 0; i < points; i++)
+				samples.push(vec3(x(random), y(random), z(random)));
+
+			std::vector<GLfloat> reference(points), out(points);
+			for (size_t i = 0; i < points; i++)
+				reference[i] = shape(vec3(samples.x[i], samples.y[i], samples.z[i]));
+
+			size_t nodes = scene.nodes().size();
+			std::unique_ptr<VirtualSdfNode> tree = VirtualSdfNode::build(scene, scene.root());
+			measure(label, "Virtual nodes", nodes, reference, out, [&]() {
+				for (size_t i = 0; i < points; i++)
+					out[i] = tree->distance(vec3(samples.x[i], samples.y[i], samples.z[i]));
+			});
+			measure(label, "Expression template", nodes, reference, out, [&]() {
+				for (size_t i = 0; i < points; i++)
+					out[i] = shape(vec3(samples.x[i], samples.y[i], samples.z[i]));
+			});
+			SdfEvaluator walker(scene);
+			measure(label, "Tree walk", nodes, reference, out, [&]() {
+				for (size_t i = 0; i < points; i++)
+					out[i] = walker.distance(vec3(samples.x[i], samples.y[i], samples.z[i]));
+			});
+			BytecodeEvaluator bytecode(scene);
+			measure(label, "Bytecode batch", nodes, reference, out, [&]() { bytecode.distances(samples, out.data(), 1); });
+		}
+
+	public:
+
+		/*
+		sdf::demo and sdf::pillars
+		*/
+		void run(vec3 low, vec3 high, size_t points = 1 << 20) {
+			m_Results.clear();
+			measureScene("Demo", sdf::demo(), low, high, points);
+
+			measureScene("Pillars", sdf::pillars(), low, high, points);
+		}
+
+		inline const std::vector<ExpressionCost>& results() const { return m_Results; }
+	};
+}
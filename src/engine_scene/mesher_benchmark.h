@@ -0,0 +1,24 @@
+#pragma once
+#include <vector>
+#include "sdf_mesher.h"
+
+namespace rtre {
+
+	/*
+	Meshes the same box at every depth in [firstDepth, lastDepth] with both methods
+	Reports throughput in cells per second and the memory held by cells and mesh at each resolution
+	Runs on the calling thread and blocks until every level is done
+	*/
+	std::vector<MeshingStats> benchmarkMeshing(const SdfEvaluator& evaluator, vec3 low, vec3 high, GLuint firstDepth, GLuint lastDepth, GLuint threads = 0) {
+		std::vector<MeshingStats> results;
+		SdfMesher mesher(evaluator, low, high, threads);
+		for (GLuint depth = firstDepth; depth <= lastDepth; depth++) {
+			mesher.setDepth(depth);
+			for (MeshingMethod method : { rMdualContouring, rMmarchingTetrahedra }) {
+				mesher.extract(method);
+				results.push_back(mesher.stats());
+			}
+		}
+		return results;
+	}
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <vector>
+#include <random>
+#include <thread>
+#include <algorithm>
+#include "bytecode_evaluator.h"
+#include "sdf_queries.h"
+
+namespace rtre {
+
+	/*
+	hits counts the rays and sweeps that hit, the spheres that overlap or the closest points within 0.01 of the surface
+	*/
+	struct QueryCost {
+		std::string query;
+		std::string path;
+		GLuint threads = 1;
+		size_t count = 0;
+		double milliseconds = 0;
+		double queriesPerSecond = 0;
+		size_t hits = 0;
+	};
+
+	/*
+	Runs the same random queries in a box one at a time, as a camera or a mouse click would, then as one batch on
+	every thread, for ray casts, sphere sweeps, closest points and overlaps
+	Runs on the calling thread and blocks until every query is done
+	*/
+	class QueryBenchmark {
+
+		std::vector<QueryCost> m_Results;
+
+		template<class Query, class Count>
+		void measure(const char* query, const char* path, GLuint threads, size_t count, Query run, Count hits) {
+			auto start = std::chrono::steady_clock::now();
+			run();
+			auto end = std::chrono::steady_clock::now();
+			QueryCost cost;
+			cost.query = query;
+			cost.path = path;
+			cost.threads = threads;
+			cost.count = count;
+			cost.milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+			cost.queriesPerSecond = cost.milliseconds > 0 ? count / (cost.milliseconds / 1000) : 0;
+			cost.hits = hits();
+			m_Results.push_back(cost);
+		}
+
+	public:
+
+		void run(const SdfScene& scene, vec3 low, vec3 high, size_t count = 4096, bool repetition = true, GLuint threads = 0) {
+			m_Results.clear();
+			threads = threads ? threads : std::max(std::thread::hardware_concurrency(), 1u);
+
+			std::mt19937 random(17);
+			std::uniform_real_distribution<GLfloat> x(low.x, high.x), y(low.y, high.y), z(low.z, high.z), unit(-1, 1), size(0.05f, 0.5f);
+			auto point = [&]() { return vec3(x(random), y(random), z(random)); };
+			auto direction = [&]() {
+				vec3 d(unit(random), unit(random), unit(random));
+				return glm::length(d) > 1e-3f ? d : vec3(0, 0, -1);
+			};
+			GLfloat reach = glm::length(high - low);
+
+			std::vector<SdfRay> rays(count);
+			std::vector<SdfSweep> sweeps(count);
+			std::vector<vec3> points(count), centres(count);
+			std::vector<GLfloat> radii(count);
+			for (size_t i = 0; i < count; i++) {
+				rays[i] = { point(), direction(), reach };
+				sweeps[i] = { point(), size(random), direction() * 2.0f };
+				points[i] = point();
+				centres[i] = point();
+				radii[i] = size(random);
+			}
+
+			BytecodeEvaluator evaluator(scene, repetition);
+			SdfQueries single(evaluator, 1e-3f, 128, 1);
+			SdfQueries batched(evaluator, 1e-3f, 128, threads);
+			std::vector<SdfHit> hits(count);
+			std::vector<vec3> closest(count);
+			std::vector<uint8_t> overlapping(count);
+			auto countHits = [&]() { return size_t(std::count_if(hits.begin(), hits.end(), [](const SdfHit& hit) { return hit.hit; })); };
+			auto countClosest = [&]() {
+				size_t on = 0;
+				for (const vec3& p : closest)
+					on += std::abs(evaluator.distance(p)) < 1e-2f;
+				return on;
+			};
+			auto countOverlaps = [&]() { return size_t(std::count(overlapping.begin(), overlapping.end(), 1)); };
+
+			measure("Ray cast", "One at a time", 1, count, [&]() {
+				for (size_t i = 0; i < count; i++)
+					hits[i] = single.rayCast(rays[i]);
+			}, countHits);
+			measure("Ray cast", "Batched", threads, count, [&]() { batched.rayCasts(rays, hits); }, countHits);
+
+			measure("Sphere sweep", "One at a time", 1, count, [&]() {
+				for (size_t i = 0; i < count; i++)
+					hits[i] = single.sweep(sweeps[i]);
+			}, countHits);
+			measure("Sphere sweep", "Batched", threads, count, [&]() { batched.sweeps(sweeps, hits); }, countHits);
+
+			measure("Closest point", "One at a time", 1, count, [&]() {
+				for (size_t i = 0; i < count; i++)
+					closest[i] = single.closestPoint(points[i]);
+			}, countClosest);
+			measure("Closest point", "Batched", threads, count, [&]() { batched.closestPoints(points, closest); }, countClosest);
+
+			measure("Overlap", "One at a time", 1, count, [&]() {
+				for (size_t i = 0; i < count; i++)
+					overlapping[i] = single.overlap(centres[i], radii[i]);
+			}, countOverlaps);
+			measure("Overlap", "Batched", threads, count, [&]() { batched.overlaps(centres, radii, overlapping); }, countOverlaps);
+		}
+
+		inline const std::vector<QueryCost>& results() const { return m_Results; }
+	};
+}
@@ -0,0 +1,183 @@
+#pragma once
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include "sdf_scene.h"
+
+namespace rtre {
+
+	/*
+	Emits an SdfScene as GLSL:
+		float map(vec3 p)			distance to the scene
+		vec4 mapGradient(vec3 p)	vec4(distance, gradient), analytic, built from sdgSphere/sdgBox
+									and the gradient forms of the operators
+		vec2 mapMaterial(vec3 p)	vec2(distance, material index), the material of the closest operand wins
+	Repeat nodes are only applied when FEATURE_DOMAIN_REPETITION is defined, and the functions are left out under
+	FEATURE_SCENE_INTERPRETER where sdf/interpreter.glsl runs the scene's bytecode instead
+	Params are baked in as literals, or with a parameter buffer read from sceneParams, two vec4 per node after base:
+		sceneParams[base + 2n]		params[0]
+		sceneParams[base + 2n + 1]	params[1].xyz, material index
+	so param edits only need SceneParamBuffer to patch the buffer, the code changes with the structure alone
+	*/
+	class SceneCodegen {
+
+		const SdfScene& m_Scene;
+		std::string m_Code;
+		GLuint m_Next = 0;
+		bool m_ParameterBuffer;
+		GLuint m_ParamBase;
+
+		static std::string number(GLfloat value) {
+			std::ostringstream out;
+			out << std::setprecision(9) << value;
+			std::string text = out.str();
+			if (text.find_first_of(".einf") == std::string::npos)
+				text += ".0";
+			return text;
+		}
+
+		static std::string vector(const vec4& value) {
+			return "vec3(" + number(value.x) + ", " + number(value.y) + ", " + number(value.z) + ")";
+		}
+
+		/*
+		Component of a node's params, slot 0 or 1, as a literal or a buffer read
+		*/
+		std::string param(GLint index, int slot, int component) {
+			if (m_ParameterBuffer)
+				return "sceneParams[" + std::to_string(m_ParamBase + 2 * index + slot) + "]." + "xyzw"[component];
+			return number(m_Scene.node(index).params[slot][component]);
+		}
+
+		std::string param3(GLint index, int slot) {
+			if (m_ParameterBuffer)
+				return "sceneParams[" + std::to_string(m_ParamBase + 2 * index + slot) + "].xyz";
+			return vector(m_Scene.node(index).params[slot]);
+		}
+
+		std::string material(GLint index) {
+			if (m_ParameterBuffer)
+				return "sceneParams[" + std::to_string(m_ParamBase + 2 * index + 1) + "].w";
+			return number(GLfloat(m_Scene.node(index).material));
+		}
+
+		std::string declare(const char* type, const std::string& expression) {
+			std::string name = "d" + std::to_string(m_Next++);
+			m_Code += "\t" + std::string(type) + " " + name + " = " + expression + ";\n";
+			return name;
+		}
+
+		/*
+		Generated functions, each node is emitted once per form
+		*/
+		enum Form {
+			rGdistance,
+			rGgradient,
+			rGmaterial
+		};
+
+		std::string emit(GLint index, const std::string& position, Form form) {
+			const SdfNode& node = m_Scene.node(index);
+			static const char* s_Types[] = { "float", "vec4", "vec2" };
+			const char* type = s_Types[form];
+
+			switch (node.type) {
+			case rNsphere: {
+				std::string distance = std::string(form == rGgradient ? "sdgSphere(" : "sdSphere(") + position + ", " + param3(index, 0) + ", " + param(index, 0, 3) + ")";
+				return declare(type, form == rGmaterial ? "vec2(" + distance + ", " + material(index) + ")" : distance);
+			}
+			case rNbox: {
+				std::string distance = std::string(form == rGgradient ? "sdgBox(" : "sdBox(") + position + ", " + param3(index, 0) + ", " + param3(index, 1) + ")";
+				return declare(type, form == rGmaterial ? "vec2(" + distance + ", " + material(index) + ")" : distance);
+			}
+			case rNunion: {
+				std::string a = emit(node.left, position, form);
+				std::string b = emit(node.right, position, form);
+				return declare(type, pick(form, "min(", "minGrad(", "minMat(") + a + ", " + b + ")");
+			}
+			case rNsmoothUnion: {
+				std::string a = emit(node.left, position, form);
+				std::string b = emit(node.right, position, form);
+				return declare(type, pick(form, "smin(", "sminGrad(", "sminMat(") + a + ", " + b + ", " + param(index, 0, 0) + ")");
+			}
+			case rNsubtract: {
+				std::string a = emit(node.left, position, form);
+				std::string b = emit(node.right, position, form);
+				// The carved surface takes the material of the subtracted shape
+				if (form == rGmaterial)
+					return declare(type, "maxMat(" + a + ", vec2(-" + b + ".x, " + b + ".y))");
+				return declare(type, pick(form, "max(", "maxGrad(", "") + a + ", -" + b + ")");
+			}
+			case rNintersect: {
+				std::string a = emit(node.left, position, form);
+				std::string b = emit(node.right, position, form);
+				return declare(type, pick(form, "max(", "maxGrad(", "maxMat(") + a + ", " + b + ")");
+			}
+			case rNrepeat: {
+				std::string cell = "p" + std::to_string(m_Next++);
+				m_Code += "#ifdef FEATURE_DOMAIN_REPETITION\n";
+				m_Code += "\tvec3 " + cell + " = mod(" + position + ", " + param(index, 0, 0) + ");\n";
+				m_Code += "#else\n";
+				m_Code += "\tvec3 " + cell + " = " + position + ";\n";
+				m_Code += "#endif\n";
+				return emit(node.left, cell, form);
+			}
+			case rNround: {
+				std::string a = emit(node.left, position, form);
+				if (form == rGgradient)
+					return declare(type, "vec4(" + a + ".x - " + param(index, 0, 0) + ", " + a + ".yzw)");
+				if (form == rGmaterial)
+					return declare(type, "vec2(" + a + ".x - " + param(index, 0, 0) + ", " + a + ".y)");
+				return declare(type, a + " - " + param(index, 0, 0));
+			}
+			}
+			return declare(type, empty(form));
+		}
+
+		static std::string empty(Form form) {
+			return pick(form, "1e10", "vec4(1e10, 0.0, 1.0, 0.0)", "vec2(1e10, -1.0)");
+		}
+
+		// Spelling of an operator in each form
+		static std::string pick(Form form, const char* distance, const char* gradient, const char* material) {
+			return std::string(form == rGdistance ? distance : form == rGgradient ? gradient : material);
+		}
+
+		void function(const char* signature, Form form) {
+			m_Code += signature;
+			m_Code += " {\n";
+			if (m_Scene.empty())
+				m_Code += "\treturn " + empty(form) + ";\n";
+			else
+				m_Code += "\treturn " + emit(m_Scene.root(), "p", form) + ";\n";
+			m_Code += "}\n\n";
+		}
+
+	public:
+
+		/*
+		parameterBuffer reads params from the buffer SceneParamBuffer binds at binding 4 instead of baking them in,
+		paramBase is SceneParamBuffer::base() for the scene's current structure
+		*/
+		SceneCodegen(const SdfScene& scene, bool parameterBuffer = false, GLuint paramBase = 0)
+			:
+			m_Scene(scene),
+			m_ParameterBuffer(parameterBuffer),
+			m_ParamBase(paramBase)
+		{
+		}
+
+		std::string generate() {
+			m_Code = "// Generated from the scene description, edits are overwritten\n\n";
+			if (m_ParameterBuffer)
+				m_Code += "layout(std430, binding = 4) readonly buffer SceneParams {\n\tvec4 sceneParams[];\n};\n\n";
+			m_Next = 0;
+			m_Code += "#ifndef FEATURE_SCENE_INTERPRETER\n";
+			function("float map(vec3 p)", rGdistance);
+			function("vec4 mapGradient(vec3 p)", rGgradient);
+			function("vec2 mapMaterial(vec3 p)", rGmaterial);
+			m_Code += "#endif\n";
+			return m_Code;
+		}
+	};
+}
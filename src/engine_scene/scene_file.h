@@ -0,0 +1,306 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <unordered_map>
+#include "../engine_system/span.h"
+#include "../engine_system/mapped_file.h"
+#include "sdf_scene.h"
+#include "scene_json.h"
+
+namespace rtre {
+
+	/*
+	Layout of a binary scene file, little endian
+		SceneFileHeader
+		SceneFileNode		nodeCount records, post-order from the root, so every operand precedes its operator
+		SceneFileMaterial	materialCount records
+		string table		names, each terminated by a zero byte
+	Every section starts at a multiple of sceneFileAlignment, records are used in place from the mapped file
+	Nodes unreachable from the root follow the root's tree, still in post-order
+	*/
+	static const char sceneFileMagic[4] = { 'R', 'S', 'C', 'N' };
+	static const uint32_t sceneFileVersion = 1;
+	static const uint64_t sceneFileAlignment = 16;
+	static const uint32_t sceneFileNoName = 0xffffffffu;
+
+	struct SceneFileHeader {
+		char magic[4];
+		uint32_t version;
+		uint32_t nodeCount;
+		uint32_t materialCount;
+		int32_t root;
+		uint32_t stringBytes;
+		uint64_t nodesOffset;
+		uint64_t materialsOffset;
+		uint64_t stringsOffset;
+	};
+
+	/*
+	params as in SdfNode, name is an offset into the string table or sceneFileNoName
+	*/
+	struct SceneFileNode {
+		uint32_t type;
+		int32_t left;
+		int32_t right;
+		int32_t material;
+		float params[8];
+		uint32_t name;
+		uint32_t reserved[3];
+	};
+
+	struct SceneFileMaterial {
+		float albedo[3];
+		int32_t texture;
+		float scale;
+		uint32_t name;
+	};
+
+	/*
+	Writes scene as a binary scene file, nodes are reordered into post-order and operands remapped
+	*/
+	void writeSceneFile(const SdfScene& scene, const std::string& path) {
+		const auto& nodes = scene.nodes();
+		std::vector<GLint> order;
+		std::vector<GLint> remap(nodes.size(), -1);
+		order.reserve(nodes.size());
+
+		// Iterative so long operator chains don't exhaust the stack, an entry is emitted once its operands are
+		std::vector<std::pair<GLint, bool>> stack;
+		auto visit = [&](GLint start) {
+			stack.push_back({ start, false });
+			while (!stack.empty()) {
+				auto [index, expanded] = stack.back();
+				stack.pop_back();
+				if (remap[index] >= 0)
+					continue;
+				if (expanded) {
+					remap[index] = GLint(order.size());
+					order.push_back(index);
+					continue;
+				}
+				const SdfNode& node = nodes[index];
+				stack.push_back({ index, true });
+				if (!node.isPrimitive() && !node.isUnary() && remap[node.right] < 0)
+					stack.push_back({ node.right, false });
+				if (!node.isPrimitive() && remap[node.left] < 0)
+					stack.push_back({ node.left, false });
+			}
+		};
+		if (!scene.empty())
+			visit(scene.root());
+		for (GLint i = 0; i < GLint(nodes.size()); i++)
+			visit(i);
+
+		std::string strings;
+		std::unordered_map<std::string, uint32_t> interned;
+		auto intern = [&](const std::string& name) {
+			if (name.empty())
+				return sceneFileNoName;
+			auto found = interned.find(name);
+			if (found != interned.end())
+				return found->second;
+			uint32_t offset = uint32_t(strings.size());
+			strings.append(name);
+			strings.push_back('\0');
+			interned.emplace(name, offset);
+			return offset;
+		};
+
+		std::vector<SceneFileNode> records(order.size());
+		for (size_t i = 0; i < order.size(); i++) {
+			const SdfNode& node = nodes[order[i]];
+			SceneFileNode& record = records[i];
+			std::memset(&record, 0, sizeof(record));
+			record.type = node.type;
+			record.left = node.left >= 0 ? remap[node.left] : -1;
+			record.right = node.right >= 0 ? remap[node.right] : -1;
+			record.material = node.material;
+			for (int p = 0; p < 8; p++)
+				record.params[p] = node.params[p / 4][p % 4];
+			record.name = intern(node.name);
+		}
+
+		std::vector<SceneFileMaterial> materials(scene.materials().size());
+		for (size_t i = 0; i < materials.size(); i++) {
+			const SdfMaterial& material = scene.materials()[i];
+			for (int c = 0; c < 3; c++)
+				materials[i].albedo[c] = material.albedo[c];
+			materials[i].texture = material.texture;
+			materials[i].scale = material.scale;
+			materials[i].name = intern(material.name);
+		}
+
+		auto align = [](uint64_t offset) { return (offset + sceneFileAlignment - 1) / sceneFileAlignment * sceneFileAlignment; };
+		SceneFileHeader header;
+		std::memcpy(header.magic, sceneFileMagic, 4);
+		header.version = sceneFileVersion;
+		header.nodeCount = uint32_t(records.size());
+		header.materialCount = uint32_t(materials.size());
+		header.root = scene.empty() ? -1 : remap[scene.root()];
+		header.stringBytes = uint32_t(strings.size());
+		header.nodesOffset = align(sizeof(SceneFileHeader));
+		header.materialsOffset = align(header.nodesOffset + records.size() * sizeof(SceneFileNode));
+		header.stringsOffset = align(header.materialsOffset + materials.size() * sizeof(SceneFileMaterial));
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file) {
+			std::string message = "Could not open " + path + " for writing\n";
+			throw std::exception(message.c_str());
+		}
+		const char padding[sceneFileAlignment] = {};
+		auto section = [&](uint64_t offset, const void* data, size_t size) {
+			file.write(padding, std::streamsize(offset - uint64_t(file.tellp())));
+			file.write(static_cast<const char*>(data), size);
+		};
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		section(header.nodesOffset, records.data(), records.size() * sizeof(SceneFileNode));
+		section(header.materialsOffset, materials.data(), materials.size() * sizeof(SceneFileMaterial));
+		section(header.stringsOffset, strings.data(), strings.size());
+	}
+
+	/*
+	Converts a JSON scene description into a binary scene file
+	*/
+	void convertSceneJson(const std::string& source, const std::string& destination) {
+		writeSceneFile(loadSceneJson(source), destination);
+	}
+
+	/*
+	A binary scene file mapped and used in place, records are views into the mapping and nothing is allocated per node
+	The whole file is validated when opened, so operands, materials and names can be used unchecked afterwards
+	*/
+	class SceneFile {
+
+		MappedFile m_File;
+		const SceneFileHeader* m_Header = nullptr;
+		Span<const SceneFileNode> m_Nodes;
+		Span<const SceneFileMaterial> m_Materials;
+		const char* m_Strings = nullptr;
+
+		void fail(const std::string& path, const std::string& reason) {
+			std::string exceptionMessage = "Invalid scene file " + path + ": " + reason;
+			throw std::exception(exceptionMessage.c_str());
+		}
+
+		bool validName(uint32_t name) const {
+			return name == sceneFileNoName || name < m_Header->stringBytes;
+		}
+
+		void validate(const std::string& path) {
+			uint64_t size = m_File.size();
+			if (size < sizeof(SceneFileHeader))
+				fail(path, "truncated header");
+			m_Header = reinterpret_cast<const SceneFileHeader*>(m_File.data());
+			if (std::memcmp(m_Header->magic, sceneFileMagic, 4) != 0)
+				fail(path, "not a scene file");
+			if (m_Header->version != sceneFileVersion)
+				fail(path, "unsupported version " + std::to_string(m_Header->version));
+
+			auto fits = [&](uint64_t offset, uint64_t bytes) { return offset % sceneFileAlignment == 0 && offset <= size && bytes <= size - offset; };
+			if (!fits(m_Header->nodesOffset, uint64_t(m_Header->nodeCount) * sizeof(SceneFileNode))
+				|| !fits(m_Header->materialsOffset, uint64_t(m_Header->materialCount) * sizeof(SceneFileMaterial))
+				|| !fits(m_Header->stringsOffset, m_Header->stringBytes))
+				fail(path, "section outside the file");
+
+			m_Nodes = Span<const SceneFileNode>(reinterpret_cast<const SceneFileNode*>(m_File.data() + m_Header->nodesOffset), m_Header->nodeCount);
+			m_Materials = Span<const SceneFileMaterial>(reinterpret_cast<const SceneFileMaterial*>(m_File.data() + m_Header->materialsOffset), m_Header->materialCount);
+			m_Strings = reinterpret_cast<const char*>(m_File.data() + m_Header->stringsOffset);
+			if (m_Header->stringBytes && m_Strings[m_Header->stringBytes - 1] != '\0')
+				fail(path, "unterminated string table");
+			if (m_Header->root >= GLint(m_Header->nodeCount) || (m_Header->root < 0 && m_Header->root != -1))
+				fail(path, "root is not a node");
+
+			for (uint32_t i = 0; i < m_Header->nodeCount; i++) {
+				const SceneFileNode& node = m_Nodes[i];
+				if (node.type > rNround)
+					fail(path, "node " + std::to_string(i) + " has an unknown type");
+				bool primitive = node.type == rNsphere || node.type == rNbox;
+				bool unary = node.type == rNrepeat || node.type == rNround;
+				if (!primitive && (node.left < 0 || uint32_t(node.left) >= i))
+					fail(path, "node " + std::to_string(i) + " has an invalid left operand");
+				if (!primitive && !unary && (node.right < 0 || uint32_t(node.right) >= i))
+					fail(path, "node " + std::to_string(i) + " has an invalid right operand");
+				if (node.material >= GLint(m_Header->materialCount) || !validName(node.name))
+					fail(path, "node " + std::to_string(i) + " has an invalid material or name");
+			}
+			for (uint32_t i = 0; i < m_Header->materialCount; i++)
+				if (!validName(m_Materials[i].name))
+					fail(path, "material " + std::to_string(i) + " has an invalid name");
+		}
+
+	public:
+
+		explicit SceneFile(const std::string& path)
+			:
+			m_File(path)
+		{
+			validate(path);
+		}
+
+		SceneFile(const SceneFile&) = delete;
+		SceneFile& operator=(const SceneFile&) = delete;
+
+		/*
+		Empty string for unnamed records
+		*/
+		inline const char* name(uint32_t offset) const { return offset == sceneFileNoName ? "" : m_Strings + offset; }
+
+		inline Span<const SceneFileNode> nodes() const { return m_Nodes; }
+		inline Span<const SceneFileMaterial> materials() const { return m_Materials; }
+		inline GLint root() const { return m_Header->root; }
+		inline uint64_t bytes() const { return m_File.size(); }
+
+		/*
+		Copies the records into an SdfScene for the code that edits scenes
+		*/
+		SdfScene scene() const {
+			SdfScene scene;
+			scene.reserve(m_Nodes.size(), m_Materials.size());
+			for (const auto& record : m_Materials) {
+				SdfMaterial material;
+				material.albedo = vec3(record.albedo[0], record.albedo[1], record.albedo[2]);
+				material.texture = record.texture;
+				material.scale = record.scale;
+				material.name = name(record.name);
+				scene.material(material);
+			}
+			for (const auto& record : m_Nodes) {
+				SdfNode node;
+				node.type = SdfType(record.type);
+				node.left = record.left;
+				node.right = record.right;
+				node.material = record.material;
+				for (int p = 0; p < 8; p++)
+					node.params[p / 4][p % 4] = record.params[p];
+				node.name = name(record.name);
+				scene.add(std::move(node));
+			}
+			scene.setRoot(root());
+			return scene;
+		}
+	};
+
+	/*
+	Loads a binary scene into an SdfScene, timing the whole load into stats
+	*/
+	SdfScene loadSceneFile(const std::string& path, SceneLoadStats* stats = nullptr) {
+		auto start = std::chrono::steady_clock::now();
+		SceneFile file(path);
+		SdfScene scene = file.scene();
+
+		if (stats) {
+			stats->path = path;
+			stats->bytes = file.bytes();
+			stats->nodes = scene.nodes().size();
+			stats->materials = scene.materials().size();
+			stats->milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			stats->megabytesPerSecond = stats->milliseconds > 0 ? stats->bytes / 1048576.0 / (stats->milliseconds / 1000) : 0;
+		}
+		return scene;
+	}
+}
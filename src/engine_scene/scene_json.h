@@ -0,0 +1,370 @@
+#pragma once
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include "json/json.h"
+#include "../engine_system/mapped_file.h"
+#include "sdf_scene.h"
+
+namespace rtre {
+
+	/*
+	JSON scene files mirror SdfScene's flat storage, operands are indices of earlier nodes
+	{
+		"version": 1,
+		"materials": [ { "name": "Sphere", "albedo": [1, 1, 1], "texture": 0, "scale": 4 } ],
+		"nodes": [
+			{ "type": "sphere", "name": "Sphere", "params": [3, 3, 3, 0.1], "material": 0 },
+			{ "type": "box", "params": [2, 2.9, 3, 0, 0.5, 0.5, 0.5, 0] },
+			{ "type": "smoothUnion", "left": 0, "right": 1, "params": [1.5] }
+		],
+		"root": 2
+	}
+	params fills SdfNode::params in order, missing values stay 0, unknown keys are skipped
+	*/
+	static const int sceneJsonVersion = 1;
+
+	inline const char* sdfTypeName(SdfType type) {
+		static const char* s_Names[] = { "sphere", "box", "union", "smoothUnion", "subtract", "intersect", "repeat", "round" };
+		return s_Names[type];
+	}
+
+	inline bool parseSdfType(const std::string& name, SdfType& type) {
+		for (int i = rNsphere; i <= rNround; i++)
+			if (name == sdfTypeName(SdfType(i))) {
+				type = SdfType(i);
+				return true;
+			}
+		return false;
+	}
+
+	/*
+	Writes text as a quoted JSON string, names come back from loaded files with any character the reader decoded
+	*/
+	inline void writeJsonString(std::ostream& out, const std::string& text) {
+		static const char s_Hex[] = "0123456789abcdef";
+		out << '"';
+		for (char c : text) {
+			switch (c) {
+			case '"': out << "\\\""; break;
+			case '\\': out << "\\\\"; break;
+			case '\b': out << "\\b"; break;
+			case '\f': out << "\\f"; break;
+			case '\n': out << "\\n"; break;
+			case '\r': out << "\\r"; break;
+			case '\t': out << "\\t"; break;
+			default:
+				// Bytes of multibyte UTF-8 sequences pass through, only control characters need \u escapes
+				if (static_cast<unsigned char>(c) < 0x20)
+					out << "\\u00" << s_Hex[c >> 4] << s_Hex[c & 15];
+				else
+					out << c;
+			}
+		}
+		out << '"';
+	}
+
+	/*
+	Streams the scene out without building a document first
+	*/
+	void writeSceneJson(const SdfScene& scene, const std::string& path) {
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		if (!out) {
+			std::string message = "Could not open " + path + " for writing\n";
+			throw std::exception(message.c_str());
+		}
+
+		out << std::setprecision(9);
+		out << "{\n\t\"version\": " << sceneJsonVersion << ",\n\t\"materials\": [";
+		const auto& materials = scene.materials();
+		for (size_t i = 0; i < materials.size(); i++) {
+			const SdfMaterial& material = materials[i];
+			out << (i ? ",\n\t\t" : "\n\t\t") << "{ \"name\": ";
+			writeJsonString(out, material.name);
+			out << ", \"albedo\": ["
+				<< material.albedo.x << ", " << material.albedo.y << ", " << material.albedo.z << "], \"texture\": "
+				<< material.texture << ", \"scale\": " << material.scale << " }";
+		}
+		out << "\n\t],\n\t\"nodes\": [";
+
+		const auto& nodes = scene.nodes();
+		for (size_t i = 0; i < nodes.size(); i++) {
+			const SdfNode& node = nodes[i];
+			out << (i ? ",\n\t\t" : "\n\t\t") << "{ \"type\": \"" << sdfTypeName(node.type) << "\"";
+			if (!node.name.empty()) {
+				out << ", \"name\": ";
+				writeJsonString(out, node.name);
+			}
+			if (node.isPrimitive()) {
+				int count = node.type == rNbox ? 8 : 4;
+				out << ", \"params\": [";
+				for (int p = 0; p < count; p++)
+					out << (p ? ", " : "") << node.params[p / 4][p % 4];
+				out << "]";
+				if (node.material >= 0)
+					out << ", \"material\": " << node.material;
+			}
+			else {
+				out << ", \"left\": " << node.left;
+				if (!node.isUnary())
+					out << ", \"right\": " << node.right;
+				if (node.type != rNunion && node.type != rNsubtract && node.type != rNintersect)
+					out << ", \"params\": [" << node.params[0].x << "]";
+			}
+			out << " }";
+		}
+		out << "\n\t],\n\t\"root\": " << scene.root() << "\n}\n";
+	}
+
+	struct SceneLoadStats {
+		std::string path;
+		uint64_t bytes = 0;
+		size_t nodes = 0;
+		size_t materials = 0;
+		double milliseconds = 0;
+		double megabytesPerSecond = 0;
+	};
+
+	/*
+	SAX handler building the scene as the parser walks the file, no document is built
+	Only the element being read is held besides the scene itself, so memory stays bounded by the scene and not the file
+	Nodes and operand indices are validated as they complete
+	*/
+	class SceneJsonReader : public nlohmann::json_sax<nlohmann::json> {
+
+		enum Section {
+			rSnone,
+			rSmaterials,
+			rSnodes
+		};
+
+		SdfScene& m_Scene;
+		Section m_Section = rSnone;
+		std::string m_Key;
+		std::string m_Error;
+		// Objects and arrays currently open, the document itself is depth 1
+		int m_Depth = 0;
+		// Depth of an unknown value being skipped, 0 when nothing is skipped
+		int m_Skip = 0;
+		// Index into the array value of the current key, -1 outside of one
+		int m_Element = -1;
+		GLint m_Root = -1;
+		bool m_HasRoot = false;
+
+		SdfNode m_Node;
+		SdfMaterial m_Material;
+		// Index of the first node read, for nodes read out of a larger scene
+		GLint m_FirstNode;
+
+		bool fail(const std::string& message) {
+			m_Error = message;
+			return false;
+		}
+
+		/*
+		Depth 2 is a section array, 3 an element of it, 4 an array inside an element
+		*/
+		inline bool inElement() const { return m_Section != rSnone && m_Depth >= 3; }
+
+		bool value(double v) {
+			if (m_Skip)
+				return true;
+
+			if (m_Depth == 1) {
+				if (m_Key == "root") {
+					m_Root = GLint(v);
+					m_HasRoot = true;
+				}
+				else if (m_Key == "version" && int(v) != sceneJsonVersion)
+					return fail("Unsupported scene version " + std::to_string(int(v)));
+				return true;
+			}
+			if (!inElement())
+				return true;
+
+			if (m_Section == rSnodes) {
+				if (m_Key == "params" && m_Element >= 0) {
+					if (m_Element >= 8)
+						return fail("Too many params");
+					m_Node.params[m_Element / 4][m_Element % 4] = GLfloat(v);
+					m_Element++;
+				}
+				else if (m_Key == "left")
+					m_Node.left = GLint(v);
+				else if (m_Key == "right")
+					m_Node.right = GLint(v);
+				else if (m_Key == "material")
+					m_Node.material = GLint(v);
+			}
+			else {
+				if (m_Key == "albedo" && m_Element >= 0) {
+					if (m_Element >= 3)
+						return fail("Albedo has more than three channels");
+					m_Material.albedo[m_Element++] = GLfloat(v);
+				}
+				else if (m_Key == "texture")
+					m_Material.texture = GLint(v);
+				else if (m_Key == "scale")
+					m_Material.scale = GLfloat(v);
+			}
+			return true;
+		}
+
+		bool finishNode() {
+			GLint index = m_FirstNode + GLint(m_Scene.nodes().size());
+			if (!m_Node.isPrimitive()) {
+				if (m_Node.left < 0 || m_Node.left >= index)
+					return fail("Node " + std::to_string(index) + " has an invalid left operand");
+				if (!m_Node.isUnary() && (m_Node.right < 0 || m_Node.right >= index))
+					return fail("Node " + std::to_string(index) + " has an invalid right operand");
+			}
+			m_Scene.add(std::move(m_Node));
+			m_Node = SdfNode();
+			return true;
+		}
+
+	public:
+
+		/*
+		firstNode is the index the first node read will have, operands are checked against it
+		*/
+		SceneJsonReader(SdfScene& scene, GLint firstNode = 0)
+			:
+			m_Scene(scene),
+			m_FirstNode(firstNode)
+		{
+		}
+
+		bool null() override { return true; }
+		bool boolean(bool) override { return true; }
+		bool number_integer(number_integer_t v) override { return value(double(v)); }
+		bool number_unsigned(number_unsigned_t v) override { return value(double(v)); }
+		bool number_float(number_float_t v, const string_t&) override { return value(v); }
+		bool binary(binary_t&) override { return true; }
+
+		bool string(string_t& v) override {
+			if (m_Skip || !inElement())
+				return true;
+			if (m_Key == "name")
+				(m_Section == rSnodes ? m_Node.name : m_Material.name) = v;
+			else if (m_Key == "type" && m_Section == rSnodes && !parseSdfType(v, m_Node.type))
+				return fail("Unknown node type " + v);
+			return true;
+		}
+
+		bool key(string_t& v) override {
+			if (!m_Skip)
+				m_Key = v;
+			return true;
+		}
+
+		bool start_object(std::size_t) override {
+			m_Depth++;
+			if (m_Skip)
+				return true;
+			if (m_Depth == 3 && m_Section != rSnone)
+				return true;
+			if (m_Depth != 1)
+				m_Skip = m_Depth;
+			return true;
+		}
+
+		bool end_object() override {
+			if (m_Skip == m_Depth)
+				m_Skip = 0;
+			else if (!m_Skip && m_Depth == 3) {
+				if (m_Section == rSnodes && !finishNode())
+					return false;
+				if (m_Section == rSmaterials) {
+					m_Scene.material(m_Material);
+					m_Material = SdfMaterial();
+				}
+			}
+			m_Depth--;
+			return true;
+		}
+
+		bool start_array(std::size_t) override {
+			m_Depth++;
+			if (m_Skip)
+				return true;
+			if (m_Depth == 2 && (m_Key == "materials" || m_Key == "nodes"))
+				m_Section = m_Key == "nodes" ? rSnodes : rSmaterials;
+			else if (m_Depth == 4 && m_Section != rSnone)
+				m_Element = 0;
+			else
+				m_Skip = m_Depth;
+			return true;
+		}
+
+		bool end_array() override {
+			if (m_Skip == m_Depth)
+				m_Skip = 0;
+			else if (!m_Skip && m_Depth == 2)
+				m_Section = rSnone;
+			else if (!m_Skip && m_Depth == 4)
+				m_Element = -1;
+			m_Depth--;
+			return true;
+		}
+
+		bool parse_error(std::size_t position, const std::string&, const nlohmann::detail::exception& e) override {
+			return fail("At byte " + std::to_string(position) + ": " + e.what());
+		}
+
+		/*
+		Called once the parser is done, checks what can only be known at the end
+		*/
+		bool finish() {
+			if (!m_Error.empty())
+				return false;
+			GLint count = GLint(m_Scene.nodes().size());
+			if (m_HasRoot && m_Root >= count)
+				return fail("Root " + std::to_string(m_Root) + " is not a node");
+			if (m_HasRoot)
+				m_Scene.setRoot(m_Root);
+			for (const auto& node : m_Scene.nodes())
+				if (node.material >= GLint(m_Scene.materials().size()))
+					return fail("Node " + node.name + " uses a missing material");
+			return true;
+		}
+
+		inline const std::string& error() const { return m_Error; }
+	};
+
+	/*
+	Parses a scene from memory, throws with the position of the first error
+	*/
+	SdfScene parseSceneJson(const char* begin, const char* end, const std::string& source = "scene") {
+		SdfScene scene;
+		SceneJsonReader reader(scene);
+		bool parsed = nlohmann::json::sax_parse(begin, end, &reader);
+		if (!parsed || !reader.finish()) {
+			std::string exceptionMessage = "Failed to load " + source + ": " + reader.error();
+			throw std::exception(exceptionMessage.c_str());
+		}
+		return scene;
+	}
+
+	/*
+	Maps the file and parses it in place, pages are read in by the OS as the parser reaches them
+	*/
+	SdfScene loadSceneJson(const std::string& path, SceneLoadStats* stats = nullptr) {
+		auto start = std::chrono::steady_clock::now();
+		MappedFile file(path);
+		const char* data = reinterpret_cast<const char*>(file.data());
+		SdfScene scene = parseSceneJson(data, data + file.size(), path);
+
+		if (stats) {
+			stats->path = path;
+			stats->bytes = file.size();
+			stats->nodes = scene.nodes().size();
+			stats->materials = scene.materials().size();
+			stats->milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			stats->megabytesPerSecond = stats->milliseconds > 0 ? stats->bytes / 1048576.0 / (stats->milliseconds / 1000) : 0;
+		}
+		return scene;
+	}
+}
@@ -0,0 +1,151 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <vector>
+#include <random>
+#include <filesystem>
+#include "json/json.h"
+#include "../engine_abstractions/shader.h"
+#include "../engine_system/allocation_counter.h"
+#include "scene_json.h"
+#include "scene_file.h"
+
+namespace rtre {
+
+	struct SceneLoadCost {
+		std::string path;
+		size_t primitives = 0;
+		uint64_t bytes = 0;
+		double milliseconds = 0;
+		double megabytesPerSecond = 0;
+		uint64_t allocations = 0;
+		bool allocationsCounted = false;
+	};
+
+	/*
+	Compares ways of loading the same large scene, at each size
+		JSON DOM			get_file_contents into a string, json::parse into a document, then the document walked into a scene,
+							only below domLimit primitives since the document takes several times the file's size
+		JSON SAX			the file mapped and parsed straight into the scene by SceneJsonReader
+		Binary to scene		the binary file mapped, validated and copied into an SdfScene
+		Binary in place		the binary file mapped and validated, records used where they are
+	MB/s is relative to each format's own file size, allocations are only counted in builds with RTRE_COUNT_ALLOCATIONS and include the scene's own
+	*/
+	class SceneLoadBenchmark {
+
+		std::vector<SceneLoadCost> m_Results;
+
+		/*
+		load returns the number of nodes it read, so a short read can't pass as a fast one
+		*/
+		template<class Load>
+		void measure(const char* path, size_t primitives, size_t nodes, const std::filesystem::path& file, GLuint repeats, Load load) {
+			uint64_t bytes = std::filesystem::file_size(file);
+			uint64_t allocations = allocationCount();
+			auto start = std::chrono::steady_clock::now();
+			for (GLuint i = 0; i < repeats; i++)
+				if (load(file.string()) != nodes)
+					throw std::exception("Scene load benchmark read a different scene");
+
+			SceneLoadCost cost;
+			cost.path = path;
+			cost.primitives = primitives;
+			cost.bytes = bytes;
+			cost.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repeats;
+			cost.megabytesPerSecond = cost.milliseconds > 0 ? bytes / 1048576.0 / (cost.milliseconds / 1000) : 0;
+			cost.allocations = (allocationCount() - allocations) / repeats;
+			cost.allocationsCounted = countsAllocations();
+			m_Results.push_back(cost);
+		}
+
+		static SdfScene fromDocument(const nlohmann::json& document) {
+			SdfScene scene;
+			for (const auto& entry : document["materials"]) {
+				SdfMaterial material;
+				material.name = entry.value("name", "");
+				for (int c = 0; c < 3; c++)
+					material.albedo[c] = entry["albedo"][c].get<GLfloat>();
+				material.texture = entry.value("texture", -1);
+				material.scale = entry.value("scale", 1.f);
+				scene.material(material);
+			}
+			for (const auto& entry : document["nodes"]) {
+				SdfNode node;
+				parseSdfType(entry["type"].get<std::string>(), node.type);
+				node.name = entry.value("name", "");
+				node.left = entry.value("left", -1);
+				node.right = entry.value("right", -1);
+				node.material = entry.value("material", -1);
+				if (entry.contains("params"))
+					for (size_t p = 0; p < entry["params"].size() && p < 8; p++)
+						node.params[p / 4][p % 4] = entry["params"][p].get<GLfloat>();
+				scene.add(node);
+			}
+			scene.setRoot(document.value("root", -1));
+			return scene;
+		}
+
+	public:
+
+		/*
+		primitives spheres and boxes scattered in a cube, chained by unions, a few materials shared between them
+		*/
+		static SdfScene scatter(size_t primitives, GLfloat extent = 100) {
+			SdfScene scene;
+			std::mt19937 random(7);
+			std::uniform_real_distribution<GLfloat> position(-extent, extent), size(0.1f, 1.f);
+			for (int i = 0; i < 4; i++) {
+				SdfMaterial material;
+				material.name = "Material " + std::to_string(i);
+				material.albedo = vec3(size(random), size(random), size(random));
+				material.texture = i % 2 ? i : -1;
+				scene.material(material);
+			}
+
+			GLint root = -1;
+			for (size_t i = 0; i < primitives; i++) {
+				vec3 centre(position(random), position(random), position(random));
+				std::string name = "Primitive " + std::to_string(i);
+				GLint primitive = i % 2 ? scene.box(centre, vec3(size(random)), name) : scene.sphere(centre, size(random), name);
+				scene.setMaterial(primitive, GLint(i % 4));
+				root = root < 0 ? primitive : (i % 3 ? scene.unite(root, primitive) : scene.smoothUnion(root, primitive, 0.5f));
+			}
+			return scene;
+		}
+
+		/*
+		Writes a scattered scene of each size to directory as JSON, converts it to binary, then loads each repeats times per path
+		*/
+		void run(const std::string& directory = ".", std::vector<size_t> sizes = { 10000, 1000000 }, GLuint repeats = 2, size_t domLimit = 100000) {
+			m_Results.clear();
+			std::filesystem::path json = std::filesystem::path(directory) / "scene_benchmark.json";
+			std::filesystem::path binary = std::filesystem::path(directory) / "scene_benchmark.rscn";
+			for (size_t primitives : sizes) {
+				size_t nodes = 0;
+				{
+					SdfScene scene = scatter(primitives);
+					nodes = scene.nodes().size();
+					writeSceneJson(scene, json.string());
+				}
+				convertSceneJson(json.string(), binary.string());
+
+				if (primitives <= domLimit)
+					measure("JSON DOM", primitives, nodes, json, repeats, [](const std::string& file) {
+						std::string contents = get_file_contents(file.c_str());
+						return fromDocument(nlohmann::json::parse(contents)).nodes().size();
+					});
+				measure("JSON SAX", primitives, nodes, json, repeats, [](const std::string& file) {
+					return loadSceneJson(file).nodes().size();
+				});
+				measure("Binary to scene", primitives, nodes, binary, repeats, [](const std::string& file) {
+					return loadSceneFile(file).nodes().size();
+				});
+				measure("Binary in place", primitives, nodes, binary, repeats, [](const std::string& file) {
+					return SceneFile(file).nodes().size();
+				});
+			}
+		}
+
+		inline const std::vector<SceneLoadCost>& results() const { return m_Results; }
+	};
+}
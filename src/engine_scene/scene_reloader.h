@@ -0,0 +1,391 @@
+#pragma once
+#include <cmath>
+#include <chrono>
+#include <limits>
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+#include "../engine_system/paths.h"
+#include "../engine_system/file_watcher.h"
+#include "../engine_system/mapped_file.h"
+#include "sdf_scene.h"
+#include "scene_json.h"
+
+namespace rtre {
+
+	/*
+	What a reload changed and how long each step took
+	low and high bound every changed primitive before and after the edit, grown by the largest blend or rounding radius
+	of the scene, unbounded when the scene repeats space; baked data outside them is still valid
+	*/
+	struct SceneReloadStats {
+		std::string path;
+		size_t changedNodes = 0;
+		size_t addedNodes = 0;
+		size_t removedNodes = 0;
+		size_t changedMaterials = 0;
+		bool structural = false;
+		// Only the nodes the edit touched were parsed
+		bool partial = false;
+		bool bounded = true;
+		vec3 low = vec3(std::numeric_limits<GLfloat>::max());
+		vec3 high = vec3(-std::numeric_limits<GLfloat>::max());
+		double parseMs = 0;
+		double diffMs = 0;
+		double applyMs = 0;
+		double milliseconds = 0;
+		std::string error;
+
+		inline bool changed() const { return changedNodes || addedNodes || removedNodes || changedMaterials; }
+		inline bool touches(const vec3& boxLow, const vec3& boxHigh) const {
+			if (!bounded)
+				return true;
+			for (int i = 0; i < 3; i++)
+				if (low[i] > boxHigh[i] || high[i] < boxLow[i])
+					return false;
+			return true;
+		}
+	};
+
+	/*
+	Reloads a JSON scene when the watcher reports it saved, applying only the nodes that differ
+	Nodes are matched by index, the flat storage order, so appending or editing in place stays cheap
+	while inserting early shifts every later operand and becomes a structural edit from there on
+	Unchanged nodes keep their GPU params, and the shaders are only regenerated for structural edits through
+	the scene's structureRevision
+	The text of the last reload is kept with the byte range of every node, so a save that only changes text inside
+	existing nodes parses just those nodes; anything else, or a scene edited in between, parses the whole file,
+	so edits made outside the file never survive a save
+	*/
+	class SceneReloader {
+	public:
+		using Listener = std::function<void(const SceneReloadStats&)>;
+
+	private:
+
+		FileWatcher& m_Watcher;
+		SdfScene& m_Scene;
+		std::string m_Path;
+		std::string m_Normalized;
+		size_t m_ListenerID;
+		Listener m_Listener;
+		SceneReloadStats m_Stats;
+
+		typedef std::vector<std::pair<size_t, size_t>> Spans;
+		std::string m_Text;
+		Spans m_NodeSpans;
+		GLuint m_Structure = 0;
+		GLuint m_Params = 0;
+		// Largest blend or rounding radius in the scene and whether it repeats space, kept up to date by every reload
+		// so a partial one doesn't walk the scene, radii that shrank keep counting until the next full parse
+		GLfloat m_Radius = 0;
+		bool m_Repeats = false;
+
+		/*
+		Position of the quote closing the string whose opening quote is at i
+		*/
+		static size_t stringEnd(const std::string& text, size_t i, size_t end) {
+			for (i++; i < end && text[i] != '"'; i++)
+				if (text[i] == '\\')
+					i++;
+			return i;
+		}
+
+		/*
+		Objects at the top level of text[begin, end), found by matching brackets outside strings without parsing values
+		Stops at the bracket closing the array or object the range starts in
+		*/
+		static void objectSpans(const std::string& text, size_t begin, size_t end, Spans& spans) {
+			int depth = 0;
+			size_t start = 0;
+			for (size_t i = begin; i < end; i++) {
+				char c = text[i];
+				if (c == '"')
+					i = stringEnd(text, i, end);
+				else if (c == '{' || c == '[') {
+					if (depth++ == 0 && c == '{')
+						start = i;
+				}
+				else if (c == '}' || c == ']') {
+					if (--depth < 0)
+						return;
+					if (depth == 0 && c == '}')
+						spans.push_back({ start, i + 1 });
+				}
+			}
+		}
+
+		/*
+		Byte ranges of the objects in the document's "nodes" array, empty if it can't be found
+		*/
+		static Spans nodeSpans(const std::string& text) {
+			Spans spans;
+			int depth = 0;
+			size_t key = 0, keyLength = 0;
+			for (size_t i = 0; i < text.size(); i++) {
+				char c = text[i];
+				if (c == '"') {
+					size_t start = i + 1;
+					i = stringEnd(text, i, text.size());
+					if (depth == 1) {
+						key = start;
+						keyLength = i - start;
+					}
+				}
+				else if (c == '[' && depth == 1 && text.compare(key, keyLength, "nodes") == 0) {
+					objectSpans(text, i + 1, text.size(), spans);
+					return spans;
+				}
+				else if (c == '{' || c == '[')
+					depth++;
+				else if (c == '}' || c == ']')
+					depth--;
+			}
+			return spans;
+		}
+
+		static void grow(SceneReloadStats& stats, const SdfNode& node) {
+			if (node.type == rNsphere) {
+				stats.low = glm::min(stats.low, vec3(node.params[0]) - node.params[0].w);
+				stats.high = glm::max(stats.high, vec3(node.params[0]) + node.params[0].w);
+			}
+			else if (node.type == rNbox) {
+				stats.low = glm::min(stats.low, vec3(node.params[0]) - vec3(node.params[1]));
+				stats.high = glm::max(stats.high, vec3(node.params[0]) + vec3(node.params[1]));
+			}
+			else
+				// An operator's own change reaches as far as its operands, which are not tracked here
+				stats.bounded = false;
+		}
+
+		void include(const SdfNode& node) {
+			if (node.type == rNrepeat)
+				m_Repeats = true;
+			else if (node.type == rNsmoothUnion || node.type == rNround)
+				m_Radius = std::max(m_Radius, std::abs(node.params[0].x));
+		}
+
+		void reach(SceneReloadStats& stats) const {
+			if (m_Repeats)
+				stats.bounded = false;
+			stats.low -= vec3(m_Radius);
+			stats.high += vec3(m_Radius);
+		}
+
+		/*
+		Parses only the nodes text[prefix, text.size() - suffix) falls in, if the change stays inside existing nodes
+		and the scene still matches the last reload, returns false when the whole file has to be parsed
+		*/
+		bool parseChangedNodes(const std::string& text, size_t& first, std::vector<SdfNode>& nodes, Spans& spans) const {
+			if (m_NodeSpans.empty() || m_NodeSpans.size() != m_Scene.nodes().size() || m_Scene.structureRevision() != m_Structure
+				|| m_Scene.paramRevision() != m_Params)
+				return false;
+
+			size_t shared = std::min(text.size(), m_Text.size());
+			size_t prefix = std::mismatch(text.begin(), text.begin() + shared, m_Text.begin()).first - text.begin();
+			size_t suffix = std::mismatch(text.rbegin(), text.rbegin() + (shared - prefix), m_Text.rbegin()).first - text.rbegin();
+			size_t changedEnd = m_Text.size() - suffix;
+
+			// Nodes from the first one ending past the prefix to the last one starting before the changed end
+			auto firstSpan = std::upper_bound(m_NodeSpans.begin(), m_NodeSpans.end(), prefix,
+				[](size_t position, const std::pair<size_t, size_t>& span) { return position < span.second; });
+			auto lastSpan = std::lower_bound(m_NodeSpans.begin(), m_NodeSpans.end(), changedEnd,
+				[](const std::pair<size_t, size_t>& span, size_t position) { return span.first < position; });
+			if (firstSpan == m_NodeSpans.end() || lastSpan == m_NodeSpans.begin())
+				return false;
+			--lastSpan;
+			if (lastSpan < firstSpan || prefix < firstSpan->first || changedEnd > lastSpan->second)
+				return false;
+
+			size_t begin = firstSpan->first;
+			int64_t end = int64_t(lastSpan->second) + int64_t(text.size()) - int64_t(m_Text.size());
+			size_t count = size_t(lastSpan - firstSpan) + 1;
+			if (end <= int64_t(begin) || end > int64_t(text.size()))
+				return false;
+			objectSpans(text, begin, size_t(end), spans);
+			if (spans.size() != count)
+				return false;
+
+			first = size_t(firstSpan - m_NodeSpans.begin());
+			std::string document = "{\"nodes\": [" + text.substr(begin, size_t(end) - begin) + "]}";
+			SdfScene part;
+			SceneJsonReader reader(part, GLint(first));
+			if (!nlohmann::json::sax_parse(document, &reader) || part.nodes().size() != count)
+				return false;
+			for (const SdfNode& node : part.nodes())
+				if (node.material >= GLint(m_Scene.materials().size()))
+					return false;
+			nodes = part.nodes();
+			return true;
+		}
+
+		void reload() {
+			using clock = std::chrono::steady_clock;
+			auto start = clock::now();
+			SceneReloadStats stats;
+			stats.path = m_Path;
+
+			std::string text;
+			SdfScene loaded;
+			size_t first = 0;
+			std::vector<SdfNode> partial;
+			Spans spans;
+			try {
+				MappedFile file(m_Path);
+				text.assign(reinterpret_cast<const char*>(file.data()), file.size());
+				if (text == m_Text) {
+					stats.milliseconds = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+					m_Stats = stats;
+					return;
+				}
+				stats.partial = parseChangedNodes(text, first, partial, spans);
+				if (!stats.partial)
+					loaded = parseSceneJson(text.data(), text.data() + text.size(), m_Path);
+			}
+			catch (const std::exception& e) {
+				// Editors often save in several writes, the next notification brings the complete file
+				stats.error = e.what();
+				m_Stats = stats;
+				std::cout << "Scene reload failed, keeping the loaded scene: " << stats.error << "\n";
+				return;
+			}
+			auto parsed = clock::now();
+			stats.parseMs = std::chrono::duration<double, std::milli>(parsed - start).count();
+			GLuint structure = m_Scene.structureRevision();
+
+			if (stats.partial) {
+				std::vector<GLint> changed;
+				for (size_t i = 0; i < partial.size(); i++)
+					if (m_Scene.node(GLint(first + i)) != partial[i])
+						changed.push_back(GLint(first + i));
+				auto diffed = clock::now();
+				stats.diffMs = std::chrono::duration<double, std::milli>(diffed - parsed).count();
+
+				stats.changedNodes = changed.size();
+				for (GLint index : changed) {
+					grow(stats, m_Scene.node(index));
+					grow(stats, partial[index - first]);
+					m_Scene.edit(index, partial[index - first]);
+					include(partial[index - first]);
+				}
+				reach(stats);
+
+				// Nodes after the edit moved by the change in length
+				int64_t shift = int64_t(text.size()) - int64_t(m_Text.size());
+				std::copy(spans.begin(), spans.end(), m_NodeSpans.begin() + first);
+				for (size_t i = first + spans.size(); i < m_NodeSpans.size(); i++) {
+					m_NodeSpans[i].first = size_t(int64_t(m_NodeSpans[i].first) + shift);
+					m_NodeSpans[i].second = size_t(int64_t(m_NodeSpans[i].second) + shift);
+				}
+				stats.applyMs = std::chrono::duration<double, std::milli>(clock::now() - diffed).count();
+			}
+			else {
+				// Diff first, so the scene is never left half applied
+				const auto& current = m_Scene.nodes();
+				const auto& incoming = loaded.nodes();
+				size_t shared = std::min(current.size(), incoming.size());
+				std::vector<GLint> changed;
+				for (size_t i = 0; i < shared; i++)
+					if (current[i] != incoming[i])
+						changed.push_back(GLint(i));
+				std::vector<GLint> changedMaterials;
+				for (size_t i = 0; i < std::min(m_Scene.materials().size(), loaded.materials().size()); i++)
+					if (m_Scene.materials()[i] != loaded.materials()[i])
+						changedMaterials.push_back(GLint(i));
+				auto diffed = clock::now();
+				stats.diffMs = std::chrono::duration<double, std::milli>(diffed - parsed).count();
+
+				size_t currentNodes = current.size(), currentMaterials = m_Scene.materials().size();
+				stats.changedNodes = changed.size();
+				stats.addedNodes = incoming.size() - shared;
+				stats.removedNodes = currentNodes - shared;
+				stats.changedMaterials = changedMaterials.size() + std::max(currentMaterials, loaded.materials().size()) - std::min(currentMaterials, loaded.materials().size());
+
+				for (size_t i = shared; i < currentNodes; i++)
+					grow(stats, current[i]);
+				m_Scene.truncate(shared);
+				for (GLint index : changed) {
+					grow(stats, current[index]);
+					grow(stats, incoming[index]);
+					m_Scene.edit(index, incoming[index]);
+				}
+				for (size_t i = shared; i < incoming.size(); i++) {
+					grow(stats, incoming[i]);
+					m_Scene.add(incoming[i]);
+				}
+				if (m_Scene.root() != loaded.root())
+					m_Scene.setRoot(loaded.root());
+
+				for (GLint index : changedMaterials)
+					m_Scene.setMaterialData(index, loaded.materials()[index]);
+				for (size_t i = currentMaterials; i < loaded.materials().size(); i++)
+					m_Scene.material(loaded.materials()[i]);
+				m_Scene.truncateMaterials(loaded.materials().size());
+				m_Radius = 0;
+				m_Repeats = false;
+				for (const SdfNode& node : incoming)
+					include(node);
+				reach(stats);
+
+				// Spans that don't match the nodes leave the next reload parsing everything
+				m_NodeSpans = nodeSpans(text);
+				if (m_NodeSpans.size() != incoming.size())
+					m_NodeSpans.clear();
+				stats.applyMs = std::chrono::duration<double, std::milli>(clock::now() - diffed).count();
+			}
+			m_Text = std::move(text);
+			m_Structure = m_Scene.structureRevision();
+			m_Params = m_Scene.paramRevision();
+
+			stats.structural = m_Structure != structure;
+			stats.milliseconds = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+			std::cout << "Reloaded " << m_Path << " in " << stats.milliseconds << " ms (parse " << stats.parseMs << ", diff " << stats.diffMs
+				<< ", apply " << stats.applyMs << (stats.partial ? ", nodes only" : "") << "): " << stats.changedNodes << " changed, "
+				<< stats.addedNodes << " added, " << stats.removedNodes << " removed, " << stats.changedMaterials << " materials"
+				<< (stats.structural ? ", structural" : "") << "\n";
+			m_Stats = stats;
+			if (m_Listener)
+				m_Listener(m_Stats);
+		}
+
+	public:
+
+		/*
+		listener runs after every successful reload, from FileWatcher::dispatch
+		*/
+		SceneReloader(FileWatcher& watcher, SdfScene& scene, const std::string& path, Listener listener = Listener())
+			:
+			m_Watcher(watcher),
+			m_Scene(scene),
+			m_Path(path),
+			m_Normalized(normalizePath(path)),
+			m_Listener(std::move(listener))
+		{
+			m_Watcher.watch(m_Path);
+			m_ListenerID = m_Watcher.addListener([this](const std::string& file) {
+				if (file == m_Normalized)
+					reload();
+			});
+		}
+
+		SceneReloader(const SceneReloader&) = delete;
+		SceneReloader& operator=(const SceneReloader&) = delete;
+
+		~SceneReloader() {
+			m_Watcher.removeListener(m_ListenerID);
+			m_Watcher.unwatch(m_Path);
+		}
+
+		/*
+		Forgets the last reload's text, for when the scene was replaced rather than edited, the next save parses everything
+		*/
+		inline void invalidate() {
+			m_Text.clear();
+			m_NodeSpans.clear();
+		}
+
+		inline const SceneReloadStats& stats() const { return m_Stats; }
+	};
+}
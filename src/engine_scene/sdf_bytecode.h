@@ -0,0 +1,137 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "sdf_scene.h"
+
+namespace rtre {
+
+	/*
+	Opcodes of the scene bytecode
+		rOsphere, rObox			push the primitive's distance
+		rOunion .. rOintersect	pop b, pop a, push the operator applied to a and b
+		rOrepeat				save the position and fold it into the repetition cell
+		rOrestore				restore the position saved by the matching rOrepeat
+		rOround					subtract the rounding radius from the top of the stack
+	*/
+	enum SdfOp : uint32_t {
+		rOsphere,
+		rObox,
+		rOunion,
+		rOsmoothUnion,
+		rOsubtract,
+		rOintersect,
+		rOrepeat,
+		rOrestore,
+		rOround
+	};
+
+	/*
+	One 32 bit word per instruction
+		bits 0-3	opcode
+		bit 4		operands were pushed in reverse, b below a
+		bits 8-31	node the params are read from, the same index as in the scene and sceneParams
+	*/
+	static const uint32_t sdfSwapped = 1u << 4;
+	// Matches SCENE_STACK and SCENE_POSITIONS in sdf/interpreter.glsl
+	static const GLuint sdfStackLimit = 16;
+	static const GLuint sdfPositionLimit = 4;
+
+	inline uint32_t sdfInstruction(SdfOp op, GLint node, bool swapped = false) {
+		return uint32_t(op) | (swapped ? sdfSwapped : 0u) | (uint32_t(node) << 8);
+	}
+	inline SdfOp sdfOpcode(uint32_t instruction) { return SdfOp(instruction & 15u); }
+	inline GLint sdfNode(uint32_t instruction) { return GLint(instruction >> 8); }
+	inline bool sdfIsSwapped(uint32_t instruction) { return (instruction & sdfSwapped) != 0; }
+
+	/*
+	A scene flattened into post-order instructions for a stack machine
+	stackDepth and positionDepth are the deepest the value and position stacks get while running it
+	*/
+	struct SdfProgram {
+		std::vector<uint32_t> code;
+		GLuint stackDepth = 0;
+		GLuint positionDepth = 0;
+
+		inline bool fits(GLuint stackLimit = sdfStackLimit, GLuint positionLimit = sdfPositionLimit) const {
+			return stackDepth <= stackLimit && positionDepth <= positionLimit;
+		}
+	};
+
+	/*
+	Compiles the tree under the scene's root
+	Binary operators evaluate their deeper operand first, Sethi-Ullman order, so a chain of unions leaning either way
+	needs two stack slots, the reversed operands are flagged for the operators that don't commute
+	Shared subtrees are emitted once per use, like the generated GLSL
+	*/
+	SdfProgram compileBytecode(const SdfScene& scene) {
+		SdfProgram program;
+		if (scene.empty())
+			return program;
+
+		// Stack slots each node needs, operands precede their operators so one pass in index order does
+		const auto& nodes = scene.nodes();
+		std::vector<GLuint> need(nodes.size(), 1);
+		for (size_t i = 0; i < nodes.size(); i++) {
+			const SdfNode& node = nodes[i];
+			if (node.isPrimitive())
+				continue;
+			if (node.isUnary()) {
+				need[i] = need[node.left];
+				continue;
+			}
+			GLuint left = need[node.left], right = need[node.right];
+			need[i] = left == right ? left + 1 : std::max(left, right);
+		}
+
+		struct Frame {
+			GLint node;
+			bool expanded;
+		};
+		std::vector<Frame> stack = { { scene.root(), false } };
+		GLuint depth = 0, positions = 0;
+		while (!stack.empty()) {
+			Frame frame = stack.back();
+			stack.pop_back();
+			const SdfNode& node = nodes[frame.node];
+
+			if (node.isPrimitive()) {
+				program.code.push_back(sdfInstruction(node.type == rNsphere ? rOsphere : rObox, frame.node));
+				program.stackDepth = std::max(program.stackDepth, ++depth);
+				continue;
+			}
+
+			bool swapped = !node.isUnary() && need[node.right] > need[node.left];
+			if (!frame.expanded) {
+				stack.push_back({ frame.node, true });
+				if (node.type == rNrepeat) {
+					program.code.push_back(sdfInstruction(rOrepeat, frame.node));
+					program.positionDepth = std::max(program.positionDepth, ++positions);
+				}
+				if (node.isUnary())
+					stack.push_back({ node.left, false });
+				else {
+					// The operand evaluated first is pushed last
+					stack.push_back({ swapped ? node.left : node.right, false });
+					stack.push_back({ swapped ? node.right : node.left, false });
+				}
+				continue;
+			}
+
+			switch (node.type) {
+			case rNrepeat:
+				program.code.push_back(sdfInstruction(rOrestore, frame.node));
+				positions--;
+				break;
+			case rNround:
+				program.code.push_back(sdfInstruction(rOround, frame.node));
+				break;
+			default:
+				program.code.push_back(sdfInstruction(SdfOp(rOunion + (node.type - rNunion)), frame.node, swapped));
+				depth--;
+				break;
+			}
+		}
+		return program;
+	}
+}
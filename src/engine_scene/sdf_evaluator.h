@@ -0,0 +1,146 @@
+#pragma once
+#include <cmath>
+#include "glm/glm.hpp"
+#include "sdf_scene.h"
+
+namespace rtre {
+
+	/*
+	Reference CPU evaluation of an SdfScene, walks the node tree the way the generated map and mapGradient do
+	Gradient results are vec4(distance, gradient) like their GLSL counterparts in sdf/primitives.glsl and sdf/operators.glsl
+	Shares the scene by reference, the scene must outlive the evaluator
+	*/
+	class SdfEvaluator {
+
+		const SdfScene& m_Scene;
+		bool m_Repetition;
+
+		static GLfloat sdSphere(const vec3& position, const vec3& centre, GLfloat radius) {
+			return glm::length(position - centre) - radius;
+		}
+
+		static GLfloat sdBox(const vec3& position, const vec3& origin, const vec3& bound) {
+			vec3 d = glm::abs(position - origin) - bound;
+			return glm::min(glm::max(d.x, glm::max(d.y, d.z)), 0.0f) + glm::length(glm::max(d, 0.0f));
+		}
+
+		static GLfloat smin(GLfloat a, GLfloat b, GLfloat k) {
+			GLfloat h = glm::clamp(0.5f + 0.5f * (b - a) / k, 0.0f, 1.0f);
+			return glm::mix(b, a, h) - k * h * (1.0f - h);
+		}
+
+		static vec4 sdgSphere(const vec3& position, const vec3& centre, GLfloat radius) {
+			vec3 d = position - centre;
+			GLfloat l = glm::length(d);
+			return vec4(l - radius, d / glm::max(l, 1e-8f));
+		}
+
+		static vec4 sdgBox(const vec3& position, const vec3& origin, const vec3& bound) {
+			vec3 q = position - origin;
+			vec3 w = glm::abs(q) - bound;
+			vec3 s = glm::sign(q);
+			GLfloat g = glm::max(w.x, glm::max(w.y, w.z));
+			if (g > 0) {
+				vec3 outside = glm::max(w, 0.0f);
+				GLfloat l = glm::length(outside);
+				return vec4(l, s * outside / l);
+			}
+			vec3 axis = (w.x > w.y && w.x > w.z) ? vec3(1, 0, 0) : ((w.y > w.z) ? vec3(0, 1, 0) : vec3(0, 0, 1));
+			return vec4(g, s * axis);
+		}
+
+		static vec4 sminGrad(const vec4& a, const vec4& b, GLfloat k) {
+			GLfloat h = glm::clamp(0.5f + 0.5f * (b.x - a.x) / k, 0.0f, 1.0f);
+			vec3 gradient = glm::mix(vec3(b.y, b.z, b.w), vec3(a.y, a.z, a.w), h);
+			return vec4(glm::mix(b.x, a.x, h) - k * h * (1.0f - h), gradient);
+		}
+
+		GLfloat distance(GLint index, const vec3& position) const {
+			const SdfNode& node = m_Scene.node(index);
+			switch (node.type) {
+			case rNsphere:
+				return sdSphere(position, vec3(node.params[0]), node.params[0].w);
+			case rNbox:
+				return sdBox(position, vec3(node.params[0]), vec3(node.params[1]));
+			case rNunion:
+				return glm::min(distance(node.left, position), distance(node.right, position));
+			case rNsmoothUnion:
+				return smin(distance(node.left, position), distance(node.right, position), node.params[0].x);
+			case rNsubtract:
+				return glm::max(distance(node.left, position), -distance(node.right, position));
+			case rNintersect:
+				return glm::max(distance(node.left, position), distance(node.right, position));
+			case rNrepeat:
+				return distance(node.left, m_Repetition ? glm::mod(position, node.params[0].x) : position);
+			case rNround:
+				return distance(node.left, position) - node.params[0].x;
+			}
+			return 1e10f;
+		}
+
+		vec4 gradient(GLint index, const vec3& position) const {
+			const SdfNode& node = m_Scene.node(index);
+			switch (node.type) {
+			case rNsphere:
+				return sdgSphere(position, vec3(node.params[0]), node.params[0].w);
+			case rNbox:
+				return sdgBox(position, vec3(node.params[0]), vec3(node.params[1]));
+			case rNunion: {
+				vec4 a = gradient(node.left, position);
+				vec4 b = gradient(node.right, position);
+				return a.x < b.x ? a : b;
+			}
+			case rNsmoothUnion:
+				return sminGrad(gradient(node.left, position), gradient(node.right, position), node.params[0].x);
+			case rNsubtract: {
+				vec4 a = gradient(node.left, position);
+				vec4 b = gradient(node.right, position) * -1.0f;
+				return a.x > b.x ? a : b;
+			}
+			case rNintersect: {
+				vec4 a = gradient(node.left, position);
+				vec4 b = gradient(node.right, position);
+				return a.x > b.x ? a : b;
+			}
+			case rNrepeat:
+				return gradient(node.left, m_Repetition ? glm::mod(position, node.params[0].x) : position);
+			case rNround: {
+				vec4 a = gradient(node.left, position);
+				a.x -= node.params[0].x;
+				return a;
+			}
+			}
+			return vec4(1e10f, 0, 1, 0);
+		}
+
+	public:
+
+		/*
+		repetition mirrors FEATURE_DOMAIN_REPETITION, without it repeat nodes pass positions through
+		*/
+		SdfEvaluator(const SdfScene& scene, bool repetition = true)
+			:
+			m_Scene(scene),
+			m_Repetition(repetition)
+		{
+		}
+
+		inline GLfloat distance(const vec3& position) const {
+			return m_Scene.empty() ? 1e10f : distance(m_Scene.root(), position);
+		}
+
+		inline vec4 gradient(const vec3& position) const {
+			return m_Scene.empty() ? vec4(1e10f, 0, 1, 0) : gradient(m_Scene.root(), position);
+		}
+
+		vec3 normal(const vec3& position) const {
+			vec4 g = gradient(position);
+			vec3 n(g.y, g.z, g.w);
+			GLfloat l = glm::length(n);
+			return l > 0 ? n / l : vec3(0, 1, 0);
+		}
+
+		inline const SdfScene& scene() const { return m_Scene; }
+		inline bool repetition() const { return m_Repetition; }
+	};
+}
@@ -0,0 +1,231 @@
+#pragma once
+#include <string>
+#include <type_traits>
+#include "glm/glm.hpp"
+#include "sdf_scene.h"
+#include "scene_codegen.h"
+
+namespace rtre {
+
+	/*
+	Scenes written in C++ as expression templates, composed left to right with |
+		sdf::Sphere{ vec3(3), 0.1f } | sdf::Repeat(6) | sdf::SmoothUnion(1.5f) | sdf::Box{ vec3(2, 2.9f, 3), vec3(0.5f) }
+	two shapes side by side are united, an operator waits for the shape on its right, a modifier wraps everything on its left
+	The whole scene is one type, so evaluating it is a single inlined function without dispatch
+	Shapes also add themselves to an SdfScene, which gives the GLSL through SceneCodegen, so the shader and the
+	CPU evaluation come from the same expression and use the same formulas as SdfEvaluator
+	Repetition is always applied, as with FEATURE_DOMAIN_REPETITION
+	*/
+	namespace sdf {
+
+		struct Expression {};
+		struct Combinator {};
+		struct Modifier {};
+
+		template<class T>
+		constexpr bool isExpression = std::is_base_of<Expression, T>::value;
+
+		struct Sphere : Expression {
+			vec3 centre;
+			GLfloat radius;
+			GLint material;
+
+			Sphere(const vec3& c, GLfloat r, GLint m = -1) : centre(c), radius(r), material(m) {}
+
+			inline GLfloat operator()(const vec3& position) const {
+				return glm::length(position - centre) - radius;
+			}
+
+			GLint addTo(SdfScene& scene) const {
+				GLint node = scene.sphere(centre, radius);
+				scene.setMaterial(node, material);
+				return node;
+			}
+		};
+
+		struct Box : Expression {
+			vec3 origin;
+			vec3 bound;
+			GLint material;
+
+			Box(const vec3& o, const vec3& b, GLint m = -1) : origin(o), bound(b), material(m) {}
+
+			inline GLfloat operator()(const vec3& position) const {
+				vec3 d = glm::abs(position - origin) - bound;
+				return glm::min(glm::max(d.x, glm::max(d.y, d.z)), 0.0f) + glm::length(glm::max(d, 0.0f));
+			}
+
+			GLint addTo(SdfScene& scene) const {
+				GLint node = scene.box(origin, bound);
+				scene.setMaterial(node, material);
+				return node;
+			}
+		};
+
+		struct Union : Combinator {
+			inline GLfloat operator()(GLfloat a, GLfloat b) const { return glm::min(a, b); }
+			inline GLint addTo(SdfScene& scene, GLint left, GLint right) const { return scene.unite(left, right); }
+		};
+
+		struct SmoothUnion : Combinator {
+			GLfloat k;
+
+			explicit SmoothUnion(GLfloat blend) : k(blend) {}
+
+			inline GLfloat operator()(GLfloat a, GLfloat b) const {
+				GLfloat h = glm::clamp(0.5f + 0.5f * (b - a) / k, 0.0f, 1.0f);
+				return glm::mix(b, a, h) - k * h * (1.0f - h);
+			}
+			inline GLint addTo(SdfScene& scene, GLint left, GLint right) const { return scene.smoothUnion(left, right, k); }
+		};
+
+		struct Subtract : Combinator {
+			inline GLfloat operator()(GLfloat a, GLfloat b) const { return glm::max(a, -b); }
+			inline GLint addTo(SdfScene& scene, GLint left, GLint right) const { return scene.subtract(left, right); }
+		};
+
+		struct Intersect : Combinator {
+			inline GLfloat operator()(GLfloat a, GLfloat b) const { return glm::max(a, b); }
+			inline GLint addTo(SdfScene& scene, GLint left, GLint right) const { return scene.intersect(left, right); }
+		};
+
+		/*
+		An operator with its left operand, waiting for the right one
+		*/
+		template<class Left, class Operator>
+		struct Pending {
+			Left left;
+			Operator op;
+		};
+
+		template<class Left, class Right, class Operator>
+		struct Combined : Expression {
+			Left left;
+			Right right;
+			Operator op;
+
+			Combined(const Left& l, const Right& r, const Operator& o) : left(l), right(r), op(o) {}
+
+			inline GLfloat operator()(const vec3& position) const {
+				return op(left(position), right(position));
+			}
+
+			GLint addTo(SdfScene& scene) const {
+				GLint l = left.addTo(scene);
+				GLint r = right.addTo(scene);
+				return op.addTo(scene, l, r);
+			}
+		};
+
+		template<class Child>
+		struct Repeated : Expression {
+			Child child;
+			GLfloat period;
+
+			Repeated(const Child& c, GLfloat p) : child(c), period(p) {}
+
+			inline GLfloat operator()(const vec3& position) const {
+				return child(glm::mod(position, period));
+			}
+
+			GLint addTo(SdfScene& scene) const {
+				return scene.repeat(child.addTo(scene), period);
+			}
+		};
+
+		template<class Child>
+		struct Rounded : Expression {
+			Child child;
+			GLfloat radius;
+
+			Rounded(const Child& c, GLfloat r) : child(c), radius(r) {}
+
+			inline GLfloat operator()(const vec3& position) const {
+				return child(position) - radius;
+			}
+
+			GLint addTo(SdfScene& scene) const {
+				return scene.round(child.addTo(scene), radius);
+			}
+		};
+
+		struct Repeat : Modifier {
+			GLfloat period;
+
+			explicit Repeat(GLfloat p) : period(p) {}
+
+			template<class Child>
+			inline Repeated<Child> wrap(const Child& child) const { return Repeated<Child>(child, period); }
+		};
+
+		struct Round : Modifier {
+			GLfloat radius;
+
+			explicit Round(GLfloat r) : radius(r) {}
+
+			template<class Child>
+			inline Rounded<Child> wrap(const Child& child) const { return Rounded<Child>(child, radius); }
+		};
+
+		template<class Left, class Right, std::enable_if_t<isExpression<Left> && isExpression<Right>, int> = 0>
+		inline Combined<Left, Right, Union> operator|(const Left& left, const Right& right) {
+			return Combined<Left, Right, Union>(left, right, Union());
+		}
+
+		template<class Left, class Operator, std::enable_if_t<isExpression<Left> && std::is_base_of<Combinator, Operator>::value, int> = 0>
+		inline Pending<Left, Operator> operator|(const Left& left, const Operator& op) {
+			return { left, op };
+		}
+
+		template<class Left, class Operator, class Right, std::enable_if_t<isExpression<Right>, int> = 0>
+		inline Combined<Left, Right, Operator> operator|(const Pending<Left, Operator>& pending, const Right& right) {
+			return Combined<Left, Right, Operator>(pending.left, right, pending.op);
+		}
+
+		template<class Child, class Wrap, std::enable_if_t<isExpression<Child> && std::is_base_of<Modifier, Wrap>::value, int> = 0>
+		inline auto operator|(const Child& child, const Wrap& modifier) {
+			return modifier.wrap(child);
+		}
+
+		/*
+		The expression as nodes of an SdfScene, for the tools working on scenes
+		*/
+		template<class Shape, std::enable_if_t<isExpression<Shape>, int> = 0>
+		SdfScene toScene(const Shape& shape) {
+			SdfScene scene;
+			shape.addTo(scene);
+			return scene;
+		}
+
+		/*
+		scene.glsl for the expression, params baked in as literals
+		*/
+		template<class Shape, std::enable_if_t<isExpression<Shape>, int> = 0>
+		std::string glsl(const Shape& shape) {
+			SdfScene scene = toScene(shape);
+			return SceneCodegen(scene).generate();
+		}
+
+		/*
+		SdfScene::demo as an expression
+		*/
+		inline auto demo() {
+			return Sphere{ vec3(3, 3, 3), 0.1f } | Repeat(6) | SmoothUnion(1.5f) | Box{ vec3(2, 2.9f, 3), vec3(0.5f) } | Round(1.375f);
+		}
+
+		/*
+		A row of pillars on a slab under a carved lintel, repeated, a deeper tree using every operator
+		Repeat wraps positions into [0, 16) on every axis, so the row is built around the cell's centre like demo's sphere
+		*/
+		inline auto pillars() {
+			const vec3 centre(8);
+			auto pillar = [&](GLfloat x) { return Box{ centre + vec3(x, 1.5f, 0), vec3(0.3f, 1.5f, 0.3f) } | Round(0.05f); };
+			return Box{ centre + vec3(0, -0.25f, 0), vec3(6, 0.25f, 2) }
+				| pillar(-4) | pillar(-2) | pillar(0) | pillar(2) | pillar(4)
+				| SmoothUnion(0.2f) | Box{ centre + vec3(0, 3.2f, 0), vec3(5, 0.2f, 0.6f) }
+				| Subtract() | Sphere{ centre + vec3(0, 3.2f, 0), 0.8f }
+				| Intersect() | Box{ centre + vec3(0, 1.5f, 0), vec3(5.5f, 4, 1.5f) }
+				| Repeat(16);
+		}
+	}
+}
@@ -0,0 +1,364 @@
+#pragma once
+#include <cmath>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "glm/glm.hpp"
+#include "../engine_abstractions/dtypes.h"
+#include "sdf_evaluator.h"
+
+namespace rtre {
+
+	enum MeshingMethod {
+		rMdualContouring,
+		rMmarchingTetrahedra
+	};
+
+	struct MeshingStats {
+		MeshingMethod method = rMdualContouring;
+		GLuint depth = 0;
+		GLuint resolution = 0;
+		uint64_t nodesVisited = 0;
+		uint64_t activeCells = 0;
+		size_t vertices = 0;
+		size_t triangles = 0;
+		double milliseconds = 0;
+		// Cells of the full resolution grid covered per second, empty space included
+		double cellsPerSecond = 0;
+		size_t cellBytes = 0;
+		size_t meshBytes = 0;
+	};
+
+	/*
+	Extracts a triangle mesh from an SdfScene inside a box
+	An octree over the box is refined only where the distance at a node's centre is within its half diagonal,
+	so empty space is discarded a whole node at a time and only cells near the surface reach the leaf level
+	Subtrees are refined in parallel, then every sign changing leaf cell is polygonized:
+		rMdualContouring		one vertex per cell placed by minimizing the QEF of its edge crossings,
+								one quad per crossed edge, vertices are shared
+		rMmarchingTetrahedra	each cell split into six tetrahedra, triangle soup, the baseline
+	Vertex normals come from the analytic scene gradient
+	Leaves are all of the finest size, the octree only prunes, it doesn't merge flat regions
+	*/
+	class SdfMesher {
+
+		struct Cell {
+			uint64_t key;
+			GLuint x, y, z;
+			std::array<GLfloat, 8> corners;
+		};
+
+		const SdfEvaluator& m_Evaluator;
+		vec3 m_Low;
+		vec3 m_High;
+		vec3 m_CellSize;
+		GLuint m_Depth = 6;
+		GLuint m_Resolution = 64;
+		GLuint m_Threads;
+
+		std::vector<Cell> m_Cells;
+		MeshingStats m_Stats;
+
+		static inline uint64_t key(uint64_t x, uint64_t y, uint64_t z) {
+			return x | (y << 21) | (z << 42);
+		}
+
+		inline vec3 point(GLfloat x, GLfloat y, GLfloat z) const {
+			return m_Low + vec3(x, y, z) * m_CellSize;
+		}
+
+		static inline vec3 cornerOffset(GLuint corner) {
+			return vec3(GLfloat(corner & 1), GLfloat((corner >> 1) & 1), GLfloat((corner >> 2) & 1));
+		}
+
+		/*
+		Runs work(i) for i in [0, count) on every thread
+		*/
+		template<class Work>
+		void parallel(size_t count, Work work) const {
+			std::atomic<size_t> next{ 0 };
+			auto worker = [&](GLuint thread) {
+				for (size_t i = next++; i < count; i = next++)
+					work(i, thread);
+			};
+
+			std::vector<std::thread> threads;
+			for (GLuint t = 1; t < m_Threads; t++)
+				threads.emplace_back(worker, t);
+			worker(0);
+			for (auto& thread : threads)
+				thread.join();
+		}
+
+		void refine(GLuint x, GLuint y, GLuint z, GLuint size, std::vector<Cell>& cells, uint64_t& visited) const {
+			visited++;
+			vec3 low = point(GLfloat(x), GLfloat(y), GLfloat(z));
+			vec3 high = point(GLfloat(x + size), GLfloat(y + size), GLfloat(z + size));
+			// Slightly inflated, operators like smooth union and repetition are only close to 1-Lipschitz
+			GLfloat radius = glm::length(high - low) * 0.5f * 1.05f;
+			if (std::fabs(m_Evaluator.distance((low + high) * 0.5f)) > radius)
+				return;
+
+			if (size == 1) {
+				Cell cell;
+				cell.key = key(x, y, z);
+				cell.x = x;
+				cell.y = y;
+				cell.z = z;
+				bool inside = false, outside = false;
+				for (GLuint i = 0; i < 8; i++) {
+					vec3 offset = cornerOffset(i);
+					cell.corners[i] = m_Evaluator.distance(point(x + offset.x, y + offset.y, z + offset.z));
+					(cell.corners[i] < 0 ? inside : outside) = true;
+				}
+				if (inside && outside)
+					cells.push_back(cell);
+				return;
+			}
+
+			GLuint half = size / 2;
+			for (GLuint i = 0; i < 8; i++)
+				refine(x + (i & 1) * half, y + ((i >> 1) & 1) * half, z + ((i >> 2) & 1) * half, half, cells, visited);
+		}
+
+		/*
+		Collects the sign changing leaf cells sorted by key, subtrees a few levels down are refined in parallel
+		*/
+		void collect() {
+			GLuint split = std::min<GLuint>(m_Depth, 2);
+			GLuint tiles = 1u << split;
+			GLuint size = m_Resolution / tiles;
+
+			std::vector<std::vector<Cell>> cells(tiles * tiles * tiles);
+			std::vector<uint64_t> visited(cells.size(), 0);
+			parallel(cells.size(), [&](size_t i, GLuint) {
+				GLuint x = GLuint(i % tiles), y = GLuint(i / tiles % tiles), z = GLuint(i / (tiles * tiles));
+				refine(x * size, y * size, z * size, size, cells[i], visited[i]);
+			});
+
+			m_Cells.clear();
+			m_Stats.nodesVisited = 0;
+			for (size_t i = 0; i < cells.size(); i++) {
+				m_Cells.insert(m_Cells.end(), cells[i].begin(), cells[i].end());
+				m_Stats.nodesVisited += visited[i];
+			}
+			// Top levels above the parallel split
+			for (GLuint level = 0; level < split; level++)
+				m_Stats.nodesVisited += uint64_t(1) << (3 * level);
+
+			std::sort(m_Cells.begin(), m_Cells.end(), [](const Cell& a, const Cell& b) { return a.key < b.key; });
+		}
+
+		GLint find(int64_t x, int64_t y, int64_t z) const {
+			if (x < 0 || y < 0 || z < 0)
+				return -1;
+			uint64_t wanted = key(x, y, z);
+			auto found = std::lower_bound(m_Cells.begin(), m_Cells.end(), wanted, [](const Cell& cell, uint64_t k) { return cell.key < k; });
+			if (found == m_Cells.end() || found->key != wanted)
+				return -1;
+			return GLint(found - m_Cells.begin());
+		}
+
+		/*
+		Minimizes the squared distances to the planes of the edge crossings, biased towards their mass point
+		*/
+		vec3 solveQef(const Cell& cell) const {
+			GLfloat ata[6] = {};
+			vec3 atb(0);
+			vec3 mass(0);
+			std::vector<std::pair<vec3, vec3>> planes;
+			planes.reserve(12);
+
+			for (GLuint i = 0; i < 8; i++)
+				for (GLuint bit = 1; bit < 8; bit <<= 1) {
+					if ((i & bit) || (cell.corners[i] < 0) == (cell.corners[i | bit] < 0))
+						continue;
+					GLfloat t = cell.corners[i] / (cell.corners[i] - cell.corners[i | bit]);
+					vec3 offset = glm::mix(cornerOffset(i), cornerOffset(i | bit), t);
+					vec3 crossing = point(cell.x + offset.x, cell.y + offset.y, cell.z + offset.z);
+					planes.push_back({ crossing, m_Evaluator.normal(crossing) });
+					mass += crossing;
+				}
+			mass /= GLfloat(planes.size());
+
+			for (const auto& plane : planes) {
+				const vec3& n = plane.second;
+				GLfloat b = glm::dot(n, plane.first - mass);
+				ata[0] += n.x * n.x; ata[1] += n.x * n.y; ata[2] += n.x * n.z;
+				ata[3] += n.y * n.y; ata[4] += n.y * n.z; ata[5] += n.z * n.z;
+				atb += n * b;
+			}
+
+			// Regularized so flat and edge-only cells stay near the mass point
+			const GLfloat bias = 0.05f;
+			GLfloat a = ata[0] + bias, b = ata[1], c = ata[2], d = ata[3] + bias, e = ata[4], f = ata[5] + bias;
+			GLfloat det = a * (d * f - e * e) - b * (b * f - e * c) + c * (b * e - d * c);
+			if (std::fabs(det) < 1e-12f)
+				return mass;
+
+			vec3 x(
+				(atb.x * (d * f - e * e) - b * (atb.y * f - e * atb.z) + c * (atb.y * e - d * atb.z)) / det,
+				(a * (atb.y * f - e * atb.z) - atb.x * (b * f - e * c) + c * (b * atb.z - atb.y * c)) / det,
+				(a * (d * atb.z - atb.y * e) - b * (b * atb.z - atb.y * c) + atb.x * (b * e - d * c)) / det);
+
+			vec3 low = point(GLfloat(cell.x), GLfloat(cell.y), GLfloat(cell.z));
+			return glm::clamp(mass + x, low, low + m_CellSize);
+		}
+
+		BasicMesh dualContour() {
+			std::vector<Vertex3> vertices(m_Cells.size());
+			parallel(m_Cells.size(), [&](size_t i, GLuint) {
+				vec3 position = solveQef(m_Cells[i]);
+				vertices[i] = Vertex3(position, vec2(0, 0), m_Evaluator.normal(position));
+			});
+
+			// Each cell emits the quads of the three crossed edges leaving its lowest corner
+			std::vector<std::vector<GLuint>> indices(m_Threads);
+			parallel(m_Cells.size(), [&](size_t i, GLuint thread) {
+				const Cell& cell = m_Cells[i];
+				for (GLuint axis = 0; axis < 3; axis++) {
+					GLfloat start = cell.corners[0], end = cell.corners[1u << axis];
+					if ((start < 0) == (end < 0))
+						continue;
+
+					GLuint u = (axis + 1) % 3, v = (axis + 2) % 3;
+					int64_t c[3] = { cell.x, cell.y, cell.z };
+					int64_t cu[3] = { c[0], c[1], c[2] }; cu[u]--;
+					int64_t cv[3] = { c[0], c[1], c[2] }; cv[v]--;
+					int64_t cuv[3] = { cu[0], cu[1], cu[2] }; cuv[v]--;
+
+					GLint quad[4] = { GLint(i), find(cu[0], cu[1], cu[2]), find(cuv[0], cuv[1], cuv[2]), find(cv[0], cv[1], cv[2]) };
+					if (quad[1] < 0 || quad[2] < 0 || quad[3] < 0)
+						continue;
+
+					// Counter clockwise around +axis, flipped when the surface faces -axis, 0 counts as outside like the test above
+					if (!(start < 0))
+						std::swap(quad[1], quad[3]);
+
+					auto& out = indices[thread];
+					out.insert(out.end(), { GLuint(quad[0]), GLuint(quad[1]), GLuint(quad[2]), GLuint(quad[0]), GLuint(quad[2]), GLuint(quad[3]) });
+				}
+			});
+
+			std::vector<GLuint> merged;
+			for (auto& part : indices)
+				merged.insert(merged.end(), part.begin(), part.end());
+
+			m_Stats.vertices = vertices.size();
+			m_Stats.triangles = merged.size() / 3;
+			return BasicMesh(std::move(vertices), std::move(merged));
+		}
+
+		BasicMesh marchTetrahedra() {
+			static const GLuint s_Tetrahedra[6][4] = {
+				{ 0, 1, 3, 7 }, { 0, 3, 2, 7 }, { 0, 2, 6, 7 },
+				{ 0, 6, 4, 7 }, { 0, 4, 5, 7 }, { 0, 5, 1, 7 }
+			};
+
+			std::vector<std::vector<Vertex3>> soups(m_Threads);
+			parallel(m_Cells.size(), [&](size_t i, GLuint thread) {
+				const Cell& cell = m_Cells[i];
+				auto& soup = soups[thread];
+
+				auto crossing = [&](GLuint a, GLuint b) {
+					GLfloat t = cell.corners[a] / (cell.corners[a] - cell.corners[b]);
+					vec3 offset = glm::mix(cornerOffset(a), cornerOffset(b), t);
+					vec3 position = point(cell.x + offset.x, cell.y + offset.y, cell.z + offset.z);
+					return Vertex3(position, vec2(0, 0), m_Evaluator.normal(position));
+				};
+				auto triangle = [&](Vertex3 a, Vertex3 b, Vertex3 c) {
+					vec3 face = glm::cross(b.position - a.position, c.position - a.position);
+					if (glm::dot(face, a.normal + b.normal + c.normal) < 0)
+						std::swap(b, c);
+					soup.push_back(a);
+					soup.push_back(b);
+					soup.push_back(c);
+				};
+
+				for (const auto& tetrahedron : s_Tetrahedra) {
+					GLuint in[4], out[4], inside = 0, outside = 0;
+					for (GLuint corner : tetrahedron)
+						(cell.corners[corner] < 0 ? in[inside++] : out[outside++]) = corner;
+
+					if (inside == 1 || inside == 3) {
+						GLuint lone = inside == 1 ? in[0] : out[0];
+						const GLuint* others = inside == 1 ? out : in;
+						triangle(crossing(lone, others[0]), crossing(lone, others[1]), crossing(lone, others[2]));
+					}
+					else if (inside == 2) {
+						Vertex3 a = crossing(in[0], out[0]), b = crossing(in[0], out[1]);
+						Vertex3 c = crossing(in[1], out[1]), d = crossing(in[1], out[0]);
+						triangle(a, b, c);
+						triangle(a, c, d);
+					}
+				}
+			});
+
+			std::vector<Vertex3> vertices;
+			for (auto& soup : soups)
+				vertices.insert(vertices.end(), soup.begin(), soup.end());
+			std::vector<GLuint> indices(vertices.size());
+			for (GLuint i = 0; i < indices.size(); i++)
+				indices[i] = i;
+
+			m_Stats.vertices = vertices.size();
+			m_Stats.triangles = indices.size() / 3;
+			return BasicMesh(std::move(vertices), std::move(indices));
+		}
+
+	public:
+
+		/*
+		threads of 0 uses every hardware thread
+		*/
+		SdfMesher(const SdfEvaluator& evaluator, vec3 low, vec3 high, GLuint threads = 0)
+			:
+			m_Evaluator(evaluator),
+			m_Low(low),
+			m_High(high),
+			m_Threads(threads ? threads : std::max(std::thread::hardware_concurrency(), 1u))
+		{
+			setDepth(m_Depth);
+		}
+
+		/*
+		The box is split into 2^depth cells per axis, depth is clamped to [1, 10]
+		*/
+		void setDepth(GLuint depth) {
+			m_Depth = std::clamp<GLuint>(depth, 1, 10);
+			m_Resolution = 1u << m_Depth;
+			m_CellSize = (m_High - m_Low) / GLfloat(m_Resolution);
+		}
+
+		BasicMesh extract(MeshingMethod method = rMdualContouring) {
+			auto start = std::chrono::steady_clock::now();
+
+			m_Stats = MeshingStats();
+			m_Stats.method = method;
+			m_Stats.depth = m_Depth;
+			m_Stats.resolution = m_Resolution;
+
+			collect();
+			BasicMesh mesh = method == rMdualContouring ? dualContour() : marchTetrahedra();
+
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			m_Stats.milliseconds = seconds * 1000;
+			m_Stats.cellsPerSecond = seconds > 0 ? double(m_Resolution) * m_Resolution * m_Resolution / seconds : 0;
+			m_Stats.activeCells = m_Cells.size();
+			m_Stats.cellBytes = m_Cells.capacity() * sizeof(Cell);
+			m_Stats.meshBytes = m_Stats.vertices * sizeof(Vertex3) + m_Stats.triangles * 3 * sizeof(GLuint);
+
+			m_Cells.clear();
+			m_Cells.shrink_to_fit();
+			return mesh;
+		}
+
+		inline GLuint depth() const { return m_Depth; }
+		inline GLuint resolution() const { return m_Resolution; }
+		inline const MeshingStats& stats() const { return m_Stats; }
+	};
+}
@@ -0,0 +1,304 @@
+#pragma once
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "glm/glm.hpp"
+#include "bytecode_evaluator.h"
+
+namespace rtre {
+
+	struct SdfRay {
+		vec3 origin;
+		vec3 direction;
+		GLfloat maxDistance;
+	};
+
+	/*
+	A sphere of radius moving from centre by motion
+	*/
+	struct SdfSweep {
+		vec3 centre;
+		GLfloat radius;
+		vec3 motion;
+	};
+
+	/*
+	distance is how far along the ray or the motion the hit is, position is the hit point for rays and the sphere's centre
+	at contact for sweeps, normal is the field's gradient there, facing away from the contact for sweeps, steps the sphere
+	tracing steps taken
+	*/
+	struct SdfHit {
+		bool hit = false;
+		GLfloat distance = 0;
+		vec3 position = vec3(0);
+		vec3 normal = vec3(0);
+		GLuint steps = 0;
+	};
+
+	/*
+	Geometric queries against a scene's distance field, answered on the CPU from a BytecodeEvaluator
+		rayCast			first surface along a ray
+		sweep			first contact of a moving sphere
+		closestPoint	nearest surface point, by stepping along the gradient
+		overlap			whether a sphere intersects the geometry
+	Batched versions split the queries into chunks claimed by threads started once per call, a chunk runs every query of
+	a step as one batch of the evaluator and drops the queries that finished, so a few slow rays don't hold up the rest;
+	batches too small to fill sdfBatchWidth lanes go point by point
+	The evaluator must outlive the queries and be linked again after scene edits
+	*/
+	class SdfQueries {
+
+		const BytecodeEvaluator& m_Evaluator;
+		GLfloat m_Epsilon;
+		GLuint m_MaxSteps;
+		GLuint m_Threads;
+
+		// Active queries below this are evaluated one by one
+		static const size_t s_BatchThreshold = sdfBatchWidth / 4;
+		// Smallest chunk worth a thread, each thread gets about four chunks so the slow ones even out
+		static const size_t s_MinChunk = sdfBatchWidth * 4;
+
+		/*
+		Runs range(first, last) over the queries [0, count), threads claim chunks until none are left
+		*/
+		template<class Range>
+		void split(size_t count, Range range) const {
+			GLuint threads = m_Threads ? m_Threads : std::max(std::thread::hardware_concurrency(), 1u);
+			size_t chunk = std::max(s_MinChunk, (count + threads * 4 - 1) / (threads * 4));
+			size_t chunks = (count + chunk - 1) / chunk;
+			threads = GLuint(std::min<size_t>(threads, chunks));
+			if (threads <= 1) {
+				range(size_t(0), count);
+				return;
+			}
+
+			std::atomic<size_t> next{ 0 };
+			auto worker = [&]() {
+				for (size_t i = next++; i < chunks; i = next++)
+					range(i * chunk, std::min(count, (i + 1) * chunk));
+			};
+			std::vector<std::thread> workers;
+			for (GLuint t = 1; t < threads; t++)
+				workers.emplace_back(worker);
+			worker();
+			for (auto& thread : workers)
+				thread.join();
+		}
+
+		/*
+		Runs on the thread split gave the chunk, so the evaluator stays on it
+		*/
+		void evaluate(const SdfPoints& points, std::vector<GLfloat>& out) const {
+			out.resize(points.size());
+			if (points.size() >= s_BatchThreshold) {
+				m_Evaluator.distances(points, out.data(), 1);
+				return;
+			}
+			for (size_t i = 0; i < points.size(); i++)
+				out[i] = m_Evaluator.distance(vec3(points.x[i], points.y[i], points.z[i]));
+		}
+
+		/*
+		Tetrahedral differences at every position, the four samples of every position in one batch
+		*/
+		void gradients(const std::vector<vec3>& positions, std::vector<vec3>& normals, std::vector<GLfloat>& distances) const {
+			static const vec3 s_Offsets[4] = { vec3(1, -1, -1), vec3(-1, -1, 1), vec3(-1, 1, -1), vec3(1, 1, 1) };
+			const GLfloat h = 1e-4f;
+			SdfPoints points;
+			points.reserve(positions.size() * 4);
+			for (const vec3& position : positions)
+				for (const vec3& offset : s_Offsets)
+					points.push(position + offset * h);
+			std::vector<GLfloat> samples;
+			evaluate(points, samples);
+
+			normals.resize(positions.size());
+			distances.resize(positions.size());
+			for (size_t i = 0; i < positions.size(); i++) {
+				vec3 n(0);
+				GLfloat sum = 0;
+				for (int s = 0; s < 4; s++) {
+					n += s_Offsets[s] * samples[4 * i + s];
+					sum += samples[4 * i + s];
+				}
+				GLfloat l = glm::length(n);
+				normals[i] = l > 0 ? n / l : vec3(0, 1, 0);
+				distances[i] = sum / 4;
+			}
+		}
+
+		/*
+		Sphere traces spheres of radius[i] from origin[i] along the unit direction[i] up to limit[i], for queries [first, last)
+		*/
+		void trace(const std::vector<vec3>& origins, const std::vector<vec3>& directions, const std::vector<GLfloat>& radii,
+			const std::vector<GLfloat>& limits, std::vector<SdfHit>& hits, size_t first, size_t last) const {
+			std::vector<GLfloat> travelled(last - first, 0);
+			std::vector<size_t> active(last - first), remaining;
+			for (size_t i = first; i < last; i++)
+				active[i - first] = i;
+
+			SdfPoints points;
+			std::vector<GLfloat> distances;
+			std::vector<size_t> hitIndices;
+			for (GLuint step = 0; step < m_MaxSteps && !active.empty(); step++) {
+				points.clear();
+				for (size_t i : active)
+					points.push(origins[i] + directions[i] * travelled[i - first]);
+				evaluate(points, distances);
+
+				remaining.clear();
+				for (size_t j = 0; j < active.size(); j++) {
+					size_t i = active[j];
+					GLfloat gap = distances[j] - radii[i];
+					hits[i].steps++;
+					if (gap < m_Epsilon) {
+						hits[i].hit = true;
+						hitIndices.push_back(i);
+						continue;
+					}
+					travelled[i - first] += gap;
+					if (travelled[i - first] < limits[i])
+						remaining.push_back(i);
+				}
+				active.swap(remaining);
+			}
+
+			std::vector<vec3> positions(hitIndices.size()), normals;
+			std::vector<GLfloat> unused;
+			for (size_t j = 0; j < hitIndices.size(); j++) {
+				size_t i = hitIndices[j];
+				hits[i].distance = travelled[i - first];
+				hits[i].position = origins[i] + directions[i] * travelled[i - first];
+				positions[j] = hits[i].position;
+			}
+			gradients(positions, normals, unused);
+			for (size_t j = 0; j < hitIndices.size(); j++)
+				hits[hitIndices[j]].normal = normals[j];
+			for (size_t i = first; i < last; i++)
+				if (!hits[i].hit)
+					hits[i].distance = std::min(travelled[i - first], limits[i]);
+		}
+
+		void trace(const std::vector<vec3>& origins, const std::vector<vec3>& directions, const std::vector<GLfloat>& radii,
+			const std::vector<GLfloat>& limits, std::vector<SdfHit>& hits) const {
+			hits.assign(origins.size(), SdfHit());
+			split(origins.size(), [&](size_t first, size_t last) { trace(origins, directions, radii, limits, hits, first, last); });
+		}
+
+	public:
+
+		/*
+		epsilon is how close counts as touching, threads of 0 uses every hardware thread for calls with enough queries
+		*/
+		SdfQueries(const BytecodeEvaluator& evaluator, GLfloat epsilon = 1e-3f, GLuint maxSteps = 128, GLuint threads = 0)
+			:
+			m_Evaluator(evaluator),
+			m_Epsilon(epsilon),
+			m_MaxSteps(maxSteps),
+			m_Threads(threads)
+		{
+		}
+
+		void rayCasts(const std::vector<SdfRay>& rays, std::vector<SdfHit>& hits) const {
+			std::vector<vec3> origins(rays.size()), directions(rays.size());
+			std::vector<GLfloat> radii(rays.size(), 0), limits(rays.size());
+			for (size_t i = 0; i < rays.size(); i++) {
+				origins[i] = rays[i].origin;
+				directions[i] = glm::normalize(rays[i].direction);
+				limits[i] = rays[i].maxDistance;
+			}
+			trace(origins, directions, radii, limits, hits);
+		}
+
+		/*
+		Spheres already touching the geometry hit at distance 0
+		*/
+		void sweeps(const std::vector<SdfSweep>& sweeps, std::vector<SdfHit>& hits) const {
+			std::vector<vec3> origins(sweeps.size()), directions(sweeps.size());
+			std::vector<GLfloat> radii(sweeps.size()), limits(sweeps.size());
+			for (size_t i = 0; i < sweeps.size(); i++) {
+				GLfloat length = glm::length(sweeps[i].motion);
+				origins[i] = sweeps[i].centre;
+				directions[i] = length > 0 ? sweeps[i].motion / length : vec3(0, 1, 0);
+				radii[i] = sweeps[i].radius;
+				limits[i] = length;
+			}
+			trace(origins, directions, radii, limits, hits);
+		}
+
+		/*
+		Moves every point onto the surface along the field's gradient, iterations bounds the steps for points
+		where the field is not an exact distance, after smooth unions or inside repeated cells
+		*/
+		void closestPoints(const std::vector<vec3>& points, std::vector<vec3>& closest, GLuint iterations = 4) const {
+			closest = points;
+			split(points.size(), [&](size_t first, size_t last) {
+				std::vector<size_t> active(last - first), remaining;
+				for (size_t i = first; i < last; i++)
+					active[i - first] = i;
+				std::vector<vec3> positions, normals;
+				std::vector<GLfloat> distances;
+				for (GLuint iteration = 0; iteration < iterations && !active.empty(); iteration++) {
+					positions.clear();
+					for (size_t i : active)
+						positions.push_back(closest[i]);
+					gradients(positions, normals, distances);
+
+					remaining.clear();
+					for (size_t j = 0; j < active.size(); j++) {
+						size_t i = active[j];
+						closest[i] -= normals[j] * distances[j];
+						if (std::abs(distances[j]) >= m_Epsilon)
+							remaining.push_back(i);
+					}
+					active.swap(remaining);
+				}
+			});
+		}
+
+		/*
+		overlapping[i] is 1 where a sphere of radii[i] at centres[i] intersects the geometry
+		*/
+		void overlaps(const std::vector<vec3>& centres, const std::vector<GLfloat>& radii, std::vector<uint8_t>& overlapping) const {
+			overlapping.resize(centres.size());
+			split(centres.size(), [&](size_t first, size_t last) {
+				SdfPoints points;
+				points.reserve(last - first);
+				for (size_t i = first; i < last; i++)
+					points.push(centres[i]);
+				std::vector<GLfloat> distances;
+				evaluate(points, distances);
+				for (size_t i = first; i < last; i++)
+					overlapping[i] = distances[i - first] < radii[i];
+			});
+		}
+
+		SdfHit rayCast(const SdfRay& ray) const {
+			std::vector<SdfHit> hits;
+			rayCasts({ ray }, hits);
+			return hits[0];
+		}
+
+		SdfHit sweep(const SdfSweep& sweep) const {
+			std::vector<SdfHit> hits;
+			sweeps({ sweep }, hits);
+			return hits[0];
+		}
+
+		vec3 closestPoint(const vec3& point, GLuint iterations = 4) const {
+			std::vector<vec3> closest;
+			closestPoints({ point }, closest, iterations);
+			return closest[0];
+		}
+
+		inline bool overlap(const vec3& centre, GLfloat radius) const {
+			return m_Evaluator.distance(centre) < radius;
+		}
+
+		inline const BytecodeEvaluator& evaluator() const { return m_Evaluator; }
+		inline GLfloat epsilon() const { return m_Epsilon; }
+	};
+}
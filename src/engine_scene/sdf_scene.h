@@ -0,0 +1,251 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+
+namespace rtre {
+
+	using glm::vec4;
+	using glm::vec3;
+	using glm::vec2;
+
+	enum SdfType {
+		rNsphere,
+		rNbox,
+		rNunion,
+		rNsmoothUnion,
+		rNsubtract,
+		rNintersect,
+		rNrepeat,
+		rNround
+	};
+
+	/*
+	Surface description referenced by primitives
+	texture is an entry of the scene's TextureAtlas, -1 for untextured, scale is texture repeats per unit
+	*/
+	struct SdfMaterial {
+		vec3 albedo = vec3(1);
+		GLint texture = -1;
+		GLfloat scale = 1;
+		std::string name;
+
+		inline bool operator==(const SdfMaterial& other) const {
+			return albedo == other.albedo && texture == other.texture && scale == other.scale && name == other.name;
+		}
+		inline bool operator!=(const SdfMaterial& other) const { return !(*this == other); }
+	};
+
+	/*
+	One node of an SDF operator tree
+	Primitives are leaves, operators reference their operands by index in the owning SdfScene
+	material indexes the scene's materials and only matters for primitives, -1 shades white
+	params layout per type:
+		rNsphere		params[0] = centre, radius
+		rNbox			params[0] = origin, params[1] = half extents
+		rNsmoothUnion	params[0].x = blend radius
+		rNrepeat		params[0].x = period
+		rNround			params[0].x = rounding radius
+	*/
+	struct SdfNode {
+		SdfType type = rNsphere;
+		GLint left = -1;
+		GLint right = -1;
+		GLint material = -1;
+		vec4 params[2] = { vec4(0), vec4(0) };
+		std::string name;
+
+		inline bool isPrimitive() const { return type == rNsphere || type == rNbox; }
+		inline bool isUnary() const { return type == rNrepeat || type == rNround; }
+
+		inline bool operator==(const SdfNode& other) const {
+			return type == other.type && left == other.left && right == other.right && material == other.material
+				&& params[0] == other.params[0] && params[1] == other.params[1] && name == other.name;
+		}
+		inline bool operator!=(const SdfNode& other) const { return !(*this == other); }
+	};
+
+	/*
+	How far an edit reaches
+		rEparams		only params or materials of existing nodes changed, the generated code still holds
+		rEstructure		types, operands, nodes or the root changed, the code has to be generated again
+	*/
+	enum SdfEdit {
+		rEparams,
+		rEstructure
+	};
+
+	/*
+	Scene description shared by the shader generator and the CPU side tools
+	Nodes are stored flat, every operand is created before the operators using it
+	Changes are tracked for the GPU copies: structural edits bump structureRevision,
+	param edits widen a dirty range of nodes the consumer uploads and clears
+	Param and material edits also bump paramRevision, for consumers that must know about them without taking the range
+	*/
+	class SdfScene {
+
+		std::vector<SdfNode> m_Nodes;
+		std::vector<SdfMaterial> m_Materials;
+		GLint m_Root = -1;
+
+		GLuint m_Structure = 0;
+		GLuint m_Params = 0;
+		size_t m_DirtyBegin = 0;
+		size_t m_DirtyEnd = 0;
+
+		inline void markDirty(size_t begin, size_t end) {
+			m_Params++;
+			if (m_DirtyBegin == m_DirtyEnd) {
+				m_DirtyBegin = begin;
+				m_DirtyEnd = end;
+				return;
+			}
+			m_DirtyBegin = std::min(m_DirtyBegin, begin);
+			m_DirtyEnd = std::max(m_DirtyEnd, end);
+		}
+
+		GLint binary(SdfType type, GLint left, GLint right, GLfloat parameter = 0) {
+			SdfNode node;
+			node.type = type;
+			node.left = left;
+			node.right = right;
+			node.params[0].x = parameter;
+			return add(node);
+		}
+
+	public:
+
+		/*
+		Every builder returns the index of the new node, which also becomes the root
+		add takes a fully described node, its operands must already exist
+		*/
+		GLint add(SdfNode node) {
+			m_Nodes.push_back(std::move(node));
+			m_Structure++;
+			m_Root = GLint(m_Nodes.size()) - 1;
+			return m_Root;
+		}
+
+		GLint sphere(const vec3& centre, GLfloat radius, const std::string& name = "") {
+			SdfNode node;
+			node.type = rNsphere;
+			node.params[0] = vec4(centre, radius);
+			node.name = name;
+			return add(node);
+		}
+
+		GLint box(const vec3& origin, const vec3& bound, const std::string& name = "") {
+			SdfNode node;
+			node.type = rNbox;
+			node.params[0] = vec4(origin, 0);
+			node.params[1] = vec4(bound, 0);
+			node.name = name;
+			return add(node);
+		}
+
+		GLint unite(GLint left, GLint right) { return binary(rNunion, left, right); }
+		GLint smoothUnion(GLint left, GLint right, GLfloat k) { return binary(rNsmoothUnion, left, right, k); }
+		GLint subtract(GLint left, GLint right) { return binary(rNsubtract, left, right); }
+		GLint intersect(GLint left, GLint right) { return binary(rNintersect, left, right); }
+		GLint repeat(GLint child, GLfloat period) { return binary(rNrepeat, child, -1, period); }
+		GLint round(GLint child, GLfloat radius) { return binary(rNround, child, -1, radius); }
+
+		GLint material(const SdfMaterial& material) {
+			m_Materials.push_back(material);
+			return GLint(m_Materials.size()) - 1;
+		}
+		inline void setMaterialData(GLint index, const SdfMaterial& material) {
+			m_Materials[index] = material;
+			m_Params++;
+		}
+		inline void truncateMaterials(size_t count) {
+			if (count < m_Materials.size())
+				m_Materials.resize(count);
+		}
+		inline void setMaterial(GLint node, GLint material) {
+			m_Nodes[node].material = material;
+			markDirty(node, node + 1);
+		}
+
+		/*
+		Replaces a node, returning whether the edit was param-only or structural
+		*/
+		SdfEdit edit(GLint index, const SdfNode& updated) {
+			SdfNode& node = m_Nodes[index];
+			bool structural = node.type != updated.type || node.left != updated.left || node.right != updated.right;
+			node = updated;
+			if (structural) {
+				m_Structure++;
+				return rEstructure;
+			}
+			markDirty(index, index + 1);
+			return rEparams;
+		}
+
+		/*
+		Drops every node from count on, operators must not reference the dropped nodes
+		*/
+		void truncate(size_t count) {
+			if (count >= m_Nodes.size())
+				return;
+			m_Nodes.resize(count);
+			if (m_Root >= GLint(count))
+				m_Root = -1;
+			m_DirtyEnd = std::min(m_DirtyEnd, count);
+			m_DirtyBegin = std::min(m_DirtyBegin, m_DirtyEnd);
+			m_Structure++;
+		}
+
+		inline void setParams(GLint index, const vec4& first, const vec4& second = vec4(0)) {
+			m_Nodes[index].params[0] = first;
+			m_Nodes[index].params[1] = second;
+			markDirty(index, index + 1);
+		}
+
+		/*
+		Index of the first node called name, -1 if there is none
+		*/
+		GLint find(const std::string& name) const {
+			for (size_t i = 0; i < m_Nodes.size(); i++)
+				if (m_Nodes[i].name == name)
+					return GLint(i);
+			return -1;
+		}
+
+		inline void reserve(size_t nodes, size_t materials = 0) {
+			m_Nodes.reserve(nodes);
+			m_Materials.reserve(materials);
+		}
+
+		inline void setRoot(GLint root) {
+			m_Root = root;
+			m_Structure++;
+		}
+		inline GLint root() const { return m_Root; }
+		inline bool empty() const { return m_Root < 0; }
+
+		inline const std::vector<SdfNode>& nodes() const { return m_Nodes; }
+		inline const std::vector<SdfMaterial>& materials() const { return m_Materials; }
+		inline const SdfNode& node(GLint index) const { return m_Nodes[index]; }
+
+		inline GLuint structureRevision() const { return m_Structure; }
+		inline GLuint paramRevision() const { return m_Params; }
+		inline bool paramsDirty() const { return m_DirtyBegin != m_DirtyEnd; }
+		inline size_t dirtyBegin() const { return m_DirtyBegin; }
+		inline size_t dirtyEnd() const { return m_DirtyEnd; }
+		inline void clearDirty() { m_DirtyBegin = m_DirtyEnd = 0; }
+
+		/*
+		The scene frag.frag used to hard code, a repeated sphere smoothly merged with a box
+		*/
+		static SdfScene demo() {
+			SdfScene scene;
+			GLint sphere = scene.repeat(scene.sphere(vec3(3, 3, 3), 0.1f, "Sphere"), 6);
+			GLint box = scene.box(vec3(2, 2.9f, 3), vec3(0.5f), "Box");
+			scene.round(scene.smoothUnion(sphere, box, 1.5f), 1.375f);
+			return scene;
+		}
+	};
+}
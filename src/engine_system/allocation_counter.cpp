@@ -0,0 +1,122 @@
+#include "allocation_counter.h"
+
+#ifdef RTRE_COUNT_ALLOCATIONS
+#include <new>
+#include <cstdlib>
+#include <algorithm>
+
+/*
+Replacements for every global allocation operator, counting each allocation
+Aligned allocations have their own allocator, since memory from _aligned_malloc can't go back through free
+*/
+
+static const bool s_Counting = (rtre::s_CountingAllocations = true);
+
+static void* allocate(std::size_t size) noexcept {
+	rtre::s_Allocations.fetch_add(1, std::memory_order_relaxed);
+	return std::malloc(size ? size : 1);
+}
+
+static void* allocateAligned(std::size_t size, std::align_val_t alignment) noexcept {
+	rtre::s_Allocations.fetch_add(1, std::memory_order_relaxed);
+#ifdef _MSC_VER
+	return _aligned_malloc(size ? size : 1, std::size_t(alignment));
+#else
+	void* memory = nullptr;
+	std::size_t bytes = std::max(std::size_t(alignment), sizeof(void*));
+	return posix_memalign(&memory, bytes, size ? size : 1) == 0 ? memory : nullptr;
+#endif
+}
+
+static void freeAligned(void* memory) noexcept {
+#ifdef _MSC_VER
+	_aligned_free(memory);
+#else
+	std::free(memory);
+#endif
+}
+
+void* operator new(std::size_t size) {
+	if (void* memory = allocate(size))
+		return memory;
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+	return allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+	return allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+	if (void* memory = allocateAligned(size, alignment))
+		return memory;
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+	return operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	return allocateAligned(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	return allocateAligned(size, alignment);
+}
+
+void operator delete(void* memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+	std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+	std::free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+	std::free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+	freeAligned(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept {
+	freeAligned(memory);
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept {
+	freeAligned(memory);
+}
+
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept {
+	freeAligned(memory);
+}
+
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept {
+	freeAligned(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept {
+	freeAligned(memory);
+}
+#endif
@@ -0,0 +1,25 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+namespace rtre {
+
+	inline std::atomic<uint64_t> s_Allocations{ 0 };
+	inline std::atomic<bool> s_CountingAllocations{ false };
+
+	/*
+	Heap allocations made through the global operator new so far
+	Counting replaces the global allocation operators for the whole program, so it is off by default: build
+	allocation_counter.cpp with RTRE_COUNT_ALLOCATIONS defined to enable it
+	*/
+	inline uint64_t allocationCount() {
+		return s_Allocations.load(std::memory_order_relaxed);
+	}
+
+	/*
+	Whether the counting operators are linked in, allocationCount stays 0 otherwise
+	*/
+	inline bool countsAllocations() {
+		return s_CountingAllocations.load(std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,231 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <unordered_map>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "paths.h"
+#include "spsc_queue.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace rtre {
+
+	/*
+	Watches asset files from a background thread
+	Uses inotify on the watched files' directories when available and falls back to polling st_mtime
+	Changes are handed to the render thread through a lock-free queue and delivered by dispatch(),
+	so the render loop never touches the filesystem
+	*/
+	class FileWatcher {
+	public:
+		using Listener = std::function<void(const std::string&)>;
+
+	private:
+
+		struct WatchedFile {
+			size_t refs = 0;
+			time_t lastmod = 0;
+		};
+
+		std::unordered_map<std::string, WatchedFile> m_Files;
+		std::unordered_map<std::string, int> m_Directories;
+		std::unordered_map<int, std::string> m_DirectoryNames;
+		std::mutex m_FilesMutex;
+
+		SpscQueue<std::string, 1024> m_Changes;
+		std::vector<std::pair<size_t, Listener>> m_Listeners;
+		size_t m_NextListener = 0;
+
+		std::chrono::milliseconds m_PollInterval;
+		std::atomic<bool> m_Running{ true };
+		int m_Inotify = -1;
+		std::thread m_Thread;
+
+		static time_t modificationTime(const std::string& file) {
+			struct stat fileInfo;
+			if (stat(file.c_str(), &fileInfo) != 0)
+				return 0;
+			return fileInfo.st_mtime;
+		}
+
+		static std::string directoryOf(const std::string& file) {
+			return std::filesystem::path(file).parent_path().generic_string();
+		}
+
+		void publish(std::string file) {
+			while (!m_Changes.push(file) && m_Running)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+
+		void pollFiles() {
+			while (m_Running) {
+				std::vector<std::string> changed;
+				{
+					std::lock_guard<std::mutex> lock(m_FilesMutex);
+					for (auto& entry : m_Files) {
+						time_t lastmod = modificationTime(entry.first);
+						if (lastmod != entry.second.lastmod) {
+							entry.second.lastmod = lastmod;
+							changed.push_back(entry.first);
+						}
+					}
+				}
+				for (auto& file : changed)
+					publish(std::move(file));
+
+				std::this_thread::sleep_for(m_PollInterval);
+			}
+		}
+
+#ifdef __linux__
+		void readNotifications() {
+			alignas(inotify_event) char buffer[4096];
+
+			while (m_Running) {
+				pollfd descriptor = { m_Inotify, POLLIN, 0 };
+				if (poll(&descriptor, 1, int(m_PollInterval.count())) <= 0)
+					continue;
+
+				ssize_t length = read(m_Inotify, buffer, sizeof(buffer));
+				std::vector<std::string> changed;
+				{
+					std::lock_guard<std::mutex> lock(m_FilesMutex);
+					for (char* at = buffer; at < buffer + length;) {
+						const inotify_event* event = reinterpret_cast<const inotify_event*>(at);
+						at += sizeof(inotify_event) + event->len;
+
+						auto directory = m_DirectoryNames.find(event->wd);
+						if (event->len == 0 || directory == m_DirectoryNames.end())
+							continue;
+
+						std::string file = directory->second + "/" + event->name;
+						if (m_Files.count(file))
+							changed.push_back(std::move(file));
+					}
+				}
+				for (auto& file : changed)
+					publish(std::move(file));
+			}
+		}
+#endif
+
+	public:
+
+		FileWatcher(std::chrono::milliseconds pollInterval = std::chrono::milliseconds(100))
+			:
+			m_PollInterval(pollInterval)
+		{
+#ifdef __linux__
+			m_Inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+			if (m_Inotify >= 0) {
+				m_Thread = std::thread(&FileWatcher::readNotifications, this);
+				return;
+			}
+#endif
+			m_Thread = std::thread(&FileWatcher::pollFiles, this);
+		}
+
+		FileWatcher(const FileWatcher&) = delete;
+		FileWatcher& operator=(const FileWatcher&) = delete;
+
+		~FileWatcher() {
+			m_Running = false;
+			if (m_Thread.joinable())
+				m_Thread.join();
+#ifdef __linux__
+			if (m_Inotify >= 0)
+				close(m_Inotify);
+#endif
+		}
+
+		inline bool usesNotifications() const { return m_Inotify >= 0; }
+
+		/*
+		Watches are reference counted, every watch must be matched by an unwatch
+		*/
+		void watch(const std::string& path) {
+			std::string file = normalizePath(path);
+			std::lock_guard<std::mutex> lock(m_FilesMutex);
+
+			WatchedFile& watched = m_Files[file];
+			if (watched.refs++ > 0)
+				return;
+			watched.lastmod = modificationTime(file);
+
+#ifdef __linux__
+			if (m_Inotify >= 0) {
+				std::string directory = directoryOf(file);
+				if (!m_Directories.count(directory)) {
+					int wd = inotify_add_watch(m_Inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+					if (wd >= 0) {
+						m_Directories[directory] = wd;
+						m_DirectoryNames[wd] = directory;
+					}
+				}
+			}
+#endif
+		}
+
+		void unwatch(const std::string& path) {
+			std::string file = normalizePath(path);
+			std::lock_guard<std::mutex> lock(m_FilesMutex);
+
+			auto watched = m_Files.find(file);
+			if (watched == m_Files.end() || --watched->second.refs > 0)
+				return;
+			m_Files.erase(watched);
+
+#ifdef __linux__
+			std::string directory = directoryOf(file);
+			auto wd = m_Directories.find(directory);
+			if (wd == m_Directories.end())
+				return;
+			for (const auto& entry : m_Files)
+				if (directoryOf(entry.first) == directory)
+					return;
+
+			inotify_rm_watch(m_Inotify, wd->second);
+			m_DirectoryNames.erase(wd->second);
+			m_Directories.erase(wd);
+#endif
+		}
+
+		/*
+		Listeners are called from dispatch() with the normalized path of every changed file
+		*/
+		size_t addListener(Listener listener) {
+			m_Listeners.emplace_back(m_NextListener, std::move(listener));
+			return m_NextListener++;
+		}
+
+		void removeListener(size_t id) {
+			for (auto it = m_Listeners.begin(); it != m_Listeners.end(); ++it) {
+				if (it->first == id) {
+					m_Listeners.erase(it);
+					return;
+				}
+			}
+		}
+
+		/*
+		Delivers the pending changes to the listeners
+		Call once per frame from the render thread, costs a single atomic load when nothing changed
+		*/
+		void dispatch() {
+			std::string file;
+			while (m_Changes.pop(file))
+				for (auto& listener : m_Listeners)
+					listener.second(file);
+		}
+	};
+}
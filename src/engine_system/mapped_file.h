@@ -0,0 +1,141 @@
+#pragma once
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include "span.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace rtre {
+
+	/*
+	Read-only memory mapping of a whole file, pages are read in by the OS as they are touched
+	Move-only, the mapping lives as long as the object
+	An empty file maps to an empty span
+	*/
+	class MappedFile {
+
+		const uint8_t* m_Data = nullptr;
+		size_t m_Size = 0;
+#ifdef _WIN32
+		HANDLE m_File = INVALID_HANDLE_VALUE;
+		HANDLE m_Mapping = nullptr;
+#else
+		int m_File = -1;
+#endif
+
+		void fail(const std::string& path) {
+			close();
+			std::string exceptionMessage = "Failed to map file: " + path;
+			throw std::exception(exceptionMessage.c_str());
+		}
+
+		void close() {
+#ifdef _WIN32
+			if (m_Data)
+				UnmapViewOfFile(m_Data);
+			if (m_Mapping)
+				CloseHandle(m_Mapping);
+			if (m_File != INVALID_HANDLE_VALUE)
+				CloseHandle(m_File);
+			m_Mapping = nullptr;
+			m_File = INVALID_HANDLE_VALUE;
+#else
+			if (m_Data)
+				munmap(const_cast<uint8_t*>(m_Data), m_Size);
+			if (m_File >= 0)
+				::close(m_File);
+			m_File = -1;
+#endif
+			m_Data = nullptr;
+			m_Size = 0;
+		}
+
+		void steal(MappedFile& other) {
+			m_Data = other.m_Data;
+			m_Size = other.m_Size;
+			m_File = other.m_File;
+			other.m_Data = nullptr;
+			other.m_Size = 0;
+#ifdef _WIN32
+			m_Mapping = other.m_Mapping;
+			other.m_Mapping = nullptr;
+			other.m_File = INVALID_HANDLE_VALUE;
+#else
+			other.m_File = -1;
+#endif
+		}
+
+	public:
+
+		MappedFile() {}
+
+		explicit MappedFile(const std::string& path) {
+#ifdef _WIN32
+			m_File = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (m_File == INVALID_HANDLE_VALUE)
+				fail(path);
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(m_File, &size))
+				fail(path);
+			m_Size = size_t(size.QuadPart);
+			if (m_Size == 0)
+				return;
+			m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (!m_Mapping)
+				fail(path);
+			m_Data = static_cast<const uint8_t*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+			if (!m_Data)
+				fail(path);
+#else
+			m_File = ::open(path.c_str(), O_RDONLY);
+			if (m_File < 0)
+				fail(path);
+			struct stat info;
+			if (fstat(m_File, &info) != 0)
+				fail(path);
+			m_Size = size_t(info.st_size);
+			if (m_Size == 0)
+				return;
+			void* data = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, m_File, 0);
+			if (data == MAP_FAILED)
+				fail(path);
+			m_Data = static_cast<const uint8_t*>(data);
+#endif
+		}
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		MappedFile(MappedFile&& other) noexcept {
+			steal(other);
+		}
+
+		MappedFile& operator=(MappedFile&& other) noexcept {
+			if (this != &other) {
+				close();
+				steal(other);
+			}
+			return *this;
+		}
+
+		~MappedFile() {
+			close();
+		}
+
+		inline const uint8_t* data() const { return m_Data; }
+		inline size_t size() const { return m_Size; }
+		inline Span<const uint8_t> bytes() const { return Span<const uint8_t>(m_Data, m_Size); }
+	};
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <string>
+#include <filesystem>
+
+namespace rtre {
+
+	/*
+	Key used to compare asset files, the same file reached through different relative paths maps to the same key
+	*/
+	inline std::string normalizePath(const std::filesystem::path& file) {
+		return std::filesystem::absolute(file).lexically_normal().generic_string();
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <vector>
+#include <array>
+#include <cstddef>
+#include <type_traits>
+
+namespace rtre {
+
+	/*
+	Non-owning view of contiguous elements, a small stand in for std::span until the project moves to C++20
+	Views of const elements also bind to const containers and convert from views of the mutable type
+	*/
+	template<class T>
+	class Span {
+
+		typedef std::remove_const_t<T> Element;
+
+		T* m_Data = nullptr;
+		size_t m_Size = 0;
+
+	public:
+
+		Span() {}
+
+		Span(T* data, size_t size)
+			:
+			m_Data(data),
+			m_Size(size)
+		{
+		}
+
+		Span(std::vector<Element>& vector)
+			:
+			m_Data(vector.data()),
+			m_Size(vector.size())
+		{
+		}
+
+		template<class U = T, class = std::enable_if_t<std::is_const_v<U>>>
+		Span(const std::vector<Element>& vector)
+			:
+			m_Data(vector.data()),
+			m_Size(vector.size())
+		{
+		}
+
+		template<size_t n>
+		Span(std::array<Element, n>& array)
+			:
+			m_Data(array.data()),
+			m_Size(n)
+		{
+		}
+
+		template<size_t n, class U = T, class = std::enable_if_t<std::is_const_v<U>>>
+		Span(const std::array<Element, n>& array)
+			:
+			m_Data(array.data()),
+			m_Size(n)
+		{
+		}
+
+		template<class U = T, class = std::enable_if_t<std::is_const_v<U>>>
+		Span(const Span<Element>& other)
+			:
+			m_Data(other.data()),
+			m_Size(other.size())
+		{
+		}
+
+		inline T* data() const { return m_Data; }
+		inline size_t size() const { return m_Size; }
+		inline size_t bytes() const { return m_Size * sizeof(T); }
+		inline bool empty() const { return m_Size == 0; }
+
+		inline T* begin() const { return m_Data; }
+		inline T* end() const { return m_Data + m_Size; }
+		inline T& operator[](size_t i) const { return m_Data[i]; }
+
+		inline Span subspan(size_t offset, size_t count) const { return Span(m_Data + offset, count); }
+	};
+}
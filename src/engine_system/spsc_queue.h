@@ -0,0 +1,54 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace rtre {
+
+	/*
+	Bounded lock-free queue for exactly one producer thread and one consumer thread
+	One slot is kept empty to tell a full queue from an empty one, so it holds Capacity - 1 elements
+	*/
+	template<class T, std::size_t Capacity>
+	class SpscQueue {
+
+		static_assert(Capacity > 1, "SpscQueue needs at least two slots");
+
+		std::array<T, Capacity> m_Slots;
+		alignas(64) std::atomic<std::size_t> m_Head{ 0 };
+		alignas(64) std::atomic<std::size_t> m_Tail{ 0 };
+
+	public:
+
+		/*
+		Producer side, returns false when the queue is full
+		*/
+		bool push(T value) {
+			const std::size_t tail = m_Tail.load(std::memory_order_relaxed);
+			const std::size_t next = (tail + 1) % Capacity;
+			if (next == m_Head.load(std::memory_order_acquire))
+				return false;
+
+			m_Slots[tail] = std::move(value);
+			m_Tail.store(next, std::memory_order_release);
+			return true;
+		}
+
+		/*
+		Consumer side, returns false when the queue is empty
+		*/
+		bool pop(T& value) {
+			const std::size_t head = m_Head.load(std::memory_order_relaxed);
+			if (head == m_Tail.load(std::memory_order_acquire))
+				return false;
+
+			value = std::move(m_Slots[head]);
+			m_Head.store((head + 1) % Capacity, std::memory_order_release);
+			return true;
+		}
+
+		inline bool empty() const {
+			return m_Head.load(std::memory_order_acquire) == m_Tail.load(std::memory_order_acquire);
+		}
+	};
+}
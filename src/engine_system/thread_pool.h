@@ -0,0 +1,85 @@
+#pragma once
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <future>
+#include <functional>
+#include <algorithm>
+#include <type_traits>
+#include <condition_variable>
+
+namespace rtre {
+
+	/*
+	Fixed set of worker threads running submitted jobs in submission order
+	Meant for coarse jobs like decoding a file, the queue is a plain locked deque
+	Pending jobs are still run by the destructor before the workers are joined
+	*/
+	class ThreadPool {
+
+		std::vector<std::thread> m_Workers;
+		std::deque<std::function<void()>> m_Jobs;
+		std::mutex m_Mutex;
+		std::condition_variable m_Wake;
+		bool m_Stopping = false;
+
+		void work() {
+			for (;;) {
+				std::function<void()> job;
+				{
+					std::unique_lock<std::mutex> lock(m_Mutex);
+					m_Wake.wait(lock, [this]() { return m_Stopping || !m_Jobs.empty(); });
+					if (m_Jobs.empty())
+						return;
+					job = std::move(m_Jobs.front());
+					m_Jobs.pop_front();
+				}
+				job();
+			}
+		}
+
+	public:
+
+		/*
+		threads of 0 uses every hardware thread
+		*/
+		explicit ThreadPool(unsigned threads = 0) {
+			threads = threads ? threads : std::max(std::thread::hardware_concurrency(), 1u);
+			for (unsigned i = 0; i < threads; i++)
+				m_Workers.emplace_back(&ThreadPool::work, this);
+		}
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		~ThreadPool() {
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				m_Stopping = true;
+			}
+			m_Wake.notify_all();
+			for (auto& worker : m_Workers)
+				worker.join();
+		}
+
+		/*
+		Queues job() and returns a future for its result, exceptions it throws end up in the future
+		*/
+		template<class Job>
+		auto submit(Job job) -> std::future<std::invoke_result_t<Job>> {
+			using Result = std::invoke_result_t<Job>;
+			// std::function needs a copyable target, packaged_task isn't
+			auto task = std::make_shared<std::packaged_task<Result()>>(std::move(job));
+			std::future<Result> result = task->get_future();
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				m_Jobs.emplace_back([task]() { (*task)(); });
+			}
+			m_Wake.notify_one();
+			return result;
+		}
+
+		inline size_t threadCount() const { return m_Workers.size(); }
+	};
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace rtre {
+
+	/*
+	Lock-free hand-off of the latest value from one writer thread to one reader thread
+	The writer fills back() and publishes it, the reader picks up the most recent publication with update()
+	Neither side ever waits, intermediate values the reader didn't get to are dropped
+	*/
+	template<class T>
+	class TripleBuffer {
+
+		static constexpr uint8_t s_Fresh = 4;
+		static constexpr uint8_t s_Index = 3;
+
+		std::array<T, 3> m_Buffers;
+		alignas(64) std::atomic<uint8_t> m_Middle{ 1 };
+		alignas(64) uint8_t m_Back = 0;
+		alignas(64) uint8_t m_Front = 2;
+
+	public:
+
+		TripleBuffer(const T& initial = T()) {
+			m_Buffers.fill(initial);
+		}
+
+		/*
+		Writer side
+		*/
+		inline T& back() { return m_Buffers[m_Back]; }
+
+		inline void publish() {
+			m_Back = m_Middle.exchange(m_Back | s_Fresh, std::memory_order_acq_rel) & s_Index;
+		}
+
+		inline void write(const T& value) {
+			back() = value;
+			publish();
+		}
+
+		/*
+		Reader side, returns true if a new value was published since the last update
+		*/
+		inline bool update() {
+			if (!(m_Middle.load(std::memory_order_relaxed) & s_Fresh))
+				return false;
+			m_Front = m_Middle.exchange(m_Front, std::memory_order_acq_rel) & s_Index;
+			return true;
+		}
+
+		inline const T& front() const { return m_Buffers[m_Front]; }
+	};
+}
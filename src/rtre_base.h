@@ -39,6 +39,7 @@ namespace rtre {
 		if (!gladLoadGL()) {
 			throw std::exception("Could not load glad.\n");
 		}
+		glext::load();
 
 		setViewport(viewportWidth, viewportHeight);
 